@@ -0,0 +1,503 @@
+/**
+ * @file loadgen.c
+ * @brief Self-contained HTTP/1.1 load generator for the benchmark profiles
+ *
+ * Opens a fixed number of connections spread over worker threads (one
+ * epoll instance each), keeps a configurable number of pipelined requests
+ * in flight per connection and records every request's latency in a
+ * log-linear histogram. In close mode each request uses a fresh connection.
+ * Prints one JSON object with throughput and latency percentiles.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/** Sub-buckets per power of two (relative error below 1/64) */
+#define HIST_SUB_BITS 6
+#define HIST_SUB (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS) * HIST_SUB)
+
+/** Largest pipeline depth */
+#define MAX_PIPELINE 256
+
+/** Receive buffer per connection */
+#define RECV_SIZE 65536
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t max;
+} histogram_t;
+
+typedef struct {
+    const char *host;
+    uint16_t port;
+    const char *path;
+    const char *name;
+    int connections;
+    int threads;
+    int pipeline;
+    double duration;
+    double warmup;
+    bool close_mode;
+} options_t;
+
+typedef struct {
+    int fd;
+    bool connected;
+    int outstanding;                    /** Requests sent, response not complete */
+    uint64_t sent_ns[MAX_PIPELINE];     /** Send times, ring indexed by request */
+    unsigned sent_head;
+    unsigned sent_tail;
+    char *recv;
+    size_t recv_used;
+    size_t body_remaining;              /** Body bytes of the current response still expected */
+    bool in_body;
+    uint64_t responses;                 /** Responses completed on this connection */
+} connection_t;
+
+typedef struct {
+    pthread_t thread;
+    const options_t *options;
+    int first;
+    int count;
+    connection_t *connections;
+    histogram_t histogram;
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t reconnects;                /** Keep-alive connections the server closed between responses */
+    uint64_t bytes;
+} worker_t;
+
+static char request_keepalive[512];
+static char request_close[512];
+static size_t request_keepalive_length;
+static size_t request_close_length;
+static struct sockaddr_in target_address;
+static volatile uint64_t measure_start_ns;
+static volatile uint64_t measure_end_ns;
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline unsigned hist_index(uint64_t value)
+{
+    if (value < HIST_SUB) {
+        return (unsigned)value;
+    }
+    unsigned exponent = 63 - (unsigned)__builtin_clzll(value);
+    unsigned shift = exponent - HIST_SUB_BITS;
+    unsigned sub = (unsigned)(value >> shift) & (HIST_SUB - 1);
+    return (shift + 1) * HIST_SUB + sub;
+}
+
+static inline uint64_t hist_value(unsigned index)
+{
+    if (index < HIST_SUB) {
+        return index;
+    }
+    unsigned shift = index / HIST_SUB - 1;
+    uint64_t sub = index % HIST_SUB;
+    return (HIST_SUB + sub) << shift;
+}
+
+static void hist_record(histogram_t *h, uint64_t value)
+{
+    h->counts[hist_index(value)]++;
+    h->total++;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+static uint64_t hist_percentile(const histogram_t *h, double percentile)
+{
+    if (h->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)h->total);
+    if (rank >= h->total) {
+        rank = h->total - 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > rank) {
+            return hist_value(i);
+        }
+    }
+    return h->max;
+}
+
+static void connection_reset(connection_t *c)
+{
+    if (c->fd >= 0) {
+        close(c->fd);
+    }
+    c->fd = -1;
+    c->connected = false;
+    c->outstanding = 0;
+    c->sent_head = c->sent_tail = 0;
+    c->recv_used = 0;
+    c->body_remaining = 0;
+    c->in_body = false;
+    c->responses = 0;
+}
+
+static bool connection_open(int epfd, connection_t *c)
+{
+    connection_reset(c);
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return false;
+    }
+    int on = 1;
+    (void)setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    if (connect(fd, (struct sockaddr *)&target_address, sizeof(target_address)) == -1 &&
+        errno != EINPROGRESS) {
+        close(fd);
+        return false;
+    }
+
+    c->fd = fd;
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLET, .data.ptr = c };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        connection_reset(c);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Top the connection up to the pipeline depth
+ */
+static bool connection_send(connection_t *c, const options_t *o)
+{
+    int want = o->close_mode ? 1 : o->pipeline;
+    const char *request = o->close_mode ? request_close : request_keepalive;
+    size_t length = o->close_mode ? request_close_length : request_keepalive_length;
+
+    if (c->outstanding >= want) {
+        return true;
+    }
+
+    char batch[MAX_PIPELINE * sizeof(request_keepalive)];
+    size_t used = 0;
+    int count = want - c->outstanding;
+    for (int i = 0; i < count; i++) {
+        memcpy(batch + used, request, length);
+        used += length;
+    }
+
+    /* Short writes are rare at these sizes; treat them as a broken connection */
+    ssize_t n = send(c->fd, batch, used, MSG_NOSIGNAL);
+    if (n != (ssize_t)used) {
+        return n < 0 && errno == EAGAIN;
+    }
+
+    uint64_t t = now_ns();
+    for (int i = 0; i < count; i++) {
+        c->sent_ns[c->sent_tail++ % MAX_PIPELINE] = t;
+    }
+    c->outstanding += count;
+    return true;
+}
+
+/**
+ * @brief Consume complete responses from the receive buffer
+ * @return Number of completed responses, -1 on protocol error
+ */
+static int connection_parse(worker_t *w, connection_t *c)
+{
+    int completed = 0;
+    size_t offset = 0;
+
+    for (;;) {
+        if (c->in_body) {
+            size_t take = c->recv_used - offset < c->body_remaining ? c->recv_used - offset : c->body_remaining;
+            offset += take;
+            c->body_remaining -= take;
+            if (c->body_remaining > 0) {
+                break;
+            }
+            c->in_body = false;
+
+            uint64_t t = now_ns();
+            uint64_t sent = c->sent_ns[c->sent_head++ % MAX_PIPELINE];
+            c->outstanding--;
+            c->responses++;
+            completed++;
+            if (t >= measure_start_ns && t < measure_end_ns) {
+                hist_record(&w->histogram, t - sent);
+                w->requests++;
+            }
+            continue;
+        }
+
+        char *start = c->recv + offset;
+        size_t available = c->recv_used - offset;
+        char *end = memmem(start, available, "\r\n\r\n", 4);
+        if (!end) {
+            break;
+        }
+        if (available < 12 || memcmp(start, "HTTP/1.1 ", 9) != 0) {
+            return -1;
+        }
+        if (start[9] != '2') {
+            /* Non-2xx responses count as errors but are still framed */
+            w->errors++;
+        }
+
+        size_t header_length = (size_t)(end - start) + 4;
+        char *cl = memmem(start, header_length, "Content-Length:", 15);
+        if (!cl) {
+            return -1;
+        }
+        c->body_remaining = strtoul(cl + 15, NULL, 10);
+        c->in_body = true;
+        offset += header_length;
+    }
+
+    if (offset > 0) {
+        memmove(c->recv, c->recv + offset, c->recv_used - offset);
+        c->recv_used -= offset;
+    }
+    return completed;
+}
+
+static void *worker_main(void *arg)
+{
+    worker_t *w = arg;
+    const options_t *o = w->options;
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd == -1) {
+        return NULL;
+    }
+
+    for (int i = 0; i < w->count; i++) {
+        connection_t *c = &w->connections[i];
+        c->fd = -1;
+        c->recv = malloc(RECV_SIZE);
+        if (!c->recv || !connection_open(epfd, c)) {
+            w->errors++;
+        }
+    }
+
+    struct epoll_event events[256];
+    while (now_ns() < measure_end_ns) {
+        int n = epoll_wait(epfd, events, 256, 100);
+        for (int i = 0; i < n; i++) {
+            connection_t *c = events[i].data.ptr;
+            bool broken = (events[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+
+            if (!broken && (events[i].events & EPOLLOUT) && !c->connected) {
+                c->connected = true;
+                broken = !connection_send(c, o);
+            }
+
+            while (!broken && (events[i].events & EPOLLIN)) {
+                ssize_t r = recv(c->fd, c->recv + c->recv_used, RECV_SIZE - c->recv_used, 0);
+                if (r == 0) {
+                    broken = !o->close_mode || c->outstanding > 0;
+                    if (!broken) {
+                        /* Close mode: the server closed after our one response */
+                        connection_open(epfd, c);
+                    }
+                    break;
+                }
+                if (r < 0) {
+                    broken = errno != EAGAIN;
+                    break;
+                }
+                w->bytes += (uint64_t)r;
+                c->recv_used += (size_t)r;
+
+                int done = connection_parse(w, c);
+                if (done < 0) {
+                    broken = true;
+                    break;
+                }
+                if (done > 0 && !o->close_mode) {
+                    broken = !connection_send(c, o);
+                }
+                if (c->recv_used == RECV_SIZE) {
+                    broken = true;
+                }
+            }
+
+            if (broken) {
+                if (!o->close_mode && c->responses > 0 && c->recv_used == 0 && !c->in_body) {
+                    /* Server closed a reused connection between responses (e.g. while
+                     * draining): retry the unanswered requests like an HTTP client */
+                    w->reconnects++;
+                } else {
+                    w->errors++;
+                }
+                if (!connection_open(epfd, c)) {
+                    c->fd = -1;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < w->count; i++) {
+        connection_reset(&w->connections[i]);
+        free(w->connections[i].recv);
+    }
+    close(epfd);
+    return NULL;
+}
+
+static void usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [OPTIONS]\n"
+            "  -H ADDR   Server IPv4 address (default 127.0.0.1)\n"
+            "  -p PORT   Server port (default 2342)\n"
+            "  -u PATH   Request path (default /plaintext)\n"
+            "  -c N      Connections (default 64)\n"
+            "  -t N      Threads (default 1)\n"
+            "  -P N      Pipelined requests per connection (default 1)\n"
+            "  -d SEC    Measured duration (default 5)\n"
+            "  -w SEC    Warmup before measuring (default 1)\n"
+            "  -C        Connection: close, one request per connection\n"
+            "  -n NAME   Profile name in the report\n",
+            program);
+}
+
+int main(int argc, char *argv[])
+{
+    options_t o = {
+        .host = "127.0.0.1",
+        .port = 2342,
+        .path = "/plaintext",
+        .name = "custom",
+        .connections = 64,
+        .threads = 1,
+        .pipeline = 1,
+        .duration = 5,
+        .warmup = 1,
+        .close_mode = false
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "H:p:u:c:t:P:d:w:Cn:h")) != -1) {
+        switch (opt) {
+            case 'H': o.host = optarg; break;
+            case 'p': o.port = (uint16_t)atoi(optarg); break;
+            case 'u': o.path = optarg; break;
+            case 'c': o.connections = atoi(optarg); break;
+            case 't': o.threads = atoi(optarg); break;
+            case 'P': o.pipeline = atoi(optarg); break;
+            case 'd': o.duration = atof(optarg); break;
+            case 'w': o.warmup = atof(optarg); break;
+            case 'C': o.close_mode = true; break;
+            case 'n': o.name = optarg; break;
+            default: usage(argv[0]); return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (o.connections <= 0 || o.threads <= 0 || o.pipeline <= 0 || o.pipeline > MAX_PIPELINE ||
+        o.duration <= 0 || strlen(o.path) > 256) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (o.threads > o.connections) {
+        o.threads = o.connections;
+    }
+
+    /* 16k connections need more descriptors than the usual soft limit */
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        (void)setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    target_address.sin_family = AF_INET;
+    target_address.sin_port = htons(o.port);
+    if (inet_pton(AF_INET, o.host, &target_address.sin_addr) != 1) {
+        fprintf(stderr, "Invalid address: %s\n", o.host);
+        return EXIT_FAILURE;
+    }
+
+    request_keepalive_length = (size_t)snprintf(request_keepalive, sizeof(request_keepalive),
+                                                "GET %s HTTP/1.1\r\nHost: %s\r\n\r\n", o.path, o.host);
+    request_close_length = (size_t)snprintf(request_close, sizeof(request_close),
+                                            "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n",
+                                            o.path, o.host);
+
+    uint64_t start = now_ns();
+    measure_start_ns = start + (uint64_t)(o.warmup * 1e9);
+    measure_end_ns = measure_start_ns + (uint64_t)(o.duration * 1e9);
+
+    worker_t *workers = calloc((size_t)o.threads, sizeof(*workers));
+    connection_t *connections = calloc((size_t)o.connections, sizeof(*connections));
+    if (!workers || !connections) {
+        return EXIT_FAILURE;
+    }
+
+    int next = 0;
+    for (int i = 0; i < o.threads; i++) {
+        workers[i].options = &o;
+        workers[i].first = next;
+        workers[i].count = o.connections / o.threads + (i < o.connections % o.threads ? 1 : 0);
+        workers[i].connections = connections + next;
+        next += workers[i].count;
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    histogram_t *total = calloc(1, sizeof(*total));
+    uint64_t requests = 0, errors = 0, reconnects = 0, bytes = 0;
+    for (int i = 0; i < o.threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        for (unsigned b = 0; b < HIST_BUCKETS; b++) {
+            total->counts[b] += workers[i].histogram.counts[b];
+        }
+        total->total += workers[i].histogram.total;
+        if (workers[i].histogram.max > total->max) {
+            total->max = workers[i].histogram.max;
+        }
+        requests += workers[i].requests;
+        errors += workers[i].errors;
+        reconnects += workers[i].reconnects;
+        bytes += workers[i].bytes;
+    }
+
+    printf("{\"profile\":\"%s\",\"path\":\"%s\",\"connections\":%d,\"threads\":%d,"
+           "\"pipeline\":%d,\"keepalive\":%s,\"duration_s\":%.3f,\"requests\":%llu,"
+           "\"errors\":%llu,\"reconnects\":%llu,\"rps\":%.1f,\"mbps\":%.2f,"
+           "\"latency_us\":{\"p50\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}}\n",
+           o.name, o.path, o.connections, o.threads, o.pipeline, o.close_mode ? "false" : "true",
+           o.duration, (unsigned long long)requests, (unsigned long long)errors,
+           (unsigned long long)reconnects,
+           (double)requests / o.duration, (double)bytes * 8 / o.duration / 1e6,
+           (double)hist_percentile(total, 50) / 1e3, (double)hist_percentile(total, 99) / 1e3,
+           (double)hist_percentile(total, 99.9) / 1e3, (double)total->max / 1e3);
+
+    free(total);
+    free(connections);
+    free(workers);
+    return EXIT_SUCCESS;
+}
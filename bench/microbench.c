@@ -0,0 +1,707 @@
+/**
+ * @file microbench.c
+ * @brief Microbenchmarks for the domain layer hot paths
+ *
+ * Times http_response_build, http_response_calculate_size,
+ * http_server_parse_route, http_server_generate_response, http_parser_parse
+ * (for each available kernel), the JSON writer, the response cache and log_write in
+ * isolation and reports ns/op together with instructions and cache misses
+ * per operation from perf_event_open counters (shown as "-" when the kernel
+ * refuses them, e.g. with perf_event_paranoid > 2 or inside containers).
+ *
+ * Usage: microbench [-c CPU]... [-t MS] [-r REPS] [-f FILTER] [-j]
+ *   -c CPU     Pin to CPU before running; repeat to run once per CPU,
+ *              "none" runs unpinned (default: unpinned only)
+ *   -t MS      Target duration of one repetition (default 100)
+ *   -r REPS    Repetitions per case, the median is reported (default 5)
+ *   -f FILTER  Only run cases whose name contains FILTER
+ *   -j         Print one JSON object per case instead of a table
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include <dynamic.h>
+
+#include "../src/include/domain/http_response.h"
+#include "../src/include/domain/http_server.h"
+#include "../src/include/domain/json_writer.h"
+#include "../src/include/domain/response_cache.h"
+#include "../src/include/platform/log.h"
+#include "../src/include/platform/date_clock.h"
+#include "../src/include/platform/http_parser.h"
+
+#define MICROBENCH_MAX_CPUS 64
+#define MICROBENCH_MAX_REPS 31
+#define MICROBENCH_MAX_BODY (64 * 1024)
+#define MICROBENCH_MAX_TARGETS 4096
+
+/** Keep a value alive without otherwise constraining the compiler */
+#define MICROBENCH_SINK(value) __asm__ volatile("" : : "g"(value) : "memory")
+
+/** Counter values for one measured interval */
+typedef struct {
+    uint64_t nanoseconds;
+    uint64_t instructions;
+    uint64_t cache_misses;
+} microbench_sample_t;
+
+/** Hardware counter group, leader fd -1 if unavailable */
+typedef struct {
+    int leader;
+    int misses;
+    bool available;
+} microbench_counters_t;
+
+/** One benchmark case */
+typedef struct {
+    const char *name;
+    const char *param;
+    void (*run)(void *arg, uint64_t iterations);
+    void *arg;
+    uint64_t batch;                     /** Iterations between resets, 0 for no limit */
+    void (*reset)(void *arg);           /** Untimed work between batches */
+} microbench_case_t;
+
+typedef struct {
+    unsigned duration_ms;
+    unsigned repetitions;
+    const char *filter;
+    bool json;
+} microbench_options_t;
+
+static microbench_counters_t counters = { -1, -1, false };
+
+/* ---- Counters ---------------------------------------------------------- */
+
+static int microbench_perf_open(uint64_t config, int group)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+static void microbench_counters_open(void)
+{
+    counters.leader = microbench_perf_open(PERF_COUNT_HW_INSTRUCTIONS, -1);
+    if (counters.leader == -1) {
+        fprintf(stderr, "perf_event_open: %s; reporting time only\n", strerror(errno));
+        return;
+    }
+
+    counters.misses = microbench_perf_open(PERF_COUNT_HW_CACHE_MISSES, counters.leader);
+    counters.available = true;
+}
+
+static inline void microbench_counters_start(void)
+{
+    if (counters.available) {
+        ioctl(counters.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+static inline void microbench_counters_stop(void)
+{
+    if (counters.available) {
+        ioctl(counters.leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+static void microbench_counters_read(microbench_sample_t *sample)
+{
+    /* PERF_FORMAT_GROUP: nr followed by one value per event */
+    uint64_t values[3] = { 0 };
+    if (counters.available && read(counters.leader, values, sizeof(values)) > 0) {
+        sample->instructions = values[0] > 0 ? values[1] : 0;
+        sample->cache_misses = values[0] > 1 ? values[2] : 0;
+    }
+}
+
+static void microbench_counters_reset(void)
+{
+    if (counters.available) {
+        ioctl(counters.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+static inline uint64_t microbench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ---- Harness ----------------------------------------------------------- */
+
+/**
+ * @brief Run iterations of a case, excluding reset work from the sample
+ */
+static void microbench_measure(const microbench_case_t *bench, uint64_t iterations,
+                               microbench_sample_t *sample)
+{
+    memset(sample, 0, sizeof(*sample));
+    microbench_counters_reset();
+
+    uint64_t done = 0;
+    while (done < iterations) {
+        uint64_t chunk = iterations - done;
+        if (bench->batch && chunk > bench->batch) {
+            chunk = bench->batch;
+        }
+
+        uint64_t start = microbench_now_ns();
+        microbench_counters_start();
+        bench->run(bench->arg, chunk);
+        microbench_counters_stop();
+        sample->nanoseconds += microbench_now_ns() - start;
+
+        done += chunk;
+        if (bench->reset) {
+            bench->reset(bench->arg);
+        }
+    }
+
+    microbench_counters_read(sample);
+}
+
+static int microbench_compare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void microbench_run_case(const microbench_case_t *bench, const microbench_options_t *options,
+                                const char *cpu)
+{
+    if (options->filter && !strstr(bench->name, options->filter)) {
+        return;
+    }
+
+    /* Calibrate: grow the iteration count until one run takes ~1/10 of the target */
+    uint64_t iterations = 64;
+    microbench_sample_t sample;
+    for (;;) {
+        microbench_measure(bench, iterations, &sample);
+        if (sample.nanoseconds * 10 >= (uint64_t)options->duration_ms * 1000000ull ||
+            iterations >= (1ull << 34)) {
+            break;
+        }
+        iterations *= 2;
+    }
+    if (sample.nanoseconds > 0) {
+        iterations = iterations * (uint64_t)options->duration_ms * 1000000ull / sample.nanoseconds;
+    }
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    double ns[MICROBENCH_MAX_REPS], instructions[MICROBENCH_MAX_REPS], misses[MICROBENCH_MAX_REPS];
+    for (unsigned rep = 0; rep < options->repetitions; rep++) {
+        microbench_measure(bench, iterations, &sample);
+        ns[rep] = (double)sample.nanoseconds / (double)iterations;
+        instructions[rep] = (double)sample.instructions / (double)iterations;
+        misses[rep] = (double)sample.cache_misses / (double)iterations;
+    }
+
+    qsort(ns, options->repetitions, sizeof(double), microbench_compare);
+    qsort(instructions, options->repetitions, sizeof(double), microbench_compare);
+    qsort(misses, options->repetitions, sizeof(double), microbench_compare);
+    unsigned mid = options->repetitions / 2;
+
+    if (options->json) {
+        printf("{\"case\":\"%s\",\"param\":\"%s\",\"cpu\":\"%s\",\"iterations\":%llu,"
+               "\"ns_per_op\":%.2f,\"ns_min\":%.2f,", bench->name, bench->param, cpu,
+               (unsigned long long)iterations, ns[mid], ns[0]);
+        if (counters.available) {
+            printf("\"instructions_per_op\":%.1f,\"cache_misses_per_op\":%.4f}\n",
+                   instructions[mid], misses[mid]);
+        } else {
+            printf("\"instructions_per_op\":null,\"cache_misses_per_op\":null}\n");
+        }
+    } else if (counters.available) {
+        printf("%-20s %-24s %-5s %10.2f %10.2f %10.1f %10.4f\n", bench->name, bench->param, cpu,
+               ns[mid], ns[0], instructions[mid], misses[mid]);
+    } else {
+        printf("%-20s %-24s %-5s %10.2f %10.2f %10s %10s\n", bench->name, bench->param, cpu,
+               ns[mid], ns[0], "-", "-");
+    }
+    fflush(stdout);
+}
+
+/* ---- Cases ------------------------------------------------------------- */
+
+static char body_data[MICROBENCH_MAX_BODY];
+static char response_memory[MICROBENCH_MAX_BODY + 1024];
+
+typedef struct {
+    http_response_config_t config;
+    char param[32];
+} response_case_t;
+
+static void bench_response_build(void *arg, uint64_t iterations)
+{
+    response_case_t *c = arg;
+    http_response_buffer_t buffer;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        http_response_buffer_init(&buffer, response_memory, sizeof(response_memory));
+        http_response_build(&buffer, &c->config);
+        MICROBENCH_SINK(buffer.used);
+    }
+}
+
+static void bench_response_calculate_size(void *arg, uint64_t iterations)
+{
+    response_case_t *c = arg;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        size_t size = http_response_calculate_size(&c->config);
+        MICROBENCH_SINK(size);
+    }
+}
+
+typedef struct {
+    segment method;
+    segment *targets;
+    unsigned count;
+    unsigned next;
+    char param[32];
+} route_case_t;
+
+static void bench_parse_route(void *arg, uint64_t iterations)
+{
+    route_case_t *c = arg;
+    unsigned next = c->next;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        http_route_t route = http_server_parse_route(&c->method, &c->targets[next]);
+        MICROBENCH_SINK(route);
+        if (++next == c->count) {
+            next = 0;
+        }
+    }
+    c->next = next;
+}
+
+typedef struct {
+    http_server_t *server;
+    http_route_t route;
+} generate_case_t;
+
+static void bench_generate_response(void *arg, uint64_t iterations)
+{
+    generate_case_t *c = arg;
+    http_response_config_t config;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        http_server_generate_response(c->server, c->route, &config);
+        MICROBENCH_SINK(config.body_length);
+    }
+}
+
+typedef struct {
+    buffer output;
+    unsigned items;
+    const char *text;           /** String value of every item */
+    char param[32];
+} json_case_t;
+
+static void bench_json_write(void *arg, uint64_t iterations)
+{
+    json_case_t *c = arg;
+    json_writer_t writer;
+    size_t length = 0;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        c->output.size = 0;
+        json_writer_init(&writer, &c->output);
+        json_writer_begin_array(&writer);
+        for (unsigned item = 0; item < c->items; item++) {
+            json_writer_begin_object(&writer);
+            json_writer_key(&writer, "id", 2);
+            json_writer_uint(&writer, i * c->items + item);
+            json_writer_key(&writer, "ratio", 5);
+            json_writer_double(&writer, (double)item / 8);
+            json_writer_key(&writer, "name", 4);
+            json_writer_string(&writer, c->text, strlen(c->text));
+            json_writer_end_object(&writer);
+        }
+        json_writer_end_array(&writer);
+        json_writer_finish(&writer, &length);
+        MICROBENCH_SINK(length);
+    }
+}
+
+typedef struct {
+    response_cache_t cache;
+    const char *query;          /** Query of every request */
+    bool store;                 /** Replace the entry instead of looking it up */
+    const char *response;
+    size_t length;
+    char output[512];
+} cache_case_t;
+
+static void bench_response_cache(void *arg, uint64_t iterations)
+{
+    cache_case_t *c = arg;
+    size_t query_length = strlen(c->query);
+    response_cache_key_t key;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        response_cache_key(&key, ROUTE_JSON, c->query, query_length);
+        if (c->store) {
+            response_cache_store(&c->cache, &key, c->response, c->length, (size_t)-1, 0);
+            continue;
+        }
+        const response_cache_entry_t *entry = response_cache_lookup(&c->cache, &key, 0);
+        memcpy(c->output, entry->data, entry->length);
+        MICROBENCH_SINK(c->output[0]);
+    }
+}
+
+typedef struct {
+    const char *request;
+    size_t length;
+} parse_case_t;
+
+static void bench_http_parse(void *arg, uint64_t iterations)
+{
+    parse_case_t *c = arg;
+    http_parser_request_t request;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        http_parser_error_t err = http_parser_parse(c->request, c->length, &request);
+        MICROBENCH_SINK(err);
+        MICROBENCH_SINK(request.target_length);
+    }
+}
+
+static void bench_log_info(void *arg, uint64_t iterations)
+{
+    (void)arg;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        log_info("Processing request for route: %s (%llu)", "/plaintext", (unsigned long long)i);
+    }
+}
+
+static void bench_log_write(void *arg, uint64_t iterations)
+{
+    (void)arg;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        log_write(LOG_LEVEL_DEBUG, "Processing request for route: %s (%llu)", "/plaintext",
+                  (unsigned long long)i);
+    }
+}
+
+static void bench_log_drain(void *arg)
+{
+    (void)arg;
+    log_flush();
+}
+
+/** Distinct request targets for parse_route: hits, misses and query strings */
+static segment *microbench_make_targets(unsigned count, bool hits, bool query)
+{
+    static const char *const known[] = { "/plaintext", "/json" };
+    segment *targets = calloc(count, sizeof(*targets));
+    if (!targets) {
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        char path[64];
+        if (hits) {
+            snprintf(path, sizeof(path), "%s%s", known[i % 2], query ? "?id=42&x=y" : "");
+        } else {
+            snprintf(path, sizeof(path), "/static/asset-%u.js%s", i, query ? "?v=1" : "");
+        }
+        char *copy = strdup(path);
+        targets[i] = segment_make(copy, strlen(copy));
+    }
+    return targets;
+}
+
+static void microbench_run_all(const microbench_options_t *options, const char *cpu,
+                               http_server_t *server)
+{
+    static const size_t body_sizes[] = { 0, 13, 128, 1024, 4096, 16384, 65536 };
+    const size_t body_count = sizeof(body_sizes) / sizeof(body_sizes[0]);
+
+    for (size_t i = 0; i < body_count; i++) {
+        for (int with_date = 1; with_date >= 0; with_date--) {
+            response_case_t c = {
+                .config = {
+                    .status_code = HTTP_STATUS_OK,
+                    .content_type = CONTENT_TYPE_TEXT_PLAIN,
+                    .body = body_sizes[i] ? body_data : NULL,
+                    .body_length = body_sizes[i],
+                    .include_date_header = with_date
+                }
+            };
+            snprintf(c.param, sizeof(c.param), "body=%zu%s", body_sizes[i], with_date ? "" : ",nodate");
+
+            microbench_case_t build = { "response_build", c.param, bench_response_build, &c, 0, NULL };
+            microbench_run_case(&build, options, cpu);
+            if (with_date) {
+                microbench_case_t size = { "response_calc_size", c.param,
+                                           bench_response_calculate_size, &c, 0, NULL };
+                microbench_run_case(&size, options, cpu);
+            }
+        }
+    }
+
+    /* Router: working sets of distinct targets, hits and misses */
+    static const unsigned target_counts[] = { 1, 16, 256, MICROBENCH_MAX_TARGETS };
+    for (int kind = 0; kind < 3; kind++) {
+        bool hits = kind == 0, query = kind == 2;
+        for (size_t i = 0; i < sizeof(target_counts) / sizeof(target_counts[0]); i++) {
+            unsigned count = hits && target_counts[i] < 2 ? 1 : target_counts[i];
+            route_case_t c = { .method = segment_string("GET"), .count = count };
+            c.targets = microbench_make_targets(count, hits, query);
+            if (!c.targets) {
+                continue;
+            }
+            snprintf(c.param, sizeof(c.param), "%s,targets=%u",
+                     hits ? "hit" : query ? "miss+query" : "miss", count);
+
+            microbench_case_t route = { "parse_route", c.param, bench_parse_route, &c, 0, NULL };
+            microbench_run_case(&route, options, cpu);
+
+            for (unsigned t = 0; t < count; t++) {
+                free(c.targets[t].base);
+            }
+            free(c.targets);
+        }
+    }
+
+    const char *const *names = http_server_route_names();
+    for (int route = 0; route < ROUTE_COUNT; route++) {
+        generate_case_t c = { server, (http_route_t)route };
+        microbench_case_t generate = { "generate_response", names[route],
+                                       bench_generate_response, &c, 0, NULL };
+        microbench_run_case(&generate, options, cpu);
+    }
+
+    /* JSON writer: small and large documents, plain and escaped strings */
+    static const unsigned json_items[] = { 1, 16, 256 };
+    static const char *const json_texts[] = {
+        "Hello, World!",
+        "A longer product description that needs no escaping at all, padded out to 96 bytes.",
+        "Line one\nLine \"two\"\twith a tab and a \\ backslash"
+    };
+    for (size_t i = 0; i < sizeof(json_items) / sizeof(json_items[0]); i++) {
+        for (size_t t = 0; t < sizeof(json_texts) / sizeof(json_texts[0]); t++) {
+            json_case_t c = { .items = json_items[i], .text = json_texts[t] };
+            buffer_construct(&c.output);
+            snprintf(c.param, sizeof(c.param), "items=%u,%s", c.items,
+                     t == 0 ? "short" : t == 1 ? "long" : "escaped");
+            microbench_case_t json = { "json_write", c.param, bench_json_write, &c, 0, NULL };
+            microbench_run_case(&json, options, cpu);
+            buffer_destruct(&c.output);
+        }
+    }
+
+    /* Response cache: hits with and without a query to normalize, and replacing an entry */
+    static const char cached_response[] =
+        "HTTP/1.1 200 OK\r\nServer: L\r\nDate: Thu, 01 Jan 1970 00:00:00 GMT\r\n"
+        "Content-Type: application/json\r\nContent-Length: 27        \r\n\r\n"
+        "{\"message\":\"Hello, World!\"}";
+    static const char *const cache_queries[] = { "", "id=42&lang=en&v=3", "v=3&lang=en&id=42" };
+    for (int store = 0; store <= 1; store++) {
+        for (size_t q = 0; q < sizeof(cache_queries) / sizeof(cache_queries[0]); q++) {
+            if (store && q == 2) {
+                continue;
+            }
+            cache_case_t c = { .query = cache_queries[q], .store = store, .response = cached_response,
+                               .length = sizeof(cached_response) - 1 };
+            if (response_cache_init(&c.cache, HTTP_SERVER_RESPONSE_CACHE_ENTRIES, 1024 * 1024,
+                                    INT32_MAX) != RESPONSE_CACHE_OK) {
+                continue;
+            }
+            response_cache_key_t key;
+            response_cache_key(&key, ROUTE_JSON, c.query, strlen(c.query));
+            response_cache_store(&c.cache, &key, c.response, c.length, (size_t)-1, 0);
+
+            const char *param = store ? (q == 0 ? "store" : "store+query") :
+                                q == 0 ? "hit" : q == 1 ? "hit+query" : "hit+unsorted";
+            microbench_case_t cache = { "response_cache", param, bench_response_cache, &c, 0, NULL };
+            microbench_run_case(&cache, options, cpu);
+            response_cache_cleanup(&c.cache);
+        }
+    }
+
+    /* Request parser: every kernel this CPU supports, short and browser-sized heads */
+    static const char short_request[] = "GET /plaintext HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    static const char long_request[] =
+        "GET /static/app/bundle.js?v=20240101 HTTP/1.1\r\n"
+        "Host: server.tfb\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Language: en-US,en;q=0.5\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark; consent=yes\r\n"
+        "Connection: keep-alive\r\n\r\n";
+    static const char *const parsers[] = { "scalar", "sse4.2", "avx2", "neon" };
+    for (size_t i = 0; i < sizeof(parsers) / sizeof(parsers[0]); i++) {
+        if (http_parser_select(parsers[i]) != HTTP_PARSER_OK) {
+            continue;
+        }
+        char param[32];
+        parse_case_t short_case = { short_request, sizeof(short_request) - 1 };
+        snprintf(param, sizeof(param), "%s,%zuB", parsers[i], short_case.length);
+        microbench_case_t parse_short = { "http_parse", param, bench_http_parse, &short_case, 0, NULL };
+        microbench_run_case(&parse_short, options, cpu);
+
+        parse_case_t long_case = { long_request, sizeof(long_request) - 1 };
+        snprintf(param, sizeof(param), "%s,%zuB", parsers[i], long_case.length);
+        microbench_case_t parse_long = { "http_parse", param, bench_http_parse, &long_case, 0, NULL };
+        microbench_run_case(&parse_long, options, cpu);
+    }
+    http_parser_init();
+
+    /* Logger: call site filtered at runtime, and the full enqueue path */
+    log_set_level(LOG_LEVEL_WARN);
+    microbench_case_t filtered = { "log_info", "level=warn", bench_log_info, NULL, 0, NULL };
+    microbench_run_case(&filtered, options, cpu);
+
+    is_logging_disabled = true;
+    microbench_case_t disabled = { "log_write", "disabled", bench_log_write, NULL, 0, NULL };
+    microbench_run_case(&disabled, options, cpu);
+    is_logging_disabled = false;
+
+    log_set_level(LOG_LEVEL_DEBUG);
+    uint64_t dropped = log_dropped_count();
+    microbench_case_t enabled = { "log_write", "enabled,async", bench_log_write, NULL,
+                                  LOG_RING_SLOTS / 2, bench_log_drain };
+    microbench_run_case(&enabled, options, cpu);
+    if (log_dropped_count() != dropped) {
+        fprintf(stderr, "log_write: %llu lines dropped during the run\n",
+                (unsigned long long)(log_dropped_count() - dropped));
+    }
+}
+
+/** Affinity at startup, restored for "none" */
+static cpu_set_t initial_affinity;
+
+static bool microbench_pin(const char *cpu)
+{
+    cpu_set_t set = initial_affinity;
+    if (strcmp(cpu, "none") != 0) {
+        CPU_ZERO(&set);
+        CPU_SET(atoi(cpu), &set);
+    }
+
+    if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+        fprintf(stderr, "sched_setaffinity(%s): %s\n", cpu, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    microbench_options_t options = { .duration_ms = 100, .repetitions = 5 };
+    const char *cpus[MICROBENCH_MAX_CPUS];
+    unsigned cpu_count = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:t:r:f:jh")) != -1) {
+        switch (opt) {
+            case 'c':
+                if (cpu_count < MICROBENCH_MAX_CPUS) {
+                    cpus[cpu_count++] = optarg;
+                }
+                break;
+            case 't': options.duration_ms = (unsigned)atoi(optarg); break;
+            case 'r': options.repetitions = (unsigned)atoi(optarg); break;
+            case 'f': options.filter = optarg; break;
+            case 'j': options.json = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-c CPU|none]... [-t MS] [-r REPS] [-f FILTER] [-j]\n",
+                        argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (cpu_count == 0) {
+        cpus[cpu_count++] = "none";
+    }
+    if (options.duration_ms == 0) {
+        options.duration_ms = 1;
+    }
+    if (options.repetitions == 0 || options.repetitions > MICROBENCH_MAX_REPS) {
+        options.repetitions = 5;
+    }
+
+    memset(body_data, 'x', sizeof(body_data));
+    sched_getaffinity(0, sizeof(initial_affinity), &initial_affinity);
+
+    /* Enabled logging goes through the real rings and flusher, into /dev/null */
+    FILE *null_output = fopen("/dev/null", "w");
+    log_config_t log_config = log_default_config();
+    log_config.output = null_output ? null_output : stderr;
+    log_config.level = LOG_LEVEL_DEBUG;
+    log_config.async = true;
+
+    http_server_t *server = malloc(sizeof(*server));
+    http_server_config_t server_config = {
+        .plaintext_response = "Hello, World!",
+        .json_message = "Hello, World!",
+        .enable_date_headers = true
+    };
+
+    if (log_init(&log_config) != LOG_OK || http_response_init() != HTTP_RESPONSE_OK ||
+        http_server_init() != HTTP_SERVER_OK || !server ||
+        http_server_create(server, &server_config) != HTTP_SERVER_OK) {
+        fprintf(stderr, "initialization failed\n");
+        return 1;
+    }
+    date_clock_update();
+
+    microbench_counters_open();
+    if (!options.json) {
+        printf("%-20s %-24s %-5s %10s %10s %10s %10s\n", "case", "param", "cpu",
+               "ns/op", "ns/op min", "insn/op", "miss/op");
+    }
+
+    int status = 0;
+    for (unsigned i = 0; i < cpu_count; i++) {
+        if (!microbench_pin(cpus[i])) {
+            status = 1;
+            continue;
+        }
+        microbench_run_all(&options, cpus[i], server);
+    }
+
+    http_server_destroy(server);
+    free(server);
+    http_server_cleanup();
+    http_response_cleanup();
+    log_cleanup();
+    if (null_output) {
+        fclose(null_output);
+    }
+    return status;
+}
@@ -0,0 +1,194 @@
+#!/bin/bash
+# Run the HTTP benchmark profiles against libreactor-server, write a JSON
+# report and compare throughput with a stored baseline.
+#
+# Usage: bench/run-bench.sh [--baseline FILE] [--report FILE] [--update-baseline]
+#
+# Environment:
+#   BENCH_SERVER     Server binary (default ./libreactor-server)
+#   BENCH_LOADGEN    Load generator (default build/bench/loadgen)
+#   BENCH_PORT       Server port (default 2342)
+#   BENCH_DURATION   Measured seconds per profile (default 5)
+#   BENCH_THREADS    Load generator threads (default: half the CPUs, at least 1)
+#   BENCH_TOLERANCE  Allowed RPS drop against the baseline in percent (default 10)
+#   BENCH_PROFILES   Space-separated profile names to run (default: all)
+#   BENCH_BACKEND    Backend name recorded in the report
+
+set -u
+
+SERVER=${BENCH_SERVER:-./libreactor-server}
+LOADGEN=${BENCH_LOADGEN:-build/bench/loadgen}
+PORT=${BENCH_PORT:-2342}
+DURATION=${BENCH_DURATION:-5}
+THREADS=${BENCH_THREADS:-$(( $(nproc) / 2 > 0 ? $(nproc) / 2 : 1 ))}
+TOLERANCE=${BENCH_TOLERANCE:-10}
+BASELINE=""
+REPORT="build/bench/report.json"
+UPDATE_BASELINE=false
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --baseline) BASELINE=$2; shift ;;
+        --report) REPORT=$2; shift ;;
+        --update-baseline) UPDATE_BASELINE=true ;;
+        -h|--help) sed -n '2,17p' "$0"; exit 0 ;;
+        *) echo "Unknown option: $1" >&2; exit 2 ;;
+    esac
+    shift
+done
+
+# name path connections pipeline mode warmup_seconds
+PROFILES="
+plaintext-pipelined-64  /plaintext 64    16 keepalive 1
+plaintext-pipelined-512 /plaintext 512   16 keepalive 1
+json-1                  /json      1     1  keepalive 1
+json-64                 /json      64    1  keepalive 1
+json-512                /json      512   1  keepalive 1
+json-16k                /json      16384 1  keepalive 4
+json-close-1            /json      1     1  close     1
+json-close-64           /json      64    1  close     1
+"
+
+for tool in "$SERVER" "$LOADGEN"; do
+    if [ ! -x "$tool" ]; then
+        echo "Missing $tool (run make bench)" >&2
+        exit 2
+    fi
+done
+
+ulimit -n "$(ulimit -Hn)" 2>/dev/null
+mkdir -p "$(dirname "$REPORT")"
+
+# Sum utime+stime (clock ticks) of the server and its workers
+server_ticks() {
+    local total=0 pid
+    for pid in $SERVER_PID $(pgrep -P "$SERVER_PID"); do
+        if [ -r "/proc/$pid/stat" ]; then
+            total=$(( total + $(awk '{print $14 + $15}' "/proc/$pid/stat") ))
+        fi
+    done
+    echo "$total"
+}
+
+stop_server() {
+    if [ -n "${SERVER_PID:-}" ]; then
+        local workers
+        workers=$(pgrep -P "$SERVER_PID")
+        kill "$SERVER_PID" $workers 2>/dev/null
+        sleep 0.5
+        kill -9 "$SERVER_PID" $workers 2>/dev/null
+        wait "$SERVER_PID" 2>/dev/null
+        SERVER_PID=""
+    fi
+}
+trap stop_server EXIT
+
+"$SERVER" --disable-log >/dev/null 2>&1 &
+SERVER_PID=$!
+ready=false
+for _ in $(seq 50); do
+    if (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null; then
+        ready=true
+        break
+    fi
+    if ! kill -0 "$SERVER_PID" 2>/dev/null; then
+        wait "$SERVER_PID"
+        echo "$SERVER exited with status $? before listening on port $PORT" >&2
+        SERVER_PID=""
+        exit 2
+    fi
+    sleep 0.1
+done
+if ! $ready; then
+    echo "$SERVER not accepting connections on port $PORT after 5 s" >&2
+    exit 2
+fi
+
+CLK_TCK=$(getconf CLK_TCK)
+RESULTS=""
+SUMMARY=""
+
+while read -r name path connections pipeline mode warmup; do
+    [ -z "$name" ] && continue
+    if [ -n "${BENCH_PROFILES:-}" ] && ! [[ " $BENCH_PROFILES " == *" $name "* ]]; then
+        continue
+    fi
+
+    close_flag=""
+    [ "$mode" = "close" ] && close_flag="-C"
+
+    before=$(server_ticks)
+    line=$("$LOADGEN" -p "$PORT" -u "$path" -c "$connections" -t "$THREADS" -P "$pipeline" \
+                      -d "$DURATION" -w "$warmup" $close_flag -n "$name")
+    after=$(server_ticks)
+
+    # Ticks accumulate over warmup too; scale to the measured window
+    cpu=$(echo "$line" | awk -v b="$before" -v a="$after" -v hz="$CLK_TCK" \
+                             -v d="$DURATION" -v w="$warmup" '{
+        match($0, /"requests":[0-9]+/); req = substr($0, RSTART + 11, RLENGTH - 11);
+        us = (a - b) * 1e6 / hz * d / (d + w);
+        printf "%.3f", (req > 0 ? us / req : 0) }')
+    line="${line%\}},\"server_cpu_us_per_req\":$cpu}"
+
+    rps=$(echo "$line" | sed -n 's/.*"rps":\([0-9.]*\).*/\1/p')
+    p99=$(echo "$line" | sed -n 's/.*"p99":\([0-9.]*\).*/\1/p')
+    printf "%-24s %12s rps  p99 %10s us  cpu %8s us/req\n" "$name" "$rps" "$p99" "$cpu"
+
+    RESULTS="${RESULTS:+$RESULTS,
+}    $line"
+    SUMMARY="${SUMMARY}${name}	${rps}	${p99}
+"
+done <<< "$PROFILES"
+
+stop_server
+
+cat > "$REPORT" <<EOF
+{
+  "git_revision": "$(git rev-parse --short HEAD 2>/dev/null || echo unknown)",
+  "backend": "${BENCH_BACKEND:-unknown}",
+  "date": "$(date -u +%Y-%m-%dT%H:%M:%SZ)",
+  "cpus": $(nproc),
+  "loadgen_threads": $THREADS,
+  "duration_s": $DURATION,
+  "results": [
+$RESULTS
+  ]
+}
+EOF
+echo "Report written to $REPORT"
+
+if [ -z "$BASELINE" ]; then
+    exit 0
+fi
+
+if $UPDATE_BASELINE; then
+    {
+        echo "# profile	rps	p99_us  (bench/run-bench.sh --update-baseline, $(nproc) CPUs, $(date -u +%Y-%m-%d))"
+        printf "%s" "$SUMMARY"
+    } > "$BASELINE"
+    echo "Baseline updated: $BASELINE"
+    exit 0
+fi
+
+if [ ! -r "$BASELINE" ]; then
+    echo "No baseline at $BASELINE (create one with make bench-baseline)"
+    exit 0
+fi
+
+# Fail when any profile's throughput falls more than TOLERANCE percent below baseline
+printf "%s" "$SUMMARY" | awk -v tol="$TOLERANCE" -v baseline="$BASELINE" '
+    BEGIN {
+        FS = "\t"
+        while ((getline line < baseline) > 0) {
+            if (line ~ /^#/) continue
+            split(line, f, "\t"); base_rps[f[1]] = f[2]; base_p99[f[1]] = f[3]
+        }
+    }
+    {
+        if (!($1 in base_rps)) { printf "%-24s (no baseline)\n", $1; next }
+        change = base_rps[$1] > 0 ? ($2 - base_rps[$1]) * 100 / base_rps[$1] : 0
+        status = change < -tol ? "REGRESSION" : "ok"
+        if (status != "ok") failed = 1
+        printf "%-24s rps %+7.1f%%  p99 %10s -> %10s us  %s\n", $1, change, base_p99[$1], $3, status
+    }
+    END { exit failed }'
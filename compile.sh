@@ -1,13 +1,18 @@
 #!/bin/bash
 # Compile libreactor with optimizations
+#
+# Usage: ./compile.sh [release|portable|profiling|pgo]
+# The flags of each build profile are defined in the Makefile.
+
+PROFILE=${1:-release}
 
 echo "=== Compiling Libreactor with Optimizations ==="
 
 # Clean previous build
 make clean
 
-# Compile with maximum optimizations
-make CFLAGS="-std=gnu11 -Wall -Wextra -Wpedantic -O3 -march=native -flto -DNDEBUG -fomit-frame-pointer -funroll-loops" libreactor-server
+# Compile with the selected build profile
+make "$PROFILE"
 
 # Check if compilation succeeded
 if [ $? -eq 0 ]; then
@@ -4,31 +4,248 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 
 #include "../../include/domain/http_response.h"
+#include "../../include/platform/date_clock.h"
+#include "../../include/platform/hpack.h"
+
+/** Constant header bytes with their length */
+typedef struct {
+    const char *data;
+    size_t length;
+} http_response_fragment_t;
+
+#define HTTP_RESPONSE_FRAGMENT(text) { text, sizeof(text) - 1 }
+
+/** Content types and their media type */
+#define HTTP_RESPONSE_CONTENT_TYPES(X)                                          \
+    X(CONTENT_TYPE_TEXT_PLAIN, "text/plain")                                    \
+    X(CONTENT_TYPE_APPLICATION_JSON, "application/json")                        \
+    X(CONTENT_TYPE_TEXT_HTML, "text/html; charset=utf-8")                       \
+    X(CONTENT_TYPE_TEXT_CSS, "text/css")                                        \
+    X(CONTENT_TYPE_APPLICATION_JAVASCRIPT, "application/javascript")            \
+    X(CONTENT_TYPE_IMAGE_PNG, "image/png")                                      \
+    X(CONTENT_TYPE_IMAGE_JPEG, "image/jpeg")                                    \
+    X(CONTENT_TYPE_IMAGE_GIF, "image/gif")                                      \
+    X(CONTENT_TYPE_IMAGE_SVG, "image/svg+xml")                                  \
+    X(CONTENT_TYPE_IMAGE_ICON, "image/x-icon")                                  \
+    X(CONTENT_TYPE_APPLICATION_WASM, "application/wasm")                        \
+    X(CONTENT_TYPE_APPLICATION_OCTET_STREAM, "application/octet-stream")
+
+/** Status codes, their reason phrase and their HPACK static table index (0 if it has none) */
+#define HTTP_RESPONSE_STATUSES(X)                                               \
+    X(HTTP_STATUS_OK, "200 OK", HPACK_INDEX_STATUS_200)                         \
+    X(HTTP_STATUS_NOT_MODIFIED, "304 Not Modified", HPACK_INDEX_STATUS_304)     \
+    X(HTTP_STATUS_NOT_FOUND, "404 Not Found", HPACK_INDEX_STATUS_404)           \
+    X(HTTP_STATUS_METHOD_NOT_ALLOWED, "405 Method Not Allowed", 0)              \
+    X(HTTP_STATUS_INTERNAL_ERROR, "500 Internal Server Error", HPACK_INDEX_STATUS_500)
+
+#define HTTP_RESPONSE_CONTENT_TYPE_STRING(id, name) [id] = name,
+static const char *const content_type_strings[] = {
+    HTTP_RESPONSE_CONTENT_TYPES(HTTP_RESPONSE_CONTENT_TYPE_STRING)
+};
+#undef HTTP_RESPONSE_CONTENT_TYPE_STRING
 
-#define _GNU_SOURCE
-#include <dynamic.h>
-#include <reactor.h>
+/** Content-Type header and the name of the Content-Length header that always follows it */
+#define HTTP_RESPONSE_CONTENT_TYPE_FRAGMENT(id, name) \
+    [id] = HTTP_RESPONSE_FRAGMENT("Content-Type: " name "\r\nContent-Length: "),
+static const http_response_fragment_t content_type_fragments[] = {
+    HTTP_RESPONSE_CONTENT_TYPES(HTTP_RESPONSE_CONTENT_TYPE_FRAGMENT)
+};
+#undef HTTP_RESPONSE_CONTENT_TYPE_FRAGMENT
 
-/** Thread-local date header buffer */
-static __thread char date_header[38] = "Date: Thu, 01 Jan 1970 00:00:00 GMT\r\n";
+#define HTTP_RESPONSE_STATUS_STRING(id, reason, hpack) [id] = "HTTP/1.1 " reason "\r\n",
+static const char *const status_strings[] = {
+    HTTP_RESPONSE_STATUSES(HTTP_RESPONSE_STATUS_STRING)
+};
+#undef HTTP_RESPONSE_STATUS_STRING
 
-/** Content type strings */
-static const char *content_type_strings[] = {
-    [CONTENT_TYPE_TEXT_PLAIN] = "text/plain",
-    [CONTENT_TYPE_APPLICATION_JSON] = "application/json"
+/** Status line and the Server header that always follows it; empty for unknown codes */
+#define HTTP_RESPONSE_STATUS_FRAGMENT(id, reason, hpack) \
+    [id] = HTTP_RESPONSE_FRAGMENT("HTTP/1.1 " reason "\r\nServer: L\r\n"),
+static const http_response_fragment_t status_fragments[] = {
+    HTTP_RESPONSE_STATUSES(HTTP_RESPONSE_STATUS_FRAGMENT)
 };
+#undef HTTP_RESPONSE_STATUS_FRAGMENT
 
-/** Status line strings */
-static const char *status_strings[] = {
-    [HTTP_STATUS_OK] = "HTTP/1.1 200 OK\r\n",
-    [HTTP_STATUS_NOT_FOUND] = "HTTP/1.1 404 Not Found\r\n",
-    [HTTP_STATUS_INTERNAL_ERROR] = "HTTP/1.1 500 Internal Server Error\r\n"
+#define HTTP_RESPONSE_STATUS_INDEX(id, reason, hpack) [id] = hpack,
+static const uint8_t status_indexes[] = {
+    HTTP_RESPONSE_STATUSES(HTTP_RESPONSE_STATUS_INDEX)
 };
+#undef HTTP_RESPONSE_STATUS_INDEX
+
+/** HPACK literal of the Server value "L" */
+static const uint8_t hpack_server[] = { 0x0f, HPACK_INDEX_SERVER - 15, 0x01, 'L' };
+
+#define HTTP_RESPONSE_DATE_FIELD_LENGTH (sizeof("Date: \r\n") - 1 + HTTP_RESPONSE_DATE_LENGTH)
+#define HTTP_RESPONSE_MODIFIED_FIELD_LENGTH (sizeof("Last-Modified: \r\n") - 1 + HTTP_RESPONSE_DATE_LENGTH)
+
+/** File name extensions mapped to content types */
+static const struct {
+    const char *extension;
+    content_type_t type;
+} extension_types[] = {
+    { "html", CONTENT_TYPE_TEXT_HTML },
+    { "htm",  CONTENT_TYPE_TEXT_HTML },
+    { "txt",  CONTENT_TYPE_TEXT_PLAIN },
+    { "css",  CONTENT_TYPE_TEXT_CSS },
+    { "js",   CONTENT_TYPE_APPLICATION_JAVASCRIPT },
+    { "json", CONTENT_TYPE_APPLICATION_JSON },
+    { "png",  CONTENT_TYPE_IMAGE_PNG },
+    { "jpg",  CONTENT_TYPE_IMAGE_JPEG },
+    { "jpeg", CONTENT_TYPE_IMAGE_JPEG },
+    { "gif",  CONTENT_TYPE_IMAGE_GIF },
+    { "svg",  CONTENT_TYPE_IMAGE_SVG },
+    { "ico",  CONTENT_TYPE_IMAGE_ICON },
+    { "wasm", CONTENT_TYPE_APPLICATION_WASM }
+};
+
+/** Two ASCII digits for every value below 100 */
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const uint64_t powers_of_ten[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+    10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+};
+
+/**
+ * @brief Count the decimal digits of a value without a loop
+ */
+static inline size_t http_response_digit_count(uint64_t value)
+{
+    /* Setting bit 0 keeps the digit count and makes 0 count as one digit */
+    uint64_t v = value | 1;
+    unsigned t = ((64u - (unsigned)__builtin_clzll(v)) * 1233u) >> 12;
+    return t + 1 - (v < powers_of_ten[t]);
+}
+
+size_t http_response_format_uint(uint64_t value, char *digits)
+{
+    size_t length = http_response_digit_count(value);
+    char *p = digits + length;
+
+    while (value >= 100) {
+        unsigned pair = (unsigned)(value % 100) * 2;
+        value /= 100;
+        p -= 2;
+        memcpy(p, digit_pairs + pair, 2);
+    }
+    if (value >= 10) {
+        memcpy(p - 2, digit_pairs + value * 2, 2);
+    } else {
+        p[-1] = (char)('0' + value);
+    }
+
+    return length;
+}
+
+static inline const http_response_fragment_t *http_response_status_fragment(http_status_t status)
+{
+    if ((size_t)status >= sizeof(status_fragments) / sizeof(status_fragments[0]) ||
+        status_fragments[status].length == 0) {
+        return NULL;
+    }
+    return &status_fragments[status];
+}
+
+static inline const http_response_fragment_t *http_response_type_fragment(content_type_t type)
+{
+    if ((size_t)type >= sizeof(content_type_fragments) / sizeof(content_type_fragments[0])) {
+        return NULL;
+    }
+    return &content_type_fragments[type];
+}
+
+/**
+ * @brief Size of the headers including the blank line that ends them
+ * @return 0 for an unknown status or content type
+ */
+static size_t http_response_headers_size(const http_response_config_t *config)
+{
+    const http_response_fragment_t *status = http_response_status_fragment(config->status_code);
+    const http_response_fragment_t *type = http_response_type_fragment(config->content_type);
+    if (!status || !type) {
+        return 0;
+    }
+
+    return status->length +
+           (config->include_date_header ? HTTP_RESPONSE_DATE_FIELD_LENGTH : 0) +
+           type->length +
+           (config->deferred_length ? HTTP_RESPONSE_LENGTH_FIELD_WIDTH
+                                    : http_response_digit_count(config->body_length)) + 2 +
+           (config->allow ? sizeof("Allow: \r\n") - 1 + config->allow_length : 0) +
+           (config->etag ? sizeof("ETag: \r\n") - 1 + config->etag_length : 0) +
+           (config->last_modified ? HTTP_RESPONSE_MODIFIED_FIELD_LENGTH : 0) +
+           2;
+}
+
+/**
+ * @brief Write the headers of a validated configuration
+ * @return End of the headers
+ */
+static char *http_response_write_headers(char *ptr, const http_response_config_t *config)
+{
+    const http_response_fragment_t *status = &status_fragments[config->status_code];
+    const http_response_fragment_t *type = &content_type_fragments[config->content_type];
+
+    memcpy(ptr, status->data, status->length);
+    ptr += status->length;
+
+    if (config->include_date_header) {
+        /* Fixed-length value copied from the shared clock page */
+        memcpy(ptr, "Date: ", 6);
+        (void)date_clock_poll();
+        date_clock_read(ptr + 6);
+        memcpy(ptr + 6 + HTTP_RESPONSE_DATE_LENGTH, "\r\n", 2);
+        ptr += HTTP_RESPONSE_DATE_FIELD_LENGTH;
+    }
+
+    memcpy(ptr, type->data, type->length);
+    ptr += type->length;
+    if (config->deferred_length) {
+        /* Placeholder, closed up by http_response_set_length() */
+        memset(ptr, '0', HTTP_RESPONSE_LENGTH_FIELD_WIDTH);
+        ptr += HTTP_RESPONSE_LENGTH_FIELD_WIDTH;
+    } else {
+        ptr += http_response_format_uint(config->body_length, ptr);
+    }
+    memcpy(ptr, "\r\n", 2);
+    ptr += 2;
+
+    if (config->allow) {
+        memcpy(ptr, "Allow: ", 7);
+        memcpy(ptr + 7, config->allow, config->allow_length);
+        memcpy(ptr + 7 + config->allow_length, "\r\n", 2);
+        ptr += 9 + config->allow_length;
+    }
+
+    if (config->etag) {
+        memcpy(ptr, "ETag: ", 6);
+        memcpy(ptr + 6, config->etag, config->etag_length);
+        memcpy(ptr + 6 + config->etag_length, "\r\n", 2);
+        ptr += 8 + config->etag_length;
+    }
+
+    if (config->last_modified) {
+        memcpy(ptr, "Last-Modified: ", 15);
+        date_clock_format(config->last_modified, ptr + 15);
+        memcpy(ptr + 15 + HTTP_RESPONSE_DATE_LENGTH, "\r\n", 2);
+        ptr += HTTP_RESPONSE_MODIFIED_FIELD_LENGTH;
+    }
+
+    memcpy(ptr, "\r\n", 2);
+    return ptr + 2;
+}
 
 http_response_error_t http_response_init(void)
 {
@@ -47,179 +264,205 @@ size_t http_response_calculate_size(const http_response_config_t *config)
         return 0;
     }
 
-    size_t size = 0;
+    size_t headers = http_response_headers_size(config);
+    return headers ? headers + config->body_length : 0;
+}
 
-    /* Status line */
-    const char *status_str = http_response_status_string(config->status_code);
-    if (!status_str) {
-        return 0;
+http_response_error_t http_response_build(http_response_buffer_t *buffer,
+                                          const http_response_config_t *config)
+{
+    if (!buffer || !config || buffer->used > 0) {
+        return HTTP_RESPONSE_ERROR_INVALID_PARAM;
     }
-    size += strlen(status_str);
 
-    /* Server header */
-    size += strlen("Server: L\r\n");
+    size_t headers = http_response_headers_size(config);
+    if (headers == 0) {
+        return HTTP_RESPONSE_ERROR_INVALID_PARAM;
+    }
 
-    /* Date header (if requested) */
-    if (config->include_date_header) {
-        size += sizeof(date_header) - 1; /* -1 for null terminator */
+    /* One bounds check for the whole response */
+    size_t body_length = config->body ? config->body_length : 0;
+    if (headers + body_length > buffer->size) {
+        return HTTP_RESPONSE_ERROR_BUFFER_OVERFLOW;
     }
 
-    /* Content-Type header */
-    size += strlen("Content-Type: ");
-    const char *content_type_str = http_response_content_type_string(config->content_type);
-    if (!content_type_str) {
-        return 0;
+    char *ptr = http_response_write_headers(buffer->buffer, config);
+    if (body_length > 0) {
+        memcpy(ptr, config->body, body_length);
     }
-    size += strlen(content_type_str);
-    size += strlen("\r\n");
 
-    /* Content-Length header */
-    size += strlen("Content-Length: ");
-    /* Max content length is 10 digits for uint32_t max */
-    size += 10;
-    size += strlen("\r\n");
+    buffer->used = headers + body_length;
+    return HTTP_RESPONSE_OK;
+}
 
-    /* Header separator */
-    size += strlen("\r\n");
+size_t http_response_date_offset(const http_response_config_t *config)
+{
+    if (!config || !config->include_date_header) {
+        return (size_t)-1;
+    }
 
-    /* Body */
-    size += config->body_length;
+    const http_response_fragment_t *status = http_response_status_fragment(config->status_code);
+    if (!status) {
+        return (size_t)-1;
+    }
 
-    return size;
+    /* Status line, Server header, then "Date: " precede the value */
+    return status->length + 6;
 }
 
-http_response_error_t http_response_build(http_response_buffer_t *buffer,
-                                          const http_response_config_t *config)
+size_t http_response_length_offset(const http_response_config_t *config)
 {
-    if (!buffer || !config) {
-        return HTTP_RESPONSE_ERROR_INVALID_PARAM;
+    if (!config || !config->deferred_length) {
+        return (size_t)-1;
     }
 
-    if (buffer->used > 0) {
-        return HTTP_RESPONSE_ERROR_INVALID_PARAM; /* Buffer not reset */
+    const http_response_fragment_t *status = http_response_status_fragment(config->status_code);
+    const http_response_fragment_t *type = http_response_type_fragment(config->content_type);
+    if (!status || !type) {
+        return (size_t)-1;
     }
 
-    char *ptr = buffer->buffer;
-    size_t remaining = buffer->size;
+    return status->length + (config->include_date_header ? HTTP_RESPONSE_DATE_FIELD_LENGTH : 0) +
+           type->length;
+}
 
-    /* Status line */
-    const char *status_str = http_response_status_string(config->status_code);
-    if (!status_str) {
+http_response_error_t http_response_set_length(char *field, size_t tail_length,
+                                               size_t body_length, size_t *removed)
+{
+    if (!field || !removed) {
         return HTTP_RESPONSE_ERROR_INVALID_PARAM;
     }
-    size_t status_len = strlen(status_str);
-    if (status_len >= remaining) {
-        return HTTP_RESPONSE_ERROR_BUFFER_OVERFLOW;
-    }
-    memcpy(ptr, status_str, status_len);
-    ptr += status_len;
-    remaining -= status_len;
 
-    /* Server header */
-    const char *server_str = "Server: L\r\n";
-    size_t server_len = strlen(server_str);
-    if (server_len >= remaining) {
+    size_t digits = http_response_digit_count(body_length);
+    if (digits > HTTP_RESPONSE_LENGTH_FIELD_WIDTH) {
         return HTTP_RESPONSE_ERROR_BUFFER_OVERFLOW;
     }
-    memcpy(ptr, server_str, server_len);
-    ptr += server_len;
-    remaining -= server_len;
 
-    /* Date header (if requested) */
-    if (config->include_date_header) {
-        segment date_seg = http_date(0);
-        memcpy(date_header + 6, date_seg.base, date_seg.size);
-        date_header[6 + date_seg.size] = '\r';
-        date_header[6 + date_seg.size + 1] = '\n';
-        date_header[6 + date_seg.size + 2] = '\0';
-
-        size_t date_len = strlen(date_header);
-        if (date_len >= remaining) {
-            return HTTP_RESPONSE_ERROR_BUFFER_OVERFLOW;
-        }
-        memcpy(ptr, date_header, date_len);
-        ptr += date_len;
-        remaining -= date_len;
-    }
+    /* Close the unused part of the field; the tail is a short JSON body */
+    http_response_format_uint(body_length, field);
+    memmove(field + digits, field + HTTP_RESPONSE_LENGTH_FIELD_WIDTH, tail_length);
+    *removed = HTTP_RESPONSE_LENGTH_FIELD_WIDTH - digits;
+    return HTTP_RESPONSE_OK;
+}
 
-    /* Content-Type header */
-    const char *content_type_str = http_response_content_type_string(config->content_type);
-    if (!content_type_str) {
-        return HTTP_RESPONSE_ERROR_INVALID_PARAM;
-    }
+/**
+ * @brief Bytes ahead of the value of a literal with an indexed name
+ */
+static inline size_t http_response_hpack_prefix(unsigned name_index, size_t length)
+{
+    return hpack_literal_size(name_index, length) - length;
+}
 
-    const char *content_type_prefix = "Content-Type: ";
-    size_t content_type_prefix_len = strlen(content_type_prefix);
-    size_t content_type_len = strlen(content_type_str);
-    const char *content_type_suffix = "\r\n";
+/**
+ * @brief Size of the :status field; codes outside the static table are literals
+ */
+static inline size_t http_response_hpack_status_size(http_status_t status)
+{
+    return status_indexes[status] ? hpack_integer_size(status_indexes[status], 7)
+                                  : hpack_literal_size(HPACK_INDEX_STATUS_200, 3);
+}
 
-    if (content_type_prefix_len + content_type_len + 2 >= remaining) {
-        return HTTP_RESPONSE_ERROR_BUFFER_OVERFLOW;
+static inline size_t http_response_hpack_status(uint8_t *out, http_status_t status)
+{
+    if (status_indexes[status]) {
+        return hpack_encode_indexed(out, status_indexes[status]);
     }
 
-    memcpy(ptr, content_type_prefix, content_type_prefix_len);
-    ptr += content_type_prefix_len;
-    remaining -= content_type_prefix_len;
+    char code[3] = { (char)('0' + status / 100), (char)('0' + status / 10 % 10), (char)('0' + status % 10) };
+    return hpack_encode_literal(out, HPACK_INDEX_STATUS_200, code, sizeof(code));
+}
 
-    memcpy(ptr, content_type_str, content_type_len);
-    ptr += content_type_len;
-    remaining -= content_type_len;
+size_t http_response_hpack_size(const http_response_config_t *config)
+{
+    if (!config || !http_response_status_fragment(config->status_code) ||
+        !http_response_type_fragment(config->content_type)) {
+        return 0;
+    }
 
-    memcpy(ptr, content_type_suffix, 2);
-    ptr += 2;
-    remaining -= 2;
+    const char *type = content_type_strings[config->content_type];
+    return http_response_hpack_status_size(config->status_code) +
+           sizeof(hpack_server) +
+           (config->include_date_header ? hpack_literal_size(HPACK_INDEX_DATE, HTTP_RESPONSE_DATE_LENGTH) : 0) +
+           hpack_literal_size(HPACK_INDEX_CONTENT_TYPE, strlen(type)) +
+           (config->deferred_length ? 0 :
+            hpack_literal_size(HPACK_INDEX_CONTENT_LENGTH, http_response_digit_count(config->body_length))) +
+           (config->allow ? hpack_literal_size(HPACK_INDEX_ALLOW, config->allow_length) : 0) +
+           (config->etag ? hpack_literal_size(HPACK_INDEX_ETAG, config->etag_length) : 0) +
+           (config->last_modified ? hpack_literal_size(HPACK_INDEX_LAST_MODIFIED, HTTP_RESPONSE_DATE_LENGTH) : 0);
+}
 
-    /* Content-Length header */
-    const char *content_length_prefix = "Content-Length: ";
-    size_t content_length_prefix_len = strlen(content_length_prefix);
+http_response_error_t http_response_build_hpack(http_response_buffer_t *buffer,
+                                                const http_response_config_t *config)
+{
+    if (!buffer || !config || buffer->used > 0) {
+        return HTTP_RESPONSE_ERROR_INVALID_PARAM;
+    }
 
-    /* Convert body length to string */
-    char length_str[16];
-    int length_str_len = snprintf(length_str, sizeof(length_str), "%zu", config->body_length);
-    if (length_str_len < 0 || (size_t)length_str_len >= sizeof(length_str)) {
+    size_t size = http_response_hpack_size(config);
+    if (size == 0) {
         return HTTP_RESPONSE_ERROR_INVALID_PARAM;
     }
+    if (size > buffer->size) {
+        return HTTP_RESPONSE_ERROR_BUFFER_OVERFLOW;
+    }
 
-    const char *content_length_suffix = "\r\n";
+    /* Same fields and order as HTTP/1.1, lowercase names from the static table */
+    uint8_t *out = (uint8_t *)buffer->buffer;
+    out += http_response_hpack_status(out, config->status_code);
+    memcpy(out, hpack_server, sizeof(hpack_server));
+    out += sizeof(hpack_server);
 
-    if (content_length_prefix_len + length_str_len + 2 >= remaining) {
-        return HTTP_RESPONSE_ERROR_BUFFER_OVERFLOW;
+    if (config->include_date_header) {
+        char date[HTTP_RESPONSE_DATE_LENGTH];
+        (void)date_clock_poll();
+        date_clock_read(date);
+        out += hpack_encode_literal(out, HPACK_INDEX_DATE, date, sizeof(date));
     }
 
-    memcpy(ptr, content_length_prefix, content_length_prefix_len);
-    ptr += content_length_prefix_len;
-    remaining -= content_length_prefix_len;
+    const char *type = content_type_strings[config->content_type];
+    out += hpack_encode_literal(out, HPACK_INDEX_CONTENT_TYPE, type, strlen(type));
 
-    memcpy(ptr, length_str, length_str_len);
-    ptr += length_str_len;
-    remaining -= length_str_len;
+    if (!config->deferred_length) {
+        char digits[HTTP_RESPONSE_UINT_MAX_DIGITS];
+        size_t length = http_response_format_uint(config->body_length, digits);
+        out += hpack_encode_literal(out, HPACK_INDEX_CONTENT_LENGTH, digits, length);
+    }
 
-    memcpy(ptr, content_length_suffix, 2);
-    ptr += 2;
-    remaining -= 2;
+    if (config->allow) {
+        out += hpack_encode_literal(out, HPACK_INDEX_ALLOW, config->allow, config->allow_length);
+    }
 
-    /* Header separator */
-    if (2 >= remaining) {
-        return HTTP_RESPONSE_ERROR_BUFFER_OVERFLOW;
+    if (config->etag) {
+        out += hpack_encode_literal(out, HPACK_INDEX_ETAG, config->etag, config->etag_length);
     }
-    memcpy(ptr, "\r\n", 2);
-    ptr += 2;
-    remaining -= 2;
 
-    /* Body */
-    if (config->body && config->body_length > 0) {
-        if (config->body_length >= remaining) {
-            return HTTP_RESPONSE_ERROR_BUFFER_OVERFLOW;
-        }
-        memcpy(ptr, config->body, config->body_length);
-        ptr += config->body_length;
-        remaining -= config->body_length;
+    if (config->last_modified) {
+        char modified[HTTP_RESPONSE_DATE_LENGTH];
+        date_clock_format(config->last_modified, modified);
+        out += hpack_encode_literal(out, HPACK_INDEX_LAST_MODIFIED, modified, sizeof(modified));
     }
 
-    buffer->used = buffer->size - remaining;
+    buffer->used = size;
     return HTTP_RESPONSE_OK;
 }
 
+size_t http_response_hpack_date_offset(const http_response_config_t *config)
+{
+    if (!config || !config->include_date_header || !http_response_status_fragment(config->status_code)) {
+        return (size_t)-1;
+    }
+
+    return http_response_hpack_status_size(config->status_code) + sizeof(hpack_server) +
+           http_response_hpack_prefix(HPACK_INDEX_DATE, HTTP_RESPONSE_DATE_LENGTH);
+}
+
+size_t http_response_hpack_length(char *field, size_t body_length)
+{
+    char digits[HTTP_RESPONSE_UINT_MAX_DIGITS];
+    size_t length = http_response_format_uint(body_length, digits);
+    return hpack_encode_literal((uint8_t *)field, HPACK_INDEX_CONTENT_LENGTH, digits, length);
+}
+
 http_response_error_t http_response_buffer_init(http_response_buffer_t *buffer,
                                                 char *buffer_ptr,
                                                 size_t buffer_size)
@@ -250,16 +493,36 @@ const char *http_response_content_type_string(content_type_t type)
     return content_type_strings[type];
 }
 
+content_type_t http_response_content_type_for_path(const char *path, size_t length)
+{
+    const char *dot = NULL;
+    for (size_t i = length; i > 0; i--) {
+        if (path[i - 1] == '.') {
+            dot = path + i;
+            break;
+        }
+        if (path[i - 1] == '/') {
+            break;
+        }
+    }
+
+    if (dot) {
+        size_t extension_length = (size_t)(path + length - dot);
+        for (size_t i = 0; i < sizeof(extension_types) / sizeof(extension_types[0]); i++) {
+            if (strlen(extension_types[i].extension) == extension_length &&
+                strncasecmp(extension_types[i].extension, dot, extension_length) == 0) {
+                return extension_types[i].type;
+            }
+        }
+    }
+
+    return CONTENT_TYPE_APPLICATION_OCTET_STREAM;
+}
+
 const char *http_response_status_string(http_status_t status)
 {
-    switch (status) {
-        case HTTP_STATUS_OK:
-            return status_strings[HTTP_STATUS_OK];
-        case HTTP_STATUS_NOT_FOUND:
-            return status_strings[HTTP_STATUS_NOT_FOUND];
-        case HTTP_STATUS_INTERNAL_ERROR:
-            return status_strings[HTTP_STATUS_INTERNAL_ERROR];
-        default:
-            return NULL;
+    if ((size_t)status >= sizeof(status_strings) / sizeof(status_strings[0])) {
+        return NULL;
     }
+    return status_strings[status];
 }
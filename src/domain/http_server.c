@@ -3,18 +3,212 @@
  * @brief Implementation of HTTP server business logic
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
-#define _GNU_SOURCE
 #include <dynamic.h>
 #include <reactor.h>
-#include <clo.h>
 
 #include "../../include/domain/http_server.h"
 #include "../../include/domain/http_response.h"
+#include "../../include/domain/json_writer.h"
+#include "../../include/domain/response_cache.h"
 #include "../../include/platform/log.h"
+#include "../../include/platform/metrics.h"
+#include "../../include/platform/date_clock.h"
+#include "../../include/platform/file_cache.h"
+#include "../../include/platform/system.h"
+#include "../../include/platform/trace.h"
+
+/** Files up to this size are served from memory, larger ones are spliced */
+#ifdef REACTOR_STREAM_ZERO_COPY
+#define HTTP_SERVER_FILE_MEMORY_LIMIT FILE_CACHE_DEFAULT_MEMORY_LIMIT
+#else
+#define HTTP_SERVER_FILE_MEMORY_LIMIT SIZE_MAX
+#endif
+
+/** Route handler invoked through the dispatch table */
+typedef http_server_error_t (*http_route_handler_t)(http_server_t *server,
+                                                    server_context *context,
+                                                    http_route_t route);
+
+/** Route table entry */
+typedef struct {
+    const char *method;
+    const char *path;
+    size_t method_length;
+    size_t path_length;
+} http_route_entry_t;
+
+/** Router hash table size (power of two, at least 4x the route count) */
+#define ROUTER_SLOTS 256
+
+/** Perfect hash over (length, first word, last word) of the route path */
+typedef struct {
+    uint64_t seed;
+    unsigned shift;
+    uint8_t slots[ROUTER_SLOTS];        /** http_route_t per slot, ROUTE_UNKNOWN if empty */
+    bool ready;
+} http_router_t;
+
+static http_server_error_t http_server_handle_static(http_server_t *server,
+                                                     server_context *context,
+                                                     http_route_t route);
+static http_server_error_t http_server_handle_json(http_server_t *server,
+                                                   server_context *context,
+                                                   http_route_t route);
+static http_server_error_t http_server_handle_fallback(http_server_t *server,
+                                                       server_context *context,
+                                                       http_route_t route);
+
+#define HTTP_SERVER_ROUTE_ENTRY(id, m, p, handler, cacheable) \
+    [id] = { .method = m, .path = p, .method_length = sizeof(m) - 1, .path_length = sizeof(p) - 1 },
+static const http_route_entry_t route_entries[ROUTE_UNKNOWN] = {
+    HTTP_SERVER_ROUTES(HTTP_SERVER_ROUTE_ENTRY)
+};
+#undef HTTP_SERVER_ROUTE_ENTRY
+
+#define HTTP_SERVER_ROUTE_NAME(id, m, p, handler, cacheable) [id] = p,
+static const char *const route_names[ROUTE_COUNT] = {
+    HTTP_SERVER_ROUTES(HTTP_SERVER_ROUTE_NAME)
+    [ROUTE_UNKNOWN] = "unknown"
+};
+#undef HTTP_SERVER_ROUTE_NAME
+
+#define HTTP_SERVER_ROUTE_HANDLER(id, m, p, handler, cacheable) [id] = handler,
+static const http_route_handler_t route_handlers[ROUTE_COUNT] = {
+    HTTP_SERVER_ROUTES(HTTP_SERVER_ROUTE_HANDLER)
+    [ROUTE_UNKNOWN] = http_server_handle_fallback
+};
+#undef HTTP_SERVER_ROUTE_HANDLER
+
+#define HTTP_SERVER_ROUTE_CACHEABLE(id, m, p, handler, cacheable) [id] = cacheable,
+static const bool route_cacheable[ROUTE_COUNT] = {
+    HTTP_SERVER_ROUTES(HTTP_SERVER_ROUTE_CACHEABLE)
+    [ROUTE_UNKNOWN] = false
+};
+#undef HTTP_SERVER_ROUTE_CACHEABLE
+
+_Static_assert(ROUTE_COUNT * 4 <= ROUTER_SLOTS, "ROUTER_SLOTS too small for route table");
+_Static_assert(ROUTE_COUNT <= UINT8_MAX, "route ids must fit in router slots");
+
+static http_router_t router;
+
+/**
+ * @brief Check for a HEAD request, which is answered like GET without the body
+ */
+static inline bool http_server_is_head(const server_context *context)
+{
+    const segment *method = &context->request.method;
+    return method->size == 4 && memcmp(method->base, "HEAD", 4) == 0;
+}
+
+/**
+ * @brief Load up to 8 bytes of the path at offset as a zero-padded word
+ */
+static inline uint64_t router_load_word(const char *path, size_t length, size_t offset)
+{
+    uint64_t word = 0;
+    if (length >= 8) {
+        memcpy(&word, path + offset, 8);
+    } else {
+        memcpy(&word, path, length);
+    }
+    return word;
+}
+
+static inline unsigned router_hash(const http_router_t *r, const char *path, size_t length)
+{
+    uint64_t first = router_load_word(path, length, 0);
+    uint64_t last = router_load_word(path, length, length >= 8 ? length - 8 : 0);
+    uint64_t h = (first ^ (last * 0x9e3779b97f4a7c15ull) ^ length) * r->seed;
+    return (unsigned)(h >> r->shift);
+}
+
+/**
+ * @brief Find a seed that maps every route path to a distinct slot
+ */
+static http_server_error_t router_build(http_router_t *r)
+{
+    unsigned bits = 0;
+    while ((1u << bits) < ROUTER_SLOTS) {
+        bits++;
+    }
+    r->shift = 64 - bits;
+
+    uint64_t seed = 0x2545f4914f6cdd1dull;
+    for (int attempt = 0; attempt < 100000; attempt++) {
+        r->seed = seed | 1;
+        memset(r->slots, ROUTE_UNKNOWN, sizeof(r->slots));
+
+        bool collision = false;
+        for (int route = 0; route < ROUTE_UNKNOWN && !collision; route++) {
+            unsigned slot = router_hash(r, route_entries[route].path, route_entries[route].path_length);
+            if (r->slots[slot] != ROUTE_UNKNOWN) {
+                collision = true;
+            } else {
+                r->slots[slot] = (uint8_t)route;
+            }
+        }
+
+        if (!collision) {
+            r->ready = true;
+            return HTTP_SERVER_OK;
+        }
+
+        /* xorshift to the next candidate seed */
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+    }
+
+    log_error("Router: no collision-free hash found for %d routes", ROUTE_UNKNOWN);
+    return HTTP_SERVER_ERROR_INVALID_PARAM;
+}
+
+/**
+ * @brief Look up the route for a target, reporting the path match apart from the method match
+ * @param[out] path_route Route whose path matches, whatever the method; ROUTE_UNKNOWN if none
+ * @return Route matching both path and method (any method if NULL), ROUTE_UNKNOWN otherwise
+ */
+static http_route_t router_lookup(const segment *method, const segment *target, http_route_t *path_route)
+{
+    *path_route = ROUTE_UNKNOWN;
+    if (!target || !target->base || !router.ready) {
+        return ROUTE_UNKNOWN;
+    }
+
+    /* Strip the query string */
+    const char *path = target->base;
+    size_t length = target->size;
+    const char *query = memchr(path, '?', length);
+    if (query) {
+        length = (size_t)(query - path);
+    }
+
+    /* Single probe, then verify the candidate */
+    unsigned route = router.slots[router_hash(&router, path, length)];
+    if (route == ROUTE_UNKNOWN) {
+        return ROUTE_UNKNOWN;
+    }
+
+    const http_route_entry_t *entry = &route_entries[route];
+    if (entry->path_length != length || memcmp(entry->path, path, length) != 0) {
+        return ROUTE_UNKNOWN;
+    }
+    *path_route = (http_route_t)route;
+
+    if (method && (entry->method_length != method->size ||
+                   memcmp(entry->method, method->base, method->size) != 0)) {
+        return ROUTE_UNKNOWN;
+    }
+
+    return (http_route_t)route;
+}
 
 http_server_error_t http_server_init(void)
 {
@@ -23,6 +217,13 @@ http_server_error_t http_server_init(void)
         return HTTP_SERVER_ERROR_INVALID_PARAM;
     }
 
+    if (!router.ready) {
+        http_server_error_t err = router_build(&router);
+        if (err != HTTP_SERVER_OK) {
+            return err;
+        }
+    }
+
     return HTTP_SERVER_OK;
 }
 
@@ -31,6 +232,109 @@ void http_server_cleanup(void)
     http_response_cleanup();
 }
 
+/**
+ * @brief Prebuild the complete response for a static route
+ */
+static http_server_error_t http_server_build_cached(http_server_t *server, http_route_t route)
+{
+    http_cached_response_t *cached = &server->cached_responses[route];
+    http_response_config_t response_config;
+
+    http_server_error_t err = http_server_generate_response(server, route, &response_config);
+    if (err != HTTP_SERVER_OK) {
+        return err;
+    }
+
+    if (http_response_calculate_size(&response_config) > sizeof(cached->buffer)) {
+        return HTTP_SERVER_ERROR_MEMORY;
+    }
+
+    http_response_buffer_t buffer;
+    if (http_response_buffer_init(&buffer, cached->buffer, sizeof(cached->buffer)) != HTTP_RESPONSE_OK ||
+        http_response_build(&buffer, &response_config) != HTTP_RESPONSE_OK) {
+        return HTTP_SERVER_ERROR_RESPONSE_BUILD;
+    }
+
+    cached->length = buffer.used;
+    cached->date_offset = http_response_date_offset(&response_config);
+    cached->length_offset = http_response_length_offset(&response_config);
+    cached->body_offset = buffer.used - response_config.body_length;
+
+    http_response_buffer_t block;
+    if (http_response_hpack_size(&response_config) > sizeof(cached->hpack)) {
+        return HTTP_SERVER_ERROR_MEMORY;
+    }
+    if (http_response_buffer_init(&block, cached->hpack, sizeof(cached->hpack)) != HTTP_RESPONSE_OK ||
+        http_response_build_hpack(&block, &response_config) != HTTP_RESPONSE_OK) {
+        return HTTP_SERVER_ERROR_RESPONSE_BUILD;
+    }
+
+    cached->hpack_length = block.used;
+    cached->hpack_date_offset = http_response_hpack_date_offset(&response_config);
+    return HTTP_SERVER_OK;
+}
+
+/**
+ * @brief Copy a cached response into the connection output
+ */
+static void http_server_send_cached(const http_cached_response_t *cached,
+                                    server_context *context)
+{
+    char *base = stream_allocate(&context->session->stream, cached->length);
+    memcpy(base, cached->buffer, cached->length);
+}
+
+#ifdef REACTOR_SERVER_HTTP2
+/**
+ * @brief Answer an HTTP/2 stream with a cached header block and body
+ */
+static void http_server_send_cached_http2(const http_cached_response_t *cached,
+                                          server_context *context)
+{
+    /* content-length stays in the block, so HEAD gets it without the DATA frames */
+    size_t body_length = http_server_is_head(context) ? 0 : cached->length - cached->body_offset;
+    server_http2_respond(context, segment_make((void *)cached->hpack, cached->hpack_length),
+                         segment_make((void *)(cached->buffer + cached->body_offset), body_length));
+}
+#endif
+
+/**
+ * @brief Move the configured strings into one block owned by the server
+ */
+static bool http_server_copy_strings(http_server_t *server)
+{
+    const char **strings[] = {
+        &server->config.plaintext_response,
+        &server->config.json_message,
+        &server->config.document_root
+    };
+    size_t count = sizeof(strings) / sizeof(strings[0]);
+
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++) {
+        size += *strings[i] ? strlen(*strings[i]) + 1 : 0;
+    }
+    if (size == 0) {
+        return true;
+    }
+
+    server->strings = system_malloc(size);
+    if (!server->strings) {
+        return false;
+    }
+
+    char *next = server->strings;
+    for (size_t i = 0; i < count; i++) {
+        if (*strings[i]) {
+            size_t length = strlen(*strings[i]) + 1;
+            memcpy(next, *strings[i], length);
+            *strings[i] = next;
+            next += length;
+        }
+    }
+    return true;
+}
+
 http_server_error_t http_server_create(http_server_t *server,
                                          const http_server_config_t *config)
 {
@@ -40,20 +344,45 @@ http_server_error_t http_server_create(http_server_t *server,
 
     memset(server, 0, sizeof(*server));
 
-    /* Copy configuration */
+    /* Copy configuration, strings included */
     server->config = *config;
+    if (!http_server_copy_strings(server)) {
+        return HTTP_SERVER_ERROR_MEMORY;
+    }
 
-    /* Prepare JSON buffer */
-    if (config->json_message) {
-        /* Manually create JSON object: {"message": "value"} */
-        /* Format: {"message":"Hello, World!"} */
-        int written = snprintf(server->json_buffer, sizeof(server->json_buffer),
-                              "{\"message\":\"%s\"}", config->json_message);
-        if (written < 0 || (size_t)written >= sizeof(server->json_buffer)) {
-            return HTTP_SERVER_ERROR_MEMORY;
+    server->json_message_length = config->json_message ? strlen(config->json_message) : 0;
+
+    /* Prebuild the wire bytes for every static route */
+    for (int route = 0; route < ROUTE_COUNT; route++) {
+        http_server_error_t err = http_server_build_cached(server, (http_route_t)route);
+        if (err != HTTP_SERVER_OK) {
+            return err;
+        }
+    }
+
+    /* Leave cached_date_second at 0 so the first request stamps a fresh date */
+
+    if (config->document_root) {
+        file_cache_error_t cache_err = file_cache_init(&server->file_cache, config->document_root,
+                                                       HTTP_SERVER_FILE_MEMORY_LIMIT,
+                                                       FILE_CACHE_DEFAULT_ENTRIES);
+        if (cache_err != FILE_CACHE_OK) {
+            log_error("Cannot serve files from %s (error %d)", config->document_root, cache_err);
+            return HTTP_SERVER_ERROR_INVALID_PARAM;
         }
+        server->serve_files = true;
+    }
 
-        server->json_buffer_size = (size_t)written;
+    if (config->response_cache_ttl_ms > 0 && config->response_cache_size > 0) {
+        response_cache_error_t cache_err = response_cache_init(&server->response_cache,
+                                                               HTTP_SERVER_RESPONSE_CACHE_ENTRIES,
+                                                               config->response_cache_size,
+                                                               config->response_cache_ttl_ms);
+        if (cache_err != RESPONSE_CACHE_OK) {
+            log_error("Cannot create the response cache (error %d)", cache_err);
+            return HTTP_SERVER_ERROR_MEMORY;
+        }
+        server->cache_responses = true;
     }
 
     return HTTP_SERVER_OK;
@@ -62,10 +391,147 @@ http_server_error_t http_server_create(http_server_t *server,
 void http_server_destroy(http_server_t *server)
 {
     if (server) {
+        if (server->serve_files) {
+            file_cache_cleanup(&server->file_cache);
+        }
+        if (server->cache_responses) {
+            response_cache_cleanup(&server->response_cache);
+        }
+        system_free(server->strings);
         memset(server, 0, sizeof(*server));
     }
 }
 
+size_t http_server_purge_cache(http_server_t *server)
+{
+    if (!server || !server->cache_responses) {
+        return 0;
+    }
+    return response_cache_purge(&server->response_cache);
+}
+
+/**
+ * @brief Find the Date value in the headers of a serialized response
+ */
+static size_t http_server_find_date(const char *response, size_t length)
+{
+    static const char name[] = "\r\nDate: ";
+    const size_t name_length = sizeof(name) - 1;
+
+    const char *p = response;
+    const char *end = response + length;
+    while ((p = memchr(p, '\r', (size_t)(end - p))) != NULL) {
+        if ((size_t)(end - p) < name_length + HTTP_RESPONSE_DATE_LENGTH) {
+            break;
+        }
+        if (memcmp(p, name, name_length) == 0) {
+            return (size_t)(p - response) + name_length;
+        }
+        if (p[1] == '\n' && p[2] == '\r') {
+            break;                      /* End of the headers */
+        }
+        p++;
+    }
+    return (size_t)-1;
+}
+
+/**
+ * @brief Answer a cacheable route from the response cache, filling it on a miss
+ */
+static http_server_error_t http_server_handle_cacheable(http_server_t *server,
+                                                        server_context *context,
+                                                        http_route_t route)
+{
+    const segment *target = &context->request.target;
+    const char *query = memchr(target->base, '?', target->size);
+    size_t query_length = 0;
+    if (query) {
+        query++;
+        query_length = target->size - (size_t)(query - (const char *)target->base);
+    }
+
+    response_cache_key_t key;
+    if (response_cache_key(&key, route, query, query_length) != RESPONSE_CACHE_OK) {
+        return route_handlers[route](server, context, route);
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    int64_t now_ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+    /* A hit costs a static response: one copy, Date patched in place */
+    const response_cache_entry_t *entry = response_cache_lookup(&server->response_cache, &key, now_ms);
+    if (entry) {
+        char *base = stream_allocate(&context->session->stream, entry->length);
+        memcpy(base, entry->data, entry->length);
+        if (entry->date_offset != (size_t)-1) {
+            date_clock_read(base + entry->date_offset);
+        }
+        return HTTP_SERVER_OK;
+    }
+
+    buffer *output = &context->session->stream.output;
+    size_t start = output->size;
+    http_server_error_t err = route_handlers[route](server, context, route);
+    if (err == HTTP_SERVER_OK && output->size > start) {
+        const char *response = (const char *)output->data + start;
+        size_t length = output->size - start;
+        (void)response_cache_store(&server->response_cache, &key, response, length,
+                                   http_server_find_date(response, length), now_ms);
+    }
+    return err;
+}
+
+/**
+ * @brief Answer a known path requested with a method its route does not take
+ */
+static http_server_error_t http_server_handle_method_not_allowed(http_server_t *server,
+                                                                 server_context *context,
+                                                                 http_route_t route)
+{
+    static const char body[] = "Method Not Allowed";
+    const http_route_entry_t *entry = &route_entries[route];
+
+    /* Every GET route also answers HEAD */
+    char allow[32];
+    bool get = entry->method_length == 3 && memcmp(entry->method, "GET", 3) == 0;
+    int allow_length = snprintf(allow, sizeof(allow), "%s%s", entry->method, get ? ", HEAD" : "");
+
+    http_response_config_t response_config = {
+        .status_code = HTTP_STATUS_METHOD_NOT_ALLOWED,
+        .content_type = CONTENT_TYPE_TEXT_PLAIN,
+        .body = body,
+        .body_length = sizeof(body) - 1,
+        .include_date_header = server->config.enable_date_headers,
+        .allow = allow,
+        .allow_length = (size_t)allow_length
+    };
+
+    http_response_buffer_t buffer;
+#ifdef REACTOR_SERVER_HTTP2
+    if (context->stream_id) {
+        char block[HTTP_SERVER_CACHED_HPACK_SIZE];
+        if (http_response_hpack_size(&response_config) > sizeof(block) ||
+            http_response_buffer_init(&buffer, block, sizeof(block)) != HTTP_RESPONSE_OK ||
+            http_response_build_hpack(&buffer, &response_config) != HTTP_RESPONSE_OK) {
+            return HTTP_SERVER_ERROR_RESPONSE_BUILD;
+        }
+        server_http2_respond(context, segment_make(block, buffer.used),
+                             segment_make((void *)body, http_server_is_head(context) ? 0 : sizeof(body) - 1));
+        return HTTP_SERVER_OK;
+    }
+#endif
+
+    size_t size = http_response_calculate_size(&response_config);
+    char *base = stream_allocate(&context->session->stream, size);
+    if (http_response_buffer_init(&buffer, base, size) != HTTP_RESPONSE_OK ||
+        http_response_build(&buffer, &response_config) != HTTP_RESPONSE_OK) {
+        context->session->stream.output.size -= size;
+        return HTTP_SERVER_ERROR_RESPONSE_BUILD;
+    }
+    return HTTP_SERVER_OK;
+}
+
 http_server_error_t http_server_handle_request(http_server_t *server,
                                                  server_context *context)
 {
@@ -73,48 +539,424 @@ http_server_error_t http_server_handle_request(http_server_t *server,
         return HTTP_SERVER_ERROR_INVALID_PARAM;
     }
 
-    /* Parse the route from the request */
-    http_route_t route = http_server_parse_route(&context->request.target);
+    /* Parse the route from the request and dispatch through the handler table; HEAD routes as GET */
+    static const segment get = { .base = "GET", .size = 3 };
+    bool head = http_server_is_head(context);
+    http_route_t path_route;
+    http_route_t route = router_lookup(head ? &get : &context->request.method,
+                                       &context->request.target, &path_route);
+    metrics_count_request(route);
+    trace_route(route);
 
-    /* Handle routes and send responses directly */
-    switch (route) {
-        case ROUTE_PLAINTEXT:
-            server_ok(context, 
-                     segment_string("text/plain"), 
-                     segment_string(server->config.plaintext_response));
-            break;
+    bool cacheable = server->cache_responses && route_cacheable[route];
+#ifdef REACTOR_SERVER_HTTP2
+    /* Cache entries hold HTTP/1.1 bytes; HTTP/2 streams take the handlers */
+    cacheable = cacheable && context->stream_id == 0;
+#endif
+    buffer *output = &context->session->stream.output;
+    size_t start = output->size;
+    http_server_error_t result;
+    /* A known path with another method is 405, not 404 */
+    if (path_route != route) {
+        result = http_server_handle_method_not_allowed(server, context, path_route);
+    } else {
+        result = cacheable ? http_server_handle_cacheable(server, context, route)
+                           : route_handlers[route](server, context, route);
+    }
 
-        case ROUTE_JSON:
-            server_ok(context, 
-                     segment_string("application/json"), 
-                     segment_string(server->json_buffer));
-            break;
+    /* HEAD: the handler built the GET response, whose headers keep their Content-Length */
+    if (head && result == HTTP_SERVER_OK && output->size > start) {
+        const char *end = memmem((const char *)output->data + start, output->size - start, "\r\n\r\n", 4);
+        if (end) {
+            output->size = (size_t)(end + 4 - (const char *)output->data);
+        }
+    }
+    trace_mark(TRACE_PHASE_BUILT);
+    return result;
+}
 
-        case ROUTE_UNKNOWN:
-        default:
-            server_ok(context, 
-                     segment_string("text/plain"), 
-                     segment_string("Not Found"));
-            break;
+const char *const *http_server_route_names(void)
+{
+    return route_names;
+}
+
+/**
+ * @brief Handler for routes served from the precomputed response cache
+ */
+static http_server_error_t http_server_handle_static(http_server_t *server,
+                                                     server_context *context,
+                                                     http_route_t route)
+{
+    /* Send the prebuilt response, patching Date at most once per second */
+    http_server_refresh_cached_date(server);
+#ifdef REACTOR_SERVER_HTTP2
+    if (context->stream_id) {
+        http_server_send_cached_http2(&server->cached_responses[route], context);
+        return HTTP_SERVER_OK;
     }
+#endif
+    http_server_send_cached(&server->cached_responses[route], context);
 
     return HTTP_SERVER_OK;
 }
 
-http_route_t http_server_parse_route(const segment *target)
+/**
+ * @brief Append the JSON body to output
+ * @return false if the writer failed
+ */
+static bool http_server_write_json(const http_server_t *server, buffer *output, size_t *length)
 {
-    if (!target || !target->base) {
-        return ROUTE_UNKNOWN;
+    json_writer_t writer;
+    json_writer_init(&writer, output);
+    json_writer_begin_object(&writer);
+    json_writer_key(&writer, "message", sizeof("message") - 1);
+    if (server->config.json_message) {
+        json_writer_string(&writer, server->config.json_message, server->json_message_length);
+    } else {
+        json_writer_null(&writer);
     }
+    json_writer_end_object(&writer);
+    return json_writer_finish(&writer, length) == JSON_WRITER_OK;
+}
 
-    /* Simple route matching */
-    if (segment_equal(*target, segment_string("/plaintext"))) {
-        return ROUTE_PLAINTEXT;
-    } else if (segment_equal(*target, segment_string("/json"))) {
-        return ROUTE_JSON;
+#ifdef REACTOR_SERVER_HTTP2
+/**
+ * @brief Answer the JSON route on an HTTP/2 stream: cached block plus content-length
+ */
+static http_server_error_t http_server_handle_json_http2(const http_server_t *server,
+                                                         server_context *context,
+                                                         const http_cached_response_t *cached)
+{
+    /* The body cannot go into the connection output ahead of its HEADERS frame */
+    buffer body;
+    buffer_construct(&body);
+    size_t length;
+    if (!http_server_write_json(server, &body, &length)) {
+        buffer_destruct(&body);
+        return HTTP_SERVER_ERROR_RESPONSE_BUILD;
+    }
+
+    char block[HTTP_SERVER_CACHED_HPACK_SIZE + HTTP_RESPONSE_HPACK_LENGTH_SIZE];
+    memcpy(block, cached->hpack, cached->hpack_length);
+    size_t used = cached->hpack_length + http_response_hpack_length(block + cached->hpack_length, length);
+    server_http2_respond(context, segment_make(block, used),
+                         segment_make(body.data, http_server_is_head(context) ? 0 : length));
+    buffer_destruct(&body);
+    return HTTP_SERVER_OK;
+}
+#endif
+
+/**
+ * @brief Handler for the JSON route: cached headers, body serialized per request
+ */
+static http_server_error_t http_server_handle_json(http_server_t *server,
+                                                   server_context *context,
+                                                   http_route_t route)
+{
+    const http_cached_response_t *cached = &server->cached_responses[route];
+    buffer *output = &context->session->stream.output;
+    size_t start = output->size;
+
+    http_server_refresh_cached_date(server);
+#ifdef REACTOR_SERVER_HTTP2
+    if (context->stream_id) {
+        return http_server_handle_json_http2(server, context, cached);
     }
+#endif
+    http_server_send_cached(cached, context);
+
+    /* The body goes straight into the connection output */
+    size_t length;
+    if (!http_server_write_json(server, output, &length)) {
+        output->size = start;
+        return HTTP_SERVER_ERROR_RESPONSE_BUILD;
+    }
+
+    size_t field = start + cached->length_offset;
+    size_t removed;
+    if (http_response_set_length((char *)output->data + field,
+                                 output->size - field - HTTP_RESPONSE_LENGTH_FIELD_WIDTH,
+                                 length, &removed) != HTTP_RESPONSE_OK) {
+        output->size = start;
+        return HTTP_SERVER_ERROR_RESPONSE_BUILD;
+    }
+    output->size -= removed;
+
+    return HTTP_SERVER_OK;
+}
 
-    return ROUTE_UNKNOWN;
+/**
+ * @brief Describe the response headers of a cached file
+ */
+static http_response_config_t http_server_file_response(const http_server_t *server,
+                                                        const file_cache_entry_t *entry)
+{
+    return (http_response_config_t){
+        .status_code = HTTP_STATUS_OK,
+        .content_type = http_response_content_type_for_path(entry->path, entry->path_length),
+        .body = NULL,
+        .body_length = entry->size,
+        .include_date_header = server->config.enable_date_headers,
+#ifdef REACTOR_REQUEST_VALIDATORS
+        /* Validators are only sent where requests can be checked against them */
+        .etag = entry->etag_length ? entry->etag : NULL,
+        .etag_length = entry->etag_length,
+        .last_modified = entry->mtime
+#endif
+    };
+}
+
+#ifdef REACTOR_REQUEST_VALIDATORS
+/**
+ * @brief Find the entry's tag in an If-None-Match list, by weak comparison
+ */
+static bool http_server_etag_listed(segment list, const file_cache_entry_t *entry)
+{
+    const char *p = list.base;
+    const char *end = p + list.size;
+
+    while (p < end) {
+        if (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+            continue;
+        }
+        if (*p == '*') {
+            return true;
+        }
+
+        /* Weak comparison ignores the W/ prefix */
+        if (end - p > 2 && p[0] == 'W' && p[1] == '/') {
+            p += 2;
+        }
+        const char *tag = p;
+        if (*p != '"') {
+            return false;
+        }
+        const char *close = memchr(p + 1, '"', (size_t)(end - p - 1));
+        if (!close) {
+            return false;
+        }
+        p = close + 1;
+        if ((size_t)(p - tag) == entry->etag_length && memcmp(tag, entry->etag, entry->etag_length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Evaluate If-None-Match, or failing that If-Modified-Since (RFC 9110 13.2.2)
+ */
+static bool http_server_not_modified(const http_request *request, const file_cache_entry_t *entry)
+{
+    if (request->if_none_match.size > 0) {
+        return http_server_etag_listed(request->if_none_match, entry);
+    }
+
+    int64_t since;
+    return request->if_modified_since.size > 0 &&
+           date_clock_parse(request->if_modified_since.base, request->if_modified_since.size, &since) &&
+           entry->mtime <= since;
+}
+
+/**
+ * @brief Answer a conditional request for an unchanged file: the headers of the 200, no body
+ * @return False if the headers do not fit
+ */
+static bool http_server_send_not_modified(const http_server_t *server, server_context *context,
+                                          const file_cache_entry_t *entry)
+{
+    http_response_config_t response_config = http_server_file_response(server, entry);
+    response_config.status_code = HTTP_STATUS_NOT_MODIFIED;
+
+    char block[FILE_CACHE_HEADER_SIZE];
+    http_response_buffer_t buffer;
+#ifdef REACTOR_SERVER_HTTP2
+    if (context->stream_id) {
+        if (http_response_hpack_size(&response_config) > sizeof(block) ||
+            http_response_buffer_init(&buffer, block, sizeof(block)) != HTTP_RESPONSE_OK ||
+            http_response_build_hpack(&buffer, &response_config) != HTTP_RESPONSE_OK) {
+            return false;
+        }
+        server_http2_respond(context, segment_make(block, buffer.used), segment_make(NULL, 0));
+        return true;
+    }
+#endif
+
+    if (http_response_calculate_size(&response_config) - entry->size > sizeof(block) ||
+        http_response_buffer_init(&buffer, block, sizeof(block)) != HTTP_RESPONSE_OK ||
+        http_response_build(&buffer, &response_config) != HTTP_RESPONSE_OK) {
+        return false;
+    }
+    stream_write(&context->session->stream, segment_make(block, buffer.used));
+    return true;
+}
+#endif
+
+/**
+ * @brief Build the response headers of a cached file once
+ */
+static bool http_server_build_file_headers(const http_server_t *server, file_cache_entry_t *entry)
+{
+    http_response_config_t response_config = http_server_file_response(server, entry);
+
+    http_response_buffer_t buffer;
+    if (http_response_calculate_size(&response_config) - entry->size > sizeof(entry->headers) ||
+        http_response_buffer_init(&buffer, entry->headers, sizeof(entry->headers)) != HTTP_RESPONSE_OK ||
+        http_response_build(&buffer, &response_config) != HTTP_RESPONSE_OK) {
+        return false;
+    }
+
+    entry->headers_length = buffer.used;
+    entry->headers_date_offset = http_response_date_offset(&response_config);
+    return true;
+}
+
+#ifdef REACTOR_SERVER_HTTP2
+/**
+ * @brief Answer an HTTP/2 stream with a cached file, the body referenced
+ * @return False if the header block does not fit; the entry is released
+ */
+static bool http_server_send_file_http2(const http_server_t *server, server_context *context,
+                                        file_cache_entry_t *entry)
+{
+    /* The block is small and carries the current date, so it is built per request */
+    http_response_config_t response_config = http_server_file_response(server, entry);
+    char block[FILE_CACHE_HEADER_SIZE];
+    http_response_buffer_t buffer;
+    if (http_response_hpack_size(&response_config) > sizeof(block) ||
+        http_response_buffer_init(&buffer, block, sizeof(block)) != HTTP_RESPONSE_OK ||
+        http_response_build_hpack(&buffer, &response_config) != HTTP_RESPONSE_OK) {
+        file_cache_release(entry);
+        return false;
+    }
+
+    if (http_server_is_head(context)) {
+        server_http2_respond(context, segment_make(block, buffer.used), segment_make(NULL, 0));
+        file_cache_release(entry);
+        return true;
+    }
+
+    stream_extent body = {
+        .base = entry->data,
+        .fd = entry->fd,
+        .offset = 0,
+        .size = entry->size,
+        .release = file_cache_release,
+        .arg = entry
+    };
+    server_http2_respond_extent(context, segment_make(block, buffer.used), &body);
+    return true;
+}
+#endif
+
+/**
+ * @brief Serve a file from the document root
+ * @return True if a response was queued, false if no such file exists
+ */
+static bool http_server_send_file(http_server_t *server, server_context *context)
+{
+    const segment *target = &context->request.target;
+    const char *query = memchr(target->base, '?', target->size);
+    size_t length = query ? (size_t)(query - (const char *)target->base) : target->size;
+
+    file_cache_entry_t *entry;
+    if (file_cache_acquire(&server->file_cache, target->base, length, &entry) != FILE_CACHE_OK) {
+        return false;
+    }
+#ifdef REACTOR_REQUEST_VALIDATORS
+    if (http_server_not_modified(&context->request, entry)) {
+        bool sent = http_server_send_not_modified(server, context, entry);
+        file_cache_release(entry);
+        return sent;
+    }
+#endif
+#ifdef REACTOR_SERVER_HTTP2
+    if (context->stream_id) {
+        return http_server_send_file_http2(server, context, entry);
+    }
+#endif
+
+    if (entry->headers_length == 0 && !http_server_build_file_headers(server, entry)) {
+        file_cache_release(entry);
+        return false;
+    }
+
+    /* Headers are copied (a few hundred bytes) and get the current date */
+    stream *st = &context->session->stream;
+    char *headers = stream_allocate(st, entry->headers_length);
+    memcpy(headers, entry->headers, entry->headers_length);
+    if (entry->headers_date_offset != (size_t)-1) {
+        date_clock_read(headers + entry->headers_date_offset);
+    }
+
+    if (entry->size == 0 || http_server_is_head(context)) {
+        file_cache_release(entry);
+        return true;
+    }
+
+#ifdef REACTOR_STREAM_ZERO_COPY
+    /* The body never passes through userspace; the entry outlives the send */
+    if (entry->data) {
+        stream_write_reference(st, segment_make((void *)entry->data, entry->size), file_cache_release, entry);
+    } else {
+        stream_splice_file(st, entry->fd, 0, entry->size, file_cache_release, entry);
+    }
+#else
+    /* Backends without referenced output: every file is held in memory, body is copied */
+    stream_write(st, segment_make((void *)entry->data, entry->size));
+    file_cache_release(entry);
+#endif
+
+    return true;
+}
+
+/**
+ * @brief Handler for requests no route matched: document root, then 404
+ */
+static http_server_error_t http_server_handle_fallback(http_server_t *server,
+                                                       server_context *context,
+                                                       http_route_t route)
+{
+    const segment *method = &context->request.method;
+    bool get = (method->size == 3 && memcmp(method->base, "GET", 3) == 0) || http_server_is_head(context);
+    if (server->serve_files && get && http_server_send_file(server, context)) {
+        return HTTP_SERVER_OK;
+    }
+
+    return http_server_handle_static(server, context, route);
+}
+
+void http_server_refresh_cached_date(http_server_t *server)
+{
+    if (!server) {
+        return;
+    }
+
+    /* One load of the shared clock page in the common case */
+    time_t now = (time_t)date_clock_poll();
+    if (now == server->cached_date_second) {
+        return;
+    }
+
+    char date[HTTP_RESPONSE_DATE_LENGTH];
+    server->cached_date_second = (time_t)date_clock_read(date);
+
+    for (int route = 0; route < ROUTE_COUNT; route++) {
+        http_cached_response_t *cached = &server->cached_responses[route];
+        if (cached->date_offset != (size_t)-1) {
+            memcpy(cached->buffer + cached->date_offset, date, HTTP_RESPONSE_DATE_LENGTH);
+        }
+        if (cached->hpack_date_offset != (size_t)-1) {
+            memcpy(cached->hpack + cached->hpack_date_offset, date, HTTP_RESPONSE_DATE_LENGTH);
+        }
+    }
+}
+
+http_route_t http_server_parse_route(const segment *method, const segment *target)
+{
+    http_route_t path_route;
+    return router_lookup(method, target, &path_route);
 }
 
 http_server_error_t http_server_generate_response(const http_server_t *server,
@@ -126,6 +968,7 @@ http_server_error_t http_server_generate_response(const http_server_t *server,
     }
 
     /* Initialize with defaults */
+    *response_config = (http_response_config_t){ 0 };
     response_config->status_code = HTTP_STATUS_OK;
     response_config->include_date_header = server->config.enable_date_headers;
 
@@ -138,9 +981,9 @@ http_server_error_t http_server_generate_response(const http_server_t *server,
             break;
 
         case ROUTE_JSON:
+            /* Headers only; the body is serialized per request */
             response_config->content_type = CONTENT_TYPE_APPLICATION_JSON;
-            response_config->body = server->json_buffer;
-            response_config->body_length = server->json_buffer_size;
+            response_config->deferred_length = true;
             break;
 
         case ROUTE_UNKNOWN:
@@ -0,0 +1,507 @@
+/**
+ * @file json_writer.c
+ * @brief Implementation of streaming JSON serialization
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/domain/json_writer.h"
+#include "../../include/domain/http_response.h"
+
+#if JSON_WRITER_SIMD && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define JSON_WRITER_SSE2 1
+#include <emmintrin.h>
+#else
+#define JSON_WRITER_SSE2 0
+#endif
+
+#if JSON_WRITER_SIMD && defined(__aarch64__)
+#define JSON_WRITER_NEON 1
+#include <arm_neon.h>
+#else
+#define JSON_WRITER_NEON 0
+#endif
+
+/** Input bytes escaped per output reservation; escaping grows a byte to at most 6 */
+#define JSON_WRITER_CHUNK 4096
+
+/** Longest number json_writer_double() writes ("-" and %.17g of a subnormal) */
+#define JSON_WRITER_DOUBLE_MAX 32
+
+/** Largest integer a double holds exactly, plus one */
+#define JSON_WRITER_EXACT_LIMIT 9007199254740992.0
+
+/** Fraction digits tried before falling back to printf */
+#define JSON_WRITER_MAX_FRACTION 15
+
+/** Escape for every byte: 0 copies it, 'u' means \u00XX, others follow a backslash */
+static const char escapes[256] = {
+    ['\b'] = 'b', ['\t'] = 't', ['\n'] = 'n', ['\f'] = 'f', ['\r'] = 'r',
+    [0x00] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u', [0x04] = 'u', [0x05] = 'u',
+    [0x06] = 'u', [0x07] = 'u', [0x0b] = 'u', [0x0e] = 'u', [0x0f] = 'u', [0x10] = 'u',
+    [0x11] = 'u', [0x12] = 'u', [0x13] = 'u', [0x14] = 'u', [0x15] = 'u', [0x16] = 'u',
+    [0x17] = 'u', [0x18] = 'u', [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u', [0x1c] = 'u',
+    [0x1d] = 'u', [0x1e] = 'u', [0x1f] = 'u',
+    ['"'] = '"', ['\\'] = '\\'
+};
+
+static const double powers_of_ten[JSON_WRITER_MAX_FRACTION + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+};
+
+/**
+ * @brief Length of the prefix that needs no escaping
+ */
+static size_t json_writer_scalar_span(const uint8_t *data, size_t size)
+{
+    size_t i = 0;
+    while (i < size && escapes[data[i]] == 0) {
+        i++;
+    }
+    return i;
+}
+
+#if JSON_WRITER_SSE2
+static size_t json_writer_span(const uint8_t *data, size_t size)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        /* Controls are the bytes v <= 0x1f unsigned, where max(v, 0x1f) stays 0x1f */
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                    _mm_cmpeq_epi8(v, backslash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        unsigned mask = (unsigned)_mm_movemask_epi8(special);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return i + json_writer_scalar_span(data + i, size - i);
+}
+#elif JSON_WRITER_NEON
+static size_t json_writer_span(const uint8_t *data, size_t size)
+{
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t control = vdupq_n_u8(0x1f);
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t v = vld1q_u8(data + i);
+        uint8x16_t special = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)),
+                                      vcleq_u8(v, control));
+        if (vmaxvq_u8(special)) {
+            return i + json_writer_scalar_span(data + i, 16);
+        }
+    }
+    return i + json_writer_scalar_span(data + i, size - i);
+}
+#else
+#define json_writer_span json_writer_scalar_span
+#endif
+
+/**
+ * @brief Make room for size more bytes at the end of the output
+ */
+static inline char *json_writer_reserve(json_writer_t *writer, size_t size)
+{
+    buffer *output = writer->output;
+    if (__builtin_expect(output->size + size > output->capacity, 0)) {
+        buffer_reserve(output, output->size + size);
+    }
+    return (char *)output->data + output->size;
+}
+
+/**
+ * @brief Make room for size bytes after an uncommitted position
+ */
+static inline char *json_writer_reserve_at(json_writer_t *writer, char *p, size_t size)
+{
+    buffer *output = writer->output;
+    size_t offset = (size_t)(p - (char *)output->data);
+    if (__builtin_expect(offset + size > output->capacity, 0)) {
+        buffer_reserve(output, offset + size);
+    }
+    return (char *)output->data + offset;
+}
+
+static inline void json_writer_commit(json_writer_t *writer, const char *end)
+{
+    writer->output->size = (size_t)(end - (const char *)writer->output->data);
+}
+
+static inline bool json_writer_member(const json_writer_t *writer)
+{
+    return writer->objects >> writer->depth & 1;
+}
+
+/**
+ * @brief Check that a value may follow and reserve room for it and a comma
+ * @return Output position, NULL after an error
+ */
+static char *json_writer_begin_value(json_writer_t *writer, size_t size)
+{
+    if (writer->error != JSON_WRITER_OK) {
+        return NULL;
+    }
+
+    uint64_t bit = (uint64_t)1 << writer->depth;
+    if (json_writer_member(writer)) {
+        if (!writer->after_key) {
+            writer->error = JSON_WRITER_ERROR_STATE;
+            return NULL;
+        }
+        writer->after_key = false;
+        return json_writer_reserve(writer, size);
+    }
+
+    /* Array element, or the single top-level value */
+    bool comma = writer->members & bit;
+    if (comma && writer->depth == 0) {
+        writer->error = JSON_WRITER_ERROR_STATE;
+        return NULL;
+    }
+    writer->members |= bit;
+
+    char *p = json_writer_reserve(writer, size + 1);
+    if (comma) {
+        *p++ = ',';
+    }
+    return p;
+}
+
+/**
+ * @brief Write a quoted, escaped string at p, past the end of the output
+ * @return End of the string, not yet committed
+ */
+static char *json_writer_quote(json_writer_t *writer, const char *data, size_t length, char *p,
+                               size_t trailer)
+{
+    static const char hex[] = "0123456789abcdef";
+    const uint8_t *in = (const uint8_t *)data;
+
+    size_t chunk = length < JSON_WRITER_CHUNK ? length : JSON_WRITER_CHUNK;
+    p = json_writer_reserve_at(writer, p, chunk * 6 + 2 + trailer);
+    *p++ = '"';
+
+    for (;;) {
+        const uint8_t *end = in + chunk;
+        while (in < end) {
+            size_t run = json_writer_span(in, (size_t)(end - in));
+            memcpy(p, in, run);
+            p += run;
+            in += run;
+            if (in == end) {
+                break;
+            }
+
+            char escape = escapes[*in];
+            p[0] = '\\';
+            p[1] = escape;
+            if (escape == 'u') {
+                memcpy(p + 2, "00", 2);
+                p[4] = hex[*in >> 4];
+                p[5] = hex[*in & 0xf];
+                p += 6;
+            } else {
+                p += 2;
+            }
+            in++;
+        }
+
+        length -= chunk;
+        if (length == 0) {
+            break;
+        }
+        chunk = length < JSON_WRITER_CHUNK ? length : JSON_WRITER_CHUNK;
+        p = json_writer_reserve_at(writer, p, chunk * 6 + 1 + trailer);
+    }
+
+    /* Every reservation leaves room for the closing quote and the trailer */
+    *p++ = '"';
+    return p;
+}
+
+json_writer_error_t json_writer_init(json_writer_t *writer, buffer *output)
+{
+    if (!writer || !output) {
+        return JSON_WRITER_ERROR_INVALID_PARAM;
+    }
+
+    memset(writer, 0, sizeof(*writer));
+    writer->output = output;
+    writer->start = output->size;
+    return JSON_WRITER_OK;
+}
+
+static json_writer_error_t json_writer_open(json_writer_t *writer, char bracket, bool object)
+{
+    if (!writer) {
+        return JSON_WRITER_ERROR_INVALID_PARAM;
+    }
+    if (writer->error == JSON_WRITER_OK && writer->depth >= JSON_WRITER_MAX_DEPTH) {
+        writer->error = JSON_WRITER_ERROR_DEPTH;
+    }
+
+    char *p = json_writer_begin_value(writer, 1);
+    if (!p) {
+        return writer->error;
+    }
+    *p++ = bracket;
+    json_writer_commit(writer, p);
+
+    writer->depth++;
+    uint64_t bit = (uint64_t)1 << writer->depth;
+    writer->members &= ~bit;
+    writer->objects = object ? writer->objects | bit : writer->objects & ~bit;
+    return JSON_WRITER_OK;
+}
+
+static json_writer_error_t json_writer_close(json_writer_t *writer, char bracket, bool object)
+{
+    if (!writer) {
+        return JSON_WRITER_ERROR_INVALID_PARAM;
+    }
+    if (writer->error != JSON_WRITER_OK) {
+        return writer->error;
+    }
+    if (writer->depth == 0 || json_writer_member(writer) != object) {
+        writer->error = JSON_WRITER_ERROR_DEPTH;
+        return writer->error;
+    }
+    if (writer->after_key) {
+        writer->error = JSON_WRITER_ERROR_STATE;
+        return writer->error;
+    }
+
+    char *p = json_writer_reserve(writer, 1);
+    *p++ = bracket;
+    json_writer_commit(writer, p);
+    writer->depth--;
+    return JSON_WRITER_OK;
+}
+
+json_writer_error_t json_writer_begin_object(json_writer_t *writer)
+{
+    return json_writer_open(writer, '{', true);
+}
+
+json_writer_error_t json_writer_end_object(json_writer_t *writer)
+{
+    return json_writer_close(writer, '}', true);
+}
+
+json_writer_error_t json_writer_begin_array(json_writer_t *writer)
+{
+    return json_writer_open(writer, '[', false);
+}
+
+json_writer_error_t json_writer_end_array(json_writer_t *writer)
+{
+    return json_writer_close(writer, ']', false);
+}
+
+json_writer_error_t json_writer_key(json_writer_t *writer, const char *key, size_t length)
+{
+    if (!writer || (!key && length > 0)) {
+        return JSON_WRITER_ERROR_INVALID_PARAM;
+    }
+    if (writer->error != JSON_WRITER_OK) {
+        return writer->error;
+    }
+    if (!json_writer_member(writer) || writer->after_key) {
+        writer->error = JSON_WRITER_ERROR_STATE;
+        return writer->error;
+    }
+
+    uint64_t bit = (uint64_t)1 << writer->depth;
+    bool comma = writer->members & bit;
+    writer->members |= bit;
+
+    char *p = json_writer_reserve(writer, 1);
+    if (comma) {
+        *p++ = ',';
+    }
+    p = json_writer_quote(writer, key, length, p, 1);
+    *p++ = ':';
+    json_writer_commit(writer, p);
+    writer->after_key = true;
+    return JSON_WRITER_OK;
+}
+
+json_writer_error_t json_writer_string(json_writer_t *writer, const char *value, size_t length)
+{
+    if (!writer || (!value && length > 0)) {
+        return JSON_WRITER_ERROR_INVALID_PARAM;
+    }
+
+    char *p = json_writer_begin_value(writer, 0);
+    if (!p) {
+        return writer->error;
+    }
+    json_writer_commit(writer, json_writer_quote(writer, value, length, p, 0));
+    return JSON_WRITER_OK;
+}
+
+json_writer_error_t json_writer_uint(json_writer_t *writer, uint64_t value)
+{
+    if (!writer) {
+        return JSON_WRITER_ERROR_INVALID_PARAM;
+    }
+
+    char *p = json_writer_begin_value(writer, HTTP_RESPONSE_UINT_MAX_DIGITS);
+    if (!p) {
+        return writer->error;
+    }
+    p += http_response_format_uint(value, p);
+    json_writer_commit(writer, p);
+    return JSON_WRITER_OK;
+}
+
+json_writer_error_t json_writer_int(json_writer_t *writer, int64_t value)
+{
+    if (!writer) {
+        return JSON_WRITER_ERROR_INVALID_PARAM;
+    }
+
+    char *p = json_writer_begin_value(writer, HTTP_RESPONSE_UINT_MAX_DIGITS + 1);
+    if (!p) {
+        return writer->error;
+    }
+    uint64_t magnitude = (uint64_t)value;
+    if (value < 0) {
+        *p++ = '-';
+        magnitude = 0 - magnitude;
+    }
+    p += http_response_format_uint(magnitude, p);
+    json_writer_commit(writer, p);
+    return JSON_WRITER_OK;
+}
+
+/**
+ * @brief Format a finite, non-negative double that reads back exactly
+ * @return Characters written
+ */
+static size_t json_writer_format_double(double value, char *out)
+{
+    /* Fewest fraction digits k for which m / 10^k is the same double */
+    for (int k = 0; k <= JSON_WRITER_MAX_FRACTION; k++) {
+        double scaled = value * powers_of_ten[k];
+        if (scaled >= JSON_WRITER_EXACT_LIMIT) {
+            break;
+        }
+
+        /* A misrounded candidate fails the check below and tries the next k */
+        uint64_t mantissa = (uint64_t)(scaled + 0.5);
+        if ((double)mantissa / powers_of_ten[k] != value) {
+            continue;
+        }
+
+        char digits[HTTP_RESPONSE_UINT_MAX_DIGITS];
+        size_t count = http_response_format_uint(mantissa, digits);
+        if (k == 0) {
+            memcpy(out, digits, count);
+            return count;
+        }
+
+        /* Insert the point, padding with zeros below 1 */
+        size_t integer = count > (size_t)k ? count - (size_t)k : 0;
+        char *p = out;
+        if (integer == 0) {
+            memcpy(p, "0.", 2);
+            memset(p + 2, '0', (size_t)k - count);
+            p += 2 + (size_t)k - count;
+            memcpy(p, digits, count);
+            p += count;
+        } else {
+            memcpy(p, digits, integer);
+            p[integer] = '.';
+            memcpy(p + integer + 1, digits + integer, count - integer);
+            p += count + 1;
+        }
+        return (size_t)(p - out);
+    }
+
+    /* Large, tiny or long values: shortest precision that round-trips */
+    char text[JSON_WRITER_DOUBLE_MAX];
+    int length = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        length = snprintf(text, sizeof(text), "%.*g", precision, value);
+        if (strtod(text, NULL) == value) {
+            break;
+        }
+    }
+    memcpy(out, text, (size_t)length);
+    return (size_t)length;
+}
+
+json_writer_error_t json_writer_double(json_writer_t *writer, double value)
+{
+    if (!writer) {
+        return JSON_WRITER_ERROR_INVALID_PARAM;
+    }
+    if (!isfinite(value)) {
+        return json_writer_null(writer);
+    }
+
+    char *p = json_writer_begin_value(writer, JSON_WRITER_DOUBLE_MAX + 1);
+    if (!p) {
+        return writer->error;
+    }
+    if (signbit(value)) {
+        *p++ = '-';
+        value = -value;
+    }
+    p += json_writer_format_double(value, p);
+    json_writer_commit(writer, p);
+    return JSON_WRITER_OK;
+}
+
+/**
+ * @brief Write a literal value
+ */
+static json_writer_error_t json_writer_literal(json_writer_t *writer, const char *text, size_t length)
+{
+    if (!writer) {
+        return JSON_WRITER_ERROR_INVALID_PARAM;
+    }
+
+    char *p = json_writer_begin_value(writer, length);
+    if (!p) {
+        return writer->error;
+    }
+    memcpy(p, text, length);
+    json_writer_commit(writer, p + length);
+    return JSON_WRITER_OK;
+}
+
+json_writer_error_t json_writer_bool(json_writer_t *writer, bool value)
+{
+    return value ? json_writer_literal(writer, "true", 4) : json_writer_literal(writer, "false", 5);
+}
+
+json_writer_error_t json_writer_null(json_writer_t *writer)
+{
+    return json_writer_literal(writer, "null", 4);
+}
+
+json_writer_error_t json_writer_finish(json_writer_t *writer, size_t *length)
+{
+    if (!writer) {
+        return JSON_WRITER_ERROR_INVALID_PARAM;
+    }
+    if (writer->error == JSON_WRITER_OK && (writer->depth != 0 || !(writer->members & 1))) {
+        writer->error = JSON_WRITER_ERROR_STATE;
+    }
+    if (length) {
+        *length = writer->output->size - writer->start;
+    }
+    return writer->error;
+}
@@ -0,0 +1,389 @@
+/**
+ * @file response_cache.c
+ * @brief Implementation of the per-worker response cache
+ */
+
+#include <string.h>
+
+#include "../../include/domain/response_cache.h"
+#include "../../include/platform/system.h"
+
+response_cache_error_t response_cache_init(response_cache_t *cache, size_t capacity,
+                                           size_t max_bytes, unsigned ttl_ms)
+{
+    if (!cache || capacity == 0 || capacity > INT32_MAX / 2 || max_bytes == 0) {
+        return RESPONSE_CACHE_ERROR_INVALID_PARAM;
+    }
+
+    memset(cache, 0, sizeof(*cache));
+
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    cache->entries = system_malloc(size * sizeof(*cache->entries));
+    cache->buckets = system_malloc(size * sizeof(*cache->buckets));
+    if (!cache->entries || !cache->buckets) {
+        response_cache_cleanup(cache);
+        return RESPONSE_CACHE_ERROR_MEMORY;
+    }
+
+    memset(cache->entries, 0, size * sizeof(*cache->entries));
+    for (size_t i = 0; i < size; i++) {
+        cache->buckets[i] = -1;
+        cache->entries[i].next = i + 1 < size ? (int32_t)(i + 1) : -1;
+    }
+
+    cache->capacity = size;
+    cache->max_bytes = max_bytes;
+    cache->ttl_ms = ttl_ms;
+    cache->free_list = 0;
+    return RESPONSE_CACHE_OK;
+}
+
+void response_cache_cleanup(response_cache_t *cache)
+{
+    if (!cache) {
+        return;
+    }
+
+    if (cache->entries) {
+        for (size_t i = 0; i < cache->capacity; i++) {
+            if (cache->entries[i].used) {
+                system_free(cache->entries[i].data);
+            }
+        }
+    }
+    system_free(cache->entries);
+    system_free(cache->buckets);
+    memset(cache, 0, sizeof(*cache));
+}
+
+size_t response_cache_purge(response_cache_t *cache)
+{
+    if (!cache || !cache->entries) {
+        return 0;
+    }
+
+    size_t purged = cache->count;
+    for (size_t i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].used) {
+            system_free(cache->entries[i].data);
+        }
+        memset(&cache->entries[i], 0, sizeof(cache->entries[i]));
+        cache->entries[i].next = i + 1 < cache->capacity ? (int32_t)(i + 1) : -1;
+        cache->buckets[i] = -1;
+    }
+
+    cache->count = 0;
+    cache->bytes = 0;
+    cache->hand = 0;
+    cache->free_list = 0;
+    return purged;
+}
+
+static inline uint64_t response_cache_mix(uint64_t h, uint64_t word)
+{
+    h = (h ^ word) * 0xff51afd7ed558ccdull;
+    return h ^ (h >> 32);
+}
+
+static uint64_t response_cache_hash(unsigned route, const char *data, size_t length)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ route ^ ((uint64_t)length << 32);
+
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = response_cache_mix(h, word);
+    }
+    if (i < length) {
+        uint64_t word = 0;
+        memcpy(&word, data + i, length - i);
+        h = response_cache_mix(h, word);
+    }
+
+    h *= 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 29);
+}
+
+/**
+ * @brief Order two non-empty parameters bytewise
+ */
+static inline int response_cache_compare(const char *a, size_t a_length, const char *b, size_t b_length)
+{
+    /* Parameter names mostly differ in their first byte */
+    if (a[0] != b[0]) {
+        return (unsigned char)a[0] - (unsigned char)b[0];
+    }
+
+    int order = memcmp(a, b, a_length < b_length ? a_length : b_length);
+    if (order != 0) {
+        return order;
+    }
+    return (a_length > b_length) - (a_length < b_length);
+}
+
+/**
+ * @brief Find the parameters of a query copied into a key
+ * @return false if a parameter is empty or there are too many
+ */
+static bool response_cache_split(const char *data, size_t length, uint16_t *starts, uint16_t *lengths,
+                                 size_t *count)
+{
+    size_t n = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] == '&') {
+            if (i == start || n == RESPONSE_CACHE_MAX_PARAMS - 1) {
+                return false;
+            }
+            starts[n] = (uint16_t)start;
+            lengths[n++] = (uint16_t)(i - start);
+            start = i + 1;
+        }
+    }
+    if (start == length) {
+        return false;
+    }
+
+    starts[n] = (uint16_t)start;
+    lengths[n++] = (uint16_t)(length - start);
+    *count = n;
+    return true;
+}
+
+/**
+ * @brief Drop the empty parameters of a query copied into a key
+ * @return New length, or (size_t)-1 if there are too many parameters
+ */
+static size_t response_cache_compact(char *data, size_t length, uint16_t *starts, uint16_t *lengths,
+                                     size_t *count)
+{
+    size_t n = 0;
+    size_t used = 0;
+    size_t i = 0;
+    while (i < length) {
+        if (data[i] == '&') {
+            i++;
+            continue;
+        }
+        if (n == RESPONSE_CACHE_MAX_PARAMS) {
+            return (size_t)-1;
+        }
+
+        const char *amp = memchr(data + i, '&', length - i);
+        size_t end = amp ? (size_t)(amp - data) : length;
+        if (n > 0) {
+            data[used++] = '&';
+        }
+        memmove(data + used, data + i, end - i);
+        starts[n] = (uint16_t)used;
+        lengths[n++] = (uint16_t)(end - i);
+        used += end - i;
+        i = end;
+    }
+
+    *count = n;
+    return used;
+}
+
+response_cache_error_t response_cache_key(response_cache_key_t *key, unsigned route,
+                                          const char *query, size_t length)
+{
+    if (!key || (!query && length > 0)) {
+        return RESPONSE_CACHE_ERROR_INVALID_PARAM;
+    }
+
+    key->route = route;
+    key->length = 0;
+    if (length > RESPONSE_CACHE_MAX_KEY) {
+        return RESPONSE_CACHE_ERROR_UNCACHEABLE;
+    }
+
+    /* Clients mostly send the same well-formed query: copy it, then check it */
+    char *data = key->data;
+    uint16_t starts[RESPONSE_CACHE_MAX_PARAMS];
+    uint16_t lengths[RESPONSE_CACHE_MAX_PARAMS];
+    size_t count = 0;
+    size_t used = length;
+    if (length > 0) {
+        memcpy(data, query, length);
+        if (!response_cache_split(data, length, starts, lengths, &count)) {
+            used = response_cache_compact(data, length, starts, lengths, &count);
+            if (used == (size_t)-1) {
+                return RESPONSE_CACHE_ERROR_UNCACHEABLE;
+            }
+        }
+    }
+
+    bool sorted = true;
+    for (size_t i = 1; i < count && sorted; i++) {
+        sorted = response_cache_compare(data + starts[i - 1], lengths[i - 1],
+                                        data + starts[i], lengths[i]) <= 0;
+    }
+
+    if (!sorted) {
+        /* Insertion-sort the parameters; there are only a few */
+        for (size_t i = 1; i < count; i++) {
+            uint16_t param_start = starts[i], param_length = lengths[i];
+            size_t j = i;
+            while (j > 0 && response_cache_compare(data + starts[j - 1], lengths[j - 1],
+                                                   data + param_start, param_length) > 0) {
+                starts[j] = starts[j - 1];
+                lengths[j] = lengths[j - 1];
+                j--;
+            }
+            starts[j] = param_start;
+            lengths[j] = param_length;
+        }
+
+        char sorted_data[RESPONSE_CACHE_MAX_KEY];
+        size_t sorted_used = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (i > 0) {
+                sorted_data[sorted_used++] = '&';
+            }
+            memcpy(sorted_data + sorted_used, data + starts[i], lengths[i]);
+            sorted_used += lengths[i];
+        }
+        memcpy(data, sorted_data, sorted_used);
+    }
+
+    key->length = used;
+    key->hash = response_cache_hash(route, data, used);
+    return RESPONSE_CACHE_OK;
+}
+
+/**
+ * @brief Find the entry of a key, live or expired
+ */
+static int32_t response_cache_find(const response_cache_t *cache, const response_cache_key_t *key)
+{
+    int32_t index = cache->buckets[key->hash & (cache->capacity - 1)];
+    while (index >= 0) {
+        const response_cache_entry_t *entry = &cache->entries[index];
+        if (entry->hash == key->hash && entry->route == key->route && entry->key_length == key->length &&
+            memcmp(entry->data + entry->length, key->data, key->length) == 0) {
+            return index;
+        }
+        index = entry->next;
+    }
+    return -1;
+}
+
+const response_cache_entry_t *response_cache_lookup(response_cache_t *cache,
+                                                    const response_cache_key_t *key,
+                                                    int64_t now_ms)
+{
+    if (!cache || !key || !cache->entries) {
+        return NULL;
+    }
+
+    int32_t index = response_cache_find(cache, key);
+    if (index < 0 || now_ms >= cache->entries[index].expires_ms) {
+        return NULL;
+    }
+
+    response_cache_entry_t *entry = &cache->entries[index];
+    entry->referenced = true;
+    return entry;
+}
+
+static void response_cache_remove(response_cache_t *cache, int32_t index)
+{
+    response_cache_entry_t *entry = &cache->entries[index];
+
+    int32_t *link = &cache->buckets[entry->hash & (cache->capacity - 1)];
+    while (*link != index) {
+        link = &cache->entries[*link].next;
+    }
+    *link = entry->next;
+
+    cache->bytes -= entry->length + entry->key_length;
+    cache->count--;
+    system_free(entry->data);
+    memset(entry, 0, sizeof(*entry));
+    entry->next = cache->free_list;
+    cache->free_list = index;
+}
+
+/**
+ * @brief Advance the CLOCK hand to the next victim and evict it
+ */
+static void response_cache_evict(response_cache_t *cache, int64_t now_ms)
+{
+    for (;;) {
+        size_t index = cache->hand;
+        cache->hand = (cache->hand + 1) & (cache->capacity - 1);
+
+        response_cache_entry_t *entry = &cache->entries[index];
+        if (!entry->used) {
+            continue;
+        }
+        if (entry->referenced && now_ms < entry->expires_ms) {
+            /* Second chance */
+            entry->referenced = false;
+            continue;
+        }
+
+        response_cache_remove(cache, (int32_t)index);
+        return;
+    }
+}
+
+response_cache_error_t response_cache_store(response_cache_t *cache, const response_cache_key_t *key,
+                                            const char *response, size_t length,
+                                            size_t date_offset, int64_t now_ms)
+{
+    if (!cache || !key || !response || !cache->entries) {
+        return RESPONSE_CACHE_ERROR_INVALID_PARAM;
+    }
+
+    size_t size = length + key->length;
+    if (size > cache->max_bytes) {
+        return RESPONSE_CACHE_ERROR_UNCACHEABLE;
+    }
+
+    int32_t existing = response_cache_find(cache, key);
+    if (existing >= 0) {
+        response_cache_remove(cache, existing);
+    }
+
+    /* Until the free list has a slot and the budget has room */
+    while (cache->count == cache->capacity || cache->bytes + size > cache->max_bytes) {
+        response_cache_evict(cache, now_ms);
+    }
+
+    char *data = system_malloc(size);
+    if (!data) {
+        return RESPONSE_CACHE_ERROR_MEMORY;
+    }
+    memcpy(data, response, length);
+    memcpy(data + length, key->data, key->length);
+
+    int32_t index = cache->free_list;
+    response_cache_entry_t *entry = &cache->entries[index];
+    cache->free_list = entry->next;
+
+    int32_t *bucket = &cache->buckets[key->hash & (cache->capacity - 1)];
+    *entry = (response_cache_entry_t){
+        .data = data,
+        .length = length,
+        .key_length = key->length,
+        .date_offset = date_offset,
+        .hash = key->hash,
+        .expires_ms = now_ms + cache->ttl_ms,
+        .next = *bucket,
+        .route = key->route,
+        .used = true,
+        .referenced = false
+    };
+    *bucket = index;
+
+    cache->count++;
+    cache->bytes += size;
+    return RESPONSE_CACHE_OK;
+}
@@ -4,6 +4,16 @@
  *
  * This module handles HTTP response creation and formatting,
  * providing a clean interface for building HTTP responses.
+ *
+ * Status lines and Content-Type headers come from tables of precomputed,
+ * length-tagged fragments and Content-Length is formatted from a digit-pair
+ * table, so building a response is a single pass of copies after one size
+ * check.
+ *
+ * The same configuration also encodes as an HPACK header block for HTTP/2
+ * streams. Fields are static table entries or literals that are never
+ * indexed, so a block does not depend on the connection and can be built
+ * once and reused like the HTTP/1.1 headers.
  */
 
 #ifndef DOMAIN_HTTP_RESPONSE_H
@@ -17,6 +27,18 @@
 extern "C" {
 #endif
 
+/** Length of an RFC 7231 IMF-fixdate value ("Thu, 01 Jan 1970 00:00:00 GMT") */
+#define HTTP_RESPONSE_DATE_LENGTH 29
+
+/** Longest decimal http_response_format_uint() writes (UINT64_MAX) */
+#define HTTP_RESPONSE_UINT_MAX_DIGITS 20
+
+/** Width of the Content-Length placeholder http_response_set_length() fills */
+#define HTTP_RESPONSE_LENGTH_FIELD_WIDTH 10
+
+/** Bytes http_response_hpack_length() writes at most */
+#define HTTP_RESPONSE_HPACK_LENGTH_SIZE (2 + 1 + HTTP_RESPONSE_UINT_MAX_DIGITS)
+
 /** HTTP response error codes */
 typedef enum {
     HTTP_RESPONSE_OK = 0,
@@ -28,14 +50,26 @@ typedef enum {
 /** HTTP status codes */
 typedef enum {
     HTTP_STATUS_OK = 200,
+    HTTP_STATUS_NOT_MODIFIED = 304,
     HTTP_STATUS_NOT_FOUND = 404,
+    HTTP_STATUS_METHOD_NOT_ALLOWED = 405,
     HTTP_STATUS_INTERNAL_ERROR = 500
 } http_status_t;
 
 /** Content types */
 typedef enum {
     CONTENT_TYPE_TEXT_PLAIN,
-    CONTENT_TYPE_APPLICATION_JSON
+    CONTENT_TYPE_APPLICATION_JSON,
+    CONTENT_TYPE_TEXT_HTML,
+    CONTENT_TYPE_TEXT_CSS,
+    CONTENT_TYPE_APPLICATION_JAVASCRIPT,
+    CONTENT_TYPE_IMAGE_PNG,
+    CONTENT_TYPE_IMAGE_JPEG,
+    CONTENT_TYPE_IMAGE_GIF,
+    CONTENT_TYPE_IMAGE_SVG,
+    CONTENT_TYPE_IMAGE_ICON,
+    CONTENT_TYPE_APPLICATION_WASM,
+    CONTENT_TYPE_APPLICATION_OCTET_STREAM
 } content_type_t;
 
 /** HTTP response configuration */
@@ -43,8 +77,14 @@ typedef struct {
     http_status_t status_code;
     content_type_t content_type;
     const char *body;           /** Response body (NULL for empty body) */
-    size_t body_length;         /** Length of body, 0 if body is NULL */
+    size_t body_length;         /** Length of body; with body NULL, only headers are built */
     bool include_date_header;   /** Whether to include Date header */
+    const char *etag;           /** ETag value including quotes, NULL for none */
+    size_t etag_length;
+    int64_t last_modified;      /** Last-Modified as Unix time, 0 for none */
+    const char *allow;          /** Allow value (e.g. "GET, HEAD"), NULL for none */
+    size_t allow_length;
+    bool deferred_length;       /** Reserve Content-Length for a body written afterwards */
 } http_response_config_t;
 
 /** HTTP response buffer */
@@ -68,7 +108,7 @@ void http_response_cleanup(void);
 /**
  * @brief Calculate required buffer size for a response
  * @param config Response configuration
- * @return Required buffer size in bytes, 0 on error
+ * @return Exact size of headers plus body in bytes, 0 on error
  */
 size_t http_response_calculate_size(const http_response_config_t *config);
 
@@ -78,10 +118,84 @@ size_t http_response_calculate_size(const http_response_config_t *config);
  * @param[in] config Response configuration
  * @return HTTP_RESPONSE_OK on success, error code otherwise
  * @note Buffer must be large enough (use http_response_calculate_size)
+ * @note A NULL body with a nonzero body_length builds the headers only, for
+ *       bodies that are sent separately (e.g. from a file)
  */
 http_response_error_t http_response_build(http_response_buffer_t *buffer,
                                           const http_response_config_t *config);
 
+/**
+ * @brief Format an unsigned integer in decimal
+ * @param value Value to format
+ * @param[out] digits At least HTTP_RESPONSE_UINT_MAX_DIGITS bytes, not terminated
+ * @return Number of digits written
+ */
+size_t http_response_format_uint(uint64_t value, char *digits);
+
+/**
+ * @brief Get offset of the Date value inside a built response
+ * @param config Response configuration the response was built from
+ * @return Byte offset of the HTTP_RESPONSE_DATE_LENGTH date characters,
+ *         or (size_t)-1 if the response has no Date header
+ * @note Lets callers that cache built responses patch the date in place
+ */
+size_t http_response_date_offset(const http_response_config_t *config);
+
+/**
+ * @brief Get offset of a reserved Content-Length value inside a built response
+ * @param config Response configuration with deferred_length set
+ * @return Byte offset of the HTTP_RESPONSE_LENGTH_FIELD_WIDTH placeholder,
+ *         or (size_t)-1 if the length is not deferred
+ */
+size_t http_response_length_offset(const http_response_config_t *config);
+
+/**
+ * @brief Fill in a deferred Content-Length
+ * @param field HTTP_RESPONSE_LENGTH_FIELD_WIDTH bytes at http_response_length_offset()
+ * @param tail_length Bytes following the field: the remaining headers and the body
+ * @param body_length Length of the body written after the headers
+ * @param[out] removed Bytes the response shrank by
+ * @return HTTP_RESPONSE_OK, HTTP_RESPONSE_ERROR_BUFFER_OVERFLOW if the length
+ *         does not fit the field
+ * @note The tail is moved up against the digits, so the value carries no padding
+ */
+http_response_error_t http_response_set_length(char *field, size_t tail_length,
+                                               size_t body_length, size_t *removed);
+
+/**
+ * @brief Calculate the size of a response's HPACK header block
+ * @param config Response configuration
+ * @return Exact size of the block, 0 on error
+ */
+size_t http_response_hpack_size(const http_response_config_t *config);
+
+/**
+ * @brief Build the HPACK header block of an HTTP/2 response
+ * @param[out] buffer Buffer receiving the block
+ * @param[in] config Response configuration; the body is not part of the block
+ * @return HTTP_RESPONSE_OK on success, error code otherwise
+ * @note A deferred_length configuration leaves content-length out, to be
+ *       appended with http_response_hpack_length()
+ */
+http_response_error_t http_response_build_hpack(http_response_buffer_t *buffer,
+                                                const http_response_config_t *config);
+
+/**
+ * @brief Get offset of the date value inside a built HPACK block
+ * @param config Response configuration the block was built from
+ * @return Byte offset of the HTTP_RESPONSE_DATE_LENGTH date characters,
+ *         or (size_t)-1 if the block has no date field
+ */
+size_t http_response_hpack_date_offset(const http_response_config_t *config);
+
+/**
+ * @brief Encode the content-length field of an HTTP/2 response
+ * @param[out] field At least HTTP_RESPONSE_HPACK_LENGTH_SIZE bytes
+ * @param body_length Body length
+ * @return Bytes written
+ */
+size_t http_response_hpack_length(char *field, size_t body_length);
+
 /**
  * @brief Initialize response buffer
  * @param[out] buffer Buffer to initialize
@@ -106,6 +220,14 @@ void http_response_buffer_reset(http_response_buffer_t *buffer);
  */
 const char *http_response_content_type_string(content_type_t type);
 
+/**
+ * @brief Pick a content type from a file name extension
+ * @param path File path
+ * @param length Path length
+ * @return Matching content type, CONTENT_TYPE_APPLICATION_OCTET_STREAM if unknown
+ */
+content_type_t http_response_content_type_for_path(const char *path, size_t length);
+
 /**
  * @brief Get HTTP status line string
  * @param status Status code
@@ -11,8 +11,11 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 
 #include "../../include/domain/http_response.h"
+#include "../../include/domain/response_cache.h"
+#include "../../include/platform/file_cache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,11 +33,27 @@ typedef enum {
     HTTP_SERVER_ERROR_RESPONSE_BUILD = -3
 } http_server_error_t;
 
+/**
+ * Route table, declared once: X(route id, method, path, handler, cacheable)
+ *
+ * Each entry becomes an http_route_t value, a slot in the router's perfect
+ * hash (built by http_server_init) and an entry in the handler dispatch
+ * table used by http_server_handle_request. Handlers are defined in
+ * http_server.c. Routes marked cacheable produce output that depends only on
+ * the path and query and is written to the stream's byte buffer; their
+ * responses are kept in the response cache when it is enabled.
+ */
+#define HTTP_SERVER_ROUTES(X) \
+    X(ROUTE_PLAINTEXT, "GET", "/plaintext", http_server_handle_static, false) \
+    X(ROUTE_JSON,      "GET", "/json",      http_server_handle_json,   true)
+
 /** HTTP request route */
 typedef enum {
-    ROUTE_PLAINTEXT,
-    ROUTE_JSON,
-    ROUTE_UNKNOWN
+#define HTTP_SERVER_ROUTE_ID(id, method, path, handler, cacheable) id,
+    HTTP_SERVER_ROUTES(HTTP_SERVER_ROUTE_ID)
+#undef HTTP_SERVER_ROUTE_ID
+    ROUTE_UNKNOWN,
+    ROUTE_COUNT                         /** Number of routes including ROUTE_UNKNOWN */
 } http_route_t;
 
 /** HTTP server configuration */
@@ -42,13 +61,45 @@ typedef struct {
     const char *plaintext_response;     /** Static plaintext response */
     const char *json_message;           /** JSON message field value */
     bool enable_date_headers;           /** Whether to include Date headers */
+    const char *document_root;          /** Directory served for unmatched GETs, NULL to disable */
+    unsigned response_cache_ttl_ms;     /** Lifetime of cached responses, 0 disables the cache */
+    size_t response_cache_size;         /** Bytes of cached responses per worker */
 } http_server_config_t;
 
+/** Most responses the response cache holds */
+#define HTTP_SERVER_RESPONSE_CACHE_ENTRIES 1024
+
+/** Maximum size of a precomputed static route response (headers + body) */
+#define HTTP_SERVER_CACHED_RESPONSE_SIZE (4096 + 256)
+
+/** Maximum size of a precomputed HPACK header block */
+#define HTTP_SERVER_CACHED_HPACK_SIZE 256
+
+/** Precomputed wire bytes for a static route */
+typedef struct {
+    char buffer[HTTP_SERVER_CACHED_RESPONSE_SIZE]; /** Complete HTTP response */
+    size_t length;                      /** Bytes used in buffer */
+    size_t date_offset;                 /** Offset of Date value, (size_t)-1 if none */
+    size_t length_offset;               /** Offset of a reserved Content-Length for a body
+                                            serialized per request, (size_t)-1 if complete */
+    size_t body_offset;                 /** Offset of the body in buffer */
+    char hpack[HTTP_SERVER_CACHED_HPACK_SIZE]; /** HTTP/2 header block, content-length
+                                            left out for a body serialized per request */
+    size_t hpack_length;
+    size_t hpack_date_offset;           /** Offset of the date in hpack, (size_t)-1 if none */
+} http_cached_response_t;
+
 /** HTTP server instance */
 typedef struct {
-    http_server_config_t config;
-    char json_buffer[4096];             /** Buffer for JSON responses */
-    size_t json_buffer_size;
+    http_server_config_t config;        /** Strings point into strings */
+    char *strings;                      /** Copies of the configured strings */
+    size_t json_message_length;
+    http_cached_response_t cached_responses[ROUTE_COUNT]; /** Indexed by http_route_t */
+    time_t cached_date_second;          /** Second the cached Date values were set for */
+    file_cache_t file_cache;            /** Open files beneath document_root */
+    bool serve_files;                   /** document_root is configured */
+    response_cache_t response_cache;    /** Responses of cacheable routes */
+    bool cache_responses;               /** response_cache is enabled */
 } http_server_t;
 
 /**
@@ -65,8 +116,10 @@ void http_server_cleanup(void);
 /**
  * @brief Initialize HTTP server instance
  * @param[out] server Server instance to initialize
- * @param[in] config Server configuration
+ * @param[in] config Server configuration, strings are copied
  * @return HTTP_SERVER_OK on success, error code otherwise
+ * @note A server holds no reference to the configuration, so a new one
+ *       can be built next to a running one and replace it whole
  */
 http_server_error_t http_server_create(http_server_t *server,
                                          const http_server_config_t *config);
@@ -74,25 +127,41 @@ http_server_error_t http_server_create(http_server_t *server,
 /**
  * @brief Cleanup HTTP server instance
  * @param server Server instance to cleanup
+ * @note Safe on a server whose http_server_create() failed
  */
 void http_server_destroy(http_server_t *server);
 
+/**
+ * @brief Drop all cached responses, e.g. after their source changed
+ * @param server Server instance
+ * @return Number of responses dropped, 0 if the cache is disabled
+ */
+size_t http_server_purge_cache(http_server_t *server);
+
 /**
  * @brief Handle HTTP request and generate response
  * @param server HTTP server instance
  * @param context Server context from reactor
  * @return HTTP_SERVER_OK on success, error code otherwise
  * @note This function writes the response directly to the stream
+ * @note Responses are copied from the cache built by http_server_create;
+ *       only the Date value is rewritten, once per second. JSON bodies are
+ *       serialized into the stream after the cached headers.
+ * @note With the response cache enabled, cacheable routes are answered from
+ *       it while an entry for their query lives, and fill it otherwise
  */
 http_server_error_t http_server_handle_request(http_server_t *server,
                                                  struct server_context *context);
 
 /**
- * @brief Parse route from request target
- * @param target Request target string (e.g., "/plaintext")
- * @return Parsed route
+ * @brief Parse route from request method and target
+ * @param method Request method (e.g., "GET"), NULL to match any method
+ * @param target Request target string (e.g., "/plaintext?x=1")
+ * @return Parsed route, ROUTE_UNKNOWN if no entry matches
+ * @note Query strings are ignored; lookup is a single hash probe
+ * @note Requires http_server_init() to have built the router
  */
-http_route_t http_server_parse_route(const segment *target);
+http_route_t http_server_parse_route(const segment *method, const segment *target);
 
 /**
  * @brief Generate response for a route
@@ -100,11 +169,25 @@ http_route_t http_server_parse_route(const segment *target);
  * @param route Route to generate response for
  * @param[out] response_config Response configuration to fill
  * @return HTTP_SERVER_OK on success, error code otherwise
+ * @note Routes whose body is serialized per request get a header-only
+ *       configuration with deferred_length set
  */
 http_server_error_t http_server_generate_response(const http_server_t *server,
                                                     http_route_t route,
                                                     http_response_config_t *response_config);
 
+/**
+ * @brief Get printable names for every route
+ * @return Array of ROUTE_COUNT names indexed by http_route_t
+ */
+const char *const *http_server_route_names(void);
+
+/**
+ * @brief Refresh the Date value of every cached response if the second changed
+ * @param server HTTP server instance
+ */
+void http_server_refresh_cached_date(http_server_t *server);
+
 #ifdef __cplusplus
 }
 #endif
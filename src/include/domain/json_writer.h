@@ -0,0 +1,166 @@
+/**
+ * @file json_writer.h
+ * @brief Domain layer for streaming JSON serialization
+ *
+ * This module appends JSON text to a buffer as values are written, so a
+ * response body can be serialized straight into a connection's output
+ * without an intermediate copy or a size limit. Commas and colons are
+ * inserted automatically; nesting is checked up to JSON_WRITER_MAX_DEPTH.
+ * Strings are scanned for characters that need escaping 16 bytes at a time
+ * (SSE2 or NEON; building with JSON_WRITER_SIMD=0 leaves the scalar scan),
+ * numbers are formatted without printf in the common cases.
+ *
+ * Errors are sticky: after the first one every call returns it and writes
+ * nothing, so callers can check json_writer_finish() only.
+ */
+
+#ifndef DOMAIN_JSON_WRITER_H
+#define DOMAIN_JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <dynamic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Compile the vector escaping scan (set to 0 for a scalar-only build) */
+#ifndef JSON_WRITER_SIMD
+#define JSON_WRITER_SIMD 1
+#endif
+
+/** Deepest nesting of objects and arrays */
+#define JSON_WRITER_MAX_DEPTH 32
+
+/** JSON writer error codes */
+typedef enum {
+    JSON_WRITER_OK = 0,
+    JSON_WRITER_ERROR_INVALID_PARAM = -1,
+    JSON_WRITER_ERROR_DEPTH = -2,       /** Nested too deep, or an end without a begin */
+    JSON_WRITER_ERROR_STATE = -3        /** Key outside an object, member value without a key,
+                                            or an unfinished document */
+} json_writer_error_t;
+
+/** Writer appending to a buffer */
+typedef struct {
+    buffer *output;
+    size_t start;                       /** Output size when the writer was initialized */
+    uint64_t objects;                   /** Bit per depth: the container is an object */
+    uint64_t members;                   /** Bit per depth: the container has a value already */
+    unsigned depth;                     /** Open containers */
+    bool after_key;                     /** A key was written, its value comes next */
+    json_writer_error_t error;          /** First error */
+} json_writer_t;
+
+/**
+ * @brief Start a document at the end of a buffer
+ * @param[out] writer Writer to initialize
+ * @param output Buffer to append to
+ * @return JSON_WRITER_OK on success, error code otherwise
+ */
+json_writer_error_t json_writer_init(json_writer_t *writer, buffer *output);
+
+/**
+ * @brief Open an object
+ * @param writer Writer
+ * @return JSON_WRITER_OK on success, error code otherwise
+ */
+json_writer_error_t json_writer_begin_object(json_writer_t *writer);
+
+/**
+ * @brief Close the innermost object
+ * @param writer Writer
+ * @return JSON_WRITER_OK on success, error code otherwise
+ */
+json_writer_error_t json_writer_end_object(json_writer_t *writer);
+
+/**
+ * @brief Open an array
+ * @param writer Writer
+ * @return JSON_WRITER_OK on success, error code otherwise
+ */
+json_writer_error_t json_writer_begin_array(json_writer_t *writer);
+
+/**
+ * @brief Close the innermost array
+ * @param writer Writer
+ * @return JSON_WRITER_OK on success, error code otherwise
+ */
+json_writer_error_t json_writer_end_array(json_writer_t *writer);
+
+/**
+ * @brief Write the key of the next object member
+ * @param writer Writer
+ * @param key Key bytes (UTF-8), escaped as needed
+ * @param length Key length
+ * @return JSON_WRITER_OK on success, error code otherwise
+ */
+json_writer_error_t json_writer_key(json_writer_t *writer, const char *key, size_t length);
+
+/**
+ * @brief Write a string value
+ * @param writer Writer
+ * @param value String bytes (UTF-8), escaped as needed
+ * @param length String length
+ * @return JSON_WRITER_OK on success, error code otherwise
+ */
+json_writer_error_t json_writer_string(json_writer_t *writer, const char *value, size_t length);
+
+/**
+ * @brief Write a signed integer value
+ * @param writer Writer
+ * @param value Value
+ * @return JSON_WRITER_OK on success, error code otherwise
+ */
+json_writer_error_t json_writer_int(json_writer_t *writer, int64_t value);
+
+/**
+ * @brief Write an unsigned integer value
+ * @param writer Writer
+ * @param value Value
+ * @return JSON_WRITER_OK on success, error code otherwise
+ */
+json_writer_error_t json_writer_uint(json_writer_t *writer, uint64_t value);
+
+/**
+ * @brief Write a floating-point value
+ * @param writer Writer
+ * @param value Value; NaN and infinities, which JSON lacks, are written as null
+ * @return JSON_WRITER_OK on success, error code otherwise
+ * @note The text reads back as the same double; values with at most 15
+ *       significant digits and no exponent take the shortest form without printf
+ */
+json_writer_error_t json_writer_double(json_writer_t *writer, double value);
+
+/**
+ * @brief Write true or false
+ * @param writer Writer
+ * @param value Value
+ * @return JSON_WRITER_OK on success, error code otherwise
+ */
+json_writer_error_t json_writer_bool(json_writer_t *writer, bool value);
+
+/**
+ * @brief Write null
+ * @param writer Writer
+ * @return JSON_WRITER_OK on success, error code otherwise
+ */
+json_writer_error_t json_writer_null(json_writer_t *writer);
+
+/**
+ * @brief Check that the document is complete
+ * @param writer Writer
+ * @param[out] length Bytes appended since json_writer_init() (may be NULL)
+ * @return JSON_WRITER_OK if exactly one value was written and all containers
+ *         are closed, the first error otherwise
+ */
+json_writer_error_t json_writer_finish(json_writer_t *writer, size_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DOMAIN_JSON_WRITER_H */
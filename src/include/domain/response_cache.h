@@ -0,0 +1,143 @@
+/**
+ * @file response_cache.h
+ * @brief Domain layer for caching serialized responses of dynamic routes
+ *
+ * This module keeps complete responses (headers and body) of routes whose
+ * output depends only on the route and the query, for a fixed time to live.
+ * Keys are the route plus the query with its parameters sorted and empty ones
+ * dropped, so "?a=1&b=2" and "?b=2&a=1&" share an entry. Entries live in a
+ * fixed table hashed into chained buckets. When the table or the byte budget
+ * is full, a CLOCK hand sweeps the table and evicts the first entry that is
+ * expired or was not hit since the hand last passed it.
+ *
+ * A cache belongs to one worker and is used without locks.
+ */
+
+#ifndef DOMAIN_RESPONSE_CACHE_H
+#define DOMAIN_RESPONSE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Longest query that is cached */
+#define RESPONSE_CACHE_MAX_KEY 256
+
+/** Most query parameters that are cached */
+#define RESPONSE_CACHE_MAX_PARAMS 16
+
+/** Response cache error codes */
+typedef enum {
+    RESPONSE_CACHE_OK = 0,
+    RESPONSE_CACHE_ERROR_INVALID_PARAM = -1,
+    RESPONSE_CACHE_ERROR_MEMORY = -2,
+    RESPONSE_CACHE_ERROR_UNCACHEABLE = -3 /** Query too long, or response over the byte budget */
+} response_cache_error_t;
+
+/** Normalized lookup key */
+typedef struct {
+    uint64_t hash;
+    unsigned route;
+    size_t length;                      /** Bytes used in data */
+    char data[RESPONSE_CACHE_MAX_KEY];  /** Sorted parameters joined by '&' */
+} response_cache_key_t;
+
+/** Cached response */
+typedef struct {
+    char *data;                         /** Response bytes followed by the key */
+    size_t length;                      /** Response length */
+    size_t key_length;
+    size_t date_offset;                 /** Offset of the Date value, (size_t)-1 if none */
+    uint64_t hash;
+    int64_t expires_ms;
+    int32_t next;                       /** Next entry of the bucket or free list, -1 at the end */
+    unsigned route;
+    bool used;
+    bool referenced;                    /** Hit since the CLOCK hand last passed */
+} response_cache_entry_t;
+
+/** Cache of one worker */
+typedef struct {
+    response_cache_entry_t *entries;    /** Table swept by the CLOCK hand */
+    int32_t *buckets;                   /** First entry per hash bucket, -1 if empty */
+    size_t capacity;                    /** Entries and buckets (power of two) */
+    size_t count;
+    size_t bytes;                       /** Response and key bytes stored */
+    size_t max_bytes;
+    unsigned ttl_ms;
+    size_t hand;
+    int32_t free_list;
+} response_cache_t;
+
+/**
+ * @brief Create an empty cache
+ * @param[out] cache Cache to initialize
+ * @param capacity Most entries, rounded up to a power of two
+ * @param max_bytes Most response and key bytes stored
+ * @param ttl_ms Time an entry is served after it was stored
+ * @return RESPONSE_CACHE_OK on success, error code otherwise
+ */
+response_cache_error_t response_cache_init(response_cache_t *cache, size_t capacity,
+                                           size_t max_bytes, unsigned ttl_ms);
+
+/**
+ * @brief Free all entries and the table
+ * @param cache Cache
+ */
+void response_cache_cleanup(response_cache_t *cache);
+
+/**
+ * @brief Drop every entry, keeping the table
+ * @param cache Cache
+ * @return Number of entries dropped
+ */
+size_t response_cache_purge(response_cache_t *cache);
+
+/**
+ * @brief Build the key of a request
+ * @param[out] key Key to fill
+ * @param route Route of the request
+ * @param query Query string after '?', may be NULL if length is 0
+ * @param length Query length
+ * @return RESPONSE_CACHE_OK on success, RESPONSE_CACHE_ERROR_UNCACHEABLE if
+ *         the query is longer than RESPONSE_CACHE_MAX_KEY or has more than
+ *         RESPONSE_CACHE_MAX_PARAMS parameters
+ */
+response_cache_error_t response_cache_key(response_cache_key_t *key, unsigned route,
+                                          const char *query, size_t length);
+
+/**
+ * @brief Find the live response for a key
+ * @param cache Cache
+ * @param key Key from response_cache_key()
+ * @param now_ms Current monotonic time
+ * @return Entry, NULL if none or expired
+ */
+const response_cache_entry_t *response_cache_lookup(response_cache_t *cache,
+                                                    const response_cache_key_t *key,
+                                                    int64_t now_ms);
+
+/**
+ * @brief Store a response, replacing any entry for the key
+ * @param cache Cache
+ * @param key Key from response_cache_key()
+ * @param response Complete response, copied
+ * @param length Response length
+ * @param date_offset Offset of the Date value in response, (size_t)-1 if none
+ * @param now_ms Current monotonic time
+ * @return RESPONSE_CACHE_OK on success, error code otherwise
+ * @note Evicts entries with the CLOCK hand until the response fits
+ */
+response_cache_error_t response_cache_store(response_cache_t *cache, const response_cache_key_t *key,
+                                            const char *response, size_t length,
+                                            size_t date_offset, int64_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DOMAIN_RESPONSE_CACHE_H */
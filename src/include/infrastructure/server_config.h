@@ -0,0 +1,98 @@
+/**
+ * @file server_config.h
+ * @brief Server configuration from command-line options and config files
+ *
+ * Every setting has one name that is used in both places: "--busy-poll 50"
+ * on the command line and "busy-poll = 50" in a file. Boolean settings are
+ * flags on the command line ("--skip-smt", "--no-tcp-nodelay") and take
+ * true/false, yes/no, on/off or 1/0 in a file. Values overwrite the ones
+ * in the server_config_t they are applied to, so applying
+ * server_infrastructure_default_config(), then a file, then the command
+ * line gives the usual precedence.
+ */
+
+#ifndef INFRASTRUCTURE_SERVER_CONFIG_H
+#define INFRASTRUCTURE_SERVER_CONFIG_H
+
+#include <stdio.h>
+
+#include "../../include/infrastructure/server_infrastructure.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Server configuration error codes */
+typedef enum {
+    SERVER_CONFIG_OK = 0,
+    SERVER_CONFIG_ERROR_INVALID_PARAM = -1,
+    SERVER_CONFIG_ERROR_UNKNOWN_KEY = -2,
+    SERVER_CONFIG_ERROR_INVALID_VALUE = -3,
+    SERVER_CONFIG_ERROR_MISSING_VALUE = -4,
+    SERVER_CONFIG_ERROR_IO = -5,           /** The file could not be read, see errno */
+    SERVER_CONFIG_ERROR_MEMORY = -6
+} server_config_error_t;
+
+/** Most workers a configuration may ask for */
+#define SERVER_CONFIG_MAX_WORKERS 1024
+
+/**
+ * @brief Apply one setting
+ * @param config Configuration to change
+ * @param key Setting name without dashes, e.g. "port"
+ * @param value Setting value, NULL to turn a boolean setting on
+ * @return SERVER_CONFIG_OK on success, error code otherwise
+ * @note Strings are copied with system_strdup() and worker_config.cpu_ids
+ *       is replaced by "cpus"; the values they replace are freed, so they
+ *       must come from system_malloc() or be NULL, as in
+ *       server_infrastructure_default_config()
+ */
+server_config_error_t server_config_set(server_config_t *config, const char *key, const char *value);
+
+/**
+ * @brief Free the strings and CPU list of a configuration
+ * @param config Configuration built from server_infrastructure_default_config()
+ * @note The pointers are set to NULL, so a second call does nothing
+ */
+void server_config_cleanup(server_config_t *config);
+
+/**
+ * @brief Apply the settings of a config file
+ * @param config Configuration to change
+ * @param path File with one "key = value" per line, '#' starts a comment
+ * @param[out] line Line of the first error, 0 for I/O errors (may be NULL)
+ * @return SERVER_CONFIG_OK on success, error code otherwise
+ * @note Settings before the failing line stay applied
+ */
+server_config_error_t server_config_load_file(server_config_t *config, const char *path, int *line);
+
+/**
+ * @brief Apply one command-line option and its value
+ * @param config Configuration to change
+ * @param argc Argument count
+ * @param argv Arguments
+ * @param[in,out] index Index of the option, advanced past its value
+ * @return SERVER_CONFIG_OK on success, SERVER_CONFIG_ERROR_UNKNOWN_KEY if
+ *         argv[*index] is not a setting, error code otherwise
+ */
+server_config_error_t server_config_parse_option(server_config_t *config, int argc, char *argv[],
+                                                 int *index);
+
+/**
+ * @brief Print the command-line form of every setting
+ * @param out Stream to print to
+ */
+void server_config_print_usage(FILE *out);
+
+/**
+ * @brief Get a description of an error code
+ * @param error Error code
+ * @return Static description
+ */
+const char *server_config_strerror(server_config_error_t error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFRASTRUCTURE_SERVER_CONFIG_H */
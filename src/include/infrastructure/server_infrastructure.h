@@ -20,6 +20,8 @@
 #include "../../include/platform/socket.h"
 #include "../../include/platform/log.h"
 #include "../../include/platform/signals.h"
+#include "../../include/platform/metrics.h"
+#include "../../include/platform/trace.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,13 +36,70 @@ typedef enum {
     SERVER_INFRA_ERROR_STARTUP = -4
 } server_infra_error_t;
 
-/** Server configuration */
+/** Environment variable naming the unix socket a new binary receives listeners on */
+#define SERVER_INFRA_HANDOFF_ENV "LIBREACTOR_HANDOFF_FD"
+
+/** How long the running binary waits for its replacement to become ready */
+#define SERVER_INFRA_UPGRADE_TIMEOUT_MS 30000
+
+/** Shared page the parent publishes reloaded settings in */
+#define SERVER_INFRA_CONFIG_PAGE_SIZE (16 * 1024)
+
+/** How workers wait for events */
+typedef enum {
+    SERVER_IDLE_BLOCK,                      /** Sleep until an event arrives */
+    SERVER_IDLE_SPIN,                       /** Spin for spin_us, then sleep */
+    SERVER_IDLE_BUSY_POLL,                  /** Kernel busy-polls the NIC for busy_poll_value us */
+    SERVER_IDLE_ADAPTIVE                    /** Switch between the above by event rate */
+} server_idle_mode_t;
+
+/** Worker idle strategy */
 typedef struct {
+    server_idle_mode_t mode;
+    unsigned spin_us;                       /** Spin time before sleeping */
+    unsigned spin_rate;                     /** Events per second from which adaptive spins */
+    unsigned busy_poll_rate;                /** Events per second from which adaptive busy-polls */
+} server_idle_config_t;
+
+/** Connection timeouts and caps per worker; 0 disables each */
+typedef struct {
+    unsigned header_timeout_ms;             /** From connect or a request's first byte to its full head */
+    unsigned idle_timeout_ms;               /** Without progress while a response is sent */
+    unsigned keepalive_timeout_ms;          /** Between a response and the next request */
+    unsigned max_requests;                  /** Requests per connection */
+    unsigned max_connections;               /** Open connections per worker */
+} server_limits_config_t;
+
+struct server_config;
+
+/** Rebuilds the configuration on reload; returns false if it is invalid */
+typedef bool (*server_config_loader_t)(struct server_config *config);
+
+/** Server configuration */
+typedef struct server_config {
     uint16_t port;                          /** Server port */
+    int backlog;                            /** Accept queue length of each listener */
+    int workers;                            /** Worker processes, 0 for one per placed CPU */
     const char *plaintext_response;         /** Plaintext response content */
     const char *json_message;               /** JSON message content */
     bool enable_date_headers;               /** Include Date headers */
     bool enable_socket_optimizations;       /** Enable socket optimizations */
+    bool enable_http2;                      /** Accept cleartext HTTP/2 connections */
+    bool enable_metrics;                    /** Per-worker counters + admin endpoint */
+    uint16_t metrics_port;                  /** Admin port serving /metrics */
+    uint32_t metrics_address;               /** IPv4 address of the admin port, network byte order */
+    unsigned trace_sample;                  /** Trace one request in N for /trace, 0 to disable */
+    const char *document_root;              /** Static files for unmatched GETs, NULL to disable */
+    size_t pool_high_water;                 /** Free slab bytes each worker keeps for reuse */
+    unsigned response_cache_ttl_ms;         /** Lifetime of cached dynamic responses, 0 to disable */
+    size_t response_cache_size;             /** Bytes of cached responses per worker */
+    char *const *argv;                      /** Command line re-executed on SIGUSR2, NULL to disable */
+    server_config_loader_t load_config;     /** Configuration source re-read on SIGHUP, NULL to disable */
+    unsigned drain_timeout_ms;              /** Time old workers get to finish connections */
+    bool skip_smt_siblings;                 /** One worker per physical core */
+    const char *irq_interface;              /** Run workers on this NIC's interrupt CPUs, NULL to ignore */
+    server_idle_config_t idle_config;       /** Worker idle strategy */
+    server_limits_config_t limits_config;   /** Connection timeouts and caps */
     socket_config_t socket_config;          /** Socket optimization config */
     worker_config_t worker_config;          /** Worker process config */
     log_config_t log_config;                /** Logging configuration */
@@ -50,6 +109,8 @@ typedef struct {
 /** Forward declaration */
 struct server_infrastructure;
 
+struct server_config_page;
+
 /** Server state for reactor callbacks */
 typedef struct {
     server *srv;
@@ -59,9 +120,16 @@ typedef struct {
 /** Server infrastructure instance */
 typedef struct server_infrastructure {
     server_config_t config;
-    http_server_t http_server;
+    http_server_t *http_server;             /** Current snapshot, replaced whole on reload */
     worker_manager_t worker_manager;
     signal_manager_t signal_manager;
+    metrics_t metrics;
+    trace_t trace;                          /** Request trace rings, set up with metrics */
+    int *listeners;                         /** One listener per worker, opened by the parent */
+    int listener_count;
+    int handoff_fd;                         /** Channel to the binary we replace, -1 if none */
+    struct server_config_page *config_page; /** Settings shared with the workers, NULL if unavailable */
+    uint64_t config_generation;             /** Reload the settings in use came from */
     bool initialized;
 } server_infrastructure_t;
 
@@ -97,12 +165,19 @@ void server_infrastructure_destroy(server_infrastructure_t *infra);
  * @return SERVER_INFRA_OK on success, error code otherwise
  * @note For worker processes, returns after forking
  * @note For parent process, waits for workers to exit
+ * @note On SIGUSR2 the parent starts config.argv again, hands it the
+ *       listeners and, once its workers are ready, drains its own and returns
+ * @note On SIGHUP the parent rebuilds the configuration with
+ *       config.load_config and, if it is valid, pushes the settings that can
+ *       change at run time to the workers; they replace their http_server_t
+ *       between events
  */
 server_infra_error_t server_infrastructure_start(server_infrastructure_t *infra);
 
 /**
  * @brief Get default server configuration
- * @return Default configuration
+ * @return Default configuration; its strings and CPU list come from
+ *         system_malloc() and are released with server_config_cleanup()
  */
 server_config_t server_infrastructure_default_config(void);
 
@@ -111,6 +186,8 @@ server_config_t server_infrastructure_default_config(void);
  * @param event Reactor event
  * @return Reactor status
  * @note This is the main request handler that coordinates domain logic
+ * @note Called once per pipelined request; responses are appended to the
+ *       connection output and flushed once per read burst by the backend
  */
 core_status server_infrastructure_request_handler(core_event *event);
 
@@ -0,0 +1,120 @@
+/**
+ * @file control_channel.h
+ * @brief Platform abstraction for parent-to-worker control messages
+ *
+ * This module gives each worker a single-producer single-consumer ring of
+ * fixed-size messages in memory shared with the parent, plus an eventfd
+ * doorbell. The parent appends a message and rings the doorbell; the worker
+ * watches the doorbell in its reactor like any other descriptor and applies
+ * the messages between events. Neither side takes a lock: the parent only
+ * writes the head and the worker only writes the tail.
+ *
+ * Channels are created by the parent and survive worker restarts; a
+ * replacement worker starts with an empty ring.
+ */
+
+#ifndef PLATFORM_CONTROL_CHANNEL_H
+#define PLATFORM_CONTROL_CHANNEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Messages a ring holds (power of two) */
+#define CONTROL_CHANNEL_SLOTS 64
+
+/** Payload bytes per message */
+#define CONTROL_CHANNEL_PAYLOAD 48
+
+/** Control channel error codes */
+typedef enum {
+    CONTROL_CHANNEL_OK = 0,
+    CONTROL_CHANNEL_ERROR_INVALID_PARAM = -1,
+    CONTROL_CHANNEL_ERROR_MEMORY = -2,
+    CONTROL_CHANNEL_ERROR_EVENTFD = -3,
+    CONTROL_CHANNEL_ERROR_FULL = -4    /** The worker has not caught up */
+} control_channel_error_t;
+
+/** Message types */
+typedef enum {
+    CONTROL_MESSAGE_DRAIN = 1,         /** Stop accepting and finish connections */
+    CONTROL_MESSAGE_PURGE_CACHE = 2,   /** Drop all cached responses */
+    CONTROL_MESSAGE_LOG_LEVEL = 3,     /** Log at the log_level_t in value */
+    CONTROL_MESSAGE_CONFIG = 4         /** Apply the settings the parent published as generation value */
+} control_message_type_t;
+
+/** One message (one cache line) */
+typedef struct {
+    uint32_t type;                     /** control_message_type_t */
+    uint32_t length;                   /** Payload bytes used */
+    int64_t value;
+    char payload[CONTROL_CHANNEL_PAYLOAD];
+} control_message_t;
+
+/** Shared ring; head and tail sit on their own cache lines */
+typedef struct {
+    uint64_t head __attribute__((aligned(64)));  /** Messages sent, written by the parent */
+    uint64_t tail __attribute__((aligned(64)));  /** Messages received, written by the worker */
+    control_message_t slots[CONTROL_CHANNEL_SLOTS] __attribute__((aligned(64)));
+} control_channel_ring_t;
+
+/** Channel to one worker */
+typedef struct {
+    control_channel_ring_t *ring;      /** Shared mapping, NULL until created */
+    int doorbell;                      /** Eventfd written after each message */
+} control_channel_t;
+
+/**
+ * @brief Map a ring and create its doorbell
+ * @param[out] channel Channel to initialize
+ * @return CONTROL_CHANNEL_OK on success, error code otherwise
+ * @note Call in the parent before forking the worker that receives
+ */
+control_channel_error_t control_channel_create(control_channel_t *channel);
+
+/**
+ * @brief Unmap the ring and close the doorbell
+ * @param channel Channel
+ */
+void control_channel_destroy(control_channel_t *channel);
+
+/**
+ * @brief Drop unread messages and doorbell rings
+ * @param channel Channel
+ * @note Only while no worker receives, e.g. before forking a replacement
+ */
+void control_channel_reset(control_channel_t *channel);
+
+/**
+ * @brief Append a message and ring the doorbell (producer side)
+ * @param channel Channel
+ * @param message Message, copied
+ * @return CONTROL_CHANNEL_OK on success, CONTROL_CHANNEL_ERROR_FULL if the
+ *         ring has no free slot, error code otherwise
+ */
+control_channel_error_t control_channel_send(control_channel_t *channel, const control_message_t *message);
+
+/**
+ * @brief Acknowledge the doorbell (consumer side)
+ * @param channel Channel
+ * @note Call before receiving, so a message sent meanwhile rings again
+ */
+void control_channel_clear(control_channel_t *channel);
+
+/**
+ * @brief Take the oldest unread message (consumer side)
+ * @param channel Channel
+ * @param[out] message Message
+ * @return true if a message was taken
+ */
+bool control_channel_receive(control_channel_t *channel, control_message_t *message);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_CONTROL_CHANNEL_H */
@@ -0,0 +1,123 @@
+/**
+ * @file date_clock.h
+ * @brief Platform abstraction for the shared HTTP Date clock
+ *
+ * This module formats the RFC 7231 Date value once per second into a
+ * shared page mapped before the workers are forked. A single writer thread
+ * in the parent publishes each second under a sequence lock; response
+ * builders copy the fixed-length string without formatting or strlen.
+ * Processes without a running writer (e.g. the single-process server)
+ * refresh the page themselves through date_clock_poll().
+ */
+
+#ifndef PLATFORM_DATE_CLOCK_H
+#define PLATFORM_DATE_CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Length of the Date value ("Thu, 01 Jan 1970 00:00:00 GMT") */
+#define DATE_CLOCK_LENGTH 29
+
+/** Date clock error codes */
+typedef enum {
+    DATE_CLOCK_OK = 0,
+    DATE_CLOCK_ERROR_MEMORY = -1,
+    DATE_CLOCK_ERROR_THREAD = -2
+} date_clock_error_t;
+
+/** Published clock state (one cache line) */
+typedef struct {
+    uint32_t sequence;           /** Odd while the writer is updating */
+    uint32_t writer_active;      /** Nonzero while a writer thread owns the page */
+    int64_t second;              /** Unix second the date was formatted for */
+    char date[DATE_CLOCK_LENGTH];
+} __attribute__((aligned(64))) date_clock_page_t;
+
+/** Page read by date_clock_*(); process-local until date_clock_init() */
+extern date_clock_page_t *date_clock_page;
+
+/**
+ * @brief Map the shared clock page and publish the current date
+ * @return DATE_CLOCK_OK on success, error code otherwise
+ * @note Call before forking workers so every process reads the same page
+ */
+date_clock_error_t date_clock_init(void);
+
+/**
+ * @brief Start the writer thread that republishes the date every second
+ * @return DATE_CLOCK_OK on success, error code otherwise
+ */
+date_clock_error_t date_clock_start(void);
+
+/**
+ * @brief Stop the writer thread (if this process owns it) and unmap the page
+ */
+void date_clock_cleanup(void);
+
+/**
+ * @brief Reformat the page from the current time if the second changed
+ * @note Single writer only: the writer thread, or a process without one
+ */
+void date_clock_update(void);
+
+/**
+ * @brief Format a Unix time as an RFC 7231 date
+ * @param second Unix time
+ * @param[out] out Buffer of at least DATE_CLOCK_LENGTH bytes (not terminated)
+ */
+void date_clock_format(int64_t second, char *out);
+
+/**
+ * @brief Parse an RFC 7231 IMF-fixdate, the format date_clock_format() writes
+ * @param text Date value
+ * @param length Value length
+ * @param[out] second Unix time
+ * @return False if the value is not an IMF-fixdate (the obsolete formats included)
+ */
+bool date_clock_parse(const char *text, size_t length, int64_t *second);
+
+/**
+ * @brief Get the second of the published date, refreshing it if no writer runs
+ * @return Unix second of the current date value
+ */
+static inline int64_t date_clock_poll(void)
+{
+    date_clock_page_t *page = date_clock_page;
+    if (!__atomic_load_n(&page->writer_active, __ATOMIC_RELAXED)) {
+        date_clock_update();
+    }
+    return __atomic_load_n(&page->second, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Copy the published date
+ * @param[out] out Buffer of at least DATE_CLOCK_LENGTH bytes (not terminated)
+ * @return Unix second the copied date belongs to
+ */
+static inline int64_t date_clock_read(char *out)
+{
+    const date_clock_page_t *page = date_clock_page;
+    uint32_t start;
+    int64_t second;
+
+    do {
+        start = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        second = __atomic_load_n(&page->second, __ATOMIC_RELAXED);
+        memcpy(out, page->date, DATE_CLOCK_LENGTH);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((start & 1) || __atomic_load_n(&page->sequence, __ATOMIC_RELAXED) != start);
+
+    return second;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_DATE_CLOCK_H */
@@ -0,0 +1,122 @@
+/**
+ * @file file_cache.h
+ * @brief Platform abstraction for a cache of open static files
+ *
+ * This module resolves request paths beneath a document root and keeps the
+ * resulting files open in a reference-counted table keyed by path. Files up
+ * to a size limit are also read into memory so their bodies can be sent
+ * straight from the copy; larger ones are sent from the descriptor. Request
+ * paths are percent-decoded, and only regular files are served.
+ * Entries carry the metadata needed for ETag and Last-Modified and a slot
+ * for the caller's precomputed response headers. Each entry is revalidated
+ * against the file system at most once per second.
+ */
+
+#ifndef PLATFORM_FILE_CACHE_H
+#define PLATFORM_FILE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Longest request path looked up in the cache */
+#define FILE_CACHE_MAX_PATH 1024
+
+/** Room for precomputed response headers per entry */
+#define FILE_CACHE_HEADER_SIZE 512
+
+/** Default size limit for entries held in memory */
+#define FILE_CACHE_DEFAULT_MEMORY_LIMIT (256 * 1024)
+
+/** Default maximum number of cached entries */
+#define FILE_CACHE_DEFAULT_ENTRIES 1024
+
+/** File cache error codes */
+typedef enum {
+    FILE_CACHE_OK = 0,
+    FILE_CACHE_ERROR_INVALID_PARAM = -1,
+    FILE_CACHE_ERROR_MEMORY = -2,
+    FILE_CACHE_ERROR_NOT_FOUND = -3,
+    FILE_CACHE_ERROR_IO = -4
+} file_cache_error_t;
+
+/** Cached open file */
+typedef struct file_cache_entry {
+    struct file_cache_entry *next;      /** Hash chain */
+    char *path;                         /** Path relative to the root (key) */
+    size_t path_length;
+    uint64_t hash;
+    int fd;                             /** Open descriptor */
+    char *data;                         /** File contents, NULL if sent from fd */
+    size_t size;                        /** File size in bytes */
+    int64_t mtime;                      /** Modification time, Unix seconds */
+    int64_t mtime_nsec;
+    dev_t dev;
+    ino_t ino;
+    char etag[48];                      /** Quoted strong validator */
+    size_t etag_length;
+    char headers[FILE_CACHE_HEADER_SIZE]; /** Caller-built response headers */
+    size_t headers_length;              /** 0 until the caller fills headers */
+    size_t headers_date_offset;         /** Offset of the Date value, (size_t)-1 if none */
+    int64_t checked_second;             /** Last revalidation against stat() */
+    int refs;                           /** Cache reference plus in-flight users */
+} file_cache_entry_t;
+
+/** Path-keyed cache rooted at a directory */
+typedef struct {
+    int root_fd;                        /** Document root, -1 if not open */
+    size_t memory_limit;                /** Files up to this size are held in memory */
+    unsigned max_entries;
+    unsigned count;
+    unsigned bucket_count;              /** Power of two */
+    unsigned clock_hand;                /** Next bucket examined for eviction */
+    file_cache_entry_t **buckets;
+} file_cache_t;
+
+/**
+ * @brief Open the document root and allocate the table
+ * @param[out] cache Cache to initialize
+ * @param root Document root directory
+ * @param memory_limit Largest file held in memory
+ * @param max_entries Maximum number of entries kept open
+ * @return FILE_CACHE_OK on success, error code otherwise
+ */
+file_cache_error_t file_cache_init(file_cache_t *cache, const char *root,
+                                   size_t memory_limit, unsigned max_entries);
+
+/**
+ * @brief Drop every entry and close the document root
+ * @param cache Cache instance
+ * @note Entries still referenced are freed when their last reference goes
+ */
+void file_cache_cleanup(file_cache_t *cache);
+
+/**
+ * @brief Look up (opening on a miss) the file for a request path
+ * @param cache Cache instance
+ * @param path Request path starting with '/', without query string
+ * @param length Path length
+ * @param[out] entry Referenced entry on success
+ * @return FILE_CACHE_OK, FILE_CACHE_ERROR_NOT_FOUND for missing or
+ *         disallowed paths, other error code otherwise
+ * @note The caller owns one reference and must call file_cache_release()
+ */
+file_cache_error_t file_cache_acquire(file_cache_t *cache, const char *path, size_t length,
+                                      file_cache_entry_t **entry);
+
+/**
+ * @brief Drop a reference obtained from file_cache_acquire()
+ * @param entry Entry (void * so it can be used as a release hook)
+ */
+void file_cache_release(void *entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_FILE_CACHE_H */
@@ -0,0 +1,173 @@
+/**
+ * @file hpack.h
+ * @brief Platform abstraction for HPACK header compression (RFC 7541)
+ *
+ * This module decodes the header blocks of HTTP/2 requests and encodes the
+ * fields of responses. A decoder keeps the dynamic table of one connection:
+ * entry bytes sit oldest first in one buffer that is compacted when its end
+ * is reached, so eviction only moves a start offset. Huffman-coded strings
+ * are decoded against the canonical code (symbols ordered by code length).
+ *
+ * The encoder side never indexes: fields are written as indexed static
+ * entries or as literals without indexing, so an encoded block does not
+ * depend on the connection and can be built once and reused for every
+ * stream.
+ */
+
+#ifndef PLATFORM_HPACK_H
+#define PLATFORM_HPACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Entries of the static table */
+#define HPACK_STATIC_ENTRIES 61
+
+/** Dynamic table size both sides start with (SETTINGS_HEADER_TABLE_SIZE) */
+#define HPACK_DEFAULT_TABLE_SIZE 4096
+
+/** Bytes hpack_encode_integer() writes at most */
+#define HPACK_INTEGER_MAX_SIZE 6
+
+/** Static table indexes used when encoding responses */
+enum {
+    HPACK_INDEX_STATUS_200 = 8,
+    HPACK_INDEX_STATUS_304 = 11,
+    HPACK_INDEX_STATUS_404 = 13,
+    HPACK_INDEX_STATUS_500 = 14,
+    HPACK_INDEX_ALLOW = 22,
+    HPACK_INDEX_CONTENT_LENGTH = 28,
+    HPACK_INDEX_CONTENT_TYPE = 31,
+    HPACK_INDEX_DATE = 33,
+    HPACK_INDEX_ETAG = 34,
+    HPACK_INDEX_LAST_MODIFIED = 44,
+    HPACK_INDEX_SERVER = 54
+};
+
+/** HPACK error codes */
+typedef enum {
+    HPACK_OK = 0,
+    HPACK_ERROR_INVALID_PARAM = -1,
+    HPACK_ERROR_MEMORY = -2,
+    HPACK_ERROR_MALFORMED = -3,         /** Compression error, the table is out of sync */
+    HPACK_ERROR_TOO_LARGE = -4          /** More fields or bytes than the output holds */
+} hpack_error_t;
+
+/** Decoded header field */
+typedef struct {
+    const char *name;
+    size_t name_length;
+    const char *value;
+    size_t value_length;
+} hpack_field_t;
+
+/** Dynamic table entry */
+typedef struct {
+    uint32_t offset;                    /** Name position in the decoder's data */
+    uint32_t name_length;
+    uint32_t value_length;
+} hpack_entry_t;
+
+/** Decoder state of one connection */
+typedef struct {
+    char *data;                         /** Entry bytes, name then value, oldest first */
+    size_t data_start;                  /** Bytes before this belong to evicted entries */
+    size_t data_end;
+    size_t data_capacity;               /** Twice max_size, so compaction always makes room */
+    hpack_entry_t *entries;             /** Ring, oldest at first */
+    size_t entry_capacity;              /** Power of two */
+    size_t first;
+    size_t count;
+    size_t size;                        /** RFC 7541 size: lengths plus 32 per entry */
+    size_t max_size;                    /** Current limit, set by size updates */
+    size_t settings_size;               /** Limit size updates may not exceed */
+} hpack_decoder_t;
+
+/**
+ * @brief Create an empty dynamic table
+ * @param[out] decoder Decoder to initialize
+ * @param max_size Table size advertised to the peer
+ * @return HPACK_OK on success, error code otherwise
+ */
+hpack_error_t hpack_decoder_init(hpack_decoder_t *decoder, size_t max_size);
+
+/**
+ * @brief Free the dynamic table
+ * @param decoder Decoder
+ */
+void hpack_decoder_cleanup(hpack_decoder_t *decoder);
+
+/**
+ * @brief Decode one complete header block
+ * @param decoder Decoder of the connection the block arrived on
+ * @param block Header block fragments joined
+ * @param length Block length
+ * @param[out] fields Decoded fields in block order
+ * @param max_fields Entries in fields
+ * @param[out] count Fields decoded
+ * @param scratch Space for Huffman-coded strings and copies of dynamic entries
+ * @param scratch_size Bytes in scratch
+ * @return HPACK_OK on success, HPACK_ERROR_MALFORMED for invalid input,
+ *         HPACK_ERROR_TOO_LARGE if fields or scratch ran out
+ * @note Strings point into block, the static table or scratch. After an
+ *       error the dynamic table no longer matches the peer's, so the
+ *       connection has to end.
+ */
+hpack_error_t hpack_decode(hpack_decoder_t *decoder, const uint8_t *block, size_t length,
+                           hpack_field_t *fields, size_t max_fields, size_t *count,
+                           char *scratch, size_t scratch_size);
+
+/**
+ * @brief Size of an integer with an N-bit prefix
+ * @param value Value
+ * @param prefix_bits Prefix length, 1 to 8
+ * @return Bytes hpack_encode_integer() writes
+ */
+size_t hpack_integer_size(uint64_t value, unsigned prefix_bits);
+
+/**
+ * @brief Encode an integer with an N-bit prefix
+ * @param[out] out At least hpack_integer_size() bytes
+ * @param value Value, below 2^32
+ * @param prefix_bits Prefix length, 1 to 8
+ * @param flags Bits above the prefix in the first byte
+ * @return Bytes written
+ */
+size_t hpack_encode_integer(uint8_t *out, uint64_t value, unsigned prefix_bits, uint8_t flags);
+
+/**
+ * @brief Encode an indexed field
+ * @param[out] out At least hpack_integer_size(index, 7) bytes
+ * @param index Static table index
+ * @return Bytes written
+ */
+size_t hpack_encode_indexed(uint8_t *out, unsigned index);
+
+/**
+ * @brief Size of a literal without indexing whose name is indexed
+ * @param name_index Static table index of the name
+ * @param length Value length
+ * @return Bytes hpack_encode_literal() writes
+ */
+size_t hpack_literal_size(unsigned name_index, size_t length);
+
+/**
+ * @brief Encode a literal without indexing whose name is indexed
+ * @param[out] out At least hpack_literal_size() bytes
+ * @param name_index Static table index of the name
+ * @param value Value, not Huffman-coded
+ * @param length Value length
+ * @return Bytes written; the value is the last length of them
+ */
+size_t hpack_encode_literal(uint8_t *out, unsigned name_index, const char *value, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_HPACK_H */
@@ -0,0 +1,103 @@
+/**
+ * @file http_parser.h
+ * @brief Platform abstraction for HTTP/1.x request parsing
+ *
+ * This module parses request heads in place: it locates the end of the
+ * header block, splits the request line and validates method, target and
+ * header characters. The scanning kernels come in AVX2, SSE4.2 and NEON
+ * variants that examine 32 or 16 bytes per step, plus a table-driven
+ * scalar fallback. http_parser_init() picks the best variant the CPU
+ * supports; building with HTTP_PARSER_SIMD=0 leaves only the scalar one.
+ */
+
+#ifndef PLATFORM_HTTP_PARSER_H
+#define PLATFORM_HTTP_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Compile the vector kernels (set to 0 for a scalar-only build) */
+#ifndef HTTP_PARSER_SIMD
+#define HTTP_PARSER_SIMD 1
+#endif
+
+/** HTTP parser error codes */
+typedef enum {
+    HTTP_PARSER_OK = 0,
+    HTTP_PARSER_ERROR_INVALID_PARAM = -1,
+    HTTP_PARSER_ERROR_INCOMPLETE = -2,  /** More input needed */
+    HTTP_PARSER_ERROR_MALFORMED = -3,
+    HTTP_PARSER_ERROR_UNSUPPORTED = -4,     /** Kernel not available on this CPU */
+    HTTP_PARSER_ERROR_NOT_IMPLEMENTED = -5  /** Transfer-Encoding, which is not supported */
+} http_parser_error_t;
+
+/** Parsed request head (pointers refer into the parsed data) */
+typedef struct {
+    const char *method;
+    size_t method_length;
+    const char *target;
+    size_t target_length;
+    int minor_version;
+    bool close;                 /** Connection should close after the response */
+    bool upgrade_h2c;           /** Upgrade: h2c was requested */
+    const char *http2_settings; /** HTTP2-Settings value (base64url), NULL if absent */
+    size_t http2_settings_length;
+    const char *if_none_match;  /** If-None-Match value, NULL if absent */
+    size_t if_none_match_length;
+    const char *if_modified_since; /** If-Modified-Since value, NULL if absent */
+    size_t if_modified_since_length;
+    size_t header_length;       /** Request line and headers including the blank line */
+    size_t content_length;
+    size_t length;              /** header_length + content_length, 0 if headers are incomplete */
+} http_parser_request_t;
+
+/**
+ * @brief Select the fastest kernels supported by the CPU
+ * @note Call once before starting threads; until then the scalar kernels are used
+ */
+void http_parser_init(void);
+
+/**
+ * @brief Select kernels by name
+ * @param name "avx2", "sse4.2", "neon" or "scalar"
+ * @return HTTP_PARSER_OK, HTTP_PARSER_ERROR_UNSUPPORTED if the CPU or build lacks them
+ */
+http_parser_error_t http_parser_select(const char *name);
+
+/**
+ * @brief Get the name of the selected kernels
+ * @return Kernel name
+ */
+const char *http_parser_implementation(void);
+
+/**
+ * @brief Parse one request from the start of data
+ * @param data Input bytes
+ * @param size Number of input bytes
+ * @param[out] request Parsed request
+ * @return HTTP_PARSER_OK when the head and body are complete,
+ *         HTTP_PARSER_ERROR_INCOMPLETE when more bytes are needed (request->length
+ *         then holds the full size if the head is complete, 0 otherwise),
+ *         HTTP_PARSER_ERROR_MALFORMED for invalid input, including a repeated
+ *         Content-Length or one sent with Transfer-Encoding,
+ *         HTTP_PARSER_ERROR_NOT_IMPLEMENTED for a Transfer-Encoding alone
+ */
+http_parser_error_t http_parser_parse(const char *data, size_t size, http_parser_request_t *request);
+
+/**
+ * @brief Find the "\r\n\r\n" that ends a header block
+ * @param data Input bytes
+ * @param size Number of input bytes
+ * @return Offset of the terminator, size if it is not present
+ */
+size_t http_parser_find_header_end(const char *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_HTTP_PARSER_H */
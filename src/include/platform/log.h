@@ -4,6 +4,16 @@
  *
  * This module provides a portable logging interface with different
  * log levels, output formatting, and thread safety.
+ *
+ * In asynchronous mode (the default) each thread formats its lines into its
+ * own single-producer ring without locks or syscalls; a flusher thread drains
+ * all rings and writes them out in batches. Lines that do not fit in a full
+ * ring are counted and reported instead of blocking the caller.
+ *
+ * log_error/log_warn/log_info/log_debug are macros. Levels above
+ * LOG_COMPILE_LEVEL (set with -DLOG_COMPILE_LEVEL=WARN, for example) compile
+ * to nothing; the remaining ones test the runtime level before their
+ * arguments are evaluated.
  */
 
 #ifndef PLATFORM_LOG_H
@@ -20,6 +30,15 @@ extern "C" {
 /** Global flag to disable all logging */
 extern bool is_logging_disabled;
 
+/** Slots per thread ring (power of two) */
+#define LOG_RING_SLOTS 1024
+
+/** Maximum formatted line length stored in one ring slot */
+#define LOG_SLOT_SIZE 512
+
+/** Interval between flusher passes, in milliseconds */
+#define LOG_FLUSH_INTERVAL_MS 5
+
 /** Log levels */
 typedef enum {
     LOG_LEVEL_ERROR = 0,
@@ -28,6 +47,17 @@ typedef enum {
     LOG_LEVEL_DEBUG = 3
 } log_level_t;
 
+/** Most verbose level compiled in: ERROR, WARN, INFO or DEBUG */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL DEBUG
+#endif
+
+#define LOG_CONCAT_(a, b) a##b
+#define LOG_CONCAT(a, b) LOG_CONCAT_(a, b)
+
+/** LOG_COMPILE_LEVEL as a log_level_t constant */
+#define LOG_COMPILE_THRESHOLD LOG_CONCAT(LOG_LEVEL_, LOG_COMPILE_LEVEL)
+
 /** Log error codes */
 typedef enum {
     LOG_OK = 0,
@@ -44,6 +74,7 @@ typedef struct {
     bool colors;                 /** Use ANSI color codes */
     bool pid;                    /** Include process ID */
     bool tid;                    /** Include thread ID */
+    bool async;                  /** Queue lines for the flusher thread */
 } log_config_t;
 
 /**
@@ -100,33 +131,63 @@ void log_set_pid(bool enable);
  */
 void log_set_tid(bool enable);
 
+/** Runtime level mirrored for the inline check (use log_set_level) */
+extern log_level_t log_runtime_level;
+
 /**
- * @brief Log error message
- * @param format Format string (printf style)
- * @param ... Format arguments
+ * @brief Check whether a level is currently written
+ * @param level Log level
+ * @return True if a message at level would be output
  */
-void log_error(const char *format, ...);
+static inline bool log_enabled(log_level_t level)
+{
+    return __builtin_expect(!is_logging_disabled && level <= log_runtime_level, 0);
+}
 
 /**
- * @brief Log warning message
+ * @brief Write a message at a given level
+ * @param level Log level
  * @param format Format string (printf style)
  * @param ... Format arguments
+ * @note Prefer the log_<level> macros, which skip argument evaluation
  */
-void log_warn(const char *format, ...);
+void log_write(log_level_t level, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
 
 /**
- * @brief Log info message
- * @param format Format string (printf style)
- * @param ... Format arguments
+ * @brief Log at a level if compiled in and enabled at runtime
+ * @note Arguments are evaluated only when the message will be written
+ */
+#define LOG_AT(level, ...) \
+    do { \
+        if ((level) <= LOG_COMPILE_THRESHOLD && log_enabled(level)) { \
+            log_write((level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+/** Log error message (printf style) */
+#define log_error(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+/** Log warning message (printf style) */
+#define log_warn(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+
+/** Log info message (printf style) */
+#define log_info(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+
+/** Log debug message (printf style) */
+#define log_debug(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+/**
+ * @brief Write out every queued line now
+ * @note Safe to call from any thread; callers never block producers
  */
-void log_info(const char *format, ...);
+void log_flush(void);
 
 /**
- * @brief Log debug message
- * @param format Format string (printf style)
- * @param ... Format arguments
+ * @brief Get number of lines dropped because a ring was full
+ * @return Dropped line count since startup
  */
-void log_debug(const char *format, ...);
+uint64_t log_dropped_count(void);
 
 /**
  * @brief Get default log configuration
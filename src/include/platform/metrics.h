@@ -0,0 +1,249 @@
+/**
+ * @file metrics.h
+ * @brief Platform abstraction for per-worker runtime metrics
+ *
+ * This module keeps one cache-line-aligned counter block per worker in a
+ * shared anonymous mapping created before the workers are forked. Each
+ * worker is the only writer of its block, so updates are plain relaxed
+ * stores without locked instructions; the parent reads all blocks and
+ * serves them in Prometheus text format on an admin port. The same port
+ * exports the request trace rings as GET /trace when tracing is set up.
+ *
+ * Admin connections are non-blocking and multiplexed on an epoll set of
+ * their own, which the supervisor watches next to its other descriptors,
+ * so a slow or idle client costs a slot rather than the supervisor loop.
+ */
+
+#ifndef PLATFORM_METRICS_H
+#define PLATFORM_METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum number of distinct routes tracked per worker */
+#define METRICS_MAX_ROUTES 64
+
+/** Number of log2 latency buckets (bucket i holds durations < 2^i ns) */
+#define METRICS_LATENCY_BUCKETS 32
+
+/** Admin connections served at once; further ones are closed on accept */
+#define METRICS_MAX_CLIENTS 8
+
+/** Bytes of an admin request kept; only the request line is looked at */
+#define METRICS_REQUEST_SIZE 2048
+
+/** Time an admin connection gets from accept to its last response byte */
+#define METRICS_CLIENT_TIMEOUT_MS 5000
+
+/** Metrics error codes */
+typedef enum {
+    METRICS_OK = 0,
+    METRICS_ERROR_INVALID_PARAM = -1,
+    METRICS_ERROR_MEMORY = -2,
+    METRICS_ERROR_SOCKET = -3
+} metrics_error_t;
+
+/** Scalar per-worker counters */
+typedef enum {
+    METRICS_ACCEPTS,             /** Connections accepted */
+    METRICS_CLOSES,              /** Connections closed */
+    METRICS_BYTES_IN,            /** Bytes received */
+    METRICS_BYTES_OUT,           /** Bytes sent */
+    METRICS_PARSE_ERRORS,        /** Malformed requests */
+    METRICS_CPU_CHECKS,          /** Accepted connections whose receiving CPU was sampled */
+    METRICS_CPU_MISMATCHES,      /** Sampled connections received on another CPU */
+    METRICS_TIMEOUTS,            /** Connections closed by a header, send or keep-alive timeout */
+    METRICS_REJECTS,             /** Connections closed on accept at the connection cap */
+    METRICS_SQ_FULL,             /** Receives, sends and cancels retried because the SQ was full */
+    METRICS_COUNTER_COUNT
+} metrics_counter_t;
+
+/** Counter block owned by one worker (single writer) */
+typedef struct {
+    uint64_t counters[METRICS_COUNTER_COUNT];
+    uint64_t route_requests[METRICS_MAX_ROUTES];
+    uint64_t latency_buckets[METRICS_LATENCY_BUCKETS];
+    uint64_t latency_sum_ns;
+    int32_t cpu_id;
+    int32_t pid;
+} __attribute__((aligned(64))) metrics_worker_t;
+
+/** One admin connection */
+typedef struct {
+    int fd;                      /** -1 if the slot is free */
+    size_t request_used;
+    char *response;              /** Headers and body, NULL until the request is complete */
+    size_t response_size;
+    size_t response_sent;
+    int64_t deadline_ms;         /** Monotonic time the connection is closed at */
+    char request[METRICS_REQUEST_SIZE];
+} metrics_client_t;
+
+/** Metrics region and admin endpoint state */
+typedef struct {
+    metrics_worker_t *workers;   /** Shared mapping, one block per worker */
+    size_t mapping_size;
+    int worker_count;
+    const char *const *route_names; /** Label per route index */
+    int route_count;
+    const trace_t *trace;        /** Rings served at /trace, NULL for none */
+    int listen_fd;               /** Admin listener (parent only), -1 if closed */
+    int poll_fd;                 /** epoll set of the listener and clients, -1 if closed */
+    metrics_client_t clients[METRICS_MAX_CLIENTS];
+} metrics_t;
+
+/** This process's counter block, NULL when metrics are disabled */
+extern metrics_worker_t *metrics_local;
+
+/**
+ * @brief Create the shared metrics region
+ * @param[out] metrics Metrics instance to initialize
+ * @param worker_count Number of worker blocks
+ * @return METRICS_OK on success, error code otherwise
+ * @note Must be called before forking workers so the mapping is shared
+ */
+metrics_error_t metrics_init(metrics_t *metrics, int worker_count);
+
+/**
+ * @brief Unmap the region and close the admin listener
+ * @param metrics Metrics instance
+ */
+void metrics_cleanup(metrics_t *metrics);
+
+/**
+ * @brief Set labels used for per-route counters
+ * @param metrics Metrics instance
+ * @param names Route names indexed by route id (must outlive metrics)
+ * @param count Number of names
+ */
+void metrics_set_route_names(metrics_t *metrics, const char *const *names, int count);
+
+/**
+ * @brief Serve request trace rings at /trace
+ * @param metrics Metrics instance
+ * @param trace Trace region (must outlive metrics), NULL to stop serving
+ */
+void metrics_set_trace(metrics_t *metrics, const trace_t *trace);
+
+/**
+ * @brief Select the block this worker process writes to
+ * @param metrics Metrics instance
+ * @param worker_id Worker index
+ * @param cpu_id CPU the worker runs on
+ */
+void metrics_attach_worker(metrics_t *metrics, int worker_id, int cpu_id);
+
+/**
+ * @brief Open the admin listener serving GET /metrics and GET /trace
+ * @param metrics Metrics instance
+ * @param address IPv4 address to bind, network byte order
+ * @param port TCP port
+ * @return METRICS_OK on success, error code otherwise
+ */
+metrics_error_t metrics_server_open(metrics_t *metrics, uint32_t address, uint16_t port);
+
+/**
+ * @brief Close the admin listener and its connections so another process can bind the port
+ * @param metrics Metrics instance
+ */
+void metrics_server_close(metrics_t *metrics);
+
+/**
+ * @brief Descriptor that is readable while admin connections need service
+ * @param metrics Metrics instance
+ * @return epoll descriptor, -1 if the listener is closed
+ */
+int metrics_server_fd(const metrics_t *metrics);
+
+/**
+ * @brief Wait up to timeout_ms for admin connections and make progress on them
+ * @param metrics Metrics instance
+ * @param timeout_ms Poll timeout in milliseconds
+ * @note Never blocks beyond timeout_ms: requests are read and responses
+ *       sent as far as the sockets allow, the rest on a later call
+ */
+void metrics_server_poll(metrics_t *metrics, int timeout_ms);
+
+/**
+ * @brief Render all worker blocks in Prometheus text format
+ * @param metrics Metrics instance
+ * @param[out] buffer Output buffer
+ * @param size Size of buffer
+ * @return Bytes written (truncated at size)
+ */
+size_t metrics_render(const metrics_t *metrics, char *buffer, size_t size);
+
+/**
+ * @brief Add to a scalar counter of this worker
+ * @param counter Counter to update
+ * @param value Amount to add
+ */
+static inline void metrics_add(metrics_counter_t counter, uint64_t value)
+{
+    metrics_worker_t *w = metrics_local;
+    if (w) {
+        __atomic_store_n(&w->counters[counter], w->counters[counter] + value, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Count one request for a route
+ * @param route Route index
+ */
+static inline void metrics_count_request(unsigned route)
+{
+    metrics_worker_t *w = metrics_local;
+    if (w && route < METRICS_MAX_ROUTES) {
+        __atomic_store_n(&w->route_requests[route], w->route_requests[route] + 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Monotonic timestamp for latency measurement
+ * @return Nanoseconds, 0 when metrics are disabled
+ */
+static inline uint64_t metrics_now_ns(void)
+{
+    if (!metrics_local) {
+        return 0;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Record a request duration in the log2 histogram
+ * @param start_ns Timestamp from metrics_now_ns()
+ */
+static inline void metrics_observe_latency(uint64_t start_ns)
+{
+    metrics_worker_t *w = metrics_local;
+    if (!w) {
+        return;
+    }
+
+    uint64_t elapsed = metrics_now_ns() - start_ns;
+    unsigned bucket = elapsed ? 64 - (unsigned)__builtin_clzll(elapsed) : 0;
+    if (bucket >= METRICS_LATENCY_BUCKETS) {
+        bucket = METRICS_LATENCY_BUCKETS - 1;
+    }
+
+    __atomic_store_n(&w->latency_buckets[bucket], w->latency_buckets[bucket] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&w->latency_sum_ns, w->latency_sum_ns + elapsed, __ATOMIC_RELAXED);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_METRICS_H */
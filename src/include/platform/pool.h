@@ -0,0 +1,120 @@
+/**
+ * @file pool.h
+ * @brief Platform abstraction for size-classed memory pools
+ *
+ * This module backs system_malloc() and friends. Requests up to
+ * POOL_MAX_SIZE bytes are rounded up to one of POOL_CLASS_COUNT size classes
+ * (two per power of two) and carved from slabs owned by the calling thread,
+ * so connection state and I/O buffers freed by one connection are handed to
+ * the next without going back to malloc. Slabs whose blocks are all free are
+ * kept for reuse until the thread holds more than the high-water mark of
+ * them, then returned to the system. Larger requests go straight to malloc.
+ *
+ * Each thread (in practice each worker's event loop) has its own cache, so
+ * the fast path takes no locks. Blocks freed by another thread are queued to
+ * their owner and reclaimed on its next allocation.
+ */
+
+#ifndef PLATFORM_POOL_H
+#define PLATFORM_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Smallest size class in bytes */
+#define POOL_MIN_SIZE 64
+
+/** Largest pooled request in bytes; larger ones use malloc directly */
+#define POOL_MAX_SIZE (64 * 1024)
+
+/** Number of size classes: 64, 96, 128, 192, ... 49152, 65536 */
+#define POOL_CLASS_COUNT 21
+
+/** Target slab size for the smaller classes */
+#define POOL_SLAB_SIZE (64 * 1024)
+
+/** Minimum number of blocks carved from one slab */
+#define POOL_SLAB_MIN_BLOCKS 4
+
+/** Default per-thread limit on memory held in completely free slabs */
+#define POOL_DEFAULT_HIGH_WATER (16 * 1024 * 1024)
+
+/** Pool error codes */
+typedef enum {
+    POOL_OK = 0,
+    POOL_ERROR_INVALID_PARAM = -1
+} pool_error_t;
+
+/** Per-thread allocation statistics */
+typedef struct {
+    uint64_t allocations;       /** Pooled allocations served */
+    uint64_t frees;             /** Pooled blocks returned */
+    uint64_t slab_allocations;  /** Slabs obtained from malloc */
+    uint64_t slab_frees;        /** Slabs returned after crossing the high-water mark */
+    uint64_t large_allocations; /** Requests above POOL_MAX_SIZE */
+    size_t slab_bytes;          /** Memory currently held in slabs */
+    size_t free_slab_bytes;     /** Part of slab_bytes in completely free slabs */
+} pool_stats_t;
+
+/**
+ * @brief Set the per-thread high-water mark for free slab memory
+ * @param bytes Bytes of completely free slabs a thread keeps for reuse
+ * @return POOL_OK on success, error code otherwise
+ * @note Applies to every thread; call before forking workers
+ */
+pool_error_t pool_set_high_water(size_t bytes);
+
+/**
+ * @brief Get the per-thread high-water mark
+ * @return Bytes of free slabs a thread keeps
+ */
+size_t pool_get_high_water(void);
+
+/**
+ * @brief Allocate memory
+ * @param size Size in bytes
+ * @return Pointer aligned to 16 bytes, NULL on failure or when size is 0
+ */
+void *pool_alloc(size_t size);
+
+/**
+ * @brief Free memory from pool_alloc() or pool_realloc()
+ * @param ptr Pointer to free, NULL is ignored
+ */
+void pool_free(void *ptr);
+
+/**
+ * @brief Resize an allocation, in place when the size class does not change
+ * @param ptr Original pointer, NULL to allocate
+ * @param size New size, 0 to free
+ * @return Pointer to the resized memory, NULL on failure (ptr stays valid)
+ */
+void *pool_realloc(void *ptr, size_t size);
+
+/**
+ * @brief Get the usable size of an allocation
+ * @param ptr Pointer from pool_alloc()
+ * @return Bytes usable at ptr (the size class for pooled blocks)
+ */
+size_t pool_usable_size(const void *ptr);
+
+/**
+ * @brief Return every completely free slab of the calling thread
+ */
+void pool_trim(void);
+
+/**
+ * @brief Get allocation statistics of the calling thread
+ * @param[out] stats Statistics to fill
+ */
+void pool_get_stats(pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_POOL_H */
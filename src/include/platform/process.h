@@ -14,11 +14,27 @@
 #include <sys/types.h>
 
 #include "../../include/platform/system.h" /* for system_error_t */
+#include "../../include/platform/control_channel.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** Time all workers get to report that they are listening */
+#define PROCESS_READY_TIMEOUT_MS 10000
+
+/** First delay before restarting a worker that crashed again soon after starting */
+#define PROCESS_RESPAWN_BACKOFF_MS 100
+
+/** Longest delay between restarts of a crash-looping worker */
+#define PROCESS_RESPAWN_BACKOFF_MAX_MS 30000
+
+/** A worker that ran this long before exiting is restarted at once */
+#define PROCESS_RESPAWN_STABLE_MS 10000
+
+/** Exit polling interval when pidfds are unavailable (Linux < 5.3) */
+#define PROCESS_POLL_INTERVAL_MS 100
+
 /** Process management error codes */
 typedef enum {
     PROCESS_OK = 0,
@@ -26,7 +42,9 @@ typedef enum {
     PROCESS_ERROR_EVENTFD = -2,
     PROCESS_ERROR_WAIT = -3,
     PROCESS_ERROR_INVALID_PARAM = -4,
-    PROCESS_ERROR_SIGNAL = -5
+    PROCESS_ERROR_SIGNAL = -5,
+    PROCESS_ERROR_TIMEOUT = -6,
+    PROCESS_ERROR_CHANNEL = -7
 } process_error_t;
 
 /** Process type enumeration */
@@ -40,7 +58,12 @@ typedef struct {
     int worker_id;           /** Worker ID (0-based) */
     int cpu_id;              /** CPU this worker is pinned to */
     int eventfd;             /** EventFD for synchronization */
-    pid_t pid;               /** Process ID */
+    control_channel_t control; /** Messages from the parent, kept across restarts */
+    int pidfd;               /** Readable once the worker exits (parent only) */
+    pid_t pid;               /** Process ID, 0 once reaped */
+    int failures;            /** Consecutive exits soon after starting */
+    int64_t started_ms;      /** Monotonic time of the last fork */
+    int64_t respawn_at_ms;   /** When a reaped worker is forked again */
 } worker_context_t;
 
 /** Worker manager configuration */
@@ -48,6 +71,7 @@ typedef struct {
     int worker_count;        /** Number of worker processes to create */
     int *cpu_ids;            /** Array of CPU IDs to pin workers to */
     bool enable_affinity;    /** Whether to set CPU affinity */
+    bool bind_memory;        /** Allocate worker memory on the node of its CPU */
 } worker_config_t;
 
 /** Worker manager state */
@@ -56,6 +80,7 @@ typedef struct {
     worker_context_t *workers;  /** Array of worker contexts */
     process_type_t type;        /** Whether this is parent or worker */
     int current_worker_id;      /** For worker processes: which worker this is */
+    int epoll_fd;               /** Worker pidfds, readable when one exits */
 } worker_manager_t;
 
 /**
@@ -75,8 +100,11 @@ void worker_manager_cleanup(worker_manager_t *manager);
 /**
  * @brief Fork worker processes
  * @param manager Initialized worker manager
- * @return For parent: PROCESS_OK, for worker: PROCESS_OK with different context
- * @note This function only returns in the worker processes; parent waits for synchronization
+ * @return For parent: PROCESS_OK once every worker is ready, PROCESS_ERROR_TIMEOUT
+ *         if one exits or misses PROCESS_READY_TIMEOUT_MS; for worker: PROCESS_OK
+ *         with different context
+ * @note All workers are forked before the parent waits, then readiness is
+ *       collected from their eventfds together
  */
 process_error_t worker_manager_fork_workers(worker_manager_t *manager);
 
@@ -88,11 +116,98 @@ process_error_t worker_manager_fork_workers(worker_manager_t *manager);
 process_error_t worker_manager_signal_ready(worker_manager_t *manager);
 
 /**
- * @brief Wait for all workers to exit (called by parent)
+ * @brief Reap exited workers and fork replacements whose backoff has elapsed
+ * @param manager Worker manager (parent)
+ * @return PROCESS_OK on success, error code otherwise
+ * @note Does not block. A replacement keeps the worker's index and CPU; the
+ *       first restart is immediate, later ones back off exponentially while
+ *       the worker keeps exiting within PROCESS_RESPAWN_STABLE_MS.
+ * @note Returns in the new worker too: callers check worker_manager_get_type()
+ */
+process_error_t worker_manager_supervise(worker_manager_t *manager);
+
+/**
+ * @brief Get how long the supervisor may sleep
+ * @param manager Worker manager (parent)
+ * @return Milliseconds until a pending restart is due, -1 if only worker
+ *         exits (reported through the event fd) need attention
+ */
+int worker_manager_supervise_timeout(const worker_manager_t *manager);
+
+/**
+ * @brief Get a descriptor that becomes readable when a worker exits
+ * @param manager Worker manager (parent)
+ * @return epoll descriptor over the worker pidfds, -1 if unavailable
+ */
+int worker_manager_get_event_fd(const worker_manager_t *manager);
+
+/**
+ * @brief Get the control doorbell of the current worker
  * @param manager Worker manager
+ * @return Descriptor that becomes readable when the parent sent a message,
+ *         or -1 if not a worker
+ */
+int worker_manager_get_control_fd(const worker_manager_t *manager);
+
+/**
+ * @brief Get the control channel of the current worker
+ * @param manager Worker manager
+ * @return Channel to receive from, NULL if not a worker
+ */
+control_channel_t *worker_manager_get_control_channel(worker_manager_t *manager);
+
+/**
+ * @brief Send a message to every running worker (called by parent)
+ * @param manager Worker manager
+ * @param message Message, copied into each worker's channel
+ * @return PROCESS_OK on success, PROCESS_ERROR_CHANNEL if a worker's channel
+ *         was full or its doorbell failed; the others still got the message
+ * @note Workers restarted later do not see it; they start from the
+ *       parent's state instead
+ */
+process_error_t worker_manager_broadcast(worker_manager_t *manager, const control_message_t *message);
+
+/**
+ * @brief Ask every worker to stop accepting and drain (called by parent)
+ * @param manager Worker manager
+ * @return PROCESS_OK on success, error code otherwise
+ */
+process_error_t worker_manager_stop_workers(worker_manager_t *manager);
+
+/**
+ * @brief Reap exited workers without blocking (called by parent)
+ * @param manager Worker manager
+ * @return Number of workers still running
+ */
+int worker_manager_running_workers(worker_manager_t *manager);
+
+/**
+ * @brief Wait until a worker exits or the timeout passes (called by parent)
+ * @param manager Worker manager
+ * @param timeout_ms Longest wait, -1 for none
+ * @return Number of workers still running
+ * @note Sleeps on the pidfd epoll set of worker_manager_get_event_fd();
+ *       workers without a pidfd are polled every PROCESS_POLL_INTERVAL_MS
+ */
+int worker_manager_wait_exit(worker_manager_t *manager, int timeout_ms);
+
+/**
+ * @brief Send SIGKILL to every worker still running (called by parent)
+ * @param manager Worker manager
+ */
+void worker_manager_kill_workers(worker_manager_t *manager);
+
+/**
+ * @brief Start another program that inherits one descriptor
+ * @param argv Program and arguments; argv[0] is looked up in PATH
+ * @param fd Descriptor kept open across exec
+ * @param env_name Environment variable set to the descriptor number
+ * @param[out] pid Process ID of the new program
  * @return PROCESS_OK on success, error code otherwise
+ * @note Only async-signal-safe calls run between fork and exec, so this is
+ *       safe from a process with helper threads
  */
-process_error_t worker_manager_wait_workers(worker_manager_t *manager);
+process_error_t process_spawn_with_fd(char *const argv[], int fd, const char *env_name, pid_t *pid);
 
 /**
  * @brief Get current process type
@@ -4,6 +4,12 @@
  *
  * This module provides portable signal handling for graceful shutdown,
  * configuration reloading, and other signal-based operations.
+ *
+ * The asynchronous handler only records which signals arrived. A process
+ * with an event loop then opens a signalfd with signal_manager_open_fd(),
+ * which blocks the handled signals so they queue on the descriptor instead,
+ * and calls signal_manager_dispatch() when it becomes readable. Logging and
+ * any other work happen there, outside signal context.
  */
 
 #ifndef PLATFORM_SIGNALS_H
@@ -40,6 +46,9 @@ typedef struct {
     signal_callback_t sigusr2_handler;
     volatile sig_atomic_t shutdown_requested;
     volatile sig_atomic_t reload_requested;
+    volatile sig_atomic_t usr1_requested;
+    volatile sig_atomic_t usr2_requested;
+    int fd;                      /** signalfd, -1 until opened */
 } signal_manager_t;
 
 /** Signal error codes */
@@ -47,7 +56,8 @@ typedef enum {
     SIGNAL_OK = 0,
     SIGNAL_ERROR_INVALID_PARAM = -1,
     SIGNAL_ERROR_SETUP = -2,
-    SIGNAL_ERROR_MEMORY = -3
+    SIGNAL_ERROR_MEMORY = -3,
+    SIGNAL_ERROR_FD = -4
 } signal_error_t;
 
 /**
@@ -70,9 +80,36 @@ void signal_manager_cleanup(signal_manager_t *manager);
  * @param signum Signal number
  * @param callback Handler callback, NULL to remove
  * @return SIGNAL_OK on success, error code otherwise
+ * @note Until signal_manager_open_fd() the callback runs in signal context and
+ *       may only do async-signal-safe work
  */
 signal_error_t signal_manager_set_handler(signal_manager_t *manager, int signum, signal_callback_t callback);
 
+/**
+ * @brief Receive the handled signals on a signalfd instead of the handler
+ * @param manager Signal manager
+ * @return SIGNAL_OK on success, error code otherwise
+ * @note Blocks the signals in the calling thread; threads created afterwards
+ *       inherit the mask. A forked child calls this again for a descriptor
+ *       of its own.
+ */
+signal_error_t signal_manager_open_fd(signal_manager_t *manager);
+
+/**
+ * @brief Get the descriptor opened by signal_manager_open_fd()
+ * @param manager Signal manager
+ * @return signalfd, -1 if none
+ */
+int signal_manager_get_fd(const signal_manager_t *manager);
+
+/**
+ * @brief Record the signals queued on the signalfd
+ * @param manager Signal manager
+ * @return Number of signals read
+ * @note Call when the descriptor is readable; it never blocks
+ */
+int signal_manager_dispatch(signal_manager_t *manager);
+
 /**
  * @brief Check if shutdown was requested
  * @param manager Signal manager
@@ -87,6 +124,14 @@ bool signal_manager_shutdown_requested(const signal_manager_t *manager);
  */
 bool signal_manager_reload_requested(const signal_manager_t *manager);
 
+/**
+ * @brief Check for and clear a pending SIGUSR1 or SIGUSR2
+ * @param manager Signal manager
+ * @param signum SIGUSR1 or SIGUSR2
+ * @return true if the signal arrived since the last call
+ */
+bool signal_manager_take_user(signal_manager_t *manager, int signum);
+
 /**
  * @brief Reset shutdown request flag
  * @param manager Signal manager
@@ -23,22 +23,45 @@ typedef enum {
     SOCKET_OK = 0,
     SOCKET_ERROR_SETSOCKOPT = -1,
     SOCKET_ERROR_INVALID_PARAM = -2,
-    SOCKET_ERROR_BPF = -3
+    SOCKET_ERROR_BPF = -3,
+    SOCKET_ERROR_SYSTEM = -4           /** A socket call failed, see errno */
 } socket_error_t;
 
+/** Largest CPU-to-listener map socket_enable_reuseport_cbpf() builds */
+#define SOCKET_CBPF_MAX_CPUS 1024
+
+/** Most descriptors passed in one SCM_RIGHTS message (kernel SCM_MAX_FD) */
+#define SOCKET_MAX_PASSED_FDS 253
+
 /** Socket optimization flags */
 typedef enum {
     SOCKET_OPT_BUSY_POLL = 1 << 0,      /** Enable busy polling */
     SOCKET_OPT_NODELAY = 1 << 1,        /** Disable Nagle's algorithm */
     SOCKET_OPT_KEEPALIVE = 1 << 2,      /** Enable keepalive (disable) */
-    SOCKET_OPT_REUSEPORT_CBPF = 1 << 3  /** Enable CPU-aware load balancing */
+    SOCKET_OPT_REUSEPORT_CBPF = 1 << 3, /** Enable CPU-aware load balancing */
+    SOCKET_OPT_DEFER_ACCEPT = 1 << 4,   /** Accept only once request data arrived */
+    SOCKET_OPT_FASTOPEN = 1 << 5        /** Accept TCP Fast Open SYNs carrying data */
 } socket_option_t;
 
+/** Most options socket_accepted_options() produces */
+#define SOCKET_MAX_ACCEPTED_OPTIONS 4
+
+/** One setsockopt() call for accepted connections */
+typedef struct {
+    int level;
+    int name;
+    int value;
+} socket_option_value_t;
+
 /** Socket optimization configuration */
 typedef struct {
     uint32_t options;         /** Bitmask of socket_option_t flags */
     int busy_poll_value;      /** Busy poll timeout value (microseconds) */
     bool keepalive_enabled;   /** Whether keepalive is enabled */
+    int defer_accept_s;       /** TCP_DEFER_ACCEPT timeout (seconds) */
+    int fastopen_queue;       /** Pending Fast Open requests allowed */
+    const int *cpu_ids;       /** CPU of each listener in group order, NULL if listener i runs on CPU i */
+    int cpu_count;            /** Number of entries in cpu_ids */
 } socket_config_t;
 
 /**
@@ -58,10 +81,15 @@ socket_error_t socket_apply_optimizations(int socket_fd, const socket_config_t *
 /**
  * @brief Enable CPU-aware connection distribution using BPF
  * @param socket_fd The socket file descriptor
+ * @param cpu_ids CPU of each listener in reuseport group order, NULL when
+ *                listener i runs on CPU i
+ * @param cpu_count Number of entries in cpu_ids
  * @return SOCKET_OK on success, error code otherwise
  * @note This requires SO_REUSEPORT to be enabled on the socket
+ * @note Connections arriving on a CPU without a listener fall back to the
+ *       kernel's hash distribution
  */
-socket_error_t socket_enable_reuseport_cbpf(int socket_fd);
+socket_error_t socket_enable_reuseport_cbpf(int socket_fd, const int *cpu_ids, int cpu_count);
 
 /**
  * @brief Set busy poll timeout
@@ -87,6 +115,62 @@ socket_error_t socket_set_tcp_nodelay(int socket_fd, bool enabled);
  */
 socket_error_t socket_set_keepalive(int socket_fd, bool enabled);
 
+/**
+ * @brief Create a SO_REUSEPORT listener with every listener option applied
+ * @param ip IPv4 address in host byte order (0 for any)
+ * @param port TCP port
+ * @param backlog Accept queue length, at most net.core.somaxconn takes effect
+ * @param incoming_cpu CPU whose connections this listener prefers (SO_INCOMING_CPU), -1 for none
+ * @param config Options to apply, NULL for none
+ * @param[out] socket_fd Listening socket (close-on-exec), -1 on failure
+ * @return SOCKET_OK on success, SOCKET_ERROR_SYSTEM if the socket could not
+ *         be created, bound or put into listening state (*socket_fd is -1),
+ *         otherwise the first option that failed (*socket_fd is valid)
+ * @note Options are set before bind() and the CPU-aware BPF program is
+ *       attached before listen(), so no connection is queued without them
+ * @note Listeners join the port's reuseport group in creation order, which
+ *       is the index the CPU-aware BPF program selects them by
+ */
+socket_error_t socket_open_listener(uint32_t ip, uint16_t port, int backlog, int incoming_cpu,
+                                    const socket_config_t *config, int *socket_fd);
+
+/**
+ * @brief List the options accepted connections need explicitly
+ * @param config Socket configuration
+ * @param[out] options At least SOCKET_MAX_ACCEPTED_OPTIONS entries
+ * @return Number of entries filled
+ * @note Linux copies these from the listener today; setting them on each
+ *       connection keeps that from depending on the kernel
+ */
+int socket_accepted_options(const socket_config_t *config, socket_option_value_t *options);
+
+/**
+ * @brief Get the CPU that processed a socket's most recent packets
+ * @param socket_fd The socket file descriptor
+ * @return CPU number, -1 if unknown
+ */
+int socket_get_incoming_cpu(int socket_fd);
+
+/**
+ * @brief Pass descriptors to another process over a unix socket
+ * @param channel Connected AF_UNIX stream socket
+ * @param fds Descriptors to pass
+ * @param count Number of descriptors
+ * @return SOCKET_OK on success, error code otherwise
+ * @note Larger sets are split into several SCM_RIGHTS messages
+ */
+socket_error_t socket_send_fds(int channel, const int *fds, int count);
+
+/**
+ * @brief Receive descriptors sent with socket_send_fds()
+ * @param channel Connected AF_UNIX stream socket
+ * @param[out] fds Array receiving the descriptors (close-on-exec)
+ * @param capacity Size of fds; descriptors beyond it are closed
+ * @param[out] count Number of descriptors stored in fds
+ * @return SOCKET_OK on success, error code otherwise
+ */
+socket_error_t socket_recv_fds(int channel, int *fds, int capacity, int *count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -70,6 +70,8 @@ system_error_t system_get_cpu_affinity_string(char *buffer, size_t size);
  * @brief Allocate memory with error checking
  * @param size Size in bytes to allocate
  * @return Pointer to allocated memory, NULL on failure
+ * @note Served from the calling thread's size-classed pool (see pool.h);
+ *       release only with system_free()
  */
 void *system_malloc(size_t size);
 
@@ -0,0 +1,123 @@
+/**
+ * @file timer_wheel.h
+ * @brief Platform abstraction for per-reactor connection timers
+ *
+ * This module keeps timeouts in a hierarchical timing wheel: TIMER_WHEEL_LEVELS
+ * rings of TIMER_WHEEL_SLOTS lists, each level covering TIMER_WHEEL_SLOTS times
+ * the span of the one below. Timers are intrusive and doubly linked, so arming,
+ * rearming and cancelling are O(1) and allocation-free; advancing the clock
+ * touches one slot per elapsed tick and moves the timers of a higher level
+ * down once per round of the level below. The cost per connection does not
+ * depend on how many connections are open, unlike a heap or a sorted list.
+ *
+ * A wheel belongs to one thread. Expiry is rounded up to whole ticks, so a
+ * timer never fires early but may fire up to one tick late.
+ */
+
+#ifndef PLATFORM_TIMER_WHEEL_H
+#define PLATFORM_TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Levels of the wheel */
+#define TIMER_WHEEL_LEVELS 4
+
+/** log2 of the slots per level */
+#define TIMER_WHEEL_SLOT_BITS 6
+
+/** Slots per level */
+#define TIMER_WHEEL_SLOTS (1u << TIMER_WHEEL_SLOT_BITS)
+
+/** Longest timeout in ticks; longer ones are shortened to it */
+#define TIMER_WHEEL_MAX_TICKS ((UINT64_C(1) << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS)) - 1)
+
+/** Timer wheel error codes */
+typedef enum {
+    TIMER_WHEEL_OK = 0,
+    TIMER_WHEEL_ERROR_INVALID_PARAM = -1
+} timer_wheel_error_t;
+
+struct timer_wheel_timer;
+
+/** Called once when a timer expires; the timer is disarmed and may be rearmed */
+typedef void timer_wheel_callback_t(struct timer_wheel_timer *timer);
+
+/** Timer embedded in the object it times out */
+typedef struct timer_wheel_timer {
+    struct timer_wheel_timer *next;
+    struct timer_wheel_timer **link;    /** Pointer that points to this timer, NULL when disarmed */
+    uint64_t expires;                   /** Tick the timer fires at */
+    timer_wheel_callback_t *callback;
+} timer_wheel_timer_t;
+
+/** Wheel owned by one reactor */
+typedef struct {
+    timer_wheel_timer_t *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t tick;                      /** Next tick to process */
+    int64_t origin_ms;                  /** Time of tick 0 */
+    unsigned tick_ms;                   /** Tick length */
+    size_t count;                       /** Armed timers */
+} timer_wheel_t;
+
+/**
+ * @brief Initialize an empty wheel
+ * @param[out] wheel Wheel to initialize
+ * @param tick_ms Tick length in milliseconds
+ * @param now_ms Current time on the clock later passed to timer_wheel_advance()
+ * @return TIMER_WHEEL_OK on success, error code otherwise
+ */
+timer_wheel_error_t timer_wheel_init(timer_wheel_t *wheel, unsigned tick_ms, int64_t now_ms);
+
+/**
+ * @brief Initialize a disarmed timer
+ * @param[out] timer Timer to initialize
+ * @param callback Called when the timer expires
+ */
+void timer_wheel_timer_init(timer_wheel_timer_t *timer, timer_wheel_callback_t *callback);
+
+/**
+ * @brief Arm a timer, or move it if it is armed already
+ * @param wheel Wheel
+ * @param timer Timer
+ * @param timeout_ms Time from the last timer_wheel_advance() until the timer fires
+ * @note Rearming within the same tick leaves the timer in place
+ */
+void timer_wheel_arm(timer_wheel_t *wheel, timer_wheel_timer_t *timer, uint64_t timeout_ms);
+
+/**
+ * @brief Disarm a timer; disarmed timers are left alone
+ * @param wheel Wheel
+ * @param timer Timer
+ */
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_wheel_timer_t *timer);
+
+/**
+ * @brief Run the callbacks of every timer that expired by now
+ * @param wheel Wheel
+ * @param now_ms Current time
+ * @return Number of timers fired
+ * @note Callbacks may arm and cancel any timer of the wheel
+ */
+size_t timer_wheel_advance(timer_wheel_t *wheel, int64_t now_ms);
+
+/**
+ * @brief Check whether a timer is armed
+ * @param timer Timer
+ * @return true if the timer will fire
+ */
+static inline bool timer_wheel_armed(const timer_wheel_timer_t *timer)
+{
+    return timer->link != NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_TIMER_WHEEL_H */
@@ -0,0 +1,123 @@
+/**
+ * @file topology.h
+ * @brief Platform abstraction for CPU topology and memory placement
+ *
+ * This module reads the CPU layout from sysfs: which NUMA node every CPU
+ * belongs to, which CPUs are hyperthreads of the same core and which CPUs
+ * service a network interface's interrupts. topology_select_cpus() uses it
+ * to pick and order the CPUs workers are pinned to, and
+ * topology_bind_memory() keeps a worker's allocations on its local node.
+ * Missing sysfs entries are treated as a single node of independent cores.
+ */
+
+#ifndef PLATFORM_TOPOLOGY_H
+#define PLATFORM_TOPOLOGY_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Topology error codes */
+typedef enum {
+    TOPOLOGY_OK = 0,
+    TOPOLOGY_ERROR_INVALID_PARAM = -1,
+    TOPOLOGY_ERROR_MEMORY = -2,
+    TOPOLOGY_ERROR_AFFINITY = -3,
+    TOPOLOGY_ERROR_NOT_FOUND = -4,      /** No matching CPUs or interrupts */
+    TOPOLOGY_ERROR_SYSTEM = -5          /** A system call failed, see errno */
+} topology_error_t;
+
+/** One CPU the process may run on */
+typedef struct {
+    int cpu;                 /** CPU number */
+    int node;                /** NUMA node, 0 without NUMA support */
+    int core;                /** Lowest-numbered sibling, shared by hyperthreads of a core */
+    bool primary;            /** First allowed thread of its core */
+    bool irq;                /** Services an interrupt of the marked interface */
+} topology_cpu_t;
+
+/** CPUs in the process affinity mask, in ascending order */
+typedef struct {
+    topology_cpu_t *cpus;
+    int count;
+    int node_count;          /** Distinct nodes among cpus */
+    int core_count;          /** Distinct cores among cpus */
+    int irq_count;           /** CPUs with irq set */
+} topology_t;
+
+/** Worker placement options */
+typedef struct {
+    bool skip_smt_siblings;  /** Use one thread per physical core */
+    bool prefer_irq_cpus;    /** Keep only interrupt CPUs if any are candidates */
+} topology_options_t;
+
+/**
+ * @brief Discover the topology of the CPUs the process may run on
+ * @param[out] topology Topology to fill
+ * @return TOPOLOGY_OK on success, error code otherwise
+ * @note Release with topology_destroy()
+ */
+topology_error_t topology_discover(topology_t *topology);
+
+/**
+ * @brief Release a discovered topology
+ * @param topology Topology to release
+ */
+void topology_destroy(topology_t *topology);
+
+/**
+ * @brief Mark the CPUs that service a network interface's interrupts
+ * @param topology Discovered topology
+ * @param interface Interface name, e.g. "eth0"
+ * @return TOPOLOGY_OK, TOPOLOGY_ERROR_NOT_FOUND if none of its interrupts
+ *         are routed to an allowed CPU
+ * @note Reads the MSI vectors of the device, falling back to /proc/interrupts
+ *       entries named after the interface; their smp_affinity_list is used
+ */
+topology_error_t topology_mark_irq_cpus(topology_t *topology, const char *interface);
+
+/**
+ * @brief Filter and order candidate worker CPUs
+ * @param topology Discovered topology
+ * @param options Placement options
+ * @param[in,out] cpu_ids Candidate CPUs, replaced by the selection
+ * @param[in,out] count Number of candidates, replaced by the selection size
+ * @return TOPOLOGY_OK, TOPOLOGY_ERROR_NOT_FOUND if no candidate is allowed
+ * @note The selection is ordered by node, then CPU number, so that workers of
+ *       one node have adjacent indices
+ */
+topology_error_t topology_select_cpus(const topology_t *topology, const topology_options_t *options,
+                                      int *cpu_ids, int *count);
+
+/**
+ * @brief Parse a CPU list such as "0-3,8,10-11"
+ * @param list CPU list in the kernel's cpulist format
+ * @param[out] cpu_ids Ascending CPU numbers, release with system_free()
+ * @param[out] count Number of CPUs
+ * @return TOPOLOGY_OK, TOPOLOGY_ERROR_INVALID_PARAM for a malformed or empty list
+ */
+topology_error_t topology_parse_cpu_list(const char *list, int **cpu_ids, int *count);
+
+/**
+ * @brief Get the NUMA node of a CPU
+ * @param cpu CPU number
+ * @return Node number, 0 if unknown
+ */
+int topology_get_cpu_node(int cpu);
+
+/**
+ * @brief Restrict future allocations of the calling thread to one node
+ * @param node NUMA node
+ * @return TOPOLOGY_OK, TOPOLOGY_ERROR_SYSTEM if set_mempolicy() failed
+ * @note Pages touched before the call keep their placement; call it right
+ *       after pinning a freshly forked worker
+ */
+topology_error_t topology_bind_memory(int node);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_TOPOLOGY_H */
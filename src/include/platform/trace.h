@@ -0,0 +1,255 @@
+/**
+ * @file trace.h
+ * @brief Platform abstraction for sampled per-request phase tracing
+ *
+ * This module times one request in N through its phases: received, parsed,
+ * routed, response built and written. Timestamps are raw cycle counter
+ * reads (TSC on x86, the virtual counter on ARM), so a sampled request costs
+ * a few reads and unsampled ones a countdown decrement. The reactor stamps
+ * receive, parse and write; the HTTP layer stamps the route and the built
+ * response through the record of the request being dispatched.
+ *
+ * Completed records go into a ring per worker in a shared anonymous mapping
+ * created before the workers are forked, overwriting the oldest. Each
+ * worker is the only writer of its ring; the parent copies the rings and
+ * renders them in the Chrome trace event format, which Perfetto and
+ * chrome://tracing open, with one track per connection.
+ *
+ * Probes compile to nothing with TRACE_ENABLED=0 (make TRACE=0).
+ */
+
+#ifndef PLATFORM_TRACE_H
+#define PLATFORM_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Probes compiled in unless the build sets TRACE_ENABLED=0 */
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+/** Records kept per worker (power of two) */
+#define TRACE_RING_RECORDS 1024
+
+/** Trace error codes */
+typedef enum {
+    TRACE_OK = 0,
+    TRACE_ERROR_INVALID_PARAM = -1,
+    TRACE_ERROR_MEMORY = -2
+} trace_error_t;
+
+/** Request phases, in order */
+typedef enum {
+    TRACE_PHASE_RECEIVED,        /** The bytes completing the request arrived */
+    TRACE_PHASE_PARSED,          /** Request head parsed */
+    TRACE_PHASE_ROUTED,          /** Route resolved */
+    TRACE_PHASE_BUILT,           /** Response queued */
+    TRACE_PHASE_WRITTEN,         /** The send carrying the response completed */
+    TRACE_PHASE_COUNT
+} trace_phase_t;
+
+/** One sampled request */
+typedef struct {
+    uint64_t cycles[TRACE_PHASE_COUNT]; /** Counter per phase, 0 if not reached */
+    uint32_t route;
+    uint32_t bytes;              /** Response bytes queued */
+    uint32_t connection;         /** Descriptor of the connection */
+    uint32_t stream;             /** HTTP/2 stream, 0 for HTTP/1.x */
+} trace_record_t;
+
+/** Ring owned by one worker (single writer) */
+typedef struct {
+    uint64_t head __attribute__((aligned(64))); /** Records written */
+    int32_t cpu_id;
+    int32_t pid;
+    trace_record_t records[TRACE_RING_RECORDS] __attribute__((aligned(64)));
+} trace_ring_t;
+
+/** Trace region (parent side) */
+typedef struct {
+    trace_ring_t *rings;         /** Shared mapping, one ring per worker */
+    size_t mapping_size;
+    int worker_count;
+    const char *const *route_names; /** Label per route index */
+    int route_count;
+    uint64_t base_cycles;        /** Counter and clock read together in trace_init() */
+    uint64_t base_ns;
+} trace_t;
+
+/** Sampling state of this process */
+typedef struct {
+    trace_ring_t *ring;          /** Ring written to, NULL when not attached */
+    trace_record_t *current;     /** Request being dispatched, NULL if not sampled */
+    uint64_t received;           /** Counter at the last receive */
+    uint32_t interval;           /** Sample one request in interval, 0 for none */
+    uint32_t countdown;          /** Requests until the next sample */
+} trace_worker_t;
+
+/** This process's sampling state */
+extern trace_worker_t trace_local;
+
+/**
+ * @brief Create the shared trace region
+ * @param[out] trace Trace instance to initialize
+ * @param worker_count Number of worker rings
+ * @return TRACE_OK on success, error code otherwise
+ * @note Must be called before forking workers so the mapping is shared
+ */
+trace_error_t trace_init(trace_t *trace, int worker_count);
+
+/**
+ * @brief Unmap the region
+ * @param trace Trace instance
+ */
+void trace_cleanup(trace_t *trace);
+
+/**
+ * @brief Set labels used for the route of each record
+ * @param trace Trace instance
+ * @param names Route names indexed by route id (must outlive trace)
+ * @param count Number of names
+ */
+void trace_set_route_names(trace_t *trace, const char *const *names, int count);
+
+/**
+ * @brief Select and empty the ring this worker process writes to
+ * @param trace Trace instance
+ * @param worker_id Worker index
+ * @param cpu_id CPU the worker runs on
+ */
+void trace_attach_worker(trace_t *trace, int worker_id, int cpu_id);
+
+/**
+ * @brief Set the sampling interval of this worker
+ * @param interval Trace one request in interval, 0 to stop
+ */
+void trace_set_interval(unsigned interval);
+
+/**
+ * @brief Store a completed record in this worker's ring, stamping the write
+ * @param record Record filled since trace_sample()
+ */
+void trace_commit(const trace_record_t *record);
+
+/**
+ * @brief Render all rings as a Chrome trace (JSON object format)
+ * @param trace Trace instance
+ * @param headroom Bytes left free ahead of the JSON, e.g. for response headers
+ * @param[out] data Buffer from system_malloc(), freed by the caller
+ * @param[out] size Bytes used in data, headroom included
+ * @return TRACE_OK on success, TRACE_ERROR_MEMORY if the buffer could not grow
+ * @note Records a worker overwrote while they were copied are left out
+ */
+trace_error_t trace_render(const trace_t *trace, size_t headroom, char **data, size_t *size);
+
+/**
+ * @brief Read the cycle counter
+ * @return Counter value (nanoseconds on targets without one)
+ */
+static inline uint64_t trace_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t value;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Whether this worker samples requests
+ */
+static inline bool trace_active(void)
+{
+    return TRACE_ENABLED && trace_local.interval > 0;
+}
+
+/**
+ * @brief Note the arrival of request bytes
+ */
+static inline void trace_receive(void)
+{
+    if (trace_active()) {
+        trace_local.received = trace_cycles();
+    }
+}
+
+/**
+ * @brief Decide whether to trace a parsed request and start its record
+ * @param[out] record Record to fill, kept by the caller until trace_commit()
+ * @return true if the request is sampled; its record then becomes current
+ */
+static inline bool trace_sample(trace_record_t *record)
+{
+    if (!trace_active() || --trace_local.countdown > 0) {
+        return false;
+    }
+
+    trace_local.countdown = trace_local.interval;
+    memset(record, 0, sizeof(*record));
+    record->cycles[TRACE_PHASE_RECEIVED] = trace_local.received;
+    record->cycles[TRACE_PHASE_PARSED] = trace_cycles();
+    trace_local.current = record;
+    return true;
+}
+
+/**
+ * @brief Stamp the route of the current record
+ * @param route Route index
+ */
+static inline void trace_route(unsigned route)
+{
+    trace_record_t *record = trace_local.current;
+    if (TRACE_ENABLED && record) {
+        record->route = route;
+        record->cycles[TRACE_PHASE_ROUTED] = trace_cycles();
+    }
+}
+
+/**
+ * @brief Stamp a phase of the current record
+ * @param phase Phase reached
+ */
+static inline void trace_mark(trace_phase_t phase)
+{
+    trace_record_t *record = trace_local.current;
+    if (TRACE_ENABLED && record) {
+        record->cycles[phase] = trace_cycles();
+    }
+}
+
+/**
+ * @brief End the dispatch of the current record
+ * @param bytes Response bytes the dispatch queued
+ */
+static inline void trace_dispatched(size_t bytes)
+{
+    trace_record_t *record = trace_local.current;
+    if (TRACE_ENABLED && record) {
+        record->bytes = bytes > UINT32_MAX ? UINT32_MAX : (uint32_t)bytes;
+        trace_local.current = NULL;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_TRACE_H */
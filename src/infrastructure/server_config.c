@@ -0,0 +1,669 @@
+/**
+ * @file server_config.c
+ * @brief Implementation of command-line and config file settings
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+
+#include "../../include/infrastructure/server_config.h"
+#include "../../include/platform/system.h"
+#include "../../include/platform/topology.h"
+
+/** Longest line a config file may contain */
+#define SERVER_CONFIG_MAX_LINE 4096
+
+/** Settings known to server_config_set() */
+typedef enum {
+    SETTING_PORT,
+    SETTING_BACKLOG,
+    SETTING_WORKERS,
+    SETTING_CPUS,
+    SETTING_AFFINITY,
+    SETTING_SKIP_SMT,
+    SETTING_NUMA_BIND,
+    SETTING_IRQ_INTERFACE,
+    SETTING_BUSY_POLL,
+    SETTING_IDLE,
+    SETTING_SPIN,
+    SETTING_SPIN_RATE,
+    SETTING_BUSY_POLL_RATE,
+    SETTING_TCP_NODELAY,
+    SETTING_KEEPALIVE,
+    SETTING_REUSEPORT_CBPF,
+    SETTING_DEFER_ACCEPT,
+    SETTING_FASTOPEN,
+    SETTING_DATE_HEADERS,
+    SETTING_HTTP2,
+    SETTING_PLAINTEXT_RESPONSE,
+    SETTING_JSON_MESSAGE,
+    SETTING_LOG_LEVEL,
+    SETTING_METRICS_PORT,
+    SETTING_METRICS_ADDRESS,
+    SETTING_TRACE_SAMPLE,
+    SETTING_DOCUMENT_ROOT,
+    SETTING_POOL_HIGH_WATER,
+    SETTING_RESPONSE_CACHE_TTL,
+    SETTING_RESPONSE_CACHE_SIZE,
+    SETTING_DRAIN_TIMEOUT,
+    SETTING_HEADER_TIMEOUT,
+    SETTING_IDLE_TIMEOUT,
+    SETTING_KEEPALIVE_TIMEOUT,
+    SETTING_MAX_REQUESTS,
+    SETTING_MAX_CONNECTIONS
+} server_config_setting_id_t;
+
+/** Setting description */
+typedef struct {
+    const char *name;
+    server_config_setting_id_t id;
+    const char *argument;       /** Value placeholder, NULL for booleans */
+    const char *help;
+} server_config_setting_t;
+
+static const server_config_setting_t server_config_settings[] = {
+    {"port", SETTING_PORT, "N", "Listen on TCP port N (default 2342)"},
+    {"backlog", SETTING_BACKLOG, "N", "Accept queue length of each listener"},
+    {"workers", SETTING_WORKERS, "N", "Worker processes, 0 for one per CPU (default)"},
+    {"cpus", SETTING_CPUS, "LIST", "CPUs to run workers on, e.g. 0-3,8 (default: affinity mask)"},
+    {"affinity", SETTING_AFFINITY, NULL, "Pin each worker to its CPU (default on)"},
+    {"skip-smt", SETTING_SKIP_SMT, NULL, "Run one worker per physical core, leaving hyperthreads idle"},
+    {"numa-bind", SETTING_NUMA_BIND, NULL, "Allocate each worker's memory on its CPU's NUMA node"},
+    {"irq-interface", SETTING_IRQ_INTERFACE, "IF", "Run workers only on CPUs that take IF's interrupts"},
+    {"busy-poll", SETTING_BUSY_POLL, "US", "Busy-poll time in microseconds, 0 to disable"},
+    {"idle", SETTING_IDLE, "MODE", "Worker wait: block, spin, busy-poll or adaptive"},
+    {"spin", SETTING_SPIN, "US", "Time to spin before sleeping in spin mode"},
+    {"spin-rate", SETTING_SPIN_RATE, "N", "Events per second per worker from which adaptive spins"},
+    {"busy-poll-rate", SETTING_BUSY_POLL_RATE, "N", "Events per second per worker from which adaptive busy-polls"},
+    {"tcp-nodelay", SETTING_TCP_NODELAY, NULL, "Disable Nagle's algorithm on connections"},
+    {"keepalive", SETTING_KEEPALIVE, NULL, "Enable TCP keepalive on connections"},
+    {"reuseport-cbpf", SETTING_REUSEPORT_CBPF, NULL, "Accept connections on the CPU that received them"},
+    {"defer-accept", SETTING_DEFER_ACCEPT, "S", "Wait up to S seconds for request data before accepting, 0 to disable"},
+    {"fastopen", SETTING_FASTOPEN, "N", "Allow N pending TCP Fast Open connections, 0 to disable"},
+    {"date-headers", SETTING_DATE_HEADERS, NULL, "Send Date headers (default on)"},
+    {"http2", SETTING_HTTP2, NULL, "Accept cleartext HTTP/2 connections (default on)"},
+    {"plaintext-response", SETTING_PLAINTEXT_RESPONSE, "TEXT", "Body of /plaintext"},
+    {"json-message", SETTING_JSON_MESSAGE, "TEXT", "Message field of the /json body"},
+    {"log-level", SETTING_LOG_LEVEL, "LEVEL", "Log error, warn, info (default) or debug messages"},
+    {"metrics-port", SETTING_METRICS_PORT, "N", "Serve per-worker metrics on port N at /metrics, 0 to disable"},
+    {"metrics-address", SETTING_METRICS_ADDRESS, "ADDR", "IPv4 address the metrics port listens on (default 127.0.0.1)"},
+    {"trace-sample", SETTING_TRACE_SAMPLE, "N", "Trace 1 in N requests for /trace on the metrics port, 0 to disable"},
+    {"document-root", SETTING_DOCUMENT_ROOT, "DIR", "Serve files from DIR for unmatched GET requests"},
+    {"pool-high-water", SETTING_POOL_HIGH_WATER, "MB", "Free buffer memory each worker keeps for reuse"},
+    {"response-cache-ttl", SETTING_RESPONSE_CACHE_TTL, "MS", "Serve cacheable dynamic responses from a cache for MS ms, 0 to disable"},
+    {"response-cache-size", SETTING_RESPONSE_CACHE_SIZE, "KB", "Response cache size per worker"},
+    {"drain-timeout", SETTING_DRAIN_TIMEOUT, "S", "Seconds old workers get to finish connections on reload"},
+    {"header-timeout", SETTING_HEADER_TIMEOUT, "S", "Seconds a client gets to send a request head, 0 for no limit"},
+    {"idle-timeout", SETTING_IDLE_TIMEOUT, "S", "Seconds a response may stall before closing, 0 for no limit"},
+    {"keepalive-timeout", SETTING_KEEPALIVE_TIMEOUT, "S", "Seconds an idle connection stays open, 0 for no limit"},
+    {"max-requests", SETTING_MAX_REQUESTS, "N", "Close connections after N requests, 0 for no limit"},
+    {"max-connections", SETTING_MAX_CONNECTIONS, "N", "Open connections per worker, 0 for no limit"}
+};
+
+#define SERVER_CONFIG_SETTING_COUNT (sizeof(server_config_settings) / sizeof(server_config_settings[0]))
+
+static const server_config_setting_t *server_config_find(const char *name, size_t length)
+{
+    for (size_t i = 0; i < SERVER_CONFIG_SETTING_COUNT; i++) {
+        const char *candidate = server_config_settings[i].name;
+        if (strlen(candidate) == length && strncmp(candidate, name, length) == 0) {
+            return &server_config_settings[i];
+        }
+    }
+    return NULL;
+}
+
+static bool server_config_parse_long(const char *value, long min, long max, long *out)
+{
+    char *end;
+    errno = 0;
+    long number = strtol(value, &end, 10);
+    if (errno != 0 || end == value || *end != '\0' || number < min || number > max) {
+        return false;
+    }
+    *out = number;
+    return true;
+}
+
+static bool server_config_parse_bool(const char *value, bool *out)
+{
+    static const char *const truthy[] = {"true", "yes", "on", "1"};
+    static const char *const falsy[] = {"false", "no", "off", "0"};
+
+    for (size_t i = 0; i < sizeof(truthy) / sizeof(truthy[0]); i++) {
+        if (strcasecmp(value, truthy[i]) == 0) {
+            *out = true;
+            return true;
+        }
+        if (strcasecmp(value, falsy[i]) == 0) {
+            *out = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void server_config_set_socket_option(server_config_t *config, socket_option_t option, bool enabled)
+{
+    if (enabled) {
+        config->socket_config.options |= option;
+    } else {
+        config->socket_config.options &= ~(uint32_t)option;
+    }
+}
+
+/**
+ * @brief Free a string setting and put another in its place
+ */
+static void server_config_replace_string(const char **field, char *text)
+{
+    system_free((char *)*field);
+    *field = text;
+}
+
+/**
+ * @brief Replace a string setting with a copy of value
+ * @return false without memory; the old value stays then
+ */
+static bool server_config_copy_string(const char **field, const char *value)
+{
+    char *text = system_strdup(value);
+    if (!text) {
+        return false;
+    }
+    server_config_replace_string(field, text);
+    return true;
+}
+
+static server_config_error_t server_config_apply(server_config_t *config,
+                                                 const server_config_setting_t *setting,
+                                                 const char *value)
+{
+    long number = 0;
+    bool flag = true;
+
+    if (!setting->argument) {
+        if (value && !server_config_parse_bool(value, &flag)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+    } else if (!value) {
+        return SERVER_CONFIG_ERROR_MISSING_VALUE;
+    }
+
+    switch (setting->id) {
+    case SETTING_PORT:
+        if (!server_config_parse_long(value, 1, 65535, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->port = (uint16_t)number;
+        break;
+
+    case SETTING_BACKLOG:
+        if (!server_config_parse_long(value, 1, INT_MAX, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->backlog = (int)number;
+        break;
+
+    case SETTING_WORKERS:
+        if (!server_config_parse_long(value, 0, SERVER_CONFIG_MAX_WORKERS, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->workers = (int)number;
+        break;
+
+    case SETTING_CPUS: {
+        int *cpu_ids;
+        int count;
+        topology_error_t err = topology_parse_cpu_list(value, &cpu_ids, &count);
+        if (err == TOPOLOGY_ERROR_MEMORY) {
+            return SERVER_CONFIG_ERROR_MEMORY;
+        }
+        if (err != TOPOLOGY_OK) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        system_free(config->worker_config.cpu_ids);
+        config->worker_config.cpu_ids = cpu_ids;
+        config->worker_config.worker_count = count;
+        break;
+    }
+
+    case SETTING_AFFINITY:
+        config->worker_config.enable_affinity = flag;
+        break;
+
+    case SETTING_SKIP_SMT:
+        config->skip_smt_siblings = flag;
+        break;
+
+    case SETTING_NUMA_BIND:
+        config->worker_config.bind_memory = flag;
+        break;
+
+    case SETTING_IRQ_INTERFACE:
+        if (strcmp(value, "") == 0 || strcmp(value, "none") == 0) {
+            server_config_replace_string(&config->irq_interface, NULL);
+            break;
+        }
+        if (strlen(value) >= IFNAMSIZ || strchr(value, '/')) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        if (!server_config_copy_string(&config->irq_interface, value)) {
+            return SERVER_CONFIG_ERROR_MEMORY;
+        }
+        break;
+
+    case SETTING_BUSY_POLL:
+        if (!server_config_parse_long(value, 0, 1000000, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->socket_config.busy_poll_value = (int)number;
+        server_config_set_socket_option(config, SOCKET_OPT_BUSY_POLL, number > 0);
+        break;
+
+    case SETTING_IDLE: {
+        static const char *const modes[] = {
+            [SERVER_IDLE_BLOCK] = "block",
+            [SERVER_IDLE_SPIN] = "spin",
+            [SERVER_IDLE_BUSY_POLL] = "busy-poll",
+            [SERVER_IDLE_ADAPTIVE] = "adaptive"
+        };
+        size_t mode = 0;
+        while (mode < sizeof(modes) / sizeof(modes[0]) && strcmp(value, modes[mode]) != 0) {
+            mode++;
+        }
+        if (mode == sizeof(modes) / sizeof(modes[0])) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->idle_config.mode = (server_idle_mode_t)mode;
+        break;
+    }
+
+    case SETTING_SPIN:
+        if (!server_config_parse_long(value, 0, 1000000, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->idle_config.spin_us = (unsigned)number;
+        break;
+
+    case SETTING_SPIN_RATE:
+    case SETTING_BUSY_POLL_RATE:
+        if (!server_config_parse_long(value, 0, INT_MAX, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        if (setting->id == SETTING_SPIN_RATE) {
+            config->idle_config.spin_rate = (unsigned)number;
+        } else {
+            config->idle_config.busy_poll_rate = (unsigned)number;
+        }
+        break;
+
+    case SETTING_TCP_NODELAY:
+        server_config_set_socket_option(config, SOCKET_OPT_NODELAY, flag);
+        break;
+
+    case SETTING_KEEPALIVE:
+        /* Applied either way so that "off" overrides a system-wide default */
+        server_config_set_socket_option(config, SOCKET_OPT_KEEPALIVE, true);
+        config->socket_config.keepalive_enabled = flag;
+        break;
+
+    case SETTING_REUSEPORT_CBPF:
+        server_config_set_socket_option(config, SOCKET_OPT_REUSEPORT_CBPF, flag);
+        break;
+
+    case SETTING_DEFER_ACCEPT:
+        if (!server_config_parse_long(value, 0, 3600, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->socket_config.defer_accept_s = (int)number;
+        server_config_set_socket_option(config, SOCKET_OPT_DEFER_ACCEPT, number > 0);
+        break;
+
+    case SETTING_FASTOPEN:
+        if (!server_config_parse_long(value, 0, 65535, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->socket_config.fastopen_queue = (int)number;
+        server_config_set_socket_option(config, SOCKET_OPT_FASTOPEN, number > 0);
+        break;
+
+    case SETTING_DATE_HEADERS:
+        config->enable_date_headers = flag;
+        break;
+
+    case SETTING_HTTP2:
+        config->enable_http2 = flag;
+        break;
+
+    case SETTING_PLAINTEXT_RESPONSE:
+    case SETTING_JSON_MESSAGE: {
+        /* Prebuilt responses hold headers and body in one fixed buffer */
+        if (strlen(value) > 4096) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        if (!server_config_copy_string(setting->id == SETTING_PLAINTEXT_RESPONSE ? &config->plaintext_response
+                                                                                 : &config->json_message,
+                                       value)) {
+            return SERVER_CONFIG_ERROR_MEMORY;
+        }
+        break;
+    }
+
+    case SETTING_LOG_LEVEL: {
+        static const char *const levels[] = {
+            [LOG_LEVEL_ERROR] = "error",
+            [LOG_LEVEL_WARN] = "warn",
+            [LOG_LEVEL_INFO] = "info",
+            [LOG_LEVEL_DEBUG] = "debug"
+        };
+        size_t level = 0;
+        while (level < sizeof(levels) / sizeof(levels[0]) && strcasecmp(value, levels[level]) != 0) {
+            level++;
+        }
+        if (level == sizeof(levels) / sizeof(levels[0])) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->log_config.level = (log_level_t)level;
+        break;
+    }
+
+    case SETTING_METRICS_PORT:
+        if (!server_config_parse_long(value, 0, 65535, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->enable_metrics = number > 0;
+        if (number > 0) {
+            config->metrics_port = (uint16_t)number;
+        }
+        break;
+
+    case SETTING_METRICS_ADDRESS: {
+        struct in_addr address;
+        if (inet_pton(AF_INET, value, &address) != 1) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->metrics_address = address.s_addr;
+        break;
+    }
+
+    case SETTING_TRACE_SAMPLE:
+        if (!server_config_parse_long(value, 0, 1000000000, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->trace_sample = (unsigned)number;
+        break;
+
+    case SETTING_DOCUMENT_ROOT:
+        if (strcmp(value, "") == 0) {
+            server_config_replace_string(&config->document_root, NULL);
+        } else if (!server_config_copy_string(&config->document_root, value)) {
+            return SERVER_CONFIG_ERROR_MEMORY;
+        }
+        break;
+
+    case SETTING_POOL_HIGH_WATER:
+        if (!server_config_parse_long(value, 0, 1024 * 1024, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->pool_high_water = (size_t)number * 1024 * 1024;
+        break;
+
+    case SETTING_RESPONSE_CACHE_TTL:
+        if (!server_config_parse_long(value, 0, 3600 * 1000, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->response_cache_ttl_ms = (unsigned)number;
+        break;
+
+    case SETTING_RESPONSE_CACHE_SIZE:
+        if (!server_config_parse_long(value, 1, 1024 * 1024, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->response_cache_size = (size_t)number * 1024;
+        break;
+
+    case SETTING_DRAIN_TIMEOUT:
+        if (!server_config_parse_long(value, 0, 3600, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->drain_timeout_ms = (unsigned)number * 1000;
+        break;
+
+    case SETTING_HEADER_TIMEOUT:
+        if (!server_config_parse_long(value, 0, 86400, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->limits_config.header_timeout_ms = (unsigned)number * 1000;
+        break;
+
+    case SETTING_IDLE_TIMEOUT:
+        if (!server_config_parse_long(value, 0, 86400, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->limits_config.idle_timeout_ms = (unsigned)number * 1000;
+        break;
+
+    case SETTING_KEEPALIVE_TIMEOUT:
+        if (!server_config_parse_long(value, 0, 86400, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->limits_config.keepalive_timeout_ms = (unsigned)number * 1000;
+        break;
+
+    case SETTING_MAX_REQUESTS:
+        if (!server_config_parse_long(value, 0, INT_MAX, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->limits_config.max_requests = (unsigned)number;
+        break;
+
+    case SETTING_MAX_CONNECTIONS:
+        if (!server_config_parse_long(value, 0, INT_MAX, &number)) {
+            return SERVER_CONFIG_ERROR_INVALID_VALUE;
+        }
+        config->limits_config.max_connections = (unsigned)number;
+        break;
+    }
+
+    return SERVER_CONFIG_OK;
+}
+
+server_config_error_t server_config_set(server_config_t *config, const char *key, const char *value)
+{
+    if (!config || !key) {
+        return SERVER_CONFIG_ERROR_INVALID_PARAM;
+    }
+
+    const server_config_setting_t *setting = server_config_find(key, strlen(key));
+    if (!setting) {
+        return SERVER_CONFIG_ERROR_UNKNOWN_KEY;
+    }
+
+    return server_config_apply(config, setting, value);
+}
+
+void server_config_cleanup(server_config_t *config)
+{
+    if (!config) {
+        return;
+    }
+
+    server_config_replace_string(&config->plaintext_response, NULL);
+    server_config_replace_string(&config->json_message, NULL);
+    server_config_replace_string(&config->document_root, NULL);
+    server_config_replace_string(&config->irq_interface, NULL);
+    system_free(config->worker_config.cpu_ids);
+    config->worker_config.cpu_ids = NULL;
+    config->worker_config.worker_count = 0;
+}
+
+static char *server_config_trim(char *text)
+{
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) {
+        end--;
+    }
+    *end = '\0';
+    return text;
+}
+
+server_config_error_t server_config_load_file(server_config_t *config, const char *path, int *line)
+{
+    if (line) {
+        *line = 0;
+    }
+    if (!config || !path) {
+        return SERVER_CONFIG_ERROR_INVALID_PARAM;
+    }
+
+    FILE *file = fopen(path, "re");
+    if (!file) {
+        return SERVER_CONFIG_ERROR_IO;
+    }
+
+    server_config_error_t result = SERVER_CONFIG_OK;
+    char buffer[SERVER_CONFIG_MAX_LINE];
+    int number = 0;
+
+    while (fgets(buffer, sizeof(buffer), file)) {
+        number++;
+
+        size_t length = strlen(buffer);
+        if (length == sizeof(buffer) - 1 && buffer[length - 1] != '\n' && !feof(file)) {
+            result = SERVER_CONFIG_ERROR_INVALID_VALUE;
+            break;
+        }
+
+        char *comment = strchr(buffer, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char *key = server_config_trim(buffer);
+        if (*key == '\0') {
+            continue;
+        }
+
+        char *equals = strchr(key, '=');
+        if (!equals) {
+            result = SERVER_CONFIG_ERROR_MISSING_VALUE;
+            break;
+        }
+        *equals = '\0';
+        key = server_config_trim(key);
+        char *value = server_config_trim(equals + 1);
+
+        /* Quotes keep leading or trailing blanks */
+        length = strlen(value);
+        if (length >= 2 && value[0] == '"' && value[length - 1] == '"') {
+            value[length - 1] = '\0';
+            value++;
+        }
+
+        result = server_config_set(config, key, value);
+        if (result != SERVER_CONFIG_OK) {
+            break;
+        }
+    }
+
+    if (result == SERVER_CONFIG_OK && ferror(file)) {
+        result = SERVER_CONFIG_ERROR_IO;
+        number = 0;
+    }
+    fclose(file);
+
+    if (line && result != SERVER_CONFIG_OK) {
+        *line = number;
+    }
+    return result;
+}
+
+server_config_error_t server_config_parse_option(server_config_t *config, int argc, char *argv[],
+                                                 int *index)
+{
+    if (!config || !argv || !index || *index < 0 || *index >= argc) {
+        return SERVER_CONFIG_ERROR_INVALID_PARAM;
+    }
+
+    const char *option = argv[*index];
+    if (strncmp(option, "--", 2) != 0) {
+        return SERVER_CONFIG_ERROR_UNKNOWN_KEY;
+    }
+    const char *name = option + 2;
+
+    /* "--name=value" carries its value inline */
+    const char *value = NULL;
+    size_t length = strlen(name);
+    const char *equals = strchr(name, '=');
+    if (equals) {
+        length = (size_t)(equals - name);
+        value = equals + 1;
+    }
+
+    const server_config_setting_t *setting = server_config_find(name, length);
+    if (!setting && !equals && strncmp(name, "no-", 3) == 0) {
+        setting = server_config_find(name + 3, length - 3);
+        if (setting && !setting->argument) {
+            return server_config_apply(config, setting, "false");
+        }
+        return SERVER_CONFIG_ERROR_UNKNOWN_KEY;
+    }
+    if (!setting) {
+        return SERVER_CONFIG_ERROR_UNKNOWN_KEY;
+    }
+
+    if (setting->argument && !value) {
+        if (*index + 1 >= argc) {
+            return SERVER_CONFIG_ERROR_MISSING_VALUE;
+        }
+        value = argv[++*index];
+    }
+
+    return server_config_apply(config, setting, value);
+}
+
+void server_config_print_usage(FILE *out)
+{
+    for (size_t i = 0; i < SERVER_CONFIG_SETTING_COUNT; i++) {
+        const server_config_setting_t *setting = &server_config_settings[i];
+        char form[64];
+        if (setting->argument) {
+            snprintf(form, sizeof(form), "--%s %s", setting->name, setting->argument);
+        } else {
+            snprintf(form, sizeof(form), "--[no-]%s", setting->name);
+        }
+        fprintf(out, "  %-22s %s\n", form, setting->help);
+    }
+}
+
+const char *server_config_strerror(server_config_error_t error)
+{
+    switch (error) {
+    case SERVER_CONFIG_OK:
+        return "success";
+    case SERVER_CONFIG_ERROR_INVALID_PARAM:
+        return "invalid parameter";
+    case SERVER_CONFIG_ERROR_UNKNOWN_KEY:
+        return "unknown setting";
+    case SERVER_CONFIG_ERROR_INVALID_VALUE:
+        return "invalid value";
+    case SERVER_CONFIG_ERROR_MISSING_VALUE:
+        return "missing value";
+    case SERVER_CONFIG_ERROR_IO:
+        return "cannot read file";
+    case SERVER_CONFIG_ERROR_MEMORY:
+        return "out of memory";
+    }
+    return "unknown error";
+}
@@ -8,18 +8,230 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
 
 #include <dynamic.h>
 #include <reactor.h>
 
 #include "../../include/infrastructure/server_infrastructure.h"
+#include "../../include/infrastructure/server_config.h"
 #include "../../include/platform/system.h"
 #include "../../include/platform/socket.h"
+#include "../../include/platform/date_clock.h"
+#include "../../include/platform/http_parser.h"
+#include "../../include/platform/pool.h"
+#include "../../include/platform/topology.h"
 
 /** Global infrastructure instance for reactor callback */
 static server_infrastructure_t *global_infra = NULL;
 
+/** Time drained workers get to exit after closing their last connections */
+#define SERVER_INFRA_DRAIN_EXIT_MS 1000
+
+/** Strings a reload may change: plaintext body, JSON message, document root */
+#define SERVER_INFRA_RELOAD_STRINGS 3
+
+/** Settings a reload changes in running workers; their strings follow them */
+typedef struct {
+    bool enable_date_headers;
+    bool enable_socket_optimizations;
+    bool enable_http2;
+    unsigned trace_sample;
+    unsigned response_cache_ttl_ms;
+    size_t response_cache_size;
+    unsigned drain_timeout_ms;
+    server_limits_config_t limits_config;
+    socket_config_t socket_config;          /** cpu_ids is not shared */
+    uint32_t string_lengths[SERVER_INFRA_RELOAD_STRINGS]; /** UINT32_MAX for NULL */
+} server_reload_settings_t;
+
+/** Settings published by the parent under a sequence lock, mapped before fork */
+typedef struct server_config_page {
+    uint32_t sequence;                      /** Odd while the parent writes */
+    uint32_t size;                          /** Bytes used in data */
+    uint64_t generation;                    /** Reload the data came from */
+    char data[SERVER_INFRA_CONFIG_PAGE_SIZE - 16];
+} server_config_page_t;
+
+#define SERVER_INFRA_CONFIG_DATA_SIZE (sizeof(((server_config_page_t *)0)->data))
+
+static int64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Build an HTTP server snapshot from the settings of a configuration
+ * @return Snapshot, NULL if the settings cannot be served
+ */
+static http_server_t *server_infrastructure_new_http(const server_config_t *config)
+{
+    http_server_config_t http_config = {
+        .plaintext_response = config->plaintext_response,
+        .json_message = config->json_message,
+        .enable_date_headers = config->enable_date_headers,
+        .document_root = config->document_root,
+        .response_cache_ttl_ms = config->response_cache_ttl_ms,
+        .response_cache_size = config->response_cache_size
+    };
+
+    http_server_t *http = system_malloc(sizeof(*http));
+    if (!http) {
+        return NULL;
+    }
+    if (http_server_create(http, &http_config) != HTTP_SERVER_OK) {
+        http_server_destroy(http);
+        system_free(http);
+        return NULL;
+    }
+    return http;
+}
+
+static void server_infrastructure_free_http(http_server_t *http)
+{
+    if (http) {
+        http_server_destroy(http);
+        system_free(http);
+    }
+}
+
+/**
+ * @brief Serialize the reloadable settings of a configuration
+ * @return Bytes written, 0 if they do not fit
+ */
+static size_t server_infrastructure_pack_settings(const server_config_t *config, char *data, size_t size)
+{
+    const char *strings[SERVER_INFRA_RELOAD_STRINGS] = {
+        config->plaintext_response, config->json_message, config->document_root
+    };
+    server_reload_settings_t settings = {
+        .enable_date_headers = config->enable_date_headers,
+        .enable_socket_optimizations = config->enable_socket_optimizations,
+        .enable_http2 = config->enable_http2,
+        .trace_sample = config->trace_sample,
+        .response_cache_ttl_ms = config->response_cache_ttl_ms,
+        .response_cache_size = config->response_cache_size,
+        .drain_timeout_ms = config->drain_timeout_ms,
+        .limits_config = config->limits_config,
+        .socket_config = config->socket_config
+    };
+    settings.socket_config.cpu_ids = NULL;
+    settings.socket_config.cpu_count = 0;
+
+    size_t used = sizeof(settings);
+    for (int i = 0; i < SERVER_INFRA_RELOAD_STRINGS; i++) {
+        size_t length = strings[i] ? strlen(strings[i]) : 0;
+        settings.string_lengths[i] = strings[i] ? (uint32_t)length : UINT32_MAX;
+        used += strings[i] ? length + 1 : 0;
+    }
+    if (used > size) {
+        return 0;
+    }
+
+    memcpy(data, &settings, sizeof(settings));
+    char *next = data + sizeof(settings);
+    for (int i = 0; i < SERVER_INFRA_RELOAD_STRINGS; i++) {
+        if (strings[i]) {
+            memcpy(next, strings[i], settings.string_lengths[i] + 1);
+            next += settings.string_lengths[i] + 1;
+        }
+    }
+    return used;
+}
+
+/**
+ * @brief Make packed settings current: build their snapshot, then swap it in
+ * @return false if the settings are malformed or cannot be served; nothing
+ *         changes then
+ * @note Requests are handled within single events, so once this runs between
+ *       events no request still uses the old snapshot. File bodies being sent
+ *       hold their own references to the file cache entries.
+ */
+static bool server_infrastructure_take_settings(server_infrastructure_t *infra, const char *data, size_t size)
+{
+    server_reload_settings_t settings;
+    if (size < sizeof(settings)) {
+        return false;
+    }
+    memcpy(&settings, data, sizeof(settings));
+
+    server_config_t next = infra->config;
+    const char **strings[SERVER_INFRA_RELOAD_STRINGS] = {
+        &next.plaintext_response, &next.json_message, &next.document_root
+    };
+    size_t offset = sizeof(settings);
+    for (int i = 0; i < SERVER_INFRA_RELOAD_STRINGS; i++) {
+        uint32_t length = settings.string_lengths[i];
+        if (length == UINT32_MAX) {
+            *strings[i] = NULL;
+            continue;
+        }
+        if (size - offset <= length || data[offset + length] != '\0') {
+            return false;
+        }
+        *strings[i] = data + offset;
+        offset += (size_t)length + 1;
+    }
+
+    next.enable_date_headers = settings.enable_date_headers;
+    next.enable_socket_optimizations = settings.enable_socket_optimizations;
+    next.enable_http2 = settings.enable_http2;
+    next.trace_sample = settings.trace_sample;
+    next.response_cache_ttl_ms = settings.response_cache_ttl_ms;
+    next.response_cache_size = settings.response_cache_size;
+    next.drain_timeout_ms = settings.drain_timeout_ms;
+    next.limits_config = settings.limits_config;
+    next.socket_config = settings.socket_config;
+    next.socket_config.cpu_ids = infra->config.socket_config.cpu_ids;
+    next.socket_config.cpu_count = infra->config.socket_config.cpu_count;
+
+    http_server_t *http = server_infrastructure_new_http(&next);
+    if (!http) {
+        return false;
+    }
+
+    /* The snapshot owns the strings from here on */
+    next.plaintext_response = http->config.plaintext_response;
+    next.json_message = http->config.json_message;
+    next.document_root = http->config.document_root;
+
+    http_server_t *old = infra->http_server;
+    infra->http_server = http;
+    infra->config = next;
+    server_infrastructure_free_http(old);
+    return true;
+}
+
+/**
+ * @brief Publish packed settings to the workers' shared page
+ */
+static void server_infrastructure_publish_settings(server_config_page_t *page, uint64_t generation,
+                                                   const char *data, size_t size)
+{
+    uint32_t sequence = page->sequence;
+
+    __atomic_store_n(&page->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(page->data, data, size);
+    __atomic_store_n(&page->size, (uint32_t)size, __ATOMIC_RELAXED);
+    __atomic_store_n(&page->generation, generation, __ATOMIC_RELAXED);
+    __atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+
 server_infra_error_t server_infrastructure_init(void)
 {
     /* Initialize all modules */
@@ -33,6 +245,9 @@ server_infra_error_t server_infrastructure_init(void)
         return SERVER_INFRA_ERROR_INIT;
     }
 
+    /* Pick the request scanning kernels before any worker is forked */
+    http_parser_init();
+
     http_server_error_t http_err = http_server_init();
     if (http_err != HTTP_SERVER_OK) {
         return SERVER_INFRA_ERROR_INIT;
@@ -51,6 +266,99 @@ void server_infrastructure_cleanup(void)
     /* Platform modules don't need explicit cleanup */
 }
 
+/**
+ * @brief Narrow and order the configured worker CPUs by topology
+ * @param[in,out] cpu_ids Candidate CPUs, replaced by the selection
+ * @param[in,out] count Number of candidates
+ * @return SERVER_INFRA_OK, SERVER_INFRA_ERROR_RESOURCE if memory ran out
+ */
+static server_infra_error_t server_infrastructure_place_cpus(const server_config_t *config,
+                                                             int *cpu_ids, int *count)
+{
+    topology_t topology;
+    if (topology_discover(&topology) != TOPOLOGY_OK) {
+        log_warn("CPU topology unavailable, keeping configured worker CPUs");
+        return SERVER_INFRA_OK;
+    }
+
+    topology_options_t options = {
+        .skip_smt_siblings = config->skip_smt_siblings,
+        .prefer_irq_cpus = config->irq_interface != NULL
+    };
+    if (config->irq_interface &&
+        topology_mark_irq_cpus(&topology, config->irq_interface) != TOPOLOGY_OK) {
+        log_warn("No interrupts of %s are routed to usable CPUs, ignoring them",
+                 config->irq_interface);
+    }
+
+    int selected = *count;
+    topology_error_t err = topology_select_cpus(&topology, &options, cpu_ids, &selected);
+    if (err == TOPOLOGY_ERROR_MEMORY) {
+        topology_destroy(&topology);
+        return SERVER_INFRA_ERROR_RESOURCE;
+    }
+    if (err != TOPOLOGY_OK) {
+        log_warn("No configured worker CPU is in the affinity mask, keeping them as given");
+    } else {
+        *count = selected;
+    }
+
+    log_info("CPU topology: %d CPUs, %d cores, %d NUMA nodes, %d interrupt CPUs; %d worker CPUs",
+             topology.count, topology.core_count, topology.node_count, topology.irq_count, *count);
+
+    topology_destroy(&topology);
+    return SERVER_INFRA_OK;
+}
+
+/**
+ * @brief Decide the worker CPUs from the CPU list, placement policy and worker count
+ * @param config Configuration whose worker CPUs are replaced
+ * @param[out] placed CPU array owned by the caller
+ * @return SERVER_INFRA_OK, SERVER_INFRA_ERROR_CONFIG without CPUs,
+ *         SERVER_INFRA_ERROR_RESOURCE if memory ran out
+ */
+static server_infra_error_t server_infrastructure_place_workers(server_config_t *config, int **placed)
+{
+    int count = config->worker_config.worker_count;
+    if (count <= 0 || !config->worker_config.cpu_ids) {
+        return SERVER_INFRA_ERROR_CONFIG;
+    }
+    int workers = config->workers > 0 ? config->workers : count;
+    int capacity = workers > count ? workers : count;
+
+    int *cpu_ids = system_malloc((size_t)capacity * sizeof(int));
+    if (!cpu_ids) {
+        return SERVER_INFRA_ERROR_RESOURCE;
+    }
+    memcpy(cpu_ids, config->worker_config.cpu_ids, (size_t)count * sizeof(int));
+
+    if (config->worker_config.enable_affinity &&
+        server_infrastructure_place_cpus(config, cpu_ids, &count) != SERVER_INFRA_OK) {
+        system_free(cpu_ids);
+        return SERVER_INFRA_ERROR_RESOURCE;
+    }
+
+    if (config->workers > 0 && config->workers < count) {
+        count = config->workers;
+    } else if (config->workers > count) {
+        if (config->worker_config.enable_affinity) {
+            /* Two pinned workers on one CPU only take turns */
+            log_warn("%d workers requested but %d CPUs available, starting %d",
+                     config->workers, count, count);
+        } else {
+            for (int i = count; i < config->workers; i++) {
+                cpu_ids[i] = cpu_ids[i % count];
+            }
+            count = config->workers;
+        }
+    }
+
+    config->worker_config.cpu_ids = cpu_ids;
+    config->worker_config.worker_count = count;
+    *placed = cpu_ids;
+    return SERVER_INFRA_OK;
+}
+
 server_infra_error_t server_infrastructure_create(server_infrastructure_t *infra,
                                                   const server_config_t *config)
 {
@@ -59,35 +367,94 @@ server_infra_error_t server_infrastructure_create(server_infrastructure_t *infra
     }
 
     memset(infra, 0, sizeof(*infra));
+    infra->handoff_fd = -1;
 
     /* Copy configuration */
     infra->config = *config;
 
-    /* Initialize HTTP server */
-    http_server_config_t http_config = {
-        .plaintext_response = config->plaintext_response,
-        .json_message = config->json_message,
-        .enable_date_headers = config->enable_date_headers
-    };
+    /* Inherited by the workers' allocators on fork */
+    pool_set_high_water(config->pool_high_water);
 
-    http_server_error_t http_err = http_server_create(&infra->http_server, &http_config);
-    if (http_err != HTTP_SERVER_OK) {
+    /* Apply the configured log level; the workers inherit it */
+    if (config->log_config.level <= LOG_LEVEL_DEBUG) {
+        log_set_level(config->log_config.level);
+    }
+
+    /* Initialize HTTP server */
+    infra->http_server = server_infrastructure_new_http(config);
+    if (!infra->http_server) {
         return SERVER_INFRA_ERROR_INIT;
     }
 
+    /* Pick worker CPUs by node, core and NIC interrupts */
+    int *placed = NULL;
+    server_infra_error_t place_err = server_infrastructure_place_workers(&infra->config, &placed);
+    if (place_err != SERVER_INFRA_OK) {
+        server_infrastructure_free_http(infra->http_server);
+        return place_err;
+    }
+
     /* Initialize worker manager */
-    worker_manager_init(&infra->worker_manager, &config->worker_config);
+    process_error_t proc_err = worker_manager_init(&infra->worker_manager, &infra->config.worker_config);
+    system_free(placed);
+    if (proc_err != PROCESS_OK) {
+        server_infrastructure_free_http(infra->http_server);
+        return SERVER_INFRA_ERROR_INIT;
+    }
+
+    /* The manager owns the CPU list now; the reuseport filter maps CPUs to listeners */
+    infra->config.worker_config.cpu_ids = infra->worker_manager.config.cpu_ids;
+    if (config->worker_config.enable_affinity) {
+        infra->config.socket_config.cpu_ids = infra->worker_manager.config.cpu_ids;
+        infra->config.socket_config.cpu_count = infra->worker_manager.config.worker_count;
+    }
+
+    /* Shared counter region must exist before workers are forked */
+    if (config->enable_metrics) {
+        metrics_error_t met_err = metrics_init(&infra->metrics, infra->config.worker_config.worker_count);
+        if (met_err != METRICS_OK) {
+            worker_manager_cleanup(&infra->worker_manager);
+            server_infrastructure_free_http(infra->http_server);
+            return SERVER_INFRA_ERROR_RESOURCE;
+        }
+        metrics_set_route_names(&infra->metrics, http_server_route_names(), ROUTE_COUNT);
+
+        /* Trace rings are exported on the metrics port; without them sampling stays off */
+        if (TRACE_ENABLED && trace_init(&infra->trace, infra->config.worker_config.worker_count) == TRACE_OK) {
+            trace_set_route_names(&infra->trace, http_server_route_names(), ROUTE_COUNT);
+            metrics_set_trace(&infra->metrics, &infra->trace);
+        }
+    }
+
+    /* Shared Date page, published by one writer thread in this process */
+    if (date_clock_init() != DATE_CLOCK_OK || date_clock_start() != DATE_CLOCK_OK) {
+        log_warn("Shared date clock unavailable, workers format the date themselves");
+    }
 
     /* Initialize signal manager */
     signal_error_t sig_err = signal_manager_init(&infra->signal_manager, &config->signal_config);
     if (sig_err != SIGNAL_OK) {
+        if (config->enable_metrics) {
+            metrics_cleanup(&infra->metrics);
+            trace_cleanup(&infra->trace);
+        }
+        date_clock_cleanup();
         worker_manager_cleanup(&infra->worker_manager);
-        http_server_destroy(&infra->http_server);
+        server_infrastructure_free_http(infra->http_server);
         return SERVER_INFRA_ERROR_INIT;
     }
 
+    /* Reloaded settings reach the workers through a page they all map */
+    void *page = mmap(NULL, sizeof(server_config_page_t), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+        log_warn("Shared settings page unavailable, reloads only reach restarted workers");
+    } else {
+        infra->config_page = page;
+    }
+
     infra->initialized = true;
-    log_info("Server infrastructure initialized");
+    log_info("Server infrastructure initialized (HTTP parser: %s)", http_parser_implementation());
     return SERVER_INFRA_OK;
 }
 
@@ -97,94 +464,725 @@ void server_infrastructure_destroy(server_infrastructure_t *infra)
         return;
     }
 
+    if (infra->listeners) {
+        for (int i = 0; i < infra->listener_count; i++) {
+            if (infra->listeners[i] >= 0) {
+                close(infra->listeners[i]);
+            }
+        }
+        system_free(infra->listeners);
+    }
+    if (infra->handoff_fd >= 0) {
+        close(infra->handoff_fd);
+    }
+
     if (infra->initialized) {
         signal_manager_cleanup(&infra->signal_manager);
+        if (infra->config.enable_metrics) {
+            metrics_cleanup(&infra->metrics);
+            trace_cleanup(&infra->trace);
+        }
+        date_clock_cleanup();
         worker_manager_cleanup(&infra->worker_manager);
-        http_server_destroy(&infra->http_server);
+        server_infrastructure_free_http(infra->http_server);
+        if (infra->config_page) {
+            munmap(infra->config_page, sizeof(server_config_page_t));
+        }
         infra->initialized = false;
     }
 
     memset(infra, 0, sizeof(*infra));
 }
 
-server_infra_error_t server_infrastructure_start(server_infrastructure_t *infra)
+/**
+ * @brief Apply connection limits, accepted-socket options and protocols to a worker's server
+ */
+static void server_infrastructure_configure_server(const server_infrastructure_t *infra, server *srv)
 {
-    if (!infra || !infra->initialized) {
-        return SERVER_INFRA_ERROR_CONFIG;
+    (void)infra;
+    (void)srv;
+
+#ifdef REACTOR_SERVER_LIMITS
+    const server_limits_config_t *limits = &infra->config.limits_config;
+    server_set_limits(srv, &(server_limits){
+        .header_timeout_ms = limits->header_timeout_ms,
+        .idle_timeout_ms = limits->idle_timeout_ms,
+        .keepalive_timeout_ms = limits->keepalive_timeout_ms,
+        .max_requests = limits->max_requests,
+        .max_connections = limits->max_connections
+    });
+#endif
+
+#ifdef REACTOR_SERVER_SOCKET_OPTIONS
+    /* The parent configured the listener; connections get their options in one batch */
+    socket_option_value_t accepted[SOCKET_MAX_ACCEPTED_OPTIONS];
+    server_socket_option options[SOCKET_MAX_ACCEPTED_OPTIONS];
+    int count = infra->config.enable_socket_optimizations ?
+                socket_accepted_options(&infra->config.socket_config, accepted) : 0;
+    for (int i = 0; i < count; i++) {
+        options[i] = (server_socket_option){ accepted[i].level, accepted[i].name, accepted[i].value };
     }
+    server_set_socket_options(srv, options, (size_t)count);
+#endif
 
-    /* Set global reference for reactor callback */
-    global_infra = infra;
+#ifdef REACTOR_SERVER_HTTP2
+    /* Connections already on HTTP/2 keep it when it is turned off */
+    server_set_http2(srv, infra->config.enable_http2);
+#endif
 
-    /* Fork worker processes */
-    process_error_t proc_err = worker_manager_fork_workers(&infra->worker_manager);
-    if (proc_err != PROCESS_OK) {
-        return SERVER_INFRA_ERROR_STARTUP;
+    trace_set_interval(infra->config.trace_sample);
+}
+
+#ifdef REACTOR_SERVER_HANDOFF
+/**
+ * @brief Open one listener per worker, taking over those of a previous binary
+ */
+static server_infra_error_t server_infrastructure_open_listeners(server_infrastructure_t *infra)
+{
+    int count = infra->config.worker_config.worker_count;
+    infra->listeners = system_malloc((size_t)count * sizeof(int));
+    if (!infra->listeners) {
+        return SERVER_INFRA_ERROR_RESOURCE;
+    }
+    for (int i = 0; i < count; i++) {
+        infra->listeners[i] = -1;
     }
+    infra->listener_count = count;
 
-    /* Check if we're a worker or parent */
-    process_type_t proc_type = worker_manager_get_type(&infra->worker_manager);
+    int inherited = 0;
+    const char *channel = getenv(SERVER_INFRA_HANDOFF_ENV);
+    if (channel) {
+        infra->handoff_fd = atoi(channel);
+        unsetenv(SERVER_INFRA_HANDOFF_ENV);
+        if (socket_recv_fds(infra->handoff_fd, infra->listeners, count, &inherited) != SOCKET_OK) {
+            log_error("Failed to receive listeners from the previous server: %s", strerror(errno));
+            return SERVER_INFRA_ERROR_STARTUP;
+        }
+        log_info("Took over %d listeners from the previous server", inherited);
+    }
 
-    if (proc_type == PROCESS_TYPE_WORKER) {
-        /* Worker process: initialize reactor and start server */
-        log_info("Worker process starting on CPU %d, global_infra: %p", worker_manager_get_cpu_id(&infra->worker_manager), (void*)global_infra);
+    const socket_config_t *options = infra->config.enable_socket_optimizations ?
+                                     &infra->config.socket_config : NULL;
+    const int *cpu_ids = infra->config.worker_config.cpu_ids;
+    bool affinity = infra->config.worker_config.enable_affinity;
 
-        core_construct(NULL);
+    /* Taken-over listeners get this configuration too, including the new BPF map */
+    for (int i = 0; i < inherited && options; i++) {
+        if (socket_apply_optimizations(infra->listeners[i], options) != SOCKET_OK) {
+            log_warn("Failed to apply socket optimizations to inherited listener %d", i);
+        }
+    }
 
-        server s;
-        server_state_t state = { .srv = &s, .infra = global_infra };
-        server_construct(&s, server_infrastructure_request_handler, &state);
+    /* Listeners join the reuseport group in worker order */
+    for (int i = inherited; i < count; i++) {
+        socket_error_t sock_err = socket_open_listener(0, infra->config.port, infra->config.backlog,
+                                                       affinity ? cpu_ids[i] : -1, options,
+                                                       &infra->listeners[i]);
+        if (infra->listeners[i] < 0) {
+            log_error("Failed to listen on port %d: %s", infra->config.port, strerror(errno));
+            return SERVER_INFRA_ERROR_STARTUP;
+        }
+        if (sock_err != SOCKET_OK) {
+            log_warn("Failed to apply socket optimizations to listener %d", i);
+        }
+    }
 
-        server_open(&s, 0, infra->config.port);
-        log_info("Server listening on port %d", infra->config.port);
+    return SERVER_INFRA_OK;
+}
 
-        /* Apply socket optimizations if enabled */
-        if (infra->config.enable_socket_optimizations) {
-            socket_error_t sock_err = socket_apply_optimizations(s.fd, &infra->config.socket_config);
-            if (sock_err != SOCKET_OK) {
-                log_warn("Failed to apply socket optimizations");
+/**
+ * @brief Copy the published settings out of the shared page
+ * @return Bytes copied, 0 if the parent kept rewriting the page
+ */
+static size_t server_infrastructure_read_settings(const server_config_page_t *page, char *data,
+                                                  uint64_t *generation)
+{
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        uint32_t sequence = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        if (sequence & 1) {
+            sched_yield();
+            continue;
+        }
+
+        size_t size = __atomic_load_n(&page->size, __ATOMIC_RELAXED);
+        *generation = __atomic_load_n(&page->generation, __ATOMIC_RELAXED);
+        if (size > SERVER_INFRA_CONFIG_DATA_SIZE) {
+            continue;
+        }
+        memcpy(data, page->data, size);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&page->sequence, __ATOMIC_RELAXED) == sequence) {
+            return size;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Switch to the settings the parent published for a reload
+ */
+static void server_infrastructure_load_settings(server_state_t *state, uint64_t generation)
+{
+    server_infrastructure_t *infra = state->infra;
+    if (!infra->config_page || generation <= infra->config_generation) {
+        return;
+    }
+
+    char *data = system_malloc(SERVER_INFRA_CONFIG_DATA_SIZE);
+    uint64_t published = 0;
+    size_t size = data ? server_infrastructure_read_settings(infra->config_page, data, &published) : 0;
+    if (size > 0 && server_infrastructure_take_settings(infra, data, size)) {
+        infra->config_generation = published;
+        server_infrastructure_configure_server(infra, state->srv);
+        log_info("Configuration %llu applied", (unsigned long long)published);
+    } else {
+        log_error("Failed to apply configuration %llu, keeping the running one",
+                  (unsigned long long)generation);
+    }
+    system_free(data);
+}
+
+/**
+ * @brief Apply one message from the parent between events
+ */
+static void server_infrastructure_apply_message(server_state_t *state, const control_message_t *message)
+{
+    server_infrastructure_t *infra = state->infra;
+
+    switch (message->type) {
+        case CONTROL_MESSAGE_DRAIN:
+            if (!state->srv->draining) {
+                log_info("Stop requested, draining connections");
+                server_drain(state->srv, infra->config.drain_timeout_ms);
             }
+            break;
+
+        case CONTROL_MESSAGE_PURGE_CACHE:
+            log_info("Purged %zu cached responses", http_server_purge_cache(infra->http_server));
+            break;
+
+        case CONTROL_MESSAGE_LOG_LEVEL:
+            log_set_level((log_level_t)message->value);
+            break;
+
+        case CONTROL_MESSAGE_CONFIG:
+            server_infrastructure_load_settings(state, (uint64_t)message->value);
+            break;
+
+        default:
+            log_warn("Unknown control message %u", message->type);
+            break;
+    }
+}
+
+/**
+ * @brief Worker callback for the doorbell of the parent's control channel
+ */
+static core_status server_infrastructure_control_handler(core_event *event)
+{
+    server_state_t *state = event->state;
+    control_channel_t *channel = worker_manager_get_control_channel(&state->infra->worker_manager);
+    control_message_t message;
+
+    control_channel_clear(channel);
+    while (control_channel_receive(channel, &message)) {
+        server_infrastructure_apply_message(state, &message);
+    }
+    return CORE_OK;
+}
+
+/**
+ * @brief Start draining once SIGTERM or SIGINT reached this worker
+ */
+static void server_infrastructure_check_shutdown(server_state_t *state)
+{
+    server_infrastructure_t *infra = state->infra;
+
+    /* Reload and user signals are the parent's to act on */
+    signal_manager_reset_reload(&infra->signal_manager);
+    (void)signal_manager_take_user(&infra->signal_manager, SIGUSR1);
+    (void)signal_manager_take_user(&infra->signal_manager, SIGUSR2);
+
+    if (signal_manager_shutdown_requested(&infra->signal_manager) && !state->srv->draining) {
+        log_info("Shutdown requested, draining connections for up to %u ms", infra->config.drain_timeout_ms);
+        server_drain(state->srv, infra->config.drain_timeout_ms);
+    }
+}
+
+/**
+ * @brief Worker callback for the signalfd
+ */
+static core_status server_infrastructure_signal_fd_handler(core_event *event)
+{
+    server_state_t *state = event->state;
+
+    if (signal_manager_dispatch(&state->infra->signal_manager) > 0) {
+        server_infrastructure_check_shutdown(state);
+    }
+    return CORE_OK;
+}
+#endif
+
+/**
+ * @brief Wait for the replacement binary to report that its workers are ready
+ */
+static bool server_infrastructure_wait_ready(int channel, pid_t pid)
+{
+    int64_t deadline = monotonic_ms() + SERVER_INFRA_UPGRADE_TIMEOUT_MS;
+
+    while (monotonic_ms() < deadline) {
+        struct pollfd pfd = { .fd = channel, .events = POLLIN };
+        int n = poll(&pfd, 1, 100);
+        if (n > 0) {
+            char ready;
+            return read(channel, &ready, 1) == 1;
+        }
+        if (n == -1 && errno != EINTR) {
+            return false;
         }
 
-        /* Signal parent that we're ready */
-        worker_manager_signal_ready(&infra->worker_manager);
+        int status;
+        if (waitpid(pid, &status, WNOHANG) == pid) {
+            return false;
+        }
+    }
 
-        /* Start event loop with signal monitoring */
-        log_info("Worker ready, starting event loop");
+    log_error("New server did not become ready within %d ms", SERVER_INFRA_UPGRADE_TIMEOUT_MS);
+    return false;
+}
 
-        /* Start event loop - signals will be handled asynchronously */
-        log_info("Worker ready, starting event loop");
-        core_loop(NULL);
+/**
+ * @brief Start the binary again and hand it the listeners
+ * @return true once the new server's workers accept connections
+ */
+static bool server_infrastructure_upgrade(server_infrastructure_t *infra, bool *serve_metrics)
+{
+    if (!infra->config.argv || !infra->config.argv[0] || !infra->listeners) {
+        log_warn("Binary reload is not available in this build or configuration");
+        return false;
+    }
 
-        /* Check why we exited */
-        if (signal_manager_shutdown_requested(&infra->signal_manager)) {
-            log_info("Shutdown requested, stopping server");
-        } else {
-            log_info("Event loop exited for unknown reason");
+    int channel[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel) == -1) {
+        log_error("Failed to create handoff channel: %s", strerror(errno));
+        return false;
+    }
+
+    /* The new server binds the admin port itself */
+    if (*serve_metrics) {
+        metrics_server_close(&infra->metrics);
+        *serve_metrics = false;
+    }
+
+    log_info("Binary reload requested, starting %s", infra->config.argv[0]);
+
+    pid_t pid;
+    bool ready = false;
+    if (process_spawn_with_fd(infra->config.argv, channel[1], SERVER_INFRA_HANDOFF_ENV, &pid) == PROCESS_OK) {
+        close(channel[1]);
+        channel[1] = -1;
+        ready = socket_send_fds(channel[0], infra->listeners, infra->listener_count) == SOCKET_OK &&
+                server_infrastructure_wait_ready(channel[0], pid);
+        if (!ready) {
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
         }
+    }
+
+    close(channel[0]);
+    if (channel[1] >= 0) {
+        close(channel[1]);
+    }
 
-        server_destruct(&s);
-        core_destruct(NULL);
-        log_info("Worker process shutting down");
+    if (!ready) {
+        log_error("New server failed to start, keeping the running one");
+        *serve_metrics = infra->config.enable_metrics &&
+                         metrics_server_open(&infra->metrics, infra->config.metrics_address,
+                                             infra->config.metrics_port) == METRICS_OK;
+        return false;
+    }
+
+    log_info("New server (PID: %d) is ready", pid);
+    return true;
+}
 
+#ifdef REACTOR_SERVER_HANDOFF
+/**
+ * @brief Let the workers finish their connections, then make sure they exit
+ */
+static void server_infrastructure_drain_workers(server_infrastructure_t *infra)
+{
+    worker_manager_t *manager = &infra->worker_manager;
+    /* Workers close what is left at the drain timeout; a timeout of 0 sets
+     * them no deadline, so they are only given the time to exit */
+    int64_t deadline = monotonic_ms() + infra->config.drain_timeout_ms + SERVER_INFRA_DRAIN_EXIT_MS;
+    int64_t remaining;
+
+    worker_manager_stop_workers(manager);
+    while ((remaining = deadline - monotonic_ms()) > 0 &&
+           worker_manager_wait_exit(manager, (int)remaining) > 0) {
+    }
+
+    if (worker_manager_running_workers(manager) > 0) {
+        log_warn("Workers still running after the drain timeout, killing them");
+        worker_manager_kill_workers(manager);
+        while (worker_manager_wait_exit(manager, -1) > 0) {
+        }
+    }
+    log_info("Workers drained");
+}
+#endif
+
+/**
+ * @brief Configure how this worker's reactor waits for events
+ */
+static void server_infrastructure_apply_idle_config(const server_infrastructure_t *infra)
+{
+    const server_idle_config_t *idle = &infra->config.idle_config;
+
+#ifdef REACTOR_CORE_IDLE_POLICY
+    /* The SO_BUSY_POLL time bounds kernel busy polling */
+    const socket_config_t *sockets = &infra->config.socket_config;
+    bool busy_poll = infra->config.enable_socket_optimizations && (sockets->options & SOCKET_OPT_BUSY_POLL);
+
+    core_idle_policy policy = {
+        .adaptive = idle->mode == SERVER_IDLE_ADAPTIVE,
+        .mode = idle->mode == SERVER_IDLE_SPIN ? CORE_IDLE_SPIN :
+                idle->mode == SERVER_IDLE_BLOCK ? CORE_IDLE_BLOCK : CORE_IDLE_BUSY_POLL,
+        .spin_us = idle->spin_us,
+        .busy_poll_us = busy_poll ? (unsigned)sockets->busy_poll_value : 0,
+        .spin_rate = idle->spin_rate,
+        .busy_poll_rate = idle->busy_poll_rate
+    };
+    core_set_idle_policy(NULL, &policy);
+#else
+    if (idle->mode != SERVER_IDLE_BLOCK) {
+        log_warn("Idle strategies other than blocking need the io_uring backend");
+    }
+#endif
+}
+
+/**
+ * @brief Serve connections in a worker process until its loop ends
+ */
+static void server_infrastructure_run_worker(server_infrastructure_t *infra)
+{
+    /* Worker process: initialize reactor and start server */
+    log_info("Worker process starting on CPU %d, global_infra: %p", worker_manager_get_cpu_id(&infra->worker_manager), (void*)global_infra);
+
+    /* A restarted worker is forked from the supervising parent */
+    metrics_server_close(&infra->metrics);
+
+    if (infra->config.enable_metrics) {
+        metrics_attach_worker(&infra->metrics,
+                              worker_manager_get_worker_id(&infra->worker_manager),
+                              worker_manager_get_cpu_id(&infra->worker_manager));
+        trace_attach_worker(&infra->trace,
+                            worker_manager_get_worker_id(&infra->worker_manager),
+                            worker_manager_get_cpu_id(&infra->worker_manager));
+    }
+
+    core_construct(NULL);
+    server_infrastructure_apply_idle_config(infra);
+
+    server s;
+    server_state_t state = { .srv = &s, .infra = global_infra };
+    server_construct(&s, server_infrastructure_request_handler, &state);
+    server_infrastructure_configure_server(infra, &s);
+
+#ifdef REACTOR_SERVER_HANDOFF
+    /* Keep this worker's listener; the server owns it from here on */
+    int worker_id = worker_manager_get_worker_id(&infra->worker_manager);
+    int listener = infra->listeners[worker_id];
+    infra->listeners[worker_id] = -1;
+    for (int i = 0; i < infra->listener_count; i++) {
+        if (infra->listeners[i] >= 0) {
+            close(infra->listeners[i]);
+            infra->listeners[i] = -1;
+        }
+    }
+    if (infra->handoff_fd >= 0) {
+        close(infra->handoff_fd);
+        infra->handoff_fd = -1;
+    }
+    server_open_socket(&s, listener);
+    core_add(NULL, server_infrastructure_control_handler, &state,
+             worker_manager_get_control_fd(&infra->worker_manager), POLLIN);
+
+    /* Signals become reactor events; one sent before this set its flag already */
+    if (signal_manager_open_fd(&infra->signal_manager) == SIGNAL_OK) {
+        core_add(NULL, server_infrastructure_signal_fd_handler, &state,
+                 signal_manager_get_fd(&infra->signal_manager), POLLIN);
     } else {
-        /* Parent process: wait for workers or shutdown signal */
-        log_info("Parent process started, managing %d workers", infra->config.worker_config.worker_count);
-
-        /* Wait for workers to exit or shutdown signal */
-        while (!signal_manager_shutdown_requested(&infra->signal_manager)) {
-            /* Check if any worker has exited */
-            if (worker_manager_wait_workers(&infra->worker_manager) == PROCESS_OK) {
-                log_info("Worker process exited, shutting down");
+        log_warn("Signals cannot be watched by the event loop, only the parent stops this worker");
+    }
+    server_infrastructure_check_shutdown(&state);
+#else
+    server_open(&s, 0, infra->config.port);
+
+    /* Apply socket optimizations if enabled */
+    if (infra->config.enable_socket_optimizations) {
+        socket_error_t sock_err = socket_apply_optimizations(s.fd, &infra->config.socket_config);
+        if (sock_err != SOCKET_OK) {
+            log_warn("Failed to apply socket optimizations");
+        }
+    }
+#endif
+    log_info("Server listening on port %d", infra->config.port);
+
+    /* Signal parent that we're ready */
+    worker_manager_signal_ready(&infra->worker_manager);
+
+    log_info("Worker ready, starting event loop");
+    core_loop(NULL);
+
+    /* Check why we exited */
+#ifdef REACTOR_SERVER_HANDOFF
+    if (s.draining) {
+        log_info("Connections drained");
+    } else
+#endif
+    if (signal_manager_shutdown_requested(&infra->signal_manager)) {
+        log_info("Shutdown requested, stopping server");
+    } else {
+        log_info("Event loop exited for unknown reason");
+    }
+
+    server_destruct(&s);
+    core_destruct(NULL);
+    log_info("Worker process shutting down");
+}
+
+/**
+ * @brief Warn about changed settings that only a binary reload applies
+ */
+static void server_infrastructure_warn_fixed(const server_config_t *running, const server_config_t *next)
+{
+    const struct {
+        const char *name;
+        bool changed;
+    } fixed[] = {
+        {"port", running->port != next->port},
+        {"backlog", running->backlog != next->backlog},
+        {"workers", running->workers != next->workers},
+        {"metrics-port", running->enable_metrics != next->enable_metrics ||
+                         (next->enable_metrics && (running->metrics_port != next->metrics_port ||
+                                                   running->metrics_address != next->metrics_address))},
+        {"idle", running->idle_config.mode != next->idle_config.mode ||
+                 running->idle_config.spin_us != next->idle_config.spin_us ||
+                 running->idle_config.spin_rate != next->idle_config.spin_rate ||
+                 running->idle_config.busy_poll_rate != next->idle_config.busy_poll_rate},
+        {"pool-high-water", running->pool_high_water != next->pool_high_water}
+    };
+
+    for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++) {
+        if (fixed[i].changed) {
+            log_warn("Setting %s changed; it takes effect after a binary reload (SIGUSR2)", fixed[i].name);
+        }
+    }
+}
+
+/**
+ * @brief Re-read the configuration and push what can change to the workers
+ */
+static void server_infrastructure_reload(server_infrastructure_t *infra)
+{
+    if (!infra->config.load_config) {
+        log_warn("Configuration reload is not available in this configuration");
+        return;
+    }
+
+    log_info("Reloading configuration");
+    server_config_t next;
+    if (!infra->config.load_config(&next)) {
+        log_error("New configuration is invalid, keeping the running one");
+        server_config_cleanup(&next);
+        return;
+    }
+    server_infrastructure_warn_fixed(&infra->config, &next);
+
+    /* Validated by building the parent's snapshot, which restarted workers inherit */
+    char *data = system_malloc(SERVER_INFRA_CONFIG_DATA_SIZE);
+    size_t size = data ? server_infrastructure_pack_settings(&next, data, SERVER_INFRA_CONFIG_DATA_SIZE) : 0;
+    if (size == 0 || !server_infrastructure_take_settings(infra, data, size)) {
+        log_error("New configuration cannot be served, keeping the running one");
+        system_free(data);
+        server_config_cleanup(&next);
+        return;
+    }
+
+#ifdef REACTOR_SERVER_HANDOFF
+    /* Listener options apply to connections accepted from now on */
+    for (int i = 0; i < infra->listener_count && infra->config.enable_socket_optimizations; i++) {
+        if (infra->listeners[i] >= 0 &&
+            socket_apply_optimizations(infra->listeners[i], &infra->config.socket_config) != SOCKET_OK) {
+            log_warn("Failed to apply socket optimizations to listener %d", i);
+        }
+    }
+#endif
+
+    infra->config_generation++;
+    if (infra->config_page) {
+        control_message_t message = {
+            .type = CONTROL_MESSAGE_CONFIG,
+            .value = (int64_t)infra->config_generation
+        };
+        server_infrastructure_publish_settings(infra->config_page, infra->config_generation, data, size);
+        worker_manager_broadcast(&infra->worker_manager, &message);
+    }
+    system_free(data);
+
+    log_level_t level = next.log_config.level;
+    if (level <= LOG_LEVEL_DEBUG && level != infra->config.log_config.level) {
+        control_message_t message = { .type = CONTROL_MESSAGE_LOG_LEVEL, .value = level };
+        infra->config.log_config.level = level;
+        log_set_level(level);
+        worker_manager_broadcast(&infra->worker_manager, &message);
+    }
+
+    /* The snapshot holds copies of the strings it serves */
+    server_config_cleanup(&next);
+    log_info("Configuration %llu pushed to the workers", (unsigned long long)infra->config_generation);
+}
+
+/**
+ * @brief Parent loop: restart workers, answer scrapes, handle reload and shutdown
+ * @note Returns in a restarted worker as well; callers check the process type
+ */
+static void server_infrastructure_supervise(server_infrastructure_t *infra)
+{
+    worker_manager_t *manager = &infra->worker_manager;
+    log_info("Parent process started, managing %d workers", infra->config.worker_config.worker_count);
+
+    bool serve_metrics = infra->config.enable_metrics &&
+                         metrics_server_open(&infra->metrics, infra->config.metrics_address,
+                                             infra->config.metrics_port) == METRICS_OK;
+
+    /* Tell the binary we replace that our workers accept connections */
+    if (infra->handoff_fd >= 0) {
+        char ready = 1;
+        if (write(infra->handoff_fd, &ready, 1) != 1) {
+            log_warn("Failed to notify the previous server: %s", strerror(errno));
+        }
+        close(infra->handoff_fd);
+        infra->handoff_fd = -1;
+    }
+
+    /* Worker exits (pidfds), scrapes and signals (signalfd) wake the loop */
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        log_error("Failed to create supervisor epoll: %s", strerror(errno));
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = 0 };
+    int workers_fd = worker_manager_get_event_fd(manager);
+    if (workers_fd >= 0) {
+        (void)epoll_ctl(epoll_fd, EPOLL_CTL_ADD, workers_fd, &ev);
+    }
+    if (serve_metrics) {
+        ev.data.u32 = 1;
+        (void)epoll_ctl(epoll_fd, EPOLL_CTL_ADD, metrics_server_fd(&infra->metrics), &ev);
+    }
+
+    /* Otherwise a signal landing between the flag checks and epoll_wait waits for the timeout */
+    if (signal_manager_open_fd(&infra->signal_manager) == SIGNAL_OK) {
+        ev.data.u32 = 2;
+        (void)epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_manager_get_fd(&infra->signal_manager), &ev);
+    }
+
+    bool upgraded = false;
+    while (!signal_manager_shutdown_requested(&infra->signal_manager)) {
+        /* SIGHUP: apply the configuration again without restarting workers */
+        if (signal_manager_reload_requested(&infra->signal_manager)) {
+            signal_manager_reset_reload(&infra->signal_manager);
+            server_infrastructure_reload(infra);
+        }
+
+        /* SIGUSR2: replace this binary without closing the listeners */
+        if (signal_manager_take_user(&infra->signal_manager, SIGUSR2)) {
+            if (server_infrastructure_upgrade(infra, &serve_metrics)) {
+                upgraded = true;
                 break;
             }
+            if (serve_metrics) {
+                /* Reopened after the failed upgrade */
+                ev.data.u32 = 1;
+                (void)epoll_ctl(epoll_fd, EPOLL_CTL_ADD, metrics_server_fd(&infra->metrics), &ev);
+            }
+        }
 
-            /* Small delay to avoid busy waiting */
-            usleep(100000); /* 100ms */
+        /* SIGUSR1: every worker drops its cached responses */
+        if (signal_manager_take_user(&infra->signal_manager, SIGUSR1)) {
+            control_message_t purge = { .type = CONTROL_MESSAGE_PURGE_CACHE };
+            log_info("Purging cached responses of all workers");
+            worker_manager_broadcast(manager, &purge);
+        }
+
+        struct epoll_event events[3];
+        int n = epoll_wait(epoll_fd, events, 3, worker_manager_supervise_timeout(manager));
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.u32 == 1) {
+                metrics_server_poll(&infra->metrics, 0);
+            } else if (events[i].data.u32 == 2) {
+                signal_manager_dispatch(&infra->signal_manager);
+            }
         }
 
-        log_info("Parent process shutting down");
-        /* Workers have exited or shutdown requested */
+        /* Restart exited workers; a restarted worker returns from here */
+        worker_manager_supervise(manager);
+        if (worker_manager_get_type(manager) == PROCESS_TYPE_WORKER) {
+            /* Admin connections inherited from the parent would outlive its close */
+            metrics_server_close(&infra->metrics);
+            close(epoll_fd);
+            return;
+        }
+    }
+    close(epoll_fd);
+
+#ifdef REACTOR_SERVER_HANDOFF
+    /* Workers stop accepting and finish their responses before the parent exits */
+    if (!upgraded) {
+        log_info("Shutdown requested, draining %d workers", worker_manager_running_workers(manager));
+    }
+    server_infrastructure_drain_workers(infra);
+#else
+    /* Workers without a control channel end with the parent (PR_SET_PDEATHSIG) */
+    (void)upgraded;
+#endif
+
+    log_info("Parent process shutting down");
+}
+
+server_infra_error_t server_infrastructure_start(server_infrastructure_t *infra)
+{
+    if (!infra || !infra->initialized) {
+        return SERVER_INFRA_ERROR_CONFIG;
+    }
+
+    /* Set global reference for reactor callback */
+    global_infra = infra;
+
+#ifdef REACTOR_SERVER_HANDOFF
+    /* The parent owns the listeners so it can pass them to a new binary */
+    server_infra_error_t listen_err = server_infrastructure_open_listeners(infra);
+    if (listen_err != SERVER_INFRA_OK) {
+        return listen_err;
+    }
+#endif
+
+    /* Fork worker processes */
+    process_error_t proc_err = worker_manager_fork_workers(&infra->worker_manager);
+    if (proc_err != PROCESS_OK) {
+        return SERVER_INFRA_ERROR_STARTUP;
+    }
+
+    /* Parent supervises; workers, including restarted ones, serve */
+    if (worker_manager_get_type(&infra->worker_manager) == PROCESS_TYPE_PARENT) {
+        server_infrastructure_supervise(infra);
+    }
+    if (worker_manager_get_type(&infra->worker_manager) == PROCESS_TYPE_WORKER) {
+        server_infrastructure_run_worker(infra);
     }
 
     return SERVER_INFRA_OK;
@@ -206,19 +1204,51 @@ server_config_t server_infrastructure_default_config(void)
 
     server_config_t config = {
         .port = 2342,
-        .plaintext_response = "Hello, World!",
-        .json_message = "Hello, World!",
+        .backlog = SOMAXCONN,
+        .workers = 0,
+        /* Owned like values set later, which free what they replace */
+        .plaintext_response = system_strdup("Hello, World!"),
+        .json_message = system_strdup("Hello, World!"),
         .enable_date_headers = true,
         .enable_socket_optimizations = false,
+        .enable_http2 = true,
+        .enable_metrics = false,
+        .metrics_port = 9102,
+        .metrics_address = htonl(INADDR_LOOPBACK),
+        .trace_sample = 0,
+        .document_root = NULL,
+        .pool_high_water = POOL_DEFAULT_HIGH_WATER,
+        .response_cache_ttl_ms = 0,
+        .response_cache_size = 1024 * 1024,
+        .argv = NULL,
+        .drain_timeout_ms = 10000,
+        .skip_smt_siblings = false,
+        .irq_interface = NULL,
+        .idle_config = {
+            .mode = SERVER_IDLE_BLOCK,
+            .spin_us = 50,
+            .spin_rate = 5000,
+            .busy_poll_rate = 50000
+        },
+        .limits_config = {
+            .header_timeout_ms = 10000,
+            .idle_timeout_ms = 60000,
+            .keepalive_timeout_ms = 60000,
+            .max_requests = 0,
+            .max_connections = 0
+        },
         .socket_config = {
             .options = 0, /* No optimizations by default */
             .busy_poll_value = 50,
-            .keepalive_enabled = false
+            .keepalive_enabled = false,
+            .defer_accept_s = 1,
+            .fastopen_queue = 256
         },
         .worker_config = {
             .worker_count = worker_count,
             .cpu_ids = cpu_ids,
-            .enable_affinity = true
+            .enable_affinity = true,
+            .bind_memory = false
         },
         .signal_config = signal_manager_default_config()
     };
@@ -238,8 +1268,10 @@ core_status server_infrastructure_request_handler(core_event *event)
     server_context *context = (server_context *)event->data;
 
     if (event->type == SERVER_REQUEST) {
+        uint64_t start_ns = metrics_now_ns();
         log_info("Processing HTTP request for: %.*s", (int)context->request.target.size, (char*)context->request.target.base);
-        http_server_error_t http_err = http_server_handle_request(&infra->http_server, context);
+        http_server_error_t http_err = http_server_handle_request(infra->http_server, context);
+        metrics_observe_latency(start_ns);
         if (http_err != HTTP_SERVER_OK) {
             /* Log error and return error response */
             log_error("HTTP server error: %d", http_err);
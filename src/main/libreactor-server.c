@@ -7,32 +7,133 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <errno.h>
 
 #include "../../include/infrastructure/server_infrastructure.h"
+#include "../../include/infrastructure/server_config.h"
 #include "../../include/platform/log.h"
 
+static void print_usage(const char *program)
+{
+    printf("Usage: %s [OPTIONS]\n", program);
+    printf("Options:\n");
+    printf("  --config FILE          Read settings from FILE (\"name = value\" lines)\n");
+    printf("  --disable-log          Disable logging output\n");
+    server_config_print_usage(stdout);
+    printf("  --help, -h             Show this help message\n");
+    printf("Command-line settings override those from the config file.\n");
+}
+
+/** Command line, kept for rebuilding the configuration on SIGHUP */
+static int server_argc;
+static char **server_argv;
+static const char *server_config_path;
+static bool disable_logging;
+
+/**
+ * @brief Build the configuration from defaults, the config file and the command line
+ * @param[out] config Configuration to fill
+ * @return true on success; errors are printed
+ */
+static bool load_config(server_config_t *config)
+{
+    /* Get default configuration */
+    *config = server_infrastructure_default_config();
+
+    /* Defaults for the enhanced server, overridable below */
+    config->port = 2342;
+    config->enable_socket_optimizations = true;
+    config->socket_config.options = SOCKET_OPT_BUSY_POLL |
+                                    SOCKET_OPT_NODELAY |
+                                    SOCKET_OPT_KEEPALIVE |
+                                    SOCKET_OPT_REUSEPORT_CBPF |
+                                    SOCKET_OPT_DEFER_ACCEPT;
+    config->socket_config.busy_poll_value = 50;
+    config->socket_config.keepalive_enabled = false;
+    config->idle_config.mode = SERVER_IDLE_ADAPTIVE;
+    config->log_config.level = LOG_LEVEL_INFO;
+    config->log_config.pid = true;
+    config->log_config.timestamps = true;
+    config->log_config.colors = true;
+
+    /* Config file first, so the command line wins */
+    if (server_config_path) {
+        int line = 0;
+        server_config_error_t conf_err = server_config_load_file(config, server_config_path, &line);
+        if (conf_err != SERVER_CONFIG_OK) {
+            if (line > 0) {
+                fprintf(stderr, "%s:%d: %s\n", server_config_path, line, server_config_strerror(conf_err));
+            } else {
+                fprintf(stderr, "%s: %s\n", server_config_path, strerror(errno));
+            }
+            return false;
+        }
+    }
+
+    for (int i = 1; i < server_argc; i++) {
+        if (strcmp(server_argv[i], "--disable-log") == 0) {
+            continue;
+        }
+        if (strcmp(server_argv[i], "--config") == 0 && i + 1 < server_argc) {
+            i++;
+            continue;
+        }
+
+        const char *option = server_argv[i];
+        server_config_error_t conf_err = server_config_parse_option(config, server_argc, server_argv, &i);
+        if (conf_err == SERVER_CONFIG_ERROR_UNKNOWN_KEY) {
+            fprintf(stderr, "Unknown option: %s\n", option);
+            fprintf(stderr, "Use --help for usage information\n");
+            return false;
+        }
+        if (conf_err != SERVER_CONFIG_OK) {
+            fprintf(stderr, "%s: %s%s%s\n", option, server_config_strerror(conf_err),
+                    conf_err == SERVER_CONFIG_ERROR_INVALID_VALUE ? " " : "",
+                    conf_err == SERVER_CONFIG_ERROR_INVALID_VALUE ? server_argv[i] : "");
+            return false;
+        }
+    }
+
+    /* SIGUSR2 re-executes this command line and hands over the listeners */
+    config->argv = server_argv;
+    config->signal_config.handle_sigusr2 = true;
+
+    /* SIGHUP rebuilds the configuration and pushes it to the workers */
+    config->load_config = load_config;
+    config->signal_config.handle_sighup = true;
+
+    /* SIGUSR1 purges the response caches of all workers */
+    config->signal_config.handle_sigusr1 = true;
+
+    /* Configure enhanced logging */
+    if (disable_logging) {
+        config->log_config.level = 99; /* Disable all logging */
+        config->log_config.pid = false;
+        config->log_config.timestamps = false;
+        config->log_config.colors = false;
+    }
+
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     server_infra_error_t err;
-    bool disable_logging = false;
 
-    /* Parse command-line arguments */
+    /* Options that are not server settings */
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--disable-log") == 0) {
             disable_logging = true;
             is_logging_disabled = true;  /* Set global flag immediately */
+        } else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            server_config_path = argv[++i];
         } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
-            printf("Usage: %s [OPTIONS]\n", argv[0]);
-            printf("Options:\n");
-            printf("  --disable-log    Disable logging output\n");
-            printf("  --help, -h       Show this help message\n");
+            print_usage(argv[0]);
             return EXIT_SUCCESS;
-        } else {
-            fprintf(stderr, "Unknown option: %s\n", argv[i]);
-            fprintf(stderr, "Use --help for usage information\n");
-            return EXIT_FAILURE;
         }
     }
+    server_argc = argc;
+    server_argv = argv;
 
     /* Initialize server infrastructure */
     err = server_infrastructure_init();
@@ -41,30 +142,10 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    /* Get default configuration */
-    server_config_t config = server_infrastructure_default_config();
-
-    /* Configure for enhanced server */
-    config.port = 2342; /* Different port for enhanced server */
-    config.enable_socket_optimizations = true;
-    config.socket_config.options = SOCKET_OPT_BUSY_POLL |
-                                   SOCKET_OPT_NODELAY |
-                                   SOCKET_OPT_KEEPALIVE |
-                                   SOCKET_OPT_REUSEPORT_CBPF;
-    config.socket_config.busy_poll_value = 50;
-    config.socket_config.keepalive_enabled = false;
-
-    /* Configure enhanced logging */
-    if (disable_logging) {
-        config.log_config.level = 99; /* Disable all logging */
-        config.log_config.pid = false;
-        config.log_config.timestamps = false;
-        config.log_config.colors = false;
-    } else {
-    config.log_config.level = LOG_LEVEL_INFO;
-    config.log_config.pid = true;
-    config.log_config.timestamps = true;
-    config.log_config.colors = true;
+    server_config_t config;
+    if (!load_config(&config)) {
+        server_infrastructure_cleanup();
+        return EXIT_FAILURE;
     }
 
     /* Create server infrastructure */
@@ -78,7 +159,7 @@ int main(int argc, char *argv[])
 
     log_info("Starting enhanced libreactor-server with socket optimizations");
     log_info("Server will listen on port %d with %d worker processes",
-             config.port, config.worker_config.worker_count);
+             config.port, infra.config.worker_config.worker_count);
 
     /* Start server (this will fork workers and start listening) */
     err = server_infrastructure_start(&infra);
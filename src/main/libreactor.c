@@ -17,17 +17,19 @@ static core_status simple_server_handler(core_event *event)
     if (event->type == SERVER_REQUEST){
         log_info("Processing HTTP request for: %.*s", (int)context->request.target.size, (char*)context->request.target.base);
 
-        if (segment_equal(context->request.target, segment_string("/plaintext"))){
-            log_debug("Serving plaintext response");
-            server_ok(context, segment_string("text/plain"), segment_string("Hello, World!"));
-        }
-        else if (segment_equal(context->request.target, segment_string("/json"))){
-            log_debug("Serving JSON response");
-            server_ok(context, segment_string("application/json"), segment_string("{\"message\":\"Hello, World!\"}"));
-        }
-        else{
-            log_debug("Serving 404 for unknown route");
-            server_ok(context, segment_string("text/plain"), segment_string("Not Found"));
+        switch (http_server_parse_route(&context->request.method, &context->request.target)) {
+            case ROUTE_PLAINTEXT:
+                log_debug("Serving plaintext response");
+                server_ok(context, segment_string("text/plain"), segment_string("Hello, World!"));
+                break;
+            case ROUTE_JSON:
+                log_debug("Serving JSON response");
+                server_ok(context, segment_string("application/json"), segment_string("{\"message\":\"Hello, World!\"}"));
+                break;
+            default:
+                log_debug("Serving 404 for unknown route");
+                server_ok(context, segment_string("text/plain"), segment_string("Not Found"));
+                break;
         }
         return CORE_OK;
     }
@@ -42,6 +44,11 @@ int main(void)
 {
     log_info("Starting simple test server on port 2342");
 
+    if (http_server_init() != HTTP_SERVER_OK) {
+        log_error("Failed to initialize HTTP router");
+        return EXIT_FAILURE;
+    }
+
     core_construct(NULL);
 
     server s;
@@ -0,0 +1,112 @@
+/**
+ * @file control_channel.c
+ * @brief Implementation of parent-to-worker control messages
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+#include "../../include/platform/control_channel.h"
+
+#define CONTROL_CHANNEL_MASK (CONTROL_CHANNEL_SLOTS - 1)
+
+control_channel_error_t control_channel_create(control_channel_t *channel)
+{
+    if (!channel) {
+        return CONTROL_CHANNEL_ERROR_INVALID_PARAM;
+    }
+
+    channel->ring = NULL;
+    channel->doorbell = -1;
+
+    void *region = mmap(NULL, sizeof(control_channel_ring_t), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return CONTROL_CHANNEL_ERROR_MEMORY;
+    }
+
+    int doorbell = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (doorbell == -1) {
+        munmap(region, sizeof(control_channel_ring_t));
+        return CONTROL_CHANNEL_ERROR_EVENTFD;
+    }
+
+    channel->ring = region;
+    channel->doorbell = doorbell;
+    return CONTROL_CHANNEL_OK;
+}
+
+void control_channel_destroy(control_channel_t *channel)
+{
+    /* Zeroed channels were never created and own no descriptor */
+    if (!channel || !channel->ring) {
+        return;
+    }
+
+    munmap(channel->ring, sizeof(control_channel_ring_t));
+    close(channel->doorbell);
+    channel->ring = NULL;
+    channel->doorbell = -1;
+}
+
+void control_channel_reset(control_channel_t *channel)
+{
+    if (!channel || !channel->ring) {
+        return;
+    }
+
+    control_channel_clear(channel);
+    __atomic_store_n(&channel->ring->tail, __atomic_load_n(&channel->ring->head, __ATOMIC_RELAXED),
+                     __ATOMIC_RELEASE);
+}
+
+control_channel_error_t control_channel_send(control_channel_t *channel, const control_message_t *message)
+{
+    if (!channel || !channel->ring || !message || message->length > CONTROL_CHANNEL_PAYLOAD) {
+        return CONTROL_CHANNEL_ERROR_INVALID_PARAM;
+    }
+
+    control_channel_ring_t *ring = channel->ring;
+    uint64_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == CONTROL_CHANNEL_SLOTS) {
+        return CONTROL_CHANNEL_ERROR_FULL;
+    }
+
+    /* Publish the slot before the head that makes it visible */
+    ring->slots[head & CONTROL_CHANNEL_MASK] = *message;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    if (eventfd_write(channel->doorbell, 1) == -1) {
+        return CONTROL_CHANNEL_ERROR_EVENTFD;
+    }
+    return CONTROL_CHANNEL_OK;
+}
+
+void control_channel_clear(control_channel_t *channel)
+{
+    eventfd_t value;
+
+    if (channel && channel->doorbell >= 0) {
+        (void)eventfd_read(channel->doorbell, &value);
+    }
+}
+
+bool control_channel_receive(control_channel_t *channel, control_message_t *message)
+{
+    if (!channel || !channel->ring || !message) {
+        return false;
+    }
+
+    control_channel_ring_t *ring = channel->ring;
+    uint64_t tail = ring->tail;
+    if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    /* Copy the slot out before handing it back to the parent */
+    *message = ring->slots[tail & CONTROL_CHANNEL_MASK];
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
@@ -0,0 +1,231 @@
+/**
+ * @file date_clock.c
+ * @brief Implementation of the shared HTTP Date clock
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../../include/platform/date_clock.h"
+
+/** Fallback page used before date_clock_init() and after cleanup */
+static date_clock_page_t local_page = {
+    .second = -1,
+    .date = "Thu, 01 Jan 1970 00:00:00 GMT"
+};
+
+date_clock_page_t *date_clock_page = &local_page;
+
+/** Writer thread, valid only in writer_pid */
+static pthread_t writer_thread;
+static pid_t writer_pid;
+
+void date_clock_format(int64_t second, char *out)
+{
+    static const char days[7][4] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static const char months[12][4] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                        "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+    time_t now = (time_t)second;
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    int year = tm.tm_year + 1900;
+
+    /* Fixed layout: "Www, DD Mmm YYYY HH:MM:SS GMT" */
+    memcpy(out, days[tm.tm_wday], 3);
+    out[3] = ',';
+    out[4] = ' ';
+    out[5] = (char)('0' + tm.tm_mday / 10);
+    out[6] = (char)('0' + tm.tm_mday % 10);
+    out[7] = ' ';
+    memcpy(out + 8, months[tm.tm_mon], 3);
+    out[11] = ' ';
+    out[12] = (char)('0' + year / 1000 % 10);
+    out[13] = (char)('0' + year / 100 % 10);
+    out[14] = (char)('0' + year / 10 % 10);
+    out[15] = (char)('0' + year % 10);
+    out[16] = ' ';
+    out[17] = (char)('0' + tm.tm_hour / 10);
+    out[18] = (char)('0' + tm.tm_hour % 10);
+    out[19] = ':';
+    out[20] = (char)('0' + tm.tm_min / 10);
+    out[21] = (char)('0' + tm.tm_min % 10);
+    out[22] = ':';
+    out[23] = (char)('0' + tm.tm_sec / 10);
+    out[24] = (char)('0' + tm.tm_sec % 10);
+    memcpy(out + 25, " GMT", 4);
+}
+
+/**
+ * @brief Read a run of decimal digits
+ * @return Value, -1 if a character is not a digit
+ */
+static int date_clock_digits(const char *text, size_t count)
+{
+    int value = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (text[i] < '0' || text[i] > '9') {
+            return -1;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return value;
+}
+
+bool date_clock_parse(const char *text, size_t length, int64_t *second)
+{
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+    if (!text || !second || length != DATE_CLOCK_LENGTH || text[3] != ',' || text[4] != ' ' ||
+        text[7] != ' ' || text[11] != ' ' || text[16] != ' ' || text[19] != ':' || text[22] != ':' ||
+        memcmp(text + 25, " GMT", 4) != 0) {
+        return false;
+    }
+
+    int month = -1;
+    for (int i = 0; i < 12; i++) {
+        if (memcmp(text + 8, months + i * 3, 3) == 0) {
+            month = i + 1;
+            break;
+        }
+    }
+    int day = date_clock_digits(text + 5, 2);
+    int year = date_clock_digits(text + 12, 4);
+    int hour = date_clock_digits(text + 17, 2);
+    int minute = date_clock_digits(text + 20, 2);
+    int sec = date_clock_digits(text + 23, 2);
+    if (month < 0 || day < 1 || day > 31 || year < 1970 || hour < 0 || hour > 23 ||
+        minute < 0 || minute > 59 || sec < 0 || sec > 60) {
+        return false;
+    }
+
+    /* Days from the civil date (Howard Hinnant's algorithm), March-based years */
+    int y = year - (month <= 2);
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+
+    *second = days * 86400 + hour * 3600 + minute * 60 + sec;
+    return true;
+}
+
+/**
+ * @brief Publish the date for a given second if it is not already current
+ */
+static void date_clock_publish(int64_t now)
+{
+    date_clock_page_t *page = date_clock_page;
+    if (now == __atomic_load_n(&page->second, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    char date[DATE_CLOCK_LENGTH];
+    date_clock_format(now, date);
+
+    /* Sequence lock: odd while the fields are inconsistent */
+    uint32_t sequence = page->sequence;
+    __atomic_store_n(&page->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(page->date, date, DATE_CLOCK_LENGTH);
+    __atomic_store_n(&page->second, now, __ATOMIC_RELAXED);
+    __atomic_store_n(&page->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void date_clock_update(void)
+{
+    date_clock_publish((int64_t)time(NULL));
+}
+
+date_clock_error_t date_clock_init(void)
+{
+    if (date_clock_page != &local_page) {
+        return DATE_CLOCK_OK;
+    }
+
+    void *region = mmap(NULL, sizeof(date_clock_page_t), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return DATE_CLOCK_ERROR_MEMORY;
+    }
+
+    date_clock_page_t *page = region;
+    page->second = -1;
+    date_clock_page = page;
+    date_clock_update();
+
+    return DATE_CLOCK_OK;
+}
+
+/**
+ * @brief Writer thread: republish just after every second boundary
+ */
+static void *date_clock_writer_main(void *arg)
+{
+    (void)arg;
+
+    for (;;) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        struct timespec next = { .tv_sec = now.tv_sec + 1, .tv_nsec = 0 };
+
+        /* Cancellation point; holds no locks while sleeping */
+        if (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &next, NULL) == 0) {
+            /* time() may still report the old second right at the boundary */
+            date_clock_publish((int64_t)next.tv_sec);
+        } else {
+            date_clock_update();
+        }
+    }
+
+    return NULL;
+}
+
+date_clock_error_t date_clock_start(void)
+{
+    if (writer_pid == getpid()) {
+        return DATE_CLOCK_OK;
+    }
+
+    date_clock_update();
+
+    /* Signals go to the threads that wait for them, never to the writer */
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int err = pthread_create(&writer_thread, NULL, date_clock_writer_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    if (err != 0) {
+        return DATE_CLOCK_ERROR_THREAD;
+    }
+
+    writer_pid = getpid();
+    __atomic_store_n(&date_clock_page->writer_active, 1, __ATOMIC_RELEASE);
+    return DATE_CLOCK_OK;
+}
+
+void date_clock_cleanup(void)
+{
+    date_clock_page_t *page = date_clock_page;
+
+    if (writer_pid == getpid()) {
+        pthread_cancel(writer_thread);
+        pthread_join(writer_thread, NULL);
+        writer_pid = 0;
+        __atomic_store_n(&page->writer_active, 0, __ATOMIC_RELEASE);
+    }
+
+    if (page != &local_page) {
+        /* Keep readers working on a private copy after the unmap */
+        local_page = *page;
+        local_page.writer_active = 0;
+        date_clock_page = &local_page;
+        munmap(page, sizeof(*page));
+    }
+}
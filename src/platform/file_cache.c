@@ -0,0 +1,388 @@
+/**
+ * @file file_cache.c
+ * @brief Implementation of the static file cache
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+
+#include "../../include/platform/file_cache.h"
+#include "../../include/platform/system.h"
+#include "../../include/platform/date_clock.h"
+
+/** Appended to paths naming a directory */
+static const char index_name[] = "index.html";
+
+file_cache_error_t file_cache_init(file_cache_t *cache, const char *root,
+                                   size_t memory_limit, unsigned max_entries)
+{
+    if (!cache || !root || max_entries == 0) {
+        return FILE_CACHE_ERROR_INVALID_PARAM;
+    }
+
+    memset(cache, 0, sizeof(*cache));
+    cache->root_fd = -1;
+
+    unsigned bucket_count = 16;
+    while (bucket_count < max_entries) {
+        bucket_count <<= 1;
+    }
+
+    cache->buckets = system_malloc(bucket_count * sizeof(*cache->buckets));
+    if (!cache->buckets) {
+        return FILE_CACHE_ERROR_MEMORY;
+    }
+    memset(cache->buckets, 0, bucket_count * sizeof(*cache->buckets));
+
+    cache->root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cache->root_fd == -1) {
+        system_free(cache->buckets);
+        cache->buckets = NULL;
+        return FILE_CACHE_ERROR_IO;
+    }
+
+    cache->bucket_count = bucket_count;
+    cache->memory_limit = memory_limit;
+    cache->max_entries = max_entries;
+    return FILE_CACHE_OK;
+}
+
+/**
+ * @brief Free an entry whose last reference is gone
+ */
+static void file_cache_entry_free(file_cache_entry_t *entry)
+{
+    system_free(entry->data);
+    if (entry->fd >= 0) {
+        close(entry->fd);
+    }
+    system_free(entry->path);
+    system_free(entry);
+}
+
+void file_cache_release(void *arg)
+{
+    file_cache_entry_t *entry = arg;
+    if (entry && --entry->refs == 0) {
+        file_cache_entry_free(entry);
+    }
+}
+
+/**
+ * @brief Remove an entry from its chain and drop the table's reference
+ */
+static void file_cache_unlink(file_cache_t *cache, file_cache_entry_t *entry)
+{
+    file_cache_entry_t **link = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+    while (*link && *link != entry) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = entry->next;
+        entry->next = NULL;
+        cache->count--;
+        file_cache_release(entry);
+    }
+}
+
+void file_cache_cleanup(file_cache_t *cache)
+{
+    if (!cache) {
+        return;
+    }
+
+    for (unsigned i = 0; i < cache->bucket_count; i++) {
+        while (cache->buckets[i]) {
+            file_cache_unlink(cache, cache->buckets[i]);
+        }
+    }
+
+    system_free(cache->buckets);
+    if (cache->root_fd >= 0) {
+        close(cache->root_fd);
+    }
+
+    memset(cache, 0, sizeof(*cache));
+    cache->root_fd = -1;
+}
+
+static inline int file_cache_hex(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+/**
+ * @brief Turn a request path into a root-relative file name
+ * @return Length written to out, 0 if the path is not allowed
+ * @note Percent-escapes are decoded first; an escaped '/' or NUL is refused
+ *       rather than reinterpreted, and "." or ".." are refused after decoding
+ */
+static size_t file_cache_normalize(const char *path, size_t length, char *out, size_t size)
+{
+    if (length == 0 || path[0] != '/' || length + sizeof(index_name) > size) {
+        return 0;
+    }
+
+    size_t used = 0;
+    for (size_t i = 1; i < length; i++) {
+        char c = path[i];
+        if (c == '%') {
+            int high = i + 2 < length ? file_cache_hex(path[i + 1]) : -1;
+            int low = high >= 0 ? file_cache_hex(path[i + 2]) : -1;
+            if (low < 0) {
+                return 0;
+            }
+            c = (char)(high << 4 | low);
+            if (c == '/') {
+                return 0;
+            }
+            i += 2;
+        }
+        if (c == '\0') {
+            return 0;
+        }
+        out[used++] = c;
+    }
+
+    /* Reject "." and ".." components outright; openat2 also stays beneath the root */
+    for (size_t i = 0; i <= used; ) {
+        size_t start = i;
+        while (i < used && out[i] != '/') {
+            i++;
+        }
+        size_t component = i - start;
+        if ((component == 1 && out[start] == '.') ||
+            (component == 2 && out[start] == '.' && out[start + 1] == '.')) {
+            return 0;
+        }
+        i++;
+    }
+
+    if (used == 0 || out[used - 1] == '/') {
+        memcpy(out + used, index_name, sizeof(index_name) - 1);
+        used += sizeof(index_name) - 1;
+    }
+    out[used] = '\0';
+    return used;
+}
+
+static uint64_t file_cache_hash(const char *path, size_t length)
+{
+    /* FNV-1a */
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Open a file beneath the root, refusing escapes through symlinks
+ * @note O_NONBLOCK keeps a FIFO or device from blocking the worker before
+ *       the caller's file type check turns it down
+ */
+static int file_cache_open_beneath(int root_fd, const char *name)
+{
+    struct open_how how = {
+        .flags = O_RDONLY | O_CLOEXEC | O_NONBLOCK | O_NOCTTY,
+        .resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS
+    };
+
+    int fd = (int)syscall(SYS_openat2, root_fd, name, &how, sizeof(how));
+    if (fd == -1 && errno == ENOSYS) {
+        /* Pre-5.6 kernels: components were already checked for ".." */
+        fd = openat(root_fd, name, O_RDONLY | O_CLOEXEC | O_NONBLOCK | O_NOCTTY | O_NOFOLLOW);
+    }
+    return fd;
+}
+
+/**
+ * @brief Read a whole file into memory
+ * @return Contents, NULL if the read failed or the file changed size
+ */
+static char *file_cache_read(int fd, size_t size)
+{
+    char *data = system_malloc(size);
+    if (!data) {
+        return NULL;
+    }
+
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, data + done, size - done, (off_t)done);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            system_free(data);
+            return NULL;
+        }
+        done += (size_t)n;
+    }
+    return data;
+}
+
+static inline bool file_cache_stat_matches(const file_cache_entry_t *entry, const struct stat *st)
+{
+    return entry->dev == st->st_dev && entry->ino == st->st_ino &&
+           entry->size == (size_t)st->st_size &&
+           entry->mtime == (int64_t)st->st_mtim.tv_sec &&
+           entry->mtime_nsec == (int64_t)st->st_mtim.tv_nsec;
+}
+
+/**
+ * @brief Open and describe a file; the returned entry holds one reference
+ */
+static file_cache_error_t file_cache_load(file_cache_t *cache, const char *name, size_t length,
+                                          uint64_t hash, file_cache_entry_t **out)
+{
+    int fd = file_cache_open_beneath(cache->root_fd, name);
+    if (fd == -1) {
+        return errno == ENOENT || errno == ENOTDIR || errno == EXDEV || errno == ELOOP ||
+               errno == EACCES ? FILE_CACHE_ERROR_NOT_FOUND : FILE_CACHE_ERROR_IO;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return FILE_CACHE_ERROR_NOT_FOUND;
+    }
+
+    file_cache_entry_t *entry = system_malloc(sizeof(*entry));
+    char *key = system_malloc(length + 1);
+    if (!entry || !key) {
+        system_free(entry);
+        system_free(key);
+        close(fd);
+        return FILE_CACHE_ERROR_MEMORY;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    memcpy(key, name, length + 1);
+    entry->path = key;
+    entry->path_length = length;
+    entry->hash = hash;
+    entry->fd = fd;
+    entry->size = (size_t)st.st_size;
+    entry->mtime = (int64_t)st.st_mtim.tv_sec;
+    entry->mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->headers_date_offset = (size_t)-1;
+    entry->checked_second = date_clock_poll();
+    entry->refs = 1;
+
+    int n = snprintf(entry->etag, sizeof(entry->etag), "\"%llx-%llx.%08llx\"",
+                     (unsigned long long)entry->size, (unsigned long long)entry->mtime,
+                     (unsigned long long)entry->mtime_nsec);
+    entry->etag_length = n > 0 && (size_t)n < sizeof(entry->etag) ? (size_t)n : 0;
+
+    /*
+     * Small files are copied rather than mapped: a mapping of a file that is
+     * truncated meanwhile faults with SIGBUS when touched, a copy stays whole
+     * until revalidation replaces it. Larger files are spliced from fd.
+     */
+    if (entry->size > 0 && entry->size <= cache->memory_limit) {
+        entry->data = file_cache_read(fd, entry->size);
+        if (!entry->data) {
+            file_cache_entry_free(entry);
+            return FILE_CACHE_ERROR_IO;
+        }
+    }
+
+    *out = entry;
+    return FILE_CACHE_OK;
+}
+
+/**
+ * @brief Drop one entry nobody else references, sweeping buckets in order
+ * @return True if room was made
+ */
+static bool file_cache_evict_one(file_cache_t *cache)
+{
+    for (unsigned scanned = 0; scanned < cache->bucket_count; scanned++) {
+        unsigned bucket = cache->clock_hand++ & (cache->bucket_count - 1);
+        for (file_cache_entry_t *entry = cache->buckets[bucket]; entry; entry = entry->next) {
+            if (entry->refs == 1) {
+                file_cache_unlink(cache, entry);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+file_cache_error_t file_cache_acquire(file_cache_t *cache, const char *path, size_t length,
+                                      file_cache_entry_t **entry)
+{
+    if (!cache || !path || !entry || cache->root_fd < 0) {
+        return FILE_CACHE_ERROR_INVALID_PARAM;
+    }
+
+    char name[FILE_CACHE_MAX_PATH];
+    size_t name_length = file_cache_normalize(path, length, name, sizeof(name));
+    if (name_length == 0) {
+        return FILE_CACHE_ERROR_NOT_FOUND;
+    }
+
+    uint64_t hash = file_cache_hash(name, name_length);
+    file_cache_entry_t *found = cache->buckets[hash & (cache->bucket_count - 1)];
+    while (found && (found->hash != hash || found->path_length != name_length ||
+                     memcmp(found->path, name, name_length) != 0)) {
+        found = found->next;
+    }
+
+    if (found) {
+        /* Revalidate at most once per second */
+        int64_t second = date_clock_poll();
+        if (found->checked_second == second) {
+            found->refs++;
+            *entry = found;
+            return FILE_CACHE_OK;
+        }
+
+        struct stat st;
+        if (fstatat(cache->root_fd, name, &st, 0) == 0 &&
+            file_cache_stat_matches(found, &st)) {
+            found->checked_second = second;
+            found->refs++;
+            *entry = found;
+            return FILE_CACHE_OK;
+        }
+
+        /* Changed or gone: in-flight sends keep the old copy alive */
+        file_cache_unlink(cache, found);
+    }
+
+    file_cache_entry_t *loaded = NULL;
+    file_cache_error_t err = file_cache_load(cache, name, name_length, hash, &loaded);
+    if (err != FILE_CACHE_OK) {
+        return err;
+    }
+
+    if (cache->count < cache->max_entries || file_cache_evict_one(cache)) {
+        file_cache_entry_t **bucket = &cache->buckets[hash & (cache->bucket_count - 1)];
+        loaded->next = *bucket;
+        *bucket = loaded;
+        cache->count++;
+        loaded->refs++;
+    }
+
+    /* Uncached when full of referenced entries: freed on the caller's release */
+    *entry = loaded;
+    return FILE_CACHE_OK;
+}
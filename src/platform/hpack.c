@@ -0,0 +1,506 @@
+/**
+ * @file hpack.c
+ * @brief Implementation of HPACK header compression
+ */
+
+#include <string.h>
+
+#include "../../include/platform/hpack.h"
+#include "../../include/platform/system.h"
+
+/** Longest Huffman code */
+#define HPACK_HUFFMAN_MAX_BITS 30
+
+/** Per-entry overhead counted against the table size */
+#define HPACK_ENTRY_OVERHEAD 32
+
+/** Largest integer accepted from a peer */
+#define HPACK_INTEGER_LIMIT UINT32_MAX
+
+/** Static table entry */
+typedef struct {
+    const char *name;
+    size_t name_length;
+    const char *value;
+    size_t value_length;
+} hpack_static_entry_t;
+
+#define HPACK_STATIC(name, value) { name, sizeof(name) - 1, value, sizeof(value) - 1 }
+
+static const hpack_static_entry_t hpack_static_table[HPACK_STATIC_ENTRIES + 1] = {
+    { NULL, 0, NULL, 0 },
+    HPACK_STATIC(":authority", ""),
+    HPACK_STATIC(":method", "GET"),
+    HPACK_STATIC(":method", "POST"),
+    HPACK_STATIC(":path", "/"),
+    HPACK_STATIC(":path", "/index.html"),
+    HPACK_STATIC(":scheme", "http"),
+    HPACK_STATIC(":scheme", "https"),
+    HPACK_STATIC(":status", "200"),
+    HPACK_STATIC(":status", "204"),
+    HPACK_STATIC(":status", "206"),
+    HPACK_STATIC(":status", "304"),
+    HPACK_STATIC(":status", "400"),
+    HPACK_STATIC(":status", "404"),
+    HPACK_STATIC(":status", "500"),
+    HPACK_STATIC("accept-charset", ""),
+    HPACK_STATIC("accept-encoding", "gzip, deflate"),
+    HPACK_STATIC("accept-language", ""),
+    HPACK_STATIC("accept-ranges", ""),
+    HPACK_STATIC("accept", ""),
+    HPACK_STATIC("access-control-allow-origin", ""),
+    HPACK_STATIC("age", ""),
+    HPACK_STATIC("allow", ""),
+    HPACK_STATIC("authorization", ""),
+    HPACK_STATIC("cache-control", ""),
+    HPACK_STATIC("content-disposition", ""),
+    HPACK_STATIC("content-encoding", ""),
+    HPACK_STATIC("content-language", ""),
+    HPACK_STATIC("content-length", ""),
+    HPACK_STATIC("content-location", ""),
+    HPACK_STATIC("content-range", ""),
+    HPACK_STATIC("content-type", ""),
+    HPACK_STATIC("cookie", ""),
+    HPACK_STATIC("date", ""),
+    HPACK_STATIC("etag", ""),
+    HPACK_STATIC("expect", ""),
+    HPACK_STATIC("expires", ""),
+    HPACK_STATIC("from", ""),
+    HPACK_STATIC("host", ""),
+    HPACK_STATIC("if-match", ""),
+    HPACK_STATIC("if-modified-since", ""),
+    HPACK_STATIC("if-none-match", ""),
+    HPACK_STATIC("if-range", ""),
+    HPACK_STATIC("if-unmodified-since", ""),
+    HPACK_STATIC("last-modified", ""),
+    HPACK_STATIC("link", ""),
+    HPACK_STATIC("location", ""),
+    HPACK_STATIC("max-forwards", ""),
+    HPACK_STATIC("proxy-authenticate", ""),
+    HPACK_STATIC("proxy-authorization", ""),
+    HPACK_STATIC("range", ""),
+    HPACK_STATIC("referer", ""),
+    HPACK_STATIC("refresh", ""),
+    HPACK_STATIC("retry-after", ""),
+    HPACK_STATIC("server", ""),
+    HPACK_STATIC("set-cookie", ""),
+    HPACK_STATIC("strict-transport-security", ""),
+    HPACK_STATIC("transfer-encoding", ""),
+    HPACK_STATIC("user-agent", ""),
+    HPACK_STATIC("vary", ""),
+    HPACK_STATIC("via", ""),
+    HPACK_STATIC("www-authenticate", ""),
+};
+
+static const uint8_t hpack_huffman_counts[HPACK_HUFFMAN_MAX_BITS + 1] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3, 0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4
+};
+
+static const uint16_t hpack_huffman_symbols[257] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+    52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+    110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+    77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+    119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+    43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+    179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+    163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+    158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+    144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+    212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+    2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22,
+    256,
+};
+
+/**
+ * @brief Decode an integer with an N-bit prefix
+ * @return false if it is truncated or too large
+ */
+static bool hpack_decode_integer(const uint8_t **cursor, const uint8_t *end, unsigned prefix_bits,
+                                 uint64_t *value)
+{
+    const uint8_t *p = *cursor;
+    uint64_t mask = (1u << prefix_bits) - 1;
+    uint64_t result = *p++ & mask;
+
+    if (result == mask) {
+        unsigned shift = 0;
+        uint8_t b;
+        do {
+            if (p == end || shift > 28) {
+                return false;
+            }
+            b = *p++;
+            result += (uint64_t)(b & 0x7f) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        if (result > HPACK_INTEGER_LIMIT) {
+            return false;
+        }
+    }
+
+    *cursor = p;
+    *value = result;
+    return true;
+}
+
+/**
+ * @brief Decode a Huffman-coded string
+ * @return Bytes written, (size_t)-1 if malformed, (size_t)-2 if out is too small
+ */
+static size_t hpack_huffman_decode(const uint8_t *in, size_t length, char *out, size_t space)
+{
+    /* Canonical decoding: codes of one length are consecutive and ordered by symbol */
+    uint32_t code = 0, first = 0;
+    unsigned index = 0, bits = 0;
+    bool ones = true;
+    size_t used = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        for (int shift = 7; shift >= 0; shift--) {
+            unsigned bit = (in[i] >> shift) & 1;
+            code |= bit;
+            ones = ones && bit;
+            bits++;
+
+            unsigned count = hpack_huffman_counts[bits];
+            if (code - first < count) {
+                unsigned symbol = hpack_huffman_symbols[index + code - first];
+                if (symbol == 256) {
+                    return (size_t)-1;
+                }
+                if (used == space) {
+                    return (size_t)-2;
+                }
+                out[used++] = (char)symbol;
+                code = first = 0;
+                index = bits = 0;
+                ones = true;
+                continue;
+            }
+
+            if (bits == HPACK_HUFFMAN_MAX_BITS) {
+                return (size_t)-1;
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+    }
+
+    /* Padding is the most significant bits of EOS: fewer than 8, all ones */
+    if (bits > 7 || !ones) {
+        return (size_t)-1;
+    }
+    return used;
+}
+
+/** Scratch space left for decoded strings */
+typedef struct {
+    char *data;
+    size_t size;
+    size_t used;
+} hpack_scratch_t;
+
+/**
+ * @brief Decode a string literal
+ */
+static hpack_error_t hpack_decode_string(const uint8_t **cursor, const uint8_t *end, hpack_scratch_t *scratch,
+                                         const char **string, size_t *length)
+{
+    const uint8_t *p = *cursor;
+    bool huffman = *p & 0x80;
+    uint64_t size;
+    if (!hpack_decode_integer(&p, end, 7, &size) || size > (uint64_t)(end - p)) {
+        return HPACK_ERROR_MALFORMED;
+    }
+
+    if (!huffman) {
+        *string = (const char *)p;
+        *length = (size_t)size;
+    } else {
+        char *out = scratch->data + scratch->used;
+        size_t written = hpack_huffman_decode(p, (size_t)size, out, scratch->size - scratch->used);
+        if (written == (size_t)-1) {
+            return HPACK_ERROR_MALFORMED;
+        }
+        if (written == (size_t)-2) {
+            return HPACK_ERROR_TOO_LARGE;
+        }
+        scratch->used += written;
+        *string = out;
+        *length = written;
+    }
+
+    *cursor = p + size;
+    return HPACK_OK;
+}
+
+/**
+ * @brief Copy bytes that may move into scratch
+ */
+static const char *hpack_scratch_copy(hpack_scratch_t *scratch, const char *data, size_t length)
+{
+    if (scratch->size - scratch->used < length) {
+        return NULL;
+    }
+    char *copy = scratch->data + scratch->used;
+    memcpy(copy, data, length);
+    scratch->used += length;
+    return copy;
+}
+
+/**
+ * @brief Resolve a static or dynamic index
+ * @note Dynamic entries are copied, a later insertion may move or evict them
+ */
+static hpack_error_t hpack_lookup(const hpack_decoder_t *decoder, uint64_t index, hpack_scratch_t *scratch,
+                                  hpack_field_t *field)
+{
+    if (index == 0) {
+        return HPACK_ERROR_MALFORMED;
+    }
+    if (index <= HPACK_STATIC_ENTRIES) {
+        const hpack_static_entry_t *entry = &hpack_static_table[index];
+        *field = (hpack_field_t){ entry->name, entry->name_length, entry->value, entry->value_length };
+        return HPACK_OK;
+    }
+
+    uint64_t age = index - HPACK_STATIC_ENTRIES - 1;
+    if (age >= decoder->count) {
+        return HPACK_ERROR_MALFORMED;
+    }
+
+    /* Index 62 is the newest entry */
+    const hpack_entry_t *entry =
+        &decoder->entries[(decoder->first + decoder->count - 1 - age) & (decoder->entry_capacity - 1)];
+    const char *name = decoder->data + entry->offset;
+    field->name = hpack_scratch_copy(scratch, name, entry->name_length);
+    field->value = hpack_scratch_copy(scratch, name + entry->name_length, entry->value_length);
+    if (!field->name || !field->value) {
+        return HPACK_ERROR_TOO_LARGE;
+    }
+    field->name_length = entry->name_length;
+    field->value_length = entry->value_length;
+    return HPACK_OK;
+}
+
+static void hpack_evict(hpack_decoder_t *decoder)
+{
+    const hpack_entry_t *entry = &decoder->entries[decoder->first];
+    decoder->size -= entry->name_length + entry->value_length + HPACK_ENTRY_OVERHEAD;
+    decoder->data_start = entry->offset + entry->name_length + entry->value_length;
+    decoder->first = (decoder->first + 1) & (decoder->entry_capacity - 1);
+    decoder->count--;
+    if (decoder->count == 0) {
+        decoder->data_start = decoder->data_end = 0;
+    }
+}
+
+static void hpack_shrink(hpack_decoder_t *decoder, size_t max_size)
+{
+    while (decoder->size > max_size) {
+        hpack_evict(decoder);
+    }
+}
+
+/**
+ * @brief Add a field as the newest dynamic entry
+ */
+static void hpack_insert(hpack_decoder_t *decoder, const hpack_field_t *field)
+{
+    size_t size = field->name_length + field->value_length + HPACK_ENTRY_OVERHEAD;
+    if (size > decoder->max_size) {
+        /* Not an error: the table just ends up empty */
+        hpack_shrink(decoder, 0);
+        return;
+    }
+    hpack_shrink(decoder, decoder->max_size - size);
+
+    size_t bytes = field->name_length + field->value_length;
+    if (decoder->data_end + bytes > decoder->data_capacity) {
+        /* Live bytes are below max_size, so at least max_size is free afterwards */
+        size_t shift = decoder->data_start;
+        memmove(decoder->data, decoder->data + shift, decoder->data_end - shift);
+        for (size_t i = 0; i < decoder->count; i++) {
+            decoder->entries[(decoder->first + i) & (decoder->entry_capacity - 1)].offset -= (uint32_t)shift;
+        }
+        decoder->data_start = 0;
+        decoder->data_end -= shift;
+    }
+
+    hpack_entry_t *entry = &decoder->entries[(decoder->first + decoder->count) & (decoder->entry_capacity - 1)];
+    entry->offset = (uint32_t)decoder->data_end;
+    entry->name_length = (uint32_t)field->name_length;
+    entry->value_length = (uint32_t)field->value_length;
+    memcpy(decoder->data + decoder->data_end, field->name, field->name_length);
+    memcpy(decoder->data + decoder->data_end + field->name_length, field->value, field->value_length);
+    decoder->data_end += bytes;
+    decoder->size += size;
+    decoder->count++;
+}
+
+hpack_error_t hpack_decoder_init(hpack_decoder_t *decoder, size_t max_size)
+{
+    if (!decoder || max_size > UINT32_MAX / 4) {
+        return HPACK_ERROR_INVALID_PARAM;
+    }
+
+    memset(decoder, 0, sizeof(*decoder));
+
+    size_t entries = 1;
+    while (entries < max_size / HPACK_ENTRY_OVERHEAD + 1) {
+        entries <<= 1;
+    }
+
+    decoder->data_capacity = max_size * 2;
+    decoder->data = max_size > 0 ? system_malloc(decoder->data_capacity) : NULL;
+    decoder->entries = system_malloc(entries * sizeof(*decoder->entries));
+    if ((max_size > 0 && !decoder->data) || !decoder->entries) {
+        hpack_decoder_cleanup(decoder);
+        return HPACK_ERROR_MEMORY;
+    }
+
+    decoder->entry_capacity = entries;
+    decoder->max_size = max_size;
+    decoder->settings_size = max_size;
+    return HPACK_OK;
+}
+
+void hpack_decoder_cleanup(hpack_decoder_t *decoder)
+{
+    if (!decoder) {
+        return;
+    }
+    system_free(decoder->data);
+    system_free(decoder->entries);
+    memset(decoder, 0, sizeof(*decoder));
+}
+
+hpack_error_t hpack_decode(hpack_decoder_t *decoder, const uint8_t *block, size_t length,
+                           hpack_field_t *fields, size_t max_fields, size_t *count,
+                           char *scratch, size_t scratch_size)
+{
+    if (!decoder || (!block && length > 0) || !fields || !count || (!scratch && scratch_size > 0)) {
+        return HPACK_ERROR_INVALID_PARAM;
+    }
+
+    *count = 0;
+    hpack_scratch_t space = { scratch, scratch_size, 0 };
+    const uint8_t *p = block;
+    const uint8_t *end = block + length;
+
+    while (p < end) {
+        uint8_t first = *p;
+        uint64_t index;
+        hpack_field_t field;
+        hpack_error_t err;
+
+        if (first & 0x20 && !(first & 0xc0)) {
+            /* Dynamic table size update, only ahead of the first field */
+            if (*count > 0 || !hpack_decode_integer(&p, end, 5, &index) || index > decoder->settings_size) {
+                return HPACK_ERROR_MALFORMED;
+            }
+            decoder->max_size = (size_t)index;
+            hpack_shrink(decoder, decoder->max_size);
+            continue;
+        }
+
+        if (*count == max_fields) {
+            return HPACK_ERROR_TOO_LARGE;
+        }
+
+        if (first & 0x80) {
+            /* Indexed field */
+            if (!hpack_decode_integer(&p, end, 7, &index)) {
+                return HPACK_ERROR_MALFORMED;
+            }
+            err = hpack_lookup(decoder, index, &space, &field);
+            if (err != HPACK_OK) {
+                return err;
+            }
+        } else {
+            /* Literal: with incremental indexing (01), without (0000) or never indexed (0001) */
+            bool indexing = first & 0x40;
+            if (!hpack_decode_integer(&p, end, indexing ? 6 : 4, &index)) {
+                return HPACK_ERROR_MALFORMED;
+            }
+
+            if (index > 0) {
+                err = hpack_lookup(decoder, index, &space, &field);
+            } else if (p == end) {
+                err = HPACK_ERROR_MALFORMED;
+            } else {
+                err = hpack_decode_string(&p, end, &space, &field.name, &field.name_length);
+            }
+            if (err == HPACK_OK) {
+                err = p == end ? HPACK_ERROR_MALFORMED :
+                      hpack_decode_string(&p, end, &space, &field.value, &field.value_length);
+            }
+            if (err != HPACK_OK) {
+                return err;
+            }
+
+            if (indexing) {
+                hpack_insert(decoder, &field);
+            }
+        }
+
+        fields[(*count)++] = field;
+    }
+
+    return HPACK_OK;
+}
+
+size_t hpack_integer_size(uint64_t value, unsigned prefix_bits)
+{
+    uint64_t mask = (1u << prefix_bits) - 1;
+    if (value < mask) {
+        return 1;
+    }
+
+    size_t size = 2;
+    for (value -= mask; value >= 0x80; value >>= 7) {
+        size++;
+    }
+    return size;
+}
+
+size_t hpack_encode_integer(uint8_t *out, uint64_t value, unsigned prefix_bits, uint8_t flags)
+{
+    uint64_t mask = (1u << prefix_bits) - 1;
+    if (value < mask) {
+        out[0] = flags | (uint8_t)value;
+        return 1;
+    }
+
+    size_t used = 0;
+    out[used++] = flags | (uint8_t)mask;
+    for (value -= mask; value >= 0x80; value >>= 7) {
+        out[used++] = (uint8_t)(value | 0x80);
+    }
+    out[used++] = (uint8_t)value;
+    return used;
+}
+
+size_t hpack_encode_indexed(uint8_t *out, unsigned index)
+{
+    return hpack_encode_integer(out, index, 7, 0x80);
+}
+
+size_t hpack_literal_size(unsigned name_index, size_t length)
+{
+    return hpack_integer_size(name_index, 4) + hpack_integer_size(length, 7) + length;
+}
+
+size_t hpack_encode_literal(uint8_t *out, unsigned name_index, const char *value, size_t length)
+{
+    size_t used = hpack_encode_integer(out, name_index, 4, 0x00);
+    used += hpack_encode_integer(out + used, length, 7, 0x00);
+    memcpy(out + used, value, length);
+    return used + length;
+}
@@ -0,0 +1,579 @@
+/**
+ * @file http_parser.c
+ * @brief Implementation of the HTTP/1.x request parser
+ */
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../../include/platform/http_parser.h"
+
+#if HTTP_PARSER_SIMD && (defined(__x86_64__) || defined(__i386__))
+#define HTTP_PARSER_X86 1
+#include <immintrin.h>
+#elif HTTP_PARSER_SIMD && defined(__aarch64__)
+#define HTTP_PARSER_NEON 1
+#include <arm_neon.h>
+#endif
+
+/** Character classes, one bit each */
+enum {
+    CLASS_TOKEN  = 1,           /** tchar (RFC 9110): methods and header names */
+    CLASS_TARGET = 2,           /** Visible characters and obs-text: request target */
+    CLASS_VALUE  = 4            /** HTAB, SP, visible characters, obs-text: field values */
+};
+
+static const uint8_t char_classes[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    4, 7, 6, 7, 7, 7, 7, 7, 6, 6, 7, 7, 6, 7, 7, 6,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 6, 6, 6,
+    6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 7, 6, 7, 0,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6
+};
+
+#if HTTP_PARSER_X86 || HTTP_PARSER_NEON
+/*
+ * Token bitmap for nibble lookups: byte c is a tchar when
+ * token_low_nibble[c & 15] has bit (c >> 4) set. High nibbles 8-15 map to
+ * no bit, which rejects every byte >= 0x80.
+ */
+static const uint8_t token_low_nibble[16] = {
+    0xe8, 0xfc, 0xf8, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc,
+    0xf8, 0xf8, 0xf4, 0x54, 0xd0, 0x54, 0xf4, 0x70
+};
+
+static const uint8_t token_high_nibble[16] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+    0, 0, 0, 0, 0, 0, 0, 0
+};
+#endif
+
+/** Vector kernels; each returns the length of the matching prefix */
+typedef struct {
+    const char *name;
+    size_t (*find_header_end)(const uint8_t *data, size_t size);
+    size_t (*token_span)(const uint8_t *data, size_t size);
+    size_t (*target_span)(const uint8_t *data, size_t size);
+    size_t (*value_span)(const uint8_t *data, size_t size);
+} http_parser_kernels_t;
+
+/* ---- Scalar ------------------------------------------------------------ */
+
+static size_t scalar_find_header_end(const uint8_t *data, size_t size)
+{
+    const uint8_t *end = memmem(data, size, "\r\n\r\n", 4);
+    return end ? (size_t)(end - data) : size;
+}
+
+static inline size_t scalar_span(const uint8_t *data, size_t size, uint8_t class)
+{
+    size_t i = 0;
+    while (i < size && (char_classes[data[i]] & class)) {
+        i++;
+    }
+    return i;
+}
+
+static size_t scalar_token_span(const uint8_t *data, size_t size)
+{
+    return scalar_span(data, size, CLASS_TOKEN);
+}
+
+static size_t scalar_target_span(const uint8_t *data, size_t size)
+{
+    return scalar_span(data, size, CLASS_TARGET);
+}
+
+static size_t scalar_value_span(const uint8_t *data, size_t size)
+{
+    return scalar_span(data, size, CLASS_VALUE);
+}
+
+static const http_parser_kernels_t kernels_scalar = {
+    "scalar", scalar_find_header_end, scalar_token_span, scalar_target_span, scalar_value_span
+};
+
+/* ---- x86: AVX2 and SSE4.2 ---------------------------------------------- */
+
+#if HTTP_PARSER_X86
+
+__attribute__((target("avx2")))
+static size_t avx2_find_header_end(const uint8_t *data, size_t size)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    size_t i = 0;
+
+    /* Match CR LF CR LF at every offset of the block using four shifted loads */
+    for (; i + 32 + 3 <= size; i += 32) {
+        __m256i m0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i)), cr);
+        __m256i m1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i + 1)), lf);
+        __m256i m2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i + 2)), cr);
+        __m256i m3 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + i + 3)), lf);
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_and_si256(m0, m1), _mm256_and_si256(m2, m3)));
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return i + scalar_find_header_end(data + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_token_span(const uint8_t *data, size_t size)
+{
+    const __m256i low_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)token_low_nibble));
+    const __m256i high_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)token_high_nibble));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i low = _mm256_shuffle_epi8(low_table, _mm256_and_si256(v, nibble));
+        __m256i high = _mm256_shuffle_epi8(high_table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        __m256i bad = _mm256_cmpeq_epi8(_mm256_and_si256(low, high), _mm256_setzero_si256());
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(bad);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return i + scalar_token_span(data + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_target_span(const uint8_t *data, size_t size)
+{
+    const __m256i space = _mm256_set1_epi8(0x20);
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        /* Controls and SP (v <= 0x20 unsigned) or DEL end the target */
+        __m256i bad = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, space), v),
+                                      _mm256_cmpeq_epi8(v, del));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(bad);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return i + scalar_target_span(data + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_value_span(const uint8_t *data, size_t size)
+{
+    const __m256i control = _mm256_set1_epi8(0x1f);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        /* Controls other than HTAB, and DEL, end the value */
+        __m256i ctl = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab),
+                                          _mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v));
+        __m256i bad = _mm256_or_si256(ctl, _mm256_cmpeq_epi8(v, del));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(bad);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return i + scalar_value_span(data + i, size - i);
+}
+
+static const http_parser_kernels_t kernels_avx2 = {
+    "avx2", avx2_find_header_end, avx2_token_span, avx2_target_span, avx2_value_span
+};
+
+__attribute__((target("sse4.2")))
+static size_t sse42_find_header_end(const uint8_t *data, size_t size)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    size_t i = 0;
+
+    for (; i + 16 + 3 <= size; i += 16) {
+        __m128i m0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)), cr);
+        __m128i m1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + 1)), lf);
+        __m128i m2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + 2)), cr);
+        __m128i m3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i + 3)), lf);
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(m0, m1),
+                                                                  _mm_and_si128(m2, m3)));
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return i + scalar_find_header_end(data + i, size - i);
+}
+
+__attribute__((target("sse4.2")))
+static size_t sse42_token_span(const uint8_t *data, size_t size)
+{
+    const __m128i low_table = _mm_loadu_si128((const __m128i *)token_low_nibble);
+    const __m128i high_table = _mm_loadu_si128((const __m128i *)token_high_nibble);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i low = _mm_shuffle_epi8(low_table, _mm_and_si128(v, nibble));
+        __m128i high = _mm_shuffle_epi8(high_table, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        __m128i bad = _mm_cmpeq_epi8(_mm_and_si128(low, high), _mm_setzero_si128());
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(bad);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return i + scalar_token_span(data + i, size - i);
+}
+
+__attribute__((target("sse4.2")))
+static size_t sse42_target_span(const uint8_t *data, size_t size)
+{
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7f);
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i bad = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, space), v),
+                                   _mm_cmpeq_epi8(v, del));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(bad);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return i + scalar_target_span(data + i, size - i);
+}
+
+__attribute__((target("sse4.2")))
+static size_t sse42_value_span(const uint8_t *data, size_t size)
+{
+    const __m128i control = _mm_set1_epi8(0x1f);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i del = _mm_set1_epi8(0x7f);
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i ctl = _mm_andnot_si128(_mm_cmpeq_epi8(v, tab),
+                                       _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+        __m128i bad = _mm_or_si128(ctl, _mm_cmpeq_epi8(v, del));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(bad);
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return i + scalar_value_span(data + i, size - i);
+}
+
+static const http_parser_kernels_t kernels_sse42 = {
+    "sse4.2", sse42_find_header_end, sse42_token_span, sse42_target_span, sse42_value_span
+};
+
+#endif /* HTTP_PARSER_X86 */
+
+/* ---- AArch64: NEON ----------------------------------------------------- */
+
+#if HTTP_PARSER_NEON
+
+/** Four bits per input byte: nonzero nibble i marks a match at byte i */
+static inline uint64_t neon_mask(uint8x16_t match)
+{
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(match), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+static size_t neon_find_header_end(const uint8_t *data, size_t size)
+{
+    const uint8x16_t cr = vdupq_n_u8('\r');
+    const uint8x16_t lf = vdupq_n_u8('\n');
+    size_t i = 0;
+
+    for (; i + 16 + 3 <= size; i += 16) {
+        uint8x16_t m = vandq_u8(vandq_u8(vceqq_u8(vld1q_u8(data + i), cr),
+                                         vceqq_u8(vld1q_u8(data + i + 1), lf)),
+                                vandq_u8(vceqq_u8(vld1q_u8(data + i + 2), cr),
+                                         vceqq_u8(vld1q_u8(data + i + 3), lf)));
+        uint64_t mask = neon_mask(m);
+        if (mask) {
+            return i + (size_t)(__builtin_ctzll(mask) >> 2);
+        }
+    }
+
+    return i + scalar_find_header_end(data + i, size - i);
+}
+
+static size_t neon_token_span(const uint8_t *data, size_t size)
+{
+    const uint8x16_t low_table = vld1q_u8(token_low_nibble);
+    const uint8x16_t high_table = vld1q_u8(token_high_nibble);
+    const uint8x16_t nibble = vdupq_n_u8(0x0f);
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t v = vld1q_u8(data + i);
+        uint8x16_t low = vqtbl1q_u8(low_table, vandq_u8(v, nibble));
+        uint8x16_t high = vqtbl1q_u8(high_table, vshrq_n_u8(v, 4));
+        uint64_t mask = neon_mask(vceqq_u8(vandq_u8(low, high), vdupq_n_u8(0)));
+        if (mask) {
+            return i + (size_t)(__builtin_ctzll(mask) >> 2);
+        }
+    }
+
+    return i + scalar_token_span(data + i, size - i);
+}
+
+static size_t neon_target_span(const uint8_t *data, size_t size)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t v = vld1q_u8(data + i);
+        uint8x16_t bad = vorrq_u8(vcleq_u8(v, vdupq_n_u8(0x20)), vceqq_u8(v, vdupq_n_u8(0x7f)));
+        uint64_t mask = neon_mask(bad);
+        if (mask) {
+            return i + (size_t)(__builtin_ctzll(mask) >> 2);
+        }
+    }
+
+    return i + scalar_target_span(data + i, size - i);
+}
+
+static size_t neon_value_span(const uint8_t *data, size_t size)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t v = vld1q_u8(data + i);
+        uint8x16_t ctl = vbicq_u8(vcltq_u8(v, vdupq_n_u8(0x20)), vceqq_u8(v, vdupq_n_u8('\t')));
+        uint64_t mask = neon_mask(vorrq_u8(ctl, vceqq_u8(v, vdupq_n_u8(0x7f))));
+        if (mask) {
+            return i + (size_t)(__builtin_ctzll(mask) >> 2);
+        }
+    }
+
+    return i + scalar_value_span(data + i, size - i);
+}
+
+static const http_parser_kernels_t kernels_neon = {
+    "neon", neon_find_header_end, neon_token_span, neon_target_span, neon_value_span
+};
+
+#endif /* HTTP_PARSER_NEON */
+
+/* ---- Dispatch ---------------------------------------------------------- */
+
+static const http_parser_kernels_t *kernels = &kernels_scalar;
+
+void http_parser_init(void)
+{
+#if HTTP_PARSER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels = &kernels_avx2;
+        return;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        kernels = &kernels_sse42;
+        return;
+    }
+#elif HTTP_PARSER_NEON
+    /* Advanced SIMD is mandatory on AArch64 */
+    kernels = &kernels_neon;
+    return;
+#endif
+    kernels = &kernels_scalar;
+}
+
+http_parser_error_t http_parser_select(const char *name)
+{
+    if (!name) {
+        return HTTP_PARSER_ERROR_INVALID_PARAM;
+    }
+
+    if (strcmp(name, "scalar") == 0) {
+        kernels = &kernels_scalar;
+        return HTTP_PARSER_OK;
+    }
+#if HTTP_PARSER_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        kernels = &kernels_avx2;
+        return HTTP_PARSER_OK;
+    }
+    if (strcmp(name, "sse4.2") == 0 && __builtin_cpu_supports("sse4.2")) {
+        kernels = &kernels_sse42;
+        return HTTP_PARSER_OK;
+    }
+#elif HTTP_PARSER_NEON
+    if (strcmp(name, "neon") == 0) {
+        kernels = &kernels_neon;
+        return HTTP_PARSER_OK;
+    }
+#endif
+    return HTTP_PARSER_ERROR_UNSUPPORTED;
+}
+
+const char *http_parser_implementation(void)
+{
+    return kernels->name;
+}
+
+size_t http_parser_find_header_end(const char *data, size_t size)
+{
+    return kernels->find_header_end((const uint8_t *)data, size);
+}
+
+/* ---- Request parsing --------------------------------------------------- */
+
+static inline bool header_name_equal(const uint8_t *name, size_t length, const char *expected,
+                                     size_t expected_length)
+{
+    return length == expected_length && strncasecmp((const char *)name, expected, length) == 0;
+}
+
+http_parser_error_t http_parser_parse(const char *input, size_t size, http_parser_request_t *request)
+{
+    if (!input || !request) {
+        return HTTP_PARSER_ERROR_INVALID_PARAM;
+    }
+
+    const http_parser_kernels_t *k = kernels;
+    const uint8_t *data = (const uint8_t *)input;
+    request->length = 0;
+
+    size_t header_end = k->find_header_end(data, size);
+    if (header_end == size) {
+        return HTTP_PARSER_ERROR_INCOMPLETE;
+    }
+    /* Lines end with CR LF; the blank line's CR LF follows the last one */
+    const uint8_t *head_end = data + header_end + 2;
+
+    /* Request line: token SP target SP "HTTP/1." DIGIT CR LF */
+    size_t method_length = k->token_span(data, (size_t)(head_end - data));
+    if (method_length == 0 || data[method_length] != ' ') {
+        return HTTP_PARSER_ERROR_MALFORMED;
+    }
+    const uint8_t *target = data + method_length + 1;
+    size_t target_length = k->target_span(target, (size_t)(head_end - target));
+    if (target_length == 0 || target[target_length] != ' ') {
+        return HTTP_PARSER_ERROR_MALFORMED;
+    }
+    const uint8_t *version = target + target_length + 1;
+    if (head_end - version < 10 || memcmp(version, "HTTP/1.", 7) != 0 ||
+        (version[7] != '0' && version[7] != '1') || version[8] != '\r' || version[9] != '\n') {
+        return HTTP_PARSER_ERROR_MALFORMED;
+    }
+
+    request->method = input;
+    request->method_length = method_length;
+    request->target = (const char *)target;
+    request->target_length = target_length;
+    request->minor_version = version[7] - '0';
+    request->close = request->minor_version == 0;
+    request->content_length = 0;
+    request->upgrade_h2c = false;
+    request->http2_settings = NULL;
+    request->http2_settings_length = 0;
+    request->if_none_match = NULL;
+    request->if_none_match_length = 0;
+    request->if_modified_since = NULL;
+    request->if_modified_since_length = 0;
+
+    /*
+     * Headers: Connection, Content-Length and Transfer-Encoding affect framing,
+     * Upgrade and HTTP2-Settings the protocol, If-None-Match and
+     * If-Modified-Since the response. A body that two parties could frame
+     * differently is refused rather than guessed at.
+     */
+    bool has_content_length = false;
+    bool has_transfer_encoding = false;
+    const uint8_t *line = version + 10;
+    while (line < head_end) {
+        size_t name_length = k->token_span(line, (size_t)(head_end - line));
+        if (name_length == 0 || line[name_length] != ':') {
+            return HTTP_PARSER_ERROR_MALFORMED;
+        }
+
+        const uint8_t *value = line + name_length + 1;
+        while (*value == ' ' || *value == '\t') {
+            value++;
+        }
+        size_t value_length = k->value_span(value, (size_t)(head_end - value));
+        const uint8_t *eol = value + value_length;
+        if (eol[0] != '\r' || eol[1] != '\n') {
+            return HTTP_PARSER_ERROR_MALFORMED;
+        }
+        while (value_length > 0 && (value[value_length - 1] == ' ' || value[value_length - 1] == '\t')) {
+            value_length--;
+        }
+
+        if (header_name_equal(line, name_length, "Connection", 10)) {
+            if (value_length == 5 && strncasecmp((const char *)value, "close", 5) == 0) {
+                request->close = true;
+            } else if (value_length == 10 && strncasecmp((const char *)value, "keep-alive", 10) == 0) {
+                request->close = false;
+            }
+        } else if (header_name_equal(line, name_length, "Content-Length", 14)) {
+            size_t content_length = 0;
+            if (has_content_length || value_length == 0 || value_length > 18) {
+                return HTTP_PARSER_ERROR_MALFORMED;
+            }
+            for (size_t i = 0; i < value_length; i++) {
+                if (value[i] < '0' || value[i] > '9') {
+                    return HTTP_PARSER_ERROR_MALFORMED;
+                }
+                content_length = content_length * 10 + (size_t)(value[i] - '0');
+            }
+            request->content_length = content_length;
+            has_content_length = true;
+        } else if (header_name_equal(line, name_length, "Transfer-Encoding", 17)) {
+            has_transfer_encoding = true;
+        } else if (header_name_equal(line, name_length, "Upgrade", 7)) {
+            request->upgrade_h2c = value_length == 3 && strncasecmp((const char *)value, "h2c", 3) == 0;
+        } else if (header_name_equal(line, name_length, "HTTP2-Settings", 14)) {
+            request->http2_settings = (const char *)value;
+            request->http2_settings_length = value_length;
+        } else if (header_name_equal(line, name_length, "If-None-Match", 13)) {
+            request->if_none_match = (const char *)value;
+            request->if_none_match_length = value_length;
+        } else if (header_name_equal(line, name_length, "If-Modified-Since", 17)) {
+            request->if_modified_since = (const char *)value;
+            request->if_modified_since_length = value_length;
+        }
+
+        line = eol + 2;
+    }
+
+    if (has_transfer_encoding) {
+        return has_content_length ? HTTP_PARSER_ERROR_MALFORMED : HTTP_PARSER_ERROR_NOT_IMPLEMENTED;
+    }
+
+    request->header_length = header_end + 4;
+    request->length = request->header_length + request->content_length;
+    return size < request->length ? HTTP_PARSER_ERROR_INCOMPLETE : HTTP_PARSER_OK;
+}
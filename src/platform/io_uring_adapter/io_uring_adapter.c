@@ -0,0 +1,2997 @@
+/**
+ * @file io_uring_adapter.c
+ * @brief Implementation of the io_uring reactor backend
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <linux/io_uring.h>
+
+#include "io_uring_adapter.h"
+#include "../../include/platform/system.h"
+#include "../../include/platform/log.h"
+#include "../../include/platform/metrics.h"
+#include "../../include/platform/date_clock.h"
+#include "../../include/platform/http_parser.h"
+#include "../../include/platform/hpack.h"
+#include "../../include/platform/trace.h"
+
+/** Operation tags stored in the low bits of user_data */
+enum {
+    OP_IGNORE = 0,
+    OP_ACCEPT = 1,
+    OP_RECV = 2,
+    OP_SEND = 3,
+    OP_POLL = 4,
+    OP_TIMEOUT = 5,              /** Timer wheel tick */
+    OP_SOCKOPT = 6
+};
+
+#define OP_MASK 0x7u
+
+/** Output operation kinds (stream.send_op), all tagged OP_SEND */
+enum {
+    SEND_OP_BYTES,               /** send() of the byte buffer only */
+    SEND_OP_GATHER,              /** sendmsg() of bytes and memory extents */
+    SEND_OP_SPLICE_IN,           /** file range into the splice pipe */
+    SEND_OP_SPLICE_OUT           /** splice pipe into the socket */
+};
+
+/** Session flags */
+enum {
+    SESSION_RECV_ARMED = 1 << 0,
+    SESSION_SENDING = 1 << 1,
+    SESSION_CLOSING = 1 << 2,
+    SESSION_CLOSE_AFTER_SEND = 1 << 3,
+    SESSION_FLUSH_PENDING = 1 << 4,
+    SESSION_ANSWERED = 1 << 5,   /** At least one request dispatched */
+    SESSION_HEADER_TIMER = 1 << 6, /** The timer runs for the pending request head */
+    SESSION_TRACE_OUTPUT = 1 << 7, /** The sampled response waits in output */
+    SESSION_TRACE_SENDING = 1 << 8, /** The sampled response is in the send in flight */
+    SESSION_RECV_PENDING = 1 << 9, /** The receive found the SQ full; retried from the flush list */
+    SESSION_SEND_PENDING = 1 << 10, /** The send of sending found the SQ full */
+    SESSION_CANCEL_PENDING = 1 << 11 /** The cancel of a closing session found the SQ full */
+};
+
+/** NAPI busy-poll registration (Linux 6.9+), defined here for older headers */
+#define IO_URING_ADAPTER_REGISTER_NAPI 27
+#define IO_URING_ADAPTER_UNREGISTER_NAPI 28
+
+typedef struct {
+    uint32_t busy_poll_to;       /** Busy-poll time in microseconds */
+    uint8_t prefer_busy_poll;    /** Keep NIC interrupts masked while polling */
+    uint8_t opcode;              /** 0: track the NAPI ids of polled sockets */
+    uint8_t pad[2];
+    uint32_t op_param;
+    uint32_t resv;
+} io_uring_adapter_napi;
+
+/** SOCKET_URING_OP_SETSOCKOPT command of IORING_OP_URING_CMD (Linux 6.7+) */
+#define IO_URING_ADAPTER_SOCKET_SETSOCKOPT 3
+
+/** Buffer group used for the provided receive buffers */
+#define BUFFER_GROUP_ID 0
+
+/** Default reactor for core_*(NULL) calls */
+static __thread core core_default;
+
+/** Thread-local date storage returned by http_date() */
+static __thread char date_string[HTTP_DATE_STORAGE] = "Thu, 01 Jan 1970 00:00:00 GMT";
+
+/* ------------------------------------------------------------------------ */
+/* buffer                                                                    */
+/* ------------------------------------------------------------------------ */
+
+void buffer_construct(buffer *b)
+{
+    b->data = NULL;
+    b->size = 0;
+    b->capacity = 0;
+}
+
+void buffer_destruct(buffer *b)
+{
+    system_free(b->data);
+    buffer_construct(b);
+}
+
+void buffer_reserve(buffer *b, size_t capacity)
+{
+    if (capacity <= b->capacity) {
+        return;
+    }
+
+    size_t new_capacity = b->capacity ? b->capacity : 256;
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+
+    char *data = system_realloc(b->data, new_capacity);
+    if (!data) {
+        log_error("io_uring adapter: out of memory growing buffer to %zu bytes", new_capacity);
+        abort();
+    }
+
+    b->data = data;
+    b->capacity = new_capacity;
+}
+
+void buffer_insert(buffer *b, size_t position, const void *data, size_t size)
+{
+    buffer_reserve(b, b->size + size);
+    if (position < b->size) {
+        memmove(b->data + position + size, b->data + position, b->size - position);
+    }
+    memcpy(b->data + position, data, size);
+    b->size += size;
+}
+
+void buffer_erase(buffer *b, size_t position, size_t size)
+{
+    if (position + size < b->size) {
+        memmove(b->data + position, b->data + position + size, b->size - position - size);
+    }
+    b->size -= size;
+}
+
+void buffer_clear(buffer *b)
+{
+    b->size = 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Raw io_uring plumbing                                                     */
+/* ------------------------------------------------------------------------ */
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int ring_setup(io_uring_adapter_ring *ring, unsigned entries)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    /* Single issuer + deferred task work keeps completions on our own syscalls */
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    int fd = sys_io_uring_setup(entries, &params);
+    if (fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        fd = sys_io_uring_setup(entries, &params);
+    }
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = fd;
+    ring->features = params.features;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring_ptr = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring_ptr == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring_ptr = ring->sq_ring_ptr;
+    } else {
+        ring->cq_ring_ptr = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring_ptr == MAP_FAILED) {
+            munmap(ring->sq_ring_ptr, ring->sq_ring_size);
+            close(fd);
+            return -1;
+        }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        if (ring->cq_ring_ptr != ring->sq_ring_ptr) {
+            munmap(ring->cq_ring_ptr, ring->cq_ring_size);
+        }
+        munmap(ring->sq_ring_ptr, ring->sq_ring_size);
+        close(fd);
+        return -1;
+    }
+
+    char *sq = ring->sq_ring_ptr;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = *(unsigned *)(sq + params.sq_off.ring_entries);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->sq_submitted_tail = ring->sq_local_tail;
+
+    char *cq = ring->cq_ring_ptr;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return 0;
+}
+
+static void ring_teardown(io_uring_adapter_ring *ring)
+{
+    if (ring->fd <= 0) {
+        return;
+    }
+
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring_ptr != ring->sq_ring_ptr) {
+        munmap(ring->cq_ring_ptr, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring_ptr, ring->sq_ring_size);
+    close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+}
+
+/**
+ * @brief Publish prepared SQEs and optionally wait for completions
+ */
+static int ring_submit(io_uring_adapter_ring *ring, unsigned wait_nr)
+{
+    unsigned to_submit = ring->sq_local_tail - ring->sq_submitted_tail;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    if (to_submit == 0 && wait_nr == 0) {
+        return 0;
+    }
+
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+    do {
+        ret = sys_io_uring_enter(ring->fd, to_submit, wait_nr, flags);
+    } while (ret < 0 && errno == EINTR && wait_nr == 0);
+
+    if (ret >= 0) {
+        ring->sq_submitted_tail += (unsigned)ret < to_submit ? (unsigned)ret : to_submit;
+    }
+    return ret;
+}
+
+/**
+ * @brief Get a zeroed SQE, flushing the queue first if it is full
+ */
+static struct io_uring_sqe *ring_get_sqe(io_uring_adapter_ring *ring)
+{
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        ring_submit(ring, 0);
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (ring->sq_local_tail - head >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+
+    unsigned index = ring->sq_local_tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+static int buffers_setup(io_uring_adapter_buffers *buffers, io_uring_adapter_ring *ring)
+{
+    memset(buffers, 0, sizeof(*buffers));
+    buffers->group_id = BUFFER_GROUP_ID;
+    buffers->ring_size = IO_URING_ADAPTER_BUFFER_COUNT * sizeof(struct io_uring_buf);
+
+    buffers->ring = mmap(NULL, buffers->ring_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers->ring == MAP_FAILED) {
+        buffers->ring = NULL;
+        return -1;
+    }
+
+    buffers->memory = mmap(NULL, (size_t)IO_URING_ADAPTER_BUFFER_COUNT * IO_URING_ADAPTER_BUFFER_SIZE,
+                           PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers->memory == MAP_FAILED) {
+        munmap(buffers->ring, buffers->ring_size);
+        buffers->ring = NULL;
+        buffers->memory = NULL;
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)buffers->ring;
+    reg.ring_entries = IO_URING_ADAPTER_BUFFER_COUNT;
+    reg.bgid = buffers->group_id;
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(buffers->memory, (size_t)IO_URING_ADAPTER_BUFFER_COUNT * IO_URING_ADAPTER_BUFFER_SIZE);
+        munmap(buffers->ring, buffers->ring_size);
+        buffers->ring = NULL;
+        buffers->memory = NULL;
+        return -1;
+    }
+
+    for (uint16_t bid = 0; bid < IO_URING_ADAPTER_BUFFER_COUNT; bid++) {
+        struct io_uring_buf *buf = &buffers->ring->bufs[bid];
+        buf->addr = (uint64_t)(uintptr_t)(buffers->memory + (size_t)bid * IO_URING_ADAPTER_BUFFER_SIZE);
+        buf->len = IO_URING_ADAPTER_BUFFER_SIZE;
+        buf->bid = bid;
+    }
+    buffers->tail = IO_URING_ADAPTER_BUFFER_COUNT;
+    __atomic_store_n(&buffers->ring->tail, buffers->tail, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+static void buffers_teardown(io_uring_adapter_buffers *buffers)
+{
+    if (buffers->memory) {
+        munmap(buffers->memory, (size_t)IO_URING_ADAPTER_BUFFER_COUNT * IO_URING_ADAPTER_BUFFER_SIZE);
+    }
+    if (buffers->ring) {
+        munmap(buffers->ring, buffers->ring_size);
+    }
+    memset(buffers, 0, sizeof(*buffers));
+}
+
+static inline char *buffers_address(const io_uring_adapter_buffers *buffers, uint16_t bid)
+{
+    return buffers->memory + (size_t)bid * IO_URING_ADAPTER_BUFFER_SIZE;
+}
+
+/**
+ * @brief Hand a consumed receive buffer back to the kernel
+ */
+static void buffers_recycle(io_uring_adapter_buffers *buffers, uint16_t bid)
+{
+    struct io_uring_buf *buf = &buffers->ring->bufs[buffers->tail & (IO_URING_ADAPTER_BUFFER_COUNT - 1)];
+    buf->addr = (uint64_t)(uintptr_t)buffers_address(buffers, bid);
+    buf->len = IO_URING_ADAPTER_BUFFER_SIZE;
+    buf->bid = bid;
+    buffers->tail++;
+    __atomic_store_n(&buffers->ring->tail, buffers->tail, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t user_data_make(void *object, unsigned op)
+{
+    return (uint64_t)(uintptr_t)object | op;
+}
+
+/* ------------------------------------------------------------------------ */
+/* HTTP helpers                                                              */
+/* ------------------------------------------------------------------------ */
+
+segment http_date(int update)
+{
+    if (update) {
+        (void)date_clock_poll();
+        date_clock_read(date_string);
+    }
+
+    return segment_make(date_string, HTTP_DATE_LENGTH);
+}
+
+/**
+ * @brief Parse one request from data
+ * @param[out] upgrade HTTP2-Settings value of an Upgrade: h2c request, empty otherwise
+ * @param[out] error Status of the error response when -1 is returned
+ * @return Bytes consumed, 0 if incomplete, -1 if the request is refused
+ */
+static ssize_t http_request_parse(http_request *request, char *data, size_t size, segment *upgrade,
+                                  segment *error)
+{
+    http_parser_request_t parsed;
+    http_parser_error_t err = http_parser_parse(data, size, &parsed);
+
+    if (err == HTTP_PARSER_ERROR_INCOMPLETE) {
+        /* Headers incomplete: bound the size; complete: bound the body */
+        if (parsed.length == 0 && size > IO_URING_ADAPTER_MAX_REQUEST_SIZE) {
+            *error = segment_string("431 Request Header Fields Too Large");
+            return -1;
+        }
+        if (parsed.length > IO_URING_ADAPTER_MAX_REQUEST_SIZE) {
+            *error = segment_string("413 Content Too Large");
+            return -1;
+        }
+        return 0;
+    }
+    if (err == HTTP_PARSER_ERROR_NOT_IMPLEMENTED) {
+        *error = segment_string("501 Not Implemented");
+        return -1;
+    }
+    if (err != HTTP_PARSER_OK) {
+        *error = segment_string("400 Bad Request");
+        return -1;
+    }
+    if (parsed.content_length > IO_URING_ADAPTER_MAX_REQUEST_SIZE) {
+        *error = segment_string("413 Content Too Large");
+        return -1;
+    }
+
+    request->method = segment_make(data, parsed.method_length);
+    request->target = segment_make((char *)parsed.target, parsed.target_length);
+    request->minor_version = parsed.minor_version;
+    request->close = parsed.close;
+    request->body = segment_make(data + parsed.header_length, parsed.content_length);
+    request->if_none_match = segment_make((char *)parsed.if_none_match, parsed.if_none_match_length);
+    request->if_modified_since = segment_make((char *)parsed.if_modified_since, parsed.if_modified_since_length);
+    *upgrade = parsed.upgrade_h2c && parsed.http2_settings ?
+        segment_make((char *)parsed.http2_settings, parsed.http2_settings_length) : segment_make(NULL, 0);
+    return (ssize_t)parsed.length;
+}
+
+/* ------------------------------------------------------------------------ */
+/* core                                                                      */
+/* ------------------------------------------------------------------------ */
+
+static inline core *core_resolve(core *c)
+{
+    return c ? c : &core_default;
+}
+
+static int64_t core_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void core_construct(core *c)
+{
+    c = core_resolve(c);
+    memset(c, 0, sizeof(*c));
+
+    if (ring_setup(&c->ring, IO_URING_ADAPTER_QUEUE_DEPTH) == -1) {
+        log_error("io_uring adapter: io_uring_setup failed: %s", strerror(errno));
+        return;
+    }
+
+    if (buffers_setup(&c->buffers, &c->ring) == -1) {
+        log_error("io_uring adapter: provided buffer ring setup failed: %s", strerror(errno));
+        ring_teardown(&c->ring);
+        return;
+    }
+
+    c->ready = true;
+    c->date_second = -1;
+    c->idle.mode = CORE_IDLE_BLOCK;
+    c->idle_mode = CORE_IDLE_BLOCK;
+    (void)timer_wheel_init(&c->timers, IO_URING_ADAPTER_TIMER_TICK_MS, core_now_ms());
+    c->tick.tv_sec = IO_URING_ADAPTER_TIMER_TICK_MS / 1000;
+    c->tick.tv_nsec = (long long)(IO_URING_ADAPTER_TIMER_TICK_MS % 1000) * 1000000;
+}
+
+void core_abort(core *c)
+{
+    core_resolve(c)->aborted = true;
+}
+
+void core_destruct(core *c)
+{
+    c = core_resolve(c);
+    while (c->watches) {
+        core_watch *watch = c->watches;
+        c->watches = watch->next;
+        system_free(watch);
+    }
+    buffers_teardown(&c->buffers);
+    ring_teardown(&c->ring);
+    memset(c, 0, sizeof(*c));
+}
+
+/**
+ * @brief Switch the wait strategy, (un)registering kernel busy polling as needed
+ */
+static void core_enter_idle_mode(core *c, core_idle_mode mode)
+{
+    io_uring_adapter_napi napi = {
+        .busy_poll_to = c->idle.busy_poll_us,
+        .prefer_busy_poll = 1
+    };
+
+    if (mode == CORE_IDLE_BUSY_POLL && !c->napi_registered) {
+        if (sys_io_uring_register(c->ring.fd, IO_URING_ADAPTER_REGISTER_NAPI, &napi, 1) < 0) {
+            log_warn("io_uring adapter: busy polling unavailable, spinning instead: %s", strerror(errno));
+            c->idle.busy_poll_us = 0;
+            mode = CORE_IDLE_SPIN;
+        } else {
+            c->napi_registered = true;
+        }
+    } else if (mode != CORE_IDLE_BUSY_POLL && c->napi_registered) {
+        (void)sys_io_uring_register(c->ring.fd, IO_URING_ADAPTER_UNREGISTER_NAPI, &napi, 1);
+        c->napi_registered = false;
+    }
+
+    if (mode == CORE_IDLE_SPIN && c->idle.spin_us == 0) {
+        mode = CORE_IDLE_BLOCK;
+    }
+
+    if (mode != c->idle_mode) {
+        log_debug("io_uring adapter: idle mode %d -> %d", c->idle_mode, mode);
+        c->idle_mode = mode;
+    }
+}
+
+void core_set_idle_policy(core *c, const core_idle_policy *policy)
+{
+    c = core_resolve(c);
+    if (!c->ready || !policy) {
+        return;
+    }
+
+    c->idle = *policy;
+    if (c->napi_registered) {
+        /* Re-register so a changed busy-poll time takes effect */
+        core_enter_idle_mode(c, CORE_IDLE_BLOCK);
+    }
+    c->idle_completions = 0;
+    c->idle_sample_ms = core_now_ms();
+    core_enter_idle_mode(c, policy->adaptive ? CORE_IDLE_BLOCK : policy->mode);
+}
+
+core_idle_mode core_get_idle_mode(core *c)
+{
+    return core_resolve(c)->idle_mode;
+}
+
+/**
+ * @brief Adapt the idle mode to the completion rate of the last sample
+ */
+static void core_update_idle_mode(core *c, unsigned completions)
+{
+    c->idle_completions += completions;
+
+    int64_t now = core_now_ms();
+    int64_t elapsed = now - c->idle_sample_ms;
+    if (elapsed < IO_URING_ADAPTER_IDLE_SAMPLE_MS) {
+        return;
+    }
+
+    uint64_t rate = c->idle_completions * 1000 / (uint64_t)elapsed;
+    c->idle_completions = 0;
+    c->idle_sample_ms = now;
+
+    /* Step up at a threshold, but only back down below half of it */
+    core_idle_mode mode = CORE_IDLE_BLOCK;
+    uint64_t busy_poll_rate = c->idle.busy_poll_rate;
+    uint64_t spin_rate = c->idle.spin_rate;
+    if (c->idle_mode == CORE_IDLE_BUSY_POLL) {
+        busy_poll_rate /= 2;
+    }
+    if (c->idle_mode >= CORE_IDLE_SPIN) {
+        spin_rate /= 2;
+    }
+
+    if (c->idle.mode >= CORE_IDLE_BUSY_POLL && c->idle.busy_poll_us > 0 && rate >= busy_poll_rate) {
+        mode = CORE_IDLE_BUSY_POLL;
+    } else if (c->idle.mode >= CORE_IDLE_SPIN && rate >= spin_rate) {
+        mode = CORE_IDLE_SPIN;
+    }
+
+    if (mode != c->idle_mode) {
+        core_enter_idle_mode(c, mode);
+    }
+}
+
+/**
+ * @brief Poll for completions for up to spin_us without sleeping
+ * @return true if completions are ready
+ */
+static bool core_spin(core *c)
+{
+    io_uring_adapter_ring *ring = &c->ring;
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int64_t budget_ns = (int64_t)c->idle.spin_us * 1000;
+
+    for (;;) {
+        /* Deferred task work only runs inside io_uring_enter(GETEVENTS) */
+        unsigned to_submit = ring->sq_local_tail - ring->sq_submitted_tail;
+        __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+        int ret = sys_io_uring_enter(ring->fd, to_submit, 0, IORING_ENTER_GETEVENTS);
+        if (ret > 0) {
+            ring->sq_submitted_tail += (unsigned)ret < to_submit ? (unsigned)ret : to_submit;
+        }
+
+        if (__atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) != *ring->cq_head) {
+            return true;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec - start.tv_sec) * 1000000000 + (now.tv_nsec - start.tv_nsec) >= budget_ns) {
+            return false;
+        }
+    }
+}
+
+static void session_handle_recv(server_session *session, struct io_uring_cqe *cqe);
+static void session_handle_send(server_session *session, struct io_uring_cqe *cqe);
+static void session_flush_pending(core *c);
+static void session_close(server_session *session);
+static void session_schedule_flush(server_session *session);
+static void server_handle_accept(server *s, struct io_uring_cqe *cqe);
+static void server_handle_drain_timeout(timer_wheel_timer_t *timer);
+static void http2_destroy(struct server_http2 *h2);
+
+static void core_handle_sockopt(core *c, struct io_uring_cqe *cqe)
+{
+    /* Successful commands post nothing, so one completion means the kernel lacks them */
+    if (!c->sockopt_sync) {
+        c->sockopt_sync = true;
+        log_warn("Setting socket options through io_uring failed (%s), using setsockopt()",
+                 strerror(-cqe->res));
+    }
+}
+
+/**
+ * @brief Wake the loop after one tick while timers are armed
+ */
+static void core_arm_tick(core *c)
+{
+    struct io_uring_sqe *sqe = ring_get_sqe(&c->ring);
+    if (!sqe) {
+        return;
+    }
+
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = (uint64_t)(uintptr_t)&c->tick;
+    sqe->len = 1;
+    sqe->user_data = user_data_make(c, OP_TIMEOUT);
+    c->tick_armed = true;
+}
+
+static void core_arm_watch(core *c, core_watch *watch)
+{
+    struct io_uring_sqe *sqe = ring_get_sqe(&c->ring);
+    if (!sqe) {
+        return;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = watch->fd;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = (uint32_t)watch->events;
+    sqe->user_data = user_data_make(watch, OP_POLL);
+}
+
+void core_add(core *c, core_callback *callback, void *state, int fd, int events)
+{
+    c = core_resolve(c);
+    core_watch *watch = system_malloc(sizeof(*watch));
+    if (!watch) {
+        log_error("io_uring adapter: out of memory adding a watch for fd %d", fd);
+        return;
+    }
+
+    watch->user.callback = callback;
+    watch->user.state = state;
+    watch->fd = fd;
+    watch->events = events;
+    watch->next = c->watches;
+    c->watches = watch;
+    core_arm_watch(c, watch);
+}
+
+static void core_handle_poll(core *c, core_watch *watch, struct io_uring_cqe *cqe)
+{
+    if (cqe->res < 0) {
+        log_error("io_uring adapter: poll on fd %d failed: %s", watch->fd, strerror(-cqe->res));
+        return;
+    }
+
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        core_arm_watch(c, watch);
+    }
+
+    core_event event = { .type = cqe->res, .state = watch->user.state, .data = (uintptr_t)watch->fd };
+    if (watch->user.callback(&event) != CORE_OK) {
+        core_abort(c);
+    }
+}
+
+void core_loop(core *c)
+{
+    c = core_resolve(c);
+    if (!c->ready) {
+        return;
+    }
+
+    while (c->active > 0 && !c->aborted) {
+        if (c->timers.count > 0 && !c->tick_armed) {
+            core_arm_tick(c);
+        }
+
+        unsigned wait_nr = 1;
+        if (c->idle_mode == CORE_IDLE_SPIN &&
+            __atomic_load_n(c->ring.cq_tail, __ATOMIC_ACQUIRE) == *c->ring.cq_head &&
+            core_spin(c)) {
+            wait_nr = 0;
+        }
+        if (c->flush_list) {
+            /* Operations the full SQ refused retry right after this submit */
+            wait_nr = 0;
+        }
+
+        if (ring_submit(&c->ring, wait_nr) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            log_error("io_uring adapter: io_uring_enter failed: %s", strerror(errno));
+            break;
+        }
+
+        /* Refresh the cached date when the shared clock ticks */
+        int64_t second = date_clock_poll();
+        if (second != c->date_second) {
+            c->date_second = second;
+            http_date(1);
+        }
+
+        /* Expire first, so timers armed by the completions below count from now */
+        timer_wheel_advance(&c->timers, core_now_ms());
+
+        unsigned head = *c->ring.cq_head;
+        unsigned first = head;
+        unsigned tail = __atomic_load_n(c->ring.cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &c->ring.cqes[head & c->ring.cq_mask];
+            void *object = (void *)(uintptr_t)(cqe->user_data & ~(uint64_t)OP_MASK);
+
+            switch (cqe->user_data & OP_MASK) {
+                case OP_ACCEPT:
+                    server_handle_accept(object, cqe);
+                    break;
+                case OP_RECV:
+                    session_handle_recv(object, cqe);
+                    break;
+                case OP_SEND:
+                    session_handle_send(object, cqe);
+                    break;
+                case OP_POLL:
+                    core_handle_poll(c, object, cqe);
+                    break;
+                case OP_TIMEOUT:
+                    c->tick_armed = false;
+                    break;
+                case OP_SOCKOPT:
+                    core_handle_sockopt(c, cqe);
+                    break;
+                default:
+                    break;
+            }
+
+            head++;
+            if (c->aborted) {
+                break;
+            }
+            if (head == tail) {
+                /* Release slots before checking for completions posted meanwhile */
+                __atomic_store_n(c->ring.cq_head, head, __ATOMIC_RELEASE);
+                tail = __atomic_load_n(c->ring.cq_tail, __ATOMIC_ACQUIRE);
+            }
+        }
+        __atomic_store_n(c->ring.cq_head, head, __ATOMIC_RELEASE);
+
+        /* One send per connection for everything answered in this batch */
+        session_flush_pending(c);
+
+        if (c->idle.adaptive) {
+            core_update_idle_mode(c, head - first);
+        }
+    }
+
+    /* Flush anything queued by the last batch (cancellations, closes) */
+    ring_submit(&c->ring, 0);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Sessions                                                                  */
+/* ------------------------------------------------------------------------ */
+
+/**
+ * @brief Retry an operation the full submission queue refused once the next submit made room
+ */
+static void session_defer(server_session *session, unsigned pending)
+{
+    metrics_add(METRICS_SQ_FULL, 1);
+    session->flags |= pending;
+    session_schedule_flush(session);
+}
+
+static void session_arm_recv(server_session *session)
+{
+    struct io_uring_sqe *sqe = ring_get_sqe(&session->server->core->ring);
+    if (!sqe) {
+        session_defer(session, SESSION_RECV_PENDING);
+        return;
+    }
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = session->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = session->server->core->buffers.group_id;
+    sqe->user_data = user_data_make(session, OP_RECV);
+
+    session->flags = (session->flags & ~SESSION_RECV_PENDING) | SESSION_RECV_ARMED;
+    session->refs++;
+}
+
+static inline stream_extent *stream_extent_at(buffer *extents, size_t index)
+{
+    return (stream_extent *)extents->data + index;
+}
+
+static inline size_t stream_extent_count(const buffer *extents)
+{
+    return extents->size / sizeof(stream_extent);
+}
+
+/**
+ * @brief Run and drop the release hooks of every extent in a list
+ */
+static void stream_release_extents(buffer *extents)
+{
+    size_t count = stream_extent_count(extents);
+    for (size_t i = 0; i < count; i++) {
+        stream_extent *extent = stream_extent_at(extents, i);
+        if (extent->release) {
+            extent->release(extent->arg);
+        }
+    }
+    buffer_clear(extents);
+}
+
+/**
+ * @brief Check whether every byte and extent of the in-flight send is out
+ */
+static bool stream_sending_done(const stream *st)
+{
+    return st->sent == st->sending.size &&
+           st->extent_index == stream_extent_count(&st->sending_extents);
+}
+
+/**
+ * @brief Count the bytes queued for sending, extents included
+ */
+static size_t stream_queued(const stream *st)
+{
+    size_t queued = st->output.size;
+    size_t count = stream_extent_count(&st->extents);
+    for (size_t i = 0; i < count; i++) {
+        queued += ((const stream_extent *)st->extents.data)[i].size;
+    }
+    return queued;
+}
+
+/**
+ * @brief Start the trace record of a request if it is sampled
+ * @return Bytes queued before the dispatch, or SIZE_MAX if not sampled
+ * @note One record per connection: requests are not sampled before the
+ *       response of the previous sample is written
+ */
+static size_t session_trace_begin(server_session *session, uint32_t stream_id)
+{
+    if (!trace_active() || (session->flags & (SESSION_TRACE_OUTPUT | SESSION_TRACE_SENDING)) ||
+        !trace_sample(&session->trace)) {
+        return SIZE_MAX;
+    }
+
+    session->trace.connection = (uint32_t)session->fd;
+    session->trace.stream = stream_id;
+    return stream_queued(&session->stream);
+}
+
+/**
+ * @brief End the dispatch of a request, keeping a sampled record for its send
+ * @param queued Value session_trace_begin() returned
+ */
+static void session_trace_end(server_session *session, size_t queued)
+{
+    if (queued == SIZE_MAX) {
+        return;
+    }
+
+    size_t now = stream_queued(&session->stream);
+    trace_dispatched(now > queued ? now - queued : 0);
+    if (session->trace.bytes > 0) {
+        session->flags |= SESSION_TRACE_OUTPUT;
+    }
+}
+
+/**
+ * @brief Move the send cursor forward over bytes and extents
+ */
+static void stream_advance(stream *st, size_t size)
+{
+    size_t count = stream_extent_count(&st->sending_extents);
+
+    while (size > 0) {
+        stream_extent *extent = st->extent_index < count ?
+            stream_extent_at(&st->sending_extents, st->extent_index) : NULL;
+
+        if (extent && extent->position == st->sent) {
+            size_t step = extent->size - st->extent_sent;
+            step = step < size ? step : size;
+            st->extent_sent += step;
+            size -= step;
+            if (st->extent_sent == extent->size) {
+                st->extent_index++;
+                st->extent_sent = 0;
+            }
+        } else {
+            size_t end = extent ? extent->position : st->sending.size;
+            size_t step = end - st->sent;
+            step = step < size ? step : size;
+            st->sent += step;
+            size -= step;
+        }
+    }
+
+    /* Skip empty extents so the cursor rests on real work */
+    while (st->extent_index < count) {
+        stream_extent *extent = stream_extent_at(&st->sending_extents, st->extent_index);
+        if (extent->position != st->sent || extent->size != 0) {
+            break;
+        }
+        st->extent_index++;
+    }
+}
+
+/**
+ * @brief Gather bytes and memory extents from the cursor into the iovec array
+ * @return Number of iovecs, 0 if the cursor is at a file range
+ */
+static int stream_gather(stream *st)
+{
+    size_t count = stream_extent_count(&st->sending_extents);
+    size_t sent = st->sent;
+    size_t index = st->extent_index;
+    size_t extent_sent = st->extent_sent;
+    int iovcnt = 0;
+
+    while (iovcnt < IO_URING_ADAPTER_SEND_IOVECS) {
+        stream_extent *extent = index < count ? stream_extent_at(&st->sending_extents, index) : NULL;
+
+        if (extent && extent->position == sent) {
+            if (!extent->base) {
+                break;
+            }
+            if (extent->size > extent_sent) {
+                st->iov[iovcnt].iov_base = (char *)extent->base + extent_sent;
+                st->iov[iovcnt].iov_len = extent->size - extent_sent;
+                iovcnt++;
+            }
+            index++;
+            extent_sent = 0;
+        } else {
+            size_t end = extent ? extent->position : st->sending.size;
+            if (end == sent) {
+                break;
+            }
+            st->iov[iovcnt].iov_base = st->sending.data + sent;
+            st->iov[iovcnt].iov_len = end - sent;
+            iovcnt++;
+            sent = end;
+        }
+    }
+
+    return iovcnt;
+}
+
+/**
+ * @brief Create the splice pipe on first use
+ * @return True if the pipe is usable
+ */
+static bool stream_open_pipe(stream *st)
+{
+    if (st->pipe[0] >= 0) {
+        return true;
+    }
+
+    if (pipe2(st->pipe, O_CLOEXEC) == -1) {
+        st->pipe[0] = st->pipe[1] = -1;
+        return false;
+    }
+
+    (void)fcntl(st->pipe[1], F_SETPIPE_SZ, IO_URING_ADAPTER_PIPE_SIZE);
+    return true;
+}
+
+static void session_submit_send(server_session *session)
+{
+    stream *st = &session->stream;
+    struct io_uring_sqe *sqe = ring_get_sqe(&session->server->core->ring);
+    if (!sqe) {
+        /* sending already holds the output; only the SQE is missing */
+        session_defer(session, SESSION_SEND_PENDING);
+        return;
+    }
+
+    sqe->user_data = user_data_make(session, OP_SEND);
+
+    if (st->sending_extents.size == 0) {
+        /* Plain responses: one send() of the byte buffer */
+        st->send_op = SEND_OP_BYTES;
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = session->fd;
+        sqe->addr = (uint64_t)(uintptr_t)(st->sending.data + st->sent);
+        sqe->len = (uint32_t)(st->sending.size - st->sent);
+        sqe->msg_flags = MSG_NOSIGNAL;
+    } else if ((st->message.msg_iovlen = (size_t)stream_gather(st)) > 0) {
+        st->send_op = SEND_OP_GATHER;
+        st->message.msg_iov = st->iov;
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = session->fd;
+        sqe->addr = (uint64_t)(uintptr_t)&st->message;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+    } else {
+        /* File range: page cache -> pipe -> socket, no userspace copy */
+        stream_extent *extent = stream_extent_at(&st->sending_extents, st->extent_index);
+        sqe->opcode = IORING_OP_SPLICE;
+        sqe->splice_flags = SPLICE_F_MOVE;
+        if (st->piped > 0) {
+            st->send_op = SEND_OP_SPLICE_OUT;
+            sqe->splice_fd_in = st->pipe[0];
+            sqe->splice_off_in = (uint64_t)-1;
+            sqe->fd = session->fd;
+            sqe->off = (uint64_t)-1;
+            sqe->len = (uint32_t)st->piped;
+        } else {
+            size_t remaining = extent->size - st->extent_sent;
+            st->send_op = SEND_OP_SPLICE_IN;
+            sqe->splice_fd_in = extent->fd;
+            sqe->splice_off_in = (uint64_t)(extent->offset + (off_t)st->extent_sent);
+            sqe->fd = st->pipe[1];
+            sqe->off = (uint64_t)-1;
+            sqe->len = (uint32_t)(remaining < IO_URING_ADAPTER_PIPE_SIZE ? remaining : IO_URING_ADAPTER_PIPE_SIZE);
+        }
+    }
+
+    session->flags = (session->flags & ~SESSION_SEND_PENDING) | SESSION_SENDING;
+    session->refs++;
+}
+
+/**
+ * @brief Send all queued output with one SQE unless a send is in flight
+ */
+static void session_flush(server_session *session)
+{
+    stream *st = &session->stream;
+    if ((session->flags & (SESSION_SENDING | SESSION_SEND_PENDING)) ||
+        (st->output.size == 0 && st->extents.size == 0)) {
+        return;
+    }
+
+    /* Swap so the kernel owns a buffer that is never reallocated under it */
+    buffer swap = st->sending;
+    st->sending = st->output;
+    st->output = swap;
+    buffer_clear(&st->output);
+    st->sent = 0;
+    if (session->flags & SESSION_TRACE_OUTPUT) {
+        session->flags = (session->flags & ~SESSION_TRACE_OUTPUT) | SESSION_TRACE_SENDING;
+    }
+
+    swap = st->sending_extents;
+    st->sending_extents = st->extents;
+    st->extents = swap;
+    st->extent_index = 0;
+    st->extent_sent = 0;
+    if (st->sending_extents.size > 0) {
+        if (!stream_open_pipe(st)) {
+            session_close(session);
+            return;
+        }
+        stream_advance(st, 0);
+    }
+
+    session_submit_send(session);
+}
+
+/**
+ * @brief Defer the send of queued output to the end of the completion batch
+ */
+static void session_schedule_flush(server_session *session)
+{
+    if (session->flags & SESSION_FLUSH_PENDING) {
+        return;
+    }
+
+    core *c = session->server->core;
+    session->flags |= SESSION_FLUSH_PENDING;
+    session->flush_next = c->flush_list;
+    c->flush_list = session;
+}
+
+/**
+ * @brief Arm the timeout of what the session waits for now
+ */
+static void session_update_timer(server_session *session)
+{
+    server *s = session->server;
+    unsigned timeout_ms;
+
+    if (session->stream.input.size > 0 || !(session->flags & SESSION_ANSWERED)) {
+        /* Counted from a request's first byte; trickling in more does not extend it */
+        if (session->flags & SESSION_HEADER_TIMER) {
+            return;
+        }
+        session->flags |= SESSION_HEADER_TIMER;
+        timeout_ms = s->limits.header_timeout_ms;
+    } else {
+        session->flags &= ~SESSION_HEADER_TIMER;
+        timeout_ms = session->flags & (SESSION_SENDING | SESSION_FLUSH_PENDING) ?
+            s->limits.idle_timeout_ms : s->limits.keepalive_timeout_ms;
+    }
+
+    if (timeout_ms > 0) {
+        timer_wheel_arm(&s->core->timers, &session->timer, timeout_ms);
+    } else {
+        timer_wheel_cancel(&s->core->timers, &session->timer);
+    }
+}
+
+static void session_handle_timeout(timer_wheel_timer_t *timer)
+{
+    server_session *session = (server_session *)((char *)timer - offsetof(server_session, timer));
+    metrics_add(METRICS_TIMEOUTS, 1);
+    session_close(session);
+}
+
+static void session_release(server_session *session)
+{
+    /* Sessions on the flush list are released by session_flush_pending() */
+    if (session->refs > 0 || (session->flags & SESSION_FLUSH_PENDING)) {
+        return;
+    }
+
+    server *s = session->server;
+    if (session->prev) {
+        session->prev->next = session->next;
+    } else if (s->sessions == session) {
+        s->sessions = session->next;
+    }
+    if (session->next) {
+        session->next->prev = session->prev;
+    }
+
+    timer_wheel_cancel(&s->core->timers, &session->timer);
+    close(session->fd);
+    metrics_add(METRICS_CLOSES, 1);
+    stream *st = &session->stream;
+    stream_release_extents(&st->extents);
+    stream_release_extents(&st->sending_extents);
+    if (st->pipe[0] >= 0) {
+        close(st->pipe[0]);
+        close(st->pipe[1]);
+    }
+    buffer_destruct(&st->input);
+    buffer_destruct(&st->output);
+    buffer_destruct(&st->sending);
+    buffer_destruct(&st->extents);
+    buffer_destruct(&st->sending_extents);
+    if (session->http2) {
+        http2_destroy(session->http2);
+    }
+    s->connections--;
+    s->core->active--;
+    system_free(session);
+}
+
+/**
+ * @brief Cancel the multishot recv (and any send); release on last completion
+ */
+static void session_cancel(server_session *session)
+{
+    struct io_uring_sqe *sqe = ring_get_sqe(&session->server->core->ring);
+    if (!sqe) {
+        session_defer(session, SESSION_CANCEL_PENDING);
+        return;
+    }
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = session->fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = user_data_make(NULL, OP_IGNORE);
+    session->flags &= ~SESSION_CANCEL_PENDING;
+}
+
+static void session_close(server_session *session)
+{
+    if (session->flags & SESSION_CLOSING) {
+        session_release(session);
+        return;
+    }
+    /* A receive or send still waiting for an SQE is no longer wanted */
+    session->flags = (session->flags & ~(SESSION_RECV_PENDING | SESSION_SEND_PENDING)) | SESSION_CLOSING;
+
+    if (session->refs > 0) {
+        session_cancel(session);
+        return;
+    }
+
+    session_release(session);
+}
+
+static void session_flush_pending(core *c)
+{
+    /* Sessions deferred again while flushing wait for the next submit */
+    server_session *list = c->flush_list;
+    c->flush_list = NULL;
+
+    while (list) {
+        server_session *session = list;
+        list = session->flush_next;
+        session->flush_next = NULL;
+        session->flags &= ~SESSION_FLUSH_PENDING;
+
+        if (session->flags & SESSION_CLOSING) {
+            if (session->flags & SESSION_CANCEL_PENDING) {
+                session_cancel(session);
+            }
+            session_release(session);
+            continue;
+        }
+
+        if (session->flags & SESSION_RECV_PENDING) {
+            session_arm_recv(session);
+        }
+        if (session->flags & SESSION_SEND_PENDING) {
+            session_submit_send(session);
+        } else {
+            session_flush(session);
+        }
+
+        if ((session->flags & SESSION_CLOSE_AFTER_SEND) &&
+            !(session->flags & (SESSION_SENDING | SESSION_SEND_PENDING))) {
+            session_close(session);
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/* HTTP/2                                                                    */
+/* ------------------------------------------------------------------------ */
+
+/** Client connection preface */
+#define HTTP2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define HTTP2_PREFACE_LENGTH (sizeof(HTTP2_PREFACE) - 1)
+
+#define HTTP2_FRAME_HEADER_SIZE 9
+
+/** Flow control window both sides start with */
+#define HTTP2_DEFAULT_WINDOW 65535
+#define HTTP2_MAX_WINDOW 0x7fffffff
+
+/** Most fields of a request header block */
+#define HTTP2_MAX_FIELDS 64
+
+/** Bytes for Huffman-decoded strings of one header block */
+#define HTTP2_SCRATCH_SIZE 4096
+
+/** Largest decoded HTTP2-Settings value of an upgrade request */
+#define HTTP2_UPGRADE_SETTINGS_SIZE 96
+
+/** Frame types */
+enum {
+    HTTP2_FRAME_DATA = 0,
+    HTTP2_FRAME_HEADERS = 1,
+    HTTP2_FRAME_PRIORITY = 2,
+    HTTP2_FRAME_RST_STREAM = 3,
+    HTTP2_FRAME_SETTINGS = 4,
+    HTTP2_FRAME_PUSH_PROMISE = 5,
+    HTTP2_FRAME_PING = 6,
+    HTTP2_FRAME_GOAWAY = 7,
+    HTTP2_FRAME_WINDOW_UPDATE = 8,
+    HTTP2_FRAME_CONTINUATION = 9
+};
+
+/** Frame flags */
+enum {
+    HTTP2_FLAG_END_STREAM = 0x1,
+    HTTP2_FLAG_ACK = 0x1,
+    HTTP2_FLAG_END_HEADERS = 0x4,
+    HTTP2_FLAG_PADDED = 0x8,
+    HTTP2_FLAG_PRIORITY = 0x20
+};
+
+/** Settings */
+enum {
+    HTTP2_SETTING_ENABLE_PUSH = 2,
+    HTTP2_SETTING_MAX_CONCURRENT_STREAMS = 3,
+    HTTP2_SETTING_INITIAL_WINDOW_SIZE = 4,
+    HTTP2_SETTING_MAX_FRAME_SIZE = 5
+};
+
+/** Error codes of RST_STREAM and GOAWAY */
+enum {
+    HTTP2_NO_ERROR = 0x0,
+    HTTP2_PROTOCOL_ERROR = 0x1,
+    HTTP2_INTERNAL_ERROR = 0x2,
+    HTTP2_FLOW_CONTROL_ERROR = 0x3,
+    HTTP2_STREAM_CLOSED = 0x5,
+    HTTP2_FRAME_SIZE_ERROR = 0x6,
+    HTTP2_REFUSED_STREAM = 0x7,
+    HTTP2_COMPRESSION_ERROR = 0x9,
+    HTTP2_ENHANCE_YOUR_CALM = 0xb
+};
+
+/** Received frame; the payload points into the connection input */
+typedef struct {
+    size_t length;
+    uint8_t type;
+    uint8_t flags;
+    uint32_t id;
+    const uint8_t *payload;
+} http2_frame;
+
+/** Stream receiving its request body or sending a response the windows held back */
+typedef struct http2_stream {
+    struct http2_stream *next;
+    uint32_t id;
+    bool receiving;              /** Request body still arriving */
+    bool copy;                   /** The body is copied into frames, not referenced */
+    int64_t window;              /** Send window */
+    buffer request;              /** Method, target, then the body */
+    size_t method_length;
+    size_t target_length;
+    stream_extent body;          /** Response body not framed yet */
+    buffer owned;                /** Copy of a body passed by value */
+} http2_stream;
+
+/** HTTP/2 state of a connection */
+typedef struct server_http2 {
+    hpack_decoder_t decoder;
+    http2_stream *streams;
+    unsigned stream_count;
+    uint32_t last_stream_id;     /** Highest stream the client opened */
+    uint32_t continuation_id;    /** Stream whose header block continues, 0 if none */
+    bool continuation_end_stream;
+    bool preface;                /** The client preface arrived */
+    bool goaway;                 /** GOAWAY sent: no new streams, close once all are done */
+    bool responded;              /** The stream being dispatched was answered */
+    buffer header_block;         /** Header block fragments until END_HEADERS */
+    int64_t send_window;         /** Connection send window */
+    int64_t initial_window;      /** Send window of new streams */
+} server_http2;
+
+static inline uint32_t http2_read32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline void http2_write32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+static void http2_frame_header(stream *st, uint8_t type, uint8_t flags, uint32_t id, size_t length)
+{
+    uint8_t *p = stream_allocate(st, HTTP2_FRAME_HEADER_SIZE);
+    p[0] = (uint8_t)(length >> 16);
+    p[1] = (uint8_t)(length >> 8);
+    p[2] = (uint8_t)length;
+    p[3] = type;
+    p[4] = flags;
+    http2_write32(p + 5, id);
+}
+
+/**
+ * @brief Queue a frame header and reserve its payload
+ * @return Payload to fill
+ */
+static uint8_t *http2_frame_allocate(stream *st, uint8_t type, uint8_t flags, uint32_t id, size_t length)
+{
+    http2_frame_header(st, type, flags, id, length);
+    return stream_allocate(st, length);
+}
+
+static void http2_send_rst(server_session *session, uint32_t id, uint32_t code)
+{
+    http2_write32(http2_frame_allocate(&session->stream, HTTP2_FRAME_RST_STREAM, 0, id, 4), code);
+}
+
+static void http2_send_window_update(server_session *session, uint32_t id, size_t increment)
+{
+    http2_write32(http2_frame_allocate(&session->stream, HTTP2_FRAME_WINDOW_UPDATE, 0, id, 4),
+                  (uint32_t)increment);
+}
+
+static void http2_send_goaway(server_session *session, uint32_t code)
+{
+    uint8_t *p = http2_frame_allocate(&session->stream, HTTP2_FRAME_GOAWAY, 0, 0, 8);
+    http2_write32(p, session->http2->last_stream_id);
+    http2_write32(p + 4, code);
+    session->http2->goaway = true;
+}
+
+/**
+ * @brief End the connection for a protocol violation: GOAWAY, then close
+ */
+static void http2_fail(server_session *session, uint32_t code)
+{
+    metrics_add(METRICS_PARSE_ERRORS, 1);
+    http2_send_goaway(session, code);
+    session->flags |= SESSION_CLOSE_AFTER_SEND;
+}
+
+/**
+ * @brief Close once GOAWAY went out and every stream is done
+ */
+static void http2_check_close(server_session *session)
+{
+    if (session->http2->goaway && session->http2->stream_count == 0) {
+        session->flags |= SESSION_CLOSE_AFTER_SEND;
+    }
+}
+
+/**
+ * @brief Refuse new streams and close once the open ones are answered
+ */
+static void http2_shutdown(server_session *session)
+{
+    if (!session->http2->goaway) {
+        http2_send_goaway(session, HTTP2_NO_ERROR);
+    }
+    http2_check_close(session);
+}
+
+static http2_stream *http2_find_stream(const server_http2 *h2, uint32_t id)
+{
+    http2_stream *hs = h2->streams;
+    while (hs && hs->id != id) {
+        hs = hs->next;
+    }
+    return hs;
+}
+
+static http2_stream *http2_open_stream(server_http2 *h2, uint32_t id)
+{
+    http2_stream *hs = system_malloc(sizeof(*hs));
+    if (!hs) {
+        return NULL;
+    }
+
+    memset(hs, 0, sizeof(*hs));
+    hs->id = id;
+    hs->window = h2->initial_window;
+    hs->body.fd = -1;
+    buffer_construct(&hs->request);
+    buffer_construct(&hs->owned);
+    hs->next = h2->streams;
+    h2->streams = hs;
+    h2->stream_count++;
+    return hs;
+}
+
+/**
+ * @brief Free an unlinked stream, releasing a body it still holds
+ */
+static void http2_free_stream(server_http2 *h2, http2_stream *hs)
+{
+    if (hs->body.release) {
+        hs->body.release(hs->body.arg);
+    }
+    buffer_destruct(&hs->request);
+    buffer_destruct(&hs->owned);
+    system_free(hs);
+    h2->stream_count--;
+}
+
+static void http2_close_stream(server_http2 *h2, http2_stream *hs)
+{
+    http2_stream **link = &h2->streams;
+    while (*link != hs) {
+        link = &(*link)->next;
+    }
+    *link = hs->next;
+    http2_free_stream(h2, hs);
+}
+
+static void http2_destroy(server_http2 *h2)
+{
+    while (h2->streams) {
+        http2_stream *hs = h2->streams;
+        h2->streams = hs->next;
+        http2_free_stream(h2, hs);
+    }
+    hpack_decoder_cleanup(&h2->decoder);
+    buffer_destruct(&h2->header_block);
+    system_free(h2);
+}
+
+/**
+ * @brief Switch a connection to HTTP/2 and queue the server's SETTINGS
+ * @return False if the state cannot be allocated
+ */
+static bool http2_open(server_session *session)
+{
+    server_http2 *h2 = system_malloc(sizeof(*h2));
+    if (!h2) {
+        return false;
+    }
+
+    memset(h2, 0, sizeof(*h2));
+    if (hpack_decoder_init(&h2->decoder, HPACK_DEFAULT_TABLE_SIZE) != HPACK_OK) {
+        system_free(h2);
+        return false;
+    }
+    buffer_construct(&h2->header_block);
+    h2->send_window = HTTP2_DEFAULT_WINDOW;
+    h2->initial_window = HTTP2_DEFAULT_WINDOW;
+    session->http2 = h2;
+
+    uint8_t *p = http2_frame_allocate(&session->stream, HTTP2_FRAME_SETTINGS, 0, 0, 6);
+    p[0] = 0;
+    p[1] = HTTP2_SETTING_MAX_CONCURRENT_STREAMS;
+    http2_write32(p + 2, IO_URING_ADAPTER_HTTP2_MAX_STREAMS);
+    return true;
+}
+
+/**
+ * @brief Frame as much of a stream's response body as the windows allow
+ * @return True once the whole body is queued
+ */
+static bool http2_send_body(server_session *session, http2_stream *hs)
+{
+    server_http2 *h2 = session->http2;
+    stream *st = &session->stream;
+    stream_extent *body = &hs->body;
+
+    while (body->size > 0) {
+        int64_t window = h2->send_window < hs->window ? h2->send_window : hs->window;
+        if (window <= 0) {
+            return false;
+        }
+
+        size_t chunk = body->size < IO_URING_ADAPTER_HTTP2_FRAME_SIZE ? body->size : IO_URING_ADAPTER_HTTP2_FRAME_SIZE;
+        if ((int64_t)chunk > window) {
+            chunk = (size_t)window;
+        }
+        bool last = chunk == body->size;
+        stream_release *release = last ? body->release : NULL;
+
+        /* Referenced bodies stay zero-copy: each frame's payload is an extent */
+        http2_frame_header(st, HTTP2_FRAME_DATA, last ? HTTP2_FLAG_END_STREAM : 0, hs->id, chunk);
+        if (hs->copy) {
+            memcpy(stream_allocate(st, chunk), body->base, chunk);
+        } else if (body->base) {
+            stream_write_reference(st, segment_make((void *)body->base, chunk), release, body->arg);
+        } else {
+            stream_splice_file(st, body->fd, body->offset, chunk, release, body->arg);
+        }
+
+        if (body->base) {
+            body->base = (const char *)body->base + chunk;
+        } else {
+            body->offset += (off_t)chunk;
+        }
+        body->size -= chunk;
+        h2->send_window -= (int64_t)chunk;
+        hs->window -= (int64_t)chunk;
+        if (last && !hs->copy) {
+            body->release = NULL;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Resume the bodies the windows held back
+ */
+static void http2_send_pending(server_session *session)
+{
+    server_http2 *h2 = session->http2;
+    http2_stream **link = &h2->streams;
+
+    while (*link && h2->send_window > 0) {
+        http2_stream *hs = *link;
+        if (!hs->receiving && hs->body.size > 0 && http2_send_body(session, hs)) {
+            *link = hs->next;
+            http2_free_stream(h2, hs);
+            continue;
+        }
+        link = &hs->next;
+    }
+    http2_check_close(session);
+}
+
+/**
+ * @brief Queue a header block as HEADERS and CONTINUATION frames
+ */
+static void http2_send_headers(server_session *session, uint32_t id, segment block, bool end_stream)
+{
+    stream *st = &session->stream;
+    const char *p = block.base;
+    size_t left = block.size;
+    uint8_t type = HTTP2_FRAME_HEADERS;
+    uint8_t flags = end_stream ? HTTP2_FLAG_END_STREAM : 0;
+
+    do {
+        size_t chunk = left < IO_URING_ADAPTER_HTTP2_FRAME_SIZE ? left : IO_URING_ADAPTER_HTTP2_FRAME_SIZE;
+        if (chunk == left) {
+            flags |= HTTP2_FLAG_END_HEADERS;
+        }
+        memcpy(http2_frame_allocate(st, type, flags, id, chunk), p, chunk);
+        p += chunk;
+        left -= chunk;
+        type = HTTP2_FRAME_CONTINUATION;
+        flags = 0;
+    } while (left > 0);
+}
+
+/**
+ * @brief Queue the response of the stream being dispatched
+ * @param body Body, NULL for none
+ * @param copy The body memory is only valid during the call
+ */
+static void http2_respond(server_context *context, segment headers, const stream_extent *body, bool copy)
+{
+    server_session *session = context->session;
+    server_http2 *h2 = session->http2;
+    bool empty = !body || body->size == 0;
+
+    if (!h2 || context->stream_id == 0 || h2->responded) {
+        log_error("io_uring adapter: HTTP/2 response without a stream to answer");
+        if (body && body->release) {
+            body->release(body->arg);
+        }
+        return;
+    }
+    h2->responded = true;
+
+    http2_send_headers(session, context->stream_id, headers, empty);
+    if (empty) {
+        if (body && body->release) {
+            body->release(body->arg);
+        }
+        return;
+    }
+
+    http2_stream *hs = http2_find_stream(h2, context->stream_id);
+    if (!hs && !(hs = http2_open_stream(h2, context->stream_id))) {
+        if (body->release) {
+            body->release(body->arg);
+        }
+        http2_send_rst(session, context->stream_id, HTTP2_INTERNAL_ERROR);
+        return;
+    }
+
+    hs->body = *body;
+    hs->copy = copy;
+    if (!http2_send_body(session, hs) && copy) {
+        /* Keep what the windows held back */
+        buffer_insert(&hs->owned, 0, hs->body.base, hs->body.size);
+        hs->body.base = hs->owned.data;
+    }
+}
+
+/**
+ * @brief Dispatch a complete request as a SERVER_REQUEST
+ * @param request Method, target, body and conditional fields of the stream
+ * @return False if the callback asked to close the connection
+ */
+static bool http2_dispatch(server_session *session, uint32_t id, const http_request *request)
+{
+    server *s = session->server;
+    server_http2 *h2 = session->http2;
+    stream *st = &session->stream;
+    size_t output = st->output.size;
+    size_t extents = stream_extent_count(&st->extents);
+
+    session->context.request = *request;
+    session->context.request.minor_version = 1;
+    session->context.request.close = false;
+    session->context.stream_id = id;
+    h2->responded = false;
+
+    core_event event = {
+        .type = SERVER_REQUEST,
+        .state = s->user.state,
+        .data = (uintptr_t)&session->context
+    };
+    size_t traced = session_trace_begin(session, id);
+    core_status status = s->user.callback(&event);
+    session_trace_end(session, traced);
+    if (status != CORE_OK) {
+        return false;
+    }
+
+    if (!h2->responded) {
+        /* Output written the HTTP/1.x way would break the framing */
+        size_t count = stream_extent_count(&st->extents);
+        for (size_t i = extents; i < count; i++) {
+            stream_extent *extent = stream_extent_at(&st->extents, i);
+            if (extent->release) {
+                extent->release(extent->arg);
+            }
+        }
+        st->extents.size = extents * sizeof(stream_extent);
+        st->output.size = output;
+        http2_send_rst(session, id, HTTP2_INTERNAL_ERROR);
+    }
+
+    http2_stream *hs = http2_find_stream(h2, id);
+    if (hs && hs->body.size == 0) {
+        http2_close_stream(h2, hs);
+    } else if (hs) {
+        buffer_destruct(&hs->request);
+    }
+
+    session->flags = (session->flags | SESSION_ANSWERED) & ~SESSION_HEADER_TIMER;
+    if (s->limits.max_requests > 0 && ++session->requests >= s->limits.max_requests) {
+        http2_shutdown(session);
+    }
+    return true;
+}
+
+/**
+ * @brief Dispatch a stream whose request arrived over several frames
+ * @note Only method and target are kept while the body arrives; a request
+ *       with a body is not conditional
+ */
+static bool http2_dispatch_stream(server_session *session, http2_stream *hs)
+{
+    char *data = hs->request.data;
+    size_t head = hs->method_length + hs->target_length;
+    http_request request = {
+        .method = segment_make(data, hs->method_length),
+        .target = segment_make(data + hs->method_length, hs->target_length),
+        .body = segment_make(data + head, hs->request.size - head)
+    };
+    return http2_dispatch(session, hs->id, &request);
+}
+
+/**
+ * @brief Strip the padding of a DATA or HEADERS payload
+ * @return False if the padding is longer than the payload
+ */
+static bool http2_strip_padding(const http2_frame *frame, const uint8_t **payload, size_t *length)
+{
+    if (!(frame->flags & HTTP2_FLAG_PADDED)) {
+        return true;
+    }
+    if (*length == 0 || (*payload)[0] >= *length) {
+        return false;
+    }
+    *length -= 1 + (size_t)(*payload)[0];
+    *payload += 1;
+    return true;
+}
+
+/**
+ * @brief Decode a complete header block and start or finish its stream
+ */
+static bool http2_handle_header_block(server_session *session, uint32_t id, bool end_stream,
+                                      const uint8_t *block, size_t length)
+{
+    server_http2 *h2 = session->http2;
+    hpack_field_t fields[HTTP2_MAX_FIELDS];
+    char scratch[HTTP2_SCRATCH_SIZE];
+    size_t count;
+
+    /* Decoded even for streams that are refused, the table has to stay in sync */
+    hpack_error_t err = hpack_decode(&h2->decoder, block, length, fields, HTTP2_MAX_FIELDS, &count,
+                                     scratch, sizeof(scratch));
+    if (err != HPACK_OK) {
+        http2_fail(session, err == HPACK_ERROR_TOO_LARGE ? HTTP2_ENHANCE_YOUR_CALM : HTTP2_COMPRESSION_ERROR);
+        return true;
+    }
+
+    http2_stream *hs = http2_find_stream(h2, id);
+    if (hs) {
+        /* Trailers end a request body; their fields are not passed on */
+        if (!hs->receiving || !end_stream) {
+            http2_send_rst(session, id, hs->receiving ? HTTP2_PROTOCOL_ERROR : HTTP2_STREAM_CLOSED);
+            http2_close_stream(h2, hs);
+            return true;
+        }
+        hs->receiving = false;
+        return http2_dispatch_stream(session, hs);
+    }
+
+    if ((id & 1) == 0 || id <= h2->last_stream_id) {
+        http2_fail(session, HTTP2_PROTOCOL_ERROR);
+        return true;
+    }
+    if (h2->goaway) {
+        return true;
+    }
+    h2->last_stream_id = id;
+
+    if (h2->stream_count >= IO_URING_ADAPTER_HTTP2_MAX_STREAMS) {
+        http2_send_rst(session, id, HTTP2_REFUSED_STREAM);
+        return true;
+    }
+
+    segment method = { 0 }, target = { 0 };
+    for (size_t i = 0; i < count && fields[i].name_length > 0 && fields[i].name[0] == ':'; i++) {
+        const hpack_field_t *field = &fields[i];
+        if (field->name_length == 7 && memcmp(field->name, ":method", 7) == 0) {
+            method = segment_make((void *)field->value, field->value_length);
+        } else if (field->name_length == 5 && memcmp(field->name, ":path", 5) == 0) {
+            target = segment_make((void *)field->value, field->value_length);
+        }
+    }
+    if (method.size == 0 || target.size == 0) {
+        http2_send_rst(session, id, HTTP2_PROTOCOL_ERROR);
+        return true;
+    }
+
+    if (end_stream) {
+        http_request request = { .method = method, .target = target, .body = segment_make(target.base, 0) };
+        for (size_t i = 0; i < count; i++) {
+            const hpack_field_t *field = &fields[i];
+            if (field->name_length == 13 && memcmp(field->name, "if-none-match", 13) == 0) {
+                request.if_none_match = segment_make((void *)field->value, field->value_length);
+            } else if (field->name_length == 17 && memcmp(field->name, "if-modified-since", 17) == 0) {
+                request.if_modified_since = segment_make((void *)field->value, field->value_length);
+            }
+        }
+        return http2_dispatch(session, id, &request);
+    }
+
+    /* The body follows in DATA frames; the fields only live until we return */
+    hs = http2_open_stream(h2, id);
+    if (!hs) {
+        http2_send_rst(session, id, HTTP2_INTERNAL_ERROR);
+        return true;
+    }
+    hs->receiving = true;
+    hs->method_length = method.size;
+    hs->target_length = target.size;
+    buffer_insert(&hs->request, 0, method.base, method.size);
+    buffer_insert(&hs->request, method.size, target.base, target.size);
+    return true;
+}
+
+static bool http2_handle_headers(server_session *session, const http2_frame *frame)
+{
+    server_http2 *h2 = session->http2;
+    const uint8_t *payload = frame->payload;
+    size_t length = frame->length;
+
+    if (frame->id == 0 || !http2_strip_padding(frame, &payload, &length)) {
+        http2_fail(session, HTTP2_PROTOCOL_ERROR);
+        return true;
+    }
+    if (frame->flags & HTTP2_FLAG_PRIORITY) {
+        /* Priorities are not acted on */
+        if (length < 5) {
+            http2_fail(session, HTTP2_FRAME_SIZE_ERROR);
+            return true;
+        }
+        payload += 5;
+        length -= 5;
+    }
+
+    bool end_stream = frame->flags & HTTP2_FLAG_END_STREAM;
+    if (frame->flags & HTTP2_FLAG_END_HEADERS) {
+        return http2_handle_header_block(session, frame->id, end_stream, payload, length);
+    }
+
+    buffer_clear(&h2->header_block);
+    buffer_insert(&h2->header_block, 0, payload, length);
+    h2->continuation_id = frame->id;
+    h2->continuation_end_stream = end_stream;
+    return true;
+}
+
+static bool http2_handle_continuation(server_session *session, const http2_frame *frame)
+{
+    server_http2 *h2 = session->http2;
+    buffer *block = &h2->header_block;
+
+    if (block->size + frame->length > IO_URING_ADAPTER_MAX_REQUEST_SIZE) {
+        http2_fail(session, HTTP2_ENHANCE_YOUR_CALM);
+        return true;
+    }
+    buffer_insert(block, block->size, frame->payload, frame->length);
+    if (!(frame->flags & HTTP2_FLAG_END_HEADERS)) {
+        return true;
+    }
+
+    h2->continuation_id = 0;
+    bool ok = http2_handle_header_block(session, frame->id, h2->continuation_end_stream,
+                                        (const uint8_t *)block->data, block->size);
+    buffer_destruct(block);
+    return ok;
+}
+
+static bool http2_handle_data(server_session *session, const http2_frame *frame)
+{
+    server_http2 *h2 = session->http2;
+    const uint8_t *payload = frame->payload;
+    size_t length = frame->length;
+
+    if (frame->id == 0 || !http2_strip_padding(frame, &payload, &length)) {
+        http2_fail(session, HTTP2_PROTOCOL_ERROR);
+        return true;
+    }
+
+    /* Padding counts against the windows too; the connection's is restored at once */
+    if (frame->length > 0) {
+        http2_send_window_update(session, 0, frame->length);
+    }
+
+    http2_stream *hs = http2_find_stream(h2, frame->id);
+    if (!hs || !hs->receiving) {
+        if (frame->id > h2->last_stream_id) {
+            http2_fail(session, HTTP2_PROTOCOL_ERROR);
+            return true;
+        }
+        http2_send_rst(session, frame->id, HTTP2_STREAM_CLOSED);
+        if (hs) {
+            http2_close_stream(h2, hs);
+        }
+        return true;
+    }
+
+    if (hs->request.size + length > IO_URING_ADAPTER_MAX_REQUEST_SIZE) {
+        http2_send_rst(session, frame->id, HTTP2_ENHANCE_YOUR_CALM);
+        http2_close_stream(h2, hs);
+        return true;
+    }
+    buffer_insert(&hs->request, hs->request.size, payload, length);
+
+    if (frame->flags & HTTP2_FLAG_END_STREAM) {
+        hs->receiving = false;
+        return http2_dispatch_stream(session, hs);
+    }
+    if (frame->length > 0) {
+        http2_send_window_update(session, frame->id, frame->length);
+    }
+    return true;
+}
+
+/**
+ * @brief Apply the peer's settings
+ * @return False after a connection error
+ */
+static bool http2_apply_settings(server_session *session, const uint8_t *p, size_t length)
+{
+    server_http2 *h2 = session->http2;
+
+    for (size_t i = 0; i + 6 <= length; i += 6) {
+        unsigned id = (unsigned)p[i] << 8 | p[i + 1];
+        uint32_t value = http2_read32(p + i + 2);
+
+        switch (id) {
+            case HTTP2_SETTING_ENABLE_PUSH:
+                if (value > 1) {
+                    http2_fail(session, HTTP2_PROTOCOL_ERROR);
+                    return false;
+                }
+                break;
+
+            case HTTP2_SETTING_INITIAL_WINDOW_SIZE: {
+                if (value > HTTP2_MAX_WINDOW) {
+                    http2_fail(session, HTTP2_FLOW_CONTROL_ERROR);
+                    return false;
+                }
+                /* Open streams move by the difference and may go negative */
+                int64_t delta = (int64_t)value - h2->initial_window;
+                for (http2_stream *hs = h2->streams; hs; hs = hs->next) {
+                    hs->window += delta;
+                    if (hs->window > HTTP2_MAX_WINDOW) {
+                        http2_fail(session, HTTP2_FLOW_CONTROL_ERROR);
+                        return false;
+                    }
+                }
+                h2->initial_window = value;
+                break;
+            }
+
+            case HTTP2_SETTING_MAX_FRAME_SIZE:
+                /* Frames we send never exceed the minimum every peer accepts */
+                if (value < IO_URING_ADAPTER_HTTP2_FRAME_SIZE || value > 0xffffff) {
+                    http2_fail(session, HTTP2_PROTOCOL_ERROR);
+                    return false;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    http2_send_pending(session);
+    return true;
+}
+
+static void http2_handle_settings(server_session *session, const http2_frame *frame)
+{
+    if (frame->id != 0) {
+        http2_fail(session, HTTP2_PROTOCOL_ERROR);
+    } else if (frame->flags & HTTP2_FLAG_ACK) {
+        if (frame->length != 0) {
+            http2_fail(session, HTTP2_FRAME_SIZE_ERROR);
+        }
+    } else if (frame->length % 6 != 0) {
+        http2_fail(session, HTTP2_FRAME_SIZE_ERROR);
+    } else if (http2_apply_settings(session, frame->payload, frame->length)) {
+        (void)http2_frame_allocate(&session->stream, HTTP2_FRAME_SETTINGS, HTTP2_FLAG_ACK, 0, 0);
+    }
+}
+
+static void http2_handle_window_update(server_session *session, const http2_frame *frame)
+{
+    server_http2 *h2 = session->http2;
+    if (frame->length != 4) {
+        http2_fail(session, HTTP2_FRAME_SIZE_ERROR);
+        return;
+    }
+
+    uint32_t increment = http2_read32(frame->payload) & 0x7fffffff;
+    if (frame->id == 0) {
+        h2->send_window += increment;
+        if (increment == 0 || h2->send_window > HTTP2_MAX_WINDOW) {
+            http2_fail(session, increment ? HTTP2_FLOW_CONTROL_ERROR : HTTP2_PROTOCOL_ERROR);
+            return;
+        }
+        http2_send_pending(session);
+        return;
+    }
+
+    /* Updates for streams already closed are expected and ignored */
+    http2_stream *hs = http2_find_stream(h2, frame->id);
+    if (!hs) {
+        return;
+    }
+    hs->window += increment;
+    if (increment == 0 || hs->window > HTTP2_MAX_WINDOW) {
+        http2_send_rst(session, hs->id, increment ? HTTP2_FLOW_CONTROL_ERROR : HTTP2_PROTOCOL_ERROR);
+        http2_close_stream(h2, hs);
+    } else if (!hs->receiving && hs->body.size > 0 && http2_send_body(session, hs)) {
+        http2_close_stream(h2, hs);
+    }
+    http2_check_close(session);
+}
+
+/**
+ * @brief Act on one frame
+ * @return False if the callback asked to close the connection
+ */
+static bool http2_handle_frame(server_session *session, const http2_frame *frame)
+{
+    server_http2 *h2 = session->http2;
+
+    /* A header block may not be interleaved with other frames */
+    if (h2->continuation_id != 0 &&
+        (frame->type != HTTP2_FRAME_CONTINUATION || frame->id != h2->continuation_id)) {
+        http2_fail(session, HTTP2_PROTOCOL_ERROR);
+        return true;
+    }
+
+    switch (frame->type) {
+        case HTTP2_FRAME_DATA:
+            return http2_handle_data(session, frame);
+
+        case HTTP2_FRAME_HEADERS:
+            return http2_handle_headers(session, frame);
+
+        case HTTP2_FRAME_CONTINUATION:
+            if (h2->continuation_id == 0) {
+                http2_fail(session, HTTP2_PROTOCOL_ERROR);
+                return true;
+            }
+            return http2_handle_continuation(session, frame);
+
+        case HTTP2_FRAME_PRIORITY:
+            if (frame->id == 0) {
+                http2_fail(session, HTTP2_PROTOCOL_ERROR);
+            } else if (frame->length != 5) {
+                http2_send_rst(session, frame->id, HTTP2_FRAME_SIZE_ERROR);
+            }
+            break;
+
+        case HTTP2_FRAME_RST_STREAM: {
+            if (frame->id == 0 || frame->id > h2->last_stream_id) {
+                http2_fail(session, HTTP2_PROTOCOL_ERROR);
+                break;
+            }
+            if (frame->length != 4) {
+                http2_fail(session, HTTP2_FRAME_SIZE_ERROR);
+                break;
+            }
+            http2_stream *hs = http2_find_stream(h2, frame->id);
+            if (hs) {
+                http2_close_stream(h2, hs);
+                http2_check_close(session);
+            }
+            break;
+        }
+
+        case HTTP2_FRAME_SETTINGS:
+            http2_handle_settings(session, frame);
+            break;
+
+        case HTTP2_FRAME_PING:
+            if (frame->id != 0) {
+                http2_fail(session, HTTP2_PROTOCOL_ERROR);
+            } else if (frame->length != 8) {
+                http2_fail(session, HTTP2_FRAME_SIZE_ERROR);
+            } else if (!(frame->flags & HTTP2_FLAG_ACK)) {
+                memcpy(http2_frame_allocate(&session->stream, HTTP2_FRAME_PING, HTTP2_FLAG_ACK, 0, 8),
+                       frame->payload, 8);
+            }
+            break;
+
+        case HTTP2_FRAME_GOAWAY:
+            if (frame->id != 0) {
+                http2_fail(session, HTTP2_PROTOCOL_ERROR);
+            } else {
+                http2_shutdown(session);
+            }
+            break;
+
+        case HTTP2_FRAME_WINDOW_UPDATE:
+            http2_handle_window_update(session, frame);
+            break;
+
+        case HTTP2_FRAME_PUSH_PROMISE:
+            /* Clients do not push */
+            http2_fail(session, HTTP2_PROTOCOL_ERROR);
+            break;
+
+        default:
+            /* Unknown frame types are ignored */
+            break;
+    }
+    return true;
+}
+
+/**
+ * @brief Handle every complete frame in data
+ * @return Bytes consumed, or -1 if the session must close
+ */
+static ssize_t http2_process(server_session *session, char *data, size_t size)
+{
+    server_http2 *h2 = session->http2;
+    size_t offset = 0;
+
+    if (!h2->preface) {
+        size_t length = size < HTTP2_PREFACE_LENGTH ? size : HTTP2_PREFACE_LENGTH;
+        if (memcmp(data, HTTP2_PREFACE, length) != 0) {
+            metrics_add(METRICS_PARSE_ERRORS, 1);
+            return -1;
+        }
+        if (length < HTTP2_PREFACE_LENGTH) {
+            return 0;
+        }
+        h2->preface = true;
+        offset = HTTP2_PREFACE_LENGTH;
+        /* From here on the connection waits like a keep-alive connection between frames */
+        session->flags = (session->flags | SESSION_ANSWERED) & ~SESSION_HEADER_TIMER;
+    }
+
+    while (size - offset >= HTTP2_FRAME_HEADER_SIZE && !(session->flags & SESSION_CLOSE_AFTER_SEND)) {
+        const uint8_t *p = (const uint8_t *)data + offset;
+        http2_frame frame = {
+            .length = (size_t)p[0] << 16 | (size_t)p[1] << 8 | p[2],
+            .type = p[3],
+            .flags = p[4],
+            .id = http2_read32(p + 5) & 0x7fffffff,
+            .payload = p + HTTP2_FRAME_HEADER_SIZE
+        };
+        if (frame.length > IO_URING_ADAPTER_HTTP2_FRAME_SIZE) {
+            http2_fail(session, HTTP2_FRAME_SIZE_ERROR);
+            break;
+        }
+        if (size - offset - HTTP2_FRAME_HEADER_SIZE < frame.length) {
+            break;
+        }
+        offset += HTTP2_FRAME_HEADER_SIZE + frame.length;
+
+        if (!http2_handle_frame(session, &frame)) {
+            return -1;
+        }
+    }
+
+    /* Once the connection is closing the rest of the input is not looked at */
+    return session->flags & SESSION_CLOSE_AFTER_SEND ? (ssize_t)size : (ssize_t)offset;
+}
+
+/**
+ * @brief Decode an HTTP2-Settings value (base64url without padding)
+ * @return Bytes written, (size_t)-1 if invalid or longer than size
+ */
+static size_t http2_decode_settings(segment value, uint8_t *out, size_t size)
+{
+    const char *in = value.base;
+    uint32_t bits = 0;
+    unsigned count = 0;
+    size_t used = 0;
+
+    for (size_t i = 0; i < value.size && in[i] != '='; i++) {
+        char c = in[i];
+        unsigned digit;
+        if (c >= 'A' && c <= 'Z') {
+            digit = (unsigned)(c - 'A');
+        } else if (c >= 'a' && c <= 'z') {
+            digit = (unsigned)(c - 'a') + 26;
+        } else if (c >= '0' && c <= '9') {
+            digit = (unsigned)(c - '0') + 52;
+        } else if (c == '-') {
+            digit = 62;
+        } else if (c == '_') {
+            digit = 63;
+        } else {
+            return (size_t)-1;
+        }
+
+        bits = bits << 6 | digit;
+        count += 6;
+        if (count >= 8) {
+            if (used == size) {
+                return (size_t)-1;
+            }
+            count -= 8;
+            out[used++] = (uint8_t)(bits >> count);
+        }
+    }
+    return used;
+}
+
+/**
+ * @brief Answer an Upgrade: h2c request as stream 1 of a new HTTP/2 connection
+ * @return 1 once upgraded, 0 to serve the request as HTTP/1.1, -1 to close
+ */
+static int http2_upgrade(server_session *session, segment settings_value)
+{
+    static const char switching[] = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+    uint8_t settings[HTTP2_UPGRADE_SETTINGS_SIZE];
+
+    size_t length = http2_decode_settings(settings_value, settings, sizeof(settings));
+    if (length == (size_t)-1 || length % 6 != 0) {
+        return 0;
+    }
+
+    stream_write(&session->stream, segment_make((void *)switching, sizeof(switching) - 1));
+    if (!http2_open(session)) {
+        return -1;
+    }
+
+    /* The settings count as received; the 101 acknowledges them */
+    session->http2->last_stream_id = 1;
+    if (!http2_apply_settings(session, settings, length)) {
+        return 1;
+    }
+    http_request *request = &session->context.request;
+    return http2_dispatch(session, 1, request) ? 1 : -1;
+}
+
+/**
+ * @brief Queue an error response and close once it is sent
+ * @param status Status line after the version
+ */
+static void session_reject(server_session *session, segment status)
+{
+    segment date = http_date(0);
+    size_t size = strlen("HTTP/1.1 ") + status.size + strlen("\r\nServer: L\r\nDate: ") + date.size +
+                  strlen("\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    char *p = stream_allocate(&session->stream, size);
+
+#define APPEND(base, len) do { memcpy(p, (base), (len)); p += (len); } while (0)
+    APPEND("HTTP/1.1 ", 9);
+    APPEND(status.base, status.size);
+    APPEND("\r\nServer: L\r\nDate: ", 19);
+    APPEND(date.base, date.size);
+    APPEND("\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", 42);
+#undef APPEND
+
+    session->flags |= SESSION_ANSWERED | SESSION_CLOSE_AFTER_SEND;
+}
+
+/**
+ * @brief Dispatch every complete request in data
+ * @return Bytes consumed, or -1 if the session must close
+ */
+static ssize_t session_process(server_session *session, char *data, size_t size)
+{
+    server *s = session->server;
+    size_t offset = 0;
+
+    if (session->http2) {
+        return http2_process(session, data, size);
+    }
+    if (s->http2 && !(session->flags & SESSION_ANSWERED) && data[0] == 'P') {
+        /* Prior knowledge: the client opens with the preface instead of a request */
+        size_t length = size < HTTP2_PREFACE_LENGTH ? size : HTTP2_PREFACE_LENGTH;
+        if (memcmp(data, HTTP2_PREFACE, length) == 0) {
+            if (length < HTTP2_PREFACE_LENGTH) {
+                return 0;
+            }
+            return http2_open(session) ? http2_process(session, data, size) : -1;
+        }
+    }
+
+    while (offset < size) {
+        segment upgrade, error;
+        ssize_t n = http_request_parse(&session->context.request, data + offset, size - offset, &upgrade,
+                                       &error);
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            /* Answered after the responses to the requests before it, as the stream can't be resynced */
+            metrics_add(METRICS_PARSE_ERRORS, 1);
+            session_reject(session, error);
+            return (ssize_t)size;
+        }
+        offset += (size_t)n;
+
+        /* Requests with a body are served as HTTP/1.1, as the upgrade would have to wait for it */
+        if (upgrade.base && s->http2 && !s->draining && session->context.request.body.size == 0) {
+            int upgraded = http2_upgrade(session, upgrade);
+            if (upgraded < 0) {
+                return -1;
+            }
+            if (upgraded > 0) {
+                ssize_t rest = http2_process(session, data + offset, size - offset);
+                return rest < 0 ? -1 : (ssize_t)offset + rest;
+            }
+        }
+
+        core_event event = {
+            .type = SERVER_REQUEST,
+            .state = s->user.state,
+            .data = (uintptr_t)&session->context
+        };
+        size_t traced = session_trace_begin(session, 0);
+        core_status status = s->user.callback(&event);
+        session_trace_end(session, traced);
+        if (status != CORE_OK) {
+            return -1;
+        }
+        session->flags = (session->flags | SESSION_ANSWERED) & ~SESSION_HEADER_TIMER;
+
+        if (session->context.request.close ||
+            (s->limits.max_requests > 0 && ++session->requests >= s->limits.max_requests)) {
+            session->flags |= SESSION_CLOSE_AFTER_SEND;
+            return (ssize_t)size;
+        }
+    }
+
+    return (ssize_t)offset;
+}
+
+static void session_handle_recv(server_session *session, struct io_uring_cqe *cqe)
+{
+    server *s = session->server;
+    bool more = cqe->flags & IORING_CQE_F_MORE;
+    if (!more) {
+        session->flags &= ~SESSION_RECV_ARMED;
+        session->refs--;
+    }
+
+    if (cqe->res <= 0) {
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            buffers_recycle(&s->core->buffers, (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+        }
+        if (cqe->res == -ENOBUFS && !(session->flags & SESSION_CLOSING)) {
+            /* Buffer ring ran dry; re-arm once buffers are recycled */
+            if (!more) {
+                session_arm_recv(session);
+            }
+            return;
+        }
+        session_close(session);
+        return;
+    }
+
+    uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    char *data = buffers_address(&s->core->buffers, bid);
+    size_t size = (size_t)cqe->res;
+    metrics_add(METRICS_BYTES_IN, size);
+
+    if (session->flags & (SESSION_CLOSING | SESSION_CLOSE_AFTER_SEND)) {
+        /* Input after Connection: close is discarded; pending output still goes out */
+        buffers_recycle(&s->core->buffers, bid);
+        if (session->flags & SESSION_CLOSING) {
+            session_close(session);
+        }
+        return;
+    }
+
+    ssize_t consumed;
+    buffer *input = &session->stream.input;
+    trace_receive();
+    if (input->size == 0) {
+        /* Fast path: parse straight out of the provided buffer */
+        consumed = session_process(session, data, size);
+        if (consumed >= 0 && (size_t)consumed < size) {
+            buffer_insert(input, 0, data + consumed, size - (size_t)consumed);
+        }
+    } else {
+        buffer_insert(input, input->size, data, size);
+        consumed = session_process(session, input->data, input->size);
+        if (consumed > 0) {
+            buffer_erase(input, 0, (size_t)consumed);
+            if (input->size == 0) {
+                buffer_destruct(input);
+            }
+        }
+    }
+    buffers_recycle(&s->core->buffers, bid);
+
+    if (consumed < 0) {
+        session_close(session);
+        return;
+    }
+
+    /* Draining: answer what arrived, then close between requests */
+    if (session->http2) {
+        if (s->draining) {
+            http2_shutdown(session);
+        }
+    } else if (s->draining && input->size == 0) {
+        session->flags |= SESSION_CLOSE_AFTER_SEND;
+    }
+
+    session_schedule_flush(session);
+    session_update_timer(session);
+
+    if (session->flags & SESSION_CLOSE_AFTER_SEND) {
+        return;
+    }
+
+    if (!more && !(session->flags & SESSION_CLOSING)) {
+        session_arm_recv(session);
+    }
+}
+
+static void session_handle_send(server_session *session, struct io_uring_cqe *cqe)
+{
+    stream *st = &session->stream;
+    session->flags &= ~SESSION_SENDING;
+    session->refs--;
+
+    if (session->flags & SESSION_CLOSING) {
+        session_close(session);
+        return;
+    }
+
+    if (cqe->res < 0) {
+        session_close(session);
+        return;
+    }
+
+    switch (st->send_op) {
+        case SEND_OP_SPLICE_IN:
+            if (cqe->res == 0) {
+                /* File shrank under us; the response can no longer be framed */
+                session_close(session);
+                return;
+            }
+            st->piped = (size_t)cqe->res;
+            session_submit_send(session);
+            session_update_timer(session);
+            return;
+
+        case SEND_OP_SPLICE_OUT:
+            st->piped -= (size_t)cqe->res;
+            break;
+
+        default:
+            break;
+    }
+
+    metrics_add(METRICS_BYTES_OUT, (uint64_t)cqe->res);
+    if (st->send_op == SEND_OP_BYTES) {
+        st->sent += (size_t)cqe->res;
+    } else {
+        stream_advance(st, (size_t)cqe->res);
+    }
+
+    if (st->piped > 0 || !stream_sending_done(st)) {
+        session_submit_send(session);
+        session_update_timer(session);
+        return;
+    }
+
+    stream_release_extents(&st->sending_extents);
+    st->sent = 0;
+    st->extent_index = 0;
+    st->extent_sent = 0;
+    if (session->flags & SESSION_TRACE_SENDING) {
+        session->flags &= ~SESSION_TRACE_SENDING;
+        trace_commit(&session->trace);
+    }
+    if (st->output.size > 0 || st->extents.size > 0 || (session->flags & SESSION_CLOSE_AFTER_SEND)) {
+        buffer_clear(&st->sending);
+        session_schedule_flush(session);
+    } else {
+        /* Idle: hand the output buffers back to the pool until the next request */
+        buffer_destruct(&st->sending);
+        buffer_destruct(&st->output);
+        buffer_destruct(&st->sending_extents);
+        buffer_destruct(&st->extents);
+    }
+    session_update_timer(session);
+}
+
+/* ------------------------------------------------------------------------ */
+/* server                                                                    */
+/* ------------------------------------------------------------------------ */
+
+static void server_report_error(server *s)
+{
+    /* The callback may destruct the server, so keep the reactor pointer */
+    core *c = s->core;
+    core_event event = { .type = SERVER_ERROR, .state = s->user.state, .data = 0 };
+    if (s->user.callback(&event) != CORE_OK) {
+        core_abort(c);
+    }
+}
+
+static void server_arm_accept(server *s)
+{
+    struct io_uring_sqe *sqe = ring_get_sqe(&s->core->ring);
+    if (!sqe) {
+        return;
+    }
+
+    /* Blocking sockets: io_uring polls them itself, O_NONBLOCK would surface -EAGAIN */
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = s->fd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = user_data_make(s, OP_ACCEPT);
+    s->accepting = true;
+}
+
+/**
+ * @brief Apply the configured options to an accepted connection
+ */
+static void server_apply_options(server *s, int fd)
+{
+    core *c = s->core;
+
+    for (size_t i = 0; i < s->option_count; i++) {
+        server_socket_option *option = &s->options[i];
+        struct io_uring_sqe *sqe = c->sockopt_sync ? NULL : ring_get_sqe(&c->ring);
+        if (!sqe) {
+            if (setsockopt(fd, option->level, option->name, &option->value, sizeof(option->value)) == -1) {
+                log_debug("setsockopt(%d, %d) failed: %s", option->level, option->name, strerror(errno));
+            }
+            continue;
+        }
+
+        /* The connection's first receive follows in the same submission */
+        sqe->opcode = IORING_OP_URING_CMD;
+        sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+        sqe->fd = fd;
+        sqe->cmd_op = IO_URING_ADAPTER_SOCKET_SETSOCKOPT;
+        sqe->addr = (uint32_t)option->level | (uint64_t)(uint32_t)option->name << 32;
+        sqe->splice_fd_in = sizeof(option->value);
+        sqe->addr3 = (uint64_t)(uintptr_t)&option->value;
+        sqe->user_data = user_data_make(NULL, OP_SOCKOPT);
+    }
+}
+
+/**
+ * @brief Count connections whose packets are processed on another CPU than ours
+ */
+static void server_check_cpu(server *s, int fd)
+{
+    if (s->accepts++ % IO_URING_ADAPTER_CPU_CHECK_INTERVAL != 0) {
+        return;
+    }
+
+    int incoming = -1;
+    socklen_t length = sizeof(incoming);
+    if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &incoming, &length) == -1 || incoming < 0) {
+        return;
+    }
+
+    metrics_add(METRICS_CPU_CHECKS, 1);
+    if (incoming != sched_getcpu()) {
+        metrics_add(METRICS_CPU_MISMATCHES, 1);
+    }
+}
+
+static void server_handle_accept(server *s, struct io_uring_cqe *cqe)
+{
+    bool more = cqe->flags & IORING_CQE_F_MORE;
+
+    if (cqe->res >= 0) {
+        server_session *session = NULL;
+        if (s->limits.max_connections == 0 || s->connections < s->limits.max_connections) {
+            session = system_malloc(sizeof(*session));
+        } else {
+            metrics_add(METRICS_REJECTS, 1);
+        }
+        if (!session) {
+            close(cqe->res);
+        } else {
+            memset(session, 0, sizeof(*session));
+            timer_wheel_timer_init(&session->timer, session_handle_timeout);
+            session->server = s;
+            session->fd = cqe->res;
+            session->context.session = session;
+            buffer_construct(&session->stream.input);
+            buffer_construct(&session->stream.output);
+            buffer_construct(&session->stream.sending);
+            buffer_construct(&session->stream.extents);
+            buffer_construct(&session->stream.sending_extents);
+            session->stream.pipe[0] = session->stream.pipe[1] = -1;
+
+            session->next = s->sessions;
+            if (s->sessions) {
+                s->sessions->prev = session;
+            }
+            s->sessions = session;
+            s->connections++;
+            s->core->active++;
+            metrics_add(METRICS_ACCEPTS, 1);
+
+            server_apply_options(s, session->fd);
+            server_check_cpu(s, session->fd);
+            session_arm_recv(session);
+            session_update_timer(session);
+        }
+    }
+
+    if (!more) {
+        s->accepting = false;
+        if (s->fd < 0) {
+            s->core->active--;
+        } else if (cqe->res < 0 && cqe->res != -EINTR && cqe->res != -ECONNABORTED &&
+                   cqe->res != -EMFILE && cqe->res != -ENFILE && cqe->res != -ENOBUFS) {
+            s->core->active--;
+            server_report_error(s);
+        } else {
+            server_arm_accept(s);
+        }
+    }
+}
+
+void server_construct(server *s, core_callback *callback, void *state)
+{
+    memset(s, 0, sizeof(*s));
+    s->user.callback = callback;
+    s->user.state = state;
+    s->core = core_resolve(NULL);
+    s->fd = -1;
+    timer_wheel_timer_init(&s->drain_timer, server_handle_drain_timeout);
+}
+
+void server_open_socket(server *s, int fd)
+{
+    if (fd < 0 || !s->core->ready) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        server_report_error(s);
+        return;
+    }
+
+    s->fd = fd;
+    s->core->active++;
+    server_arm_accept(s);
+}
+
+void server_set_socket_options(server *s, const server_socket_option *options, size_t count)
+{
+    if (count > IO_URING_ADAPTER_MAX_SOCKET_OPTIONS) {
+        count = IO_URING_ADAPTER_MAX_SOCKET_OPTIONS;
+    }
+    memcpy(s->options, options, count * sizeof(*options));
+    s->option_count = count;
+}
+
+void server_set_limits(server *s, const server_limits *limits)
+{
+    s->limits = *limits;
+}
+
+void server_set_http2(server *s, bool enable)
+{
+    s->http2 = enable;
+}
+
+void server_drain(server *s, unsigned timeout_ms)
+{
+    if (!s || !s->core || s->draining) {
+        return;
+    }
+    s->draining = true;
+
+    if (s->fd >= 0) {
+        /* The accept completion that ends the multishot drops the listener's count */
+        struct io_uring_sqe *sqe = s->accepting ? ring_get_sqe(&s->core->ring) : NULL;
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = user_data_make(s, OP_ACCEPT);
+            sqe->user_data = user_data_make(NULL, OP_IGNORE);
+        } else {
+            s->core->active--;
+        }
+        /* Other processes holding the socket keep its accept queue alive */
+        close(s->fd);
+        s->fd = -1;
+    }
+
+    server_session *session = s->sessions;
+    while (session) {
+        server_session *next = session->next;
+        stream *st = &session->stream;
+        if (session->http2 && !(session->flags & (SESSION_CLOSING | SESSION_CLOSE_AFTER_SEND))) {
+            /* GOAWAY now; the session closes once its open streams are answered */
+            http2_shutdown(session);
+            session_schedule_flush(session);
+        } else if (session->flags & (SESSION_CLOSING | SESSION_CLOSE_AFTER_SEND) ||
+            st->input.size > 0 || !(session->flags & SESSION_ANSWERED)) {
+            /* Request pending or still to come: session_handle_recv() closes once it is answered */
+        } else if (session->flags & (SESSION_SENDING | SESSION_FLUSH_PENDING)) {
+            session->flags |= SESSION_CLOSE_AFTER_SEND;
+        } else {
+            session_close(session);
+        }
+        session = next;
+    }
+
+    if (timeout_ms > 0 && s->sessions) {
+        timer_wheel_arm(&s->core->timers, &s->drain_timer, timeout_ms);
+    }
+}
+
+static void server_handle_drain_timeout(timer_wheel_timer_t *timer)
+{
+    server *s = (server *)((char *)timer - offsetof(server, drain_timer));
+    if (s->sessions) {
+        log_warn("io_uring adapter: drain deadline passed, closing remaining connections");
+    }
+    server_session *session = s->sessions;
+    while (session) {
+        server_session *next = session->next;
+        session_close(session);
+        session = next;
+    }
+}
+
+void server_open(server *s, uint32_t ip, uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        server_report_error(s);
+        return;
+    }
+
+    int on = 1;
+    (void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    (void)setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(ip)
+    };
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(fd, SOMAXCONN) == -1 ||
+        !s->core->ready) {
+        close(fd);
+        server_report_error(s);
+        return;
+    }
+
+    s->fd = fd;
+    s->core->active++;
+    server_arm_accept(s);
+}
+
+void server_destruct(server *s)
+{
+    if (!s || !s->core) {
+        return;
+    }
+
+    /* Drop this server's sessions from the flush list before freeing them */
+    server_session **link = &s->core->flush_list;
+    while (*link) {
+        if ((*link)->server == s) {
+            (*link)->flags &= ~SESSION_FLUSH_PENDING;
+            *link = (*link)->flush_next;
+        } else {
+            link = &(*link)->flush_next;
+        }
+    }
+
+    /* Sessions are freed immediately; the ring is torn down in core_destruct */
+    while (s->sessions) {
+        server_session *session = s->sessions;
+        session->refs = 0;
+        session->flags |= SESSION_CLOSING;
+        session_release(session);
+    }
+
+    if (s->fd >= 0) {
+        close(s->fd);
+        s->fd = -1;
+        s->core->active--;
+    }
+    timer_wheel_cancel(&s->core->timers, &s->drain_timer);
+    s->accepting = false;
+    s->core = NULL;
+}
+
+void *stream_allocate(stream *s, size_t size)
+{
+    buffer_reserve(&s->output, s->output.size + size);
+    void *base = s->output.data + s->output.size;
+    s->output.size += size;
+    return base;
+}
+
+void stream_write(stream *s, segment data)
+{
+    memcpy(stream_allocate(s, data.size), data.base, data.size);
+}
+
+/**
+ * @brief Queue an extent after the bytes written so far
+ */
+static void stream_append_extent(stream *s, const stream_extent *extent)
+{
+    buffer_insert(&s->extents, s->extents.size, extent, sizeof(*extent));
+}
+
+void stream_write_reference(stream *s, segment data, stream_release *release, void *arg)
+{
+    stream_extent extent = {
+        .position = s->output.size,
+        .base = data.base,
+        .fd = -1,
+        .size = data.size,
+        .release = release,
+        .arg = arg
+    };
+    stream_append_extent(s, &extent);
+}
+
+void stream_splice_file(stream *s, int fd, off_t offset, size_t size, stream_release *release, void *arg)
+{
+    stream_extent extent = {
+        .position = s->output.size,
+        .base = NULL,
+        .fd = fd,
+        .offset = offset,
+        .size = size,
+        .release = release,
+        .arg = arg
+    };
+    stream_append_extent(s, &extent);
+}
+
+/**
+ * @brief Answer an HTTP/2 stream with fields encoded for this response only
+ */
+static void http2_respond_fields(server_context *context, segment status, segment type, segment data)
+{
+    char content_length[24];
+    int length_len = snprintf(content_length, sizeof(content_length), "%zu", data.size);
+    segment date = http_date(0);
+
+    /* The status code is the first three characters of the status text */
+    size_t status_len = status.size < 3 ? status.size : 3;
+    size_t size = hpack_literal_size(HPACK_INDEX_STATUS_200, status_len) +
+                  hpack_literal_size(HPACK_INDEX_SERVER, 1) +
+                  hpack_literal_size(HPACK_INDEX_DATE, date.size) +
+                  hpack_literal_size(HPACK_INDEX_CONTENT_TYPE, type.size) +
+                  hpack_literal_size(HPACK_INDEX_CONTENT_LENGTH, (size_t)length_len);
+    uint8_t *block = system_malloc(size);
+    if (!block) {
+        log_error("io_uring adapter: out of memory encoding HTTP/2 response headers");
+        server_disconnect(context);
+        return;
+    }
+
+    uint8_t *p = block;
+    p += hpack_encode_literal(p, HPACK_INDEX_STATUS_200, status.base, status_len);
+    p += hpack_encode_literal(p, HPACK_INDEX_SERVER, "L", 1);
+    p += hpack_encode_literal(p, HPACK_INDEX_DATE, date.base, date.size);
+    p += hpack_encode_literal(p, HPACK_INDEX_CONTENT_TYPE, type.base, type.size);
+    p += hpack_encode_literal(p, HPACK_INDEX_CONTENT_LENGTH, content_length, (size_t)length_len);
+    server_http2_respond(context, segment_make(block, (size_t)(p - block)), data);
+    system_free(block);
+}
+
+void server_respond(server_context *context, segment status, segment type, segment data)
+{
+    if (context->stream_id) {
+        http2_respond_fields(context, status, type, data);
+        return;
+    }
+
+    char content_length[24];
+    int length_len = snprintf(content_length, sizeof(content_length), "%zu", data.size);
+    segment date = http_date(0);
+
+    size_t size = strlen("HTTP/1.1 ") + status.size + strlen("\r\nServer: L\r\nDate: ") + date.size +
+                  strlen("\r\nContent-Type: ") + type.size + strlen("\r\nContent-Length: ") +
+                  (size_t)length_len + strlen("\r\n\r\n") + data.size;
+    char *p = stream_allocate(&context->session->stream, size);
+
+#define APPEND(base, len) do { memcpy(p, (base), (len)); p += (len); } while (0)
+    APPEND("HTTP/1.1 ", 9);
+    APPEND(status.base, status.size);
+    APPEND("\r\nServer: L\r\nDate: ", 19);
+    APPEND(date.base, date.size);
+    APPEND("\r\nContent-Type: ", 16);
+    APPEND(type.base, type.size);
+    APPEND("\r\nContent-Length: ", 18);
+    APPEND(content_length, (size_t)length_len);
+    APPEND("\r\n\r\n", 4);
+    APPEND(data.base, data.size);
+#undef APPEND
+}
+
+void server_ok(server_context *context, segment type, segment data)
+{
+    server_respond(context, segment_string("200 OK"), type, data);
+}
+
+void server_disconnect(server_context *context)
+{
+    if (context->session->http2) {
+        http2_shutdown(context->session);
+        return;
+    }
+    context->session->flags |= SESSION_CLOSE_AFTER_SEND;
+}
+
+void server_http2_respond(server_context *context, segment headers, segment body)
+{
+    stream_extent extent = {
+        .base = body.base,
+        .fd = -1,
+        .size = body.size
+    };
+    http2_respond(context, headers, &extent, true);
+}
+
+void server_http2_respond_extent(server_context *context, segment headers, const stream_extent *body)
+{
+    http2_respond(context, headers, body, false);
+}
@@ -0,0 +1,615 @@
+/**
+ * @file io_uring_adapter.h
+ * @brief io_uring reactor backend exposing the libdynamic/libreactor API subset
+ *
+ * This module implements the parts of the libdynamic (segment, buffer) and
+ * libreactor (core, server, stream, http) interfaces used by the server
+ * infrastructure on top of a raw io_uring instance. Listening sockets use
+ * multishot accept, connections use multishot recv with a provided buffer
+ * ring, and all SQEs queued during one loop iteration are submitted with a
+ * single io_uring_enter() call. Responses to every request parsed during a
+ * batch of completions are coalesced into one send per connection.
+ *
+ * Beyond the libreactor API, output may reference memory owned elsewhere
+ * (sent with sendmsg() iovecs) or a file range (spliced through a pipe),
+ * so static file bodies never pass through userspace copies. Callers test
+ * REACTOR_STREAM_ZERO_COPY before using these extensions.
+ *
+ * A server can also adopt a listener opened by another process and later
+ * drain: stop accepting, close idle connections, close busy ones after their
+ * current response and return from core_loop() once all are gone. Callers
+ * test REACTOR_SERVER_HANDOFF before using these.
+ *
+ * How a reactor waits for completions is set with core_set_idle_policy():
+ * sleep in io_uring_enter(), spin for a while before sleeping, or let the
+ * kernel busy-poll the NIC queues of its sockets (NAPI, Linux 6.9+). The
+ * adaptive policy picks one from the completion rate of each reactor.
+ * Callers test REACTOR_CORE_IDLE_POLICY before using it.
+ *
+ * Options for accepted connections, such as TCP_NODELAY, are set with
+ * server_set_socket_options() and submitted as socket commands in the same
+ * batch as the connection's first receive (Linux 6.7+, setsockopt() before).
+ * Callers test REACTOR_SERVER_SOCKET_OPTIONS before using it.
+ *
+ * Connections time out on a per-reactor timer wheel: waiting for a request
+ * head, for the peer to take a response, or idle between requests. A server
+ * can also cap its connections and the requests per connection. The limits
+ * are set with server_set_limits(); callers test REACTOR_SERVER_LIMITS.
+ *
+ * Connections may also speak cleartext HTTP/2 (h2c), entered with the
+ * connection preface (prior knowledge) or an Upgrade: h2c request. Each
+ * stream is dispatched as a SERVER_REQUEST whose context carries its stream
+ * id; handlers answer it with server_http2_respond() and an HPACK header
+ * block. Response bodies are framed as DATA under the peer's flow control
+ * windows, referenced memory and file ranges included. It is enabled with
+ * server_set_http2(); callers test REACTOR_SERVER_HTTP2.
+ *
+ * Requests over both protocols carry their If-None-Match and
+ * If-Modified-Since values so handlers can answer 304 Not Modified; callers
+ * test REACTOR_REQUEST_VALIDATORS.
+ *
+ * It is selected at build time through the compat headers (make BACKEND=io_uring).
+ */
+
+#ifndef PLATFORM_IO_URING_ADAPTER_H
+#define PLATFORM_IO_URING_ADAPTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <linux/time_types.h>
+
+#include "../../include/platform/timer_wheel.h"
+#include "../../include/platform/trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Submission queue depth per reactor */
+#define IO_URING_ADAPTER_QUEUE_DEPTH 2048
+
+/** Number of receive buffers in the provided buffer ring (power of two) */
+#define IO_URING_ADAPTER_BUFFER_COUNT 1024
+
+/** Size of each provided receive buffer */
+#define IO_URING_ADAPTER_BUFFER_SIZE 4096
+
+/** Largest partial request kept per connection before it is dropped */
+#define IO_URING_ADAPTER_MAX_REQUEST_SIZE 65536
+
+/** Maximum iovecs gathered into one sendmsg() */
+#define IO_URING_ADAPTER_SEND_IOVECS 64
+
+/** Requested pipe capacity for splicing file ranges */
+#define IO_URING_ADAPTER_PIPE_SIZE (1024 * 1024)
+
+/** Output extensions (stream_write_reference, stream_splice_file) are available */
+#define REACTOR_STREAM_ZERO_COPY 1
+
+/** Listener handoff extensions (core_add, server_open_socket, server_drain) are available */
+#define REACTOR_SERVER_HANDOFF 1
+
+/** Idle policy extension (core_set_idle_policy) is available */
+#define REACTOR_CORE_IDLE_POLICY 1
+
+/** Accepted-socket option extension (server_set_socket_options) is available */
+#define REACTOR_SERVER_SOCKET_OPTIONS 1
+
+/** Connection limit extension (server_set_limits) is available */
+#define REACTOR_SERVER_LIMITS 1
+
+/** HTTP/2 extension (server_set_http2, server_http2_respond) is available */
+#define REACTOR_SERVER_HTTP2 1
+
+/** Requests carry their conditional fields (if_none_match, if_modified_since) */
+#define REACTOR_REQUEST_VALIDATORS 1
+
+/** Resolution of connection and drain timeouts */
+#define IO_URING_ADAPTER_TIMER_TICK_MS 100
+
+/** Most options server_set_socket_options() takes */
+#define IO_URING_ADAPTER_MAX_SOCKET_OPTIONS 8
+
+/** Streams an HTTP/2 connection may have open (SETTINGS_MAX_CONCURRENT_STREAMS) */
+#define IO_URING_ADAPTER_HTTP2_MAX_STREAMS 256
+
+/** Largest HTTP/2 frame payload sent or accepted (the protocol minimum) */
+#define IO_URING_ADAPTER_HTTP2_FRAME_SIZE 16384
+
+/** Every this many accepts the connection's receiving CPU is compared with ours */
+#define IO_URING_ADAPTER_CPU_CHECK_INTERVAL 16
+
+/** Interval over which the adaptive idle policy measures the completion rate */
+#define IO_URING_ADAPTER_IDLE_SAMPLE_MS 100
+
+/** Length of the date returned by http_date() (DATE_CLOCK_LENGTH) */
+#define HTTP_DATE_LENGTH 29
+
+/** Storage for the http_date() string including terminator */
+#define HTTP_DATE_STORAGE (HTTP_DATE_LENGTH + 1)
+
+/* ------------------------------------------------------------------------ */
+/* libdynamic subset                                                         */
+/* ------------------------------------------------------------------------ */
+
+/** Non-owning view of a byte range */
+typedef struct segment {
+    void *base;
+    size_t size;
+} segment;
+
+/** Growable byte buffer */
+typedef struct buffer {
+    char *data;
+    size_t size;
+    size_t capacity;
+} buffer;
+
+static inline segment segment_make(void *base, size_t size)
+{
+    return (segment){ .base = base, .size = size };
+}
+
+static inline segment segment_string(const char *string)
+{
+    return segment_make((void *)string, strlen(string));
+}
+
+static inline int segment_equal(segment a, segment b)
+{
+    return a.size == b.size && memcmp(a.base, b.base, a.size) == 0;
+}
+
+void buffer_construct(buffer *b);
+void buffer_destruct(buffer *b);
+void buffer_reserve(buffer *b, size_t capacity);
+void buffer_insert(buffer *b, size_t position, const void *data, size_t size);
+void buffer_erase(buffer *b, size_t position, size_t size);
+void buffer_clear(buffer *b);
+
+static inline void *buffer_data(const buffer *b)
+{
+    return b->data;
+}
+
+static inline size_t buffer_size(const buffer *b)
+{
+    return b->size;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Reactor core                                                              */
+/* ------------------------------------------------------------------------ */
+
+/** Callback status */
+typedef enum {
+    CORE_OK = 0,
+    CORE_ABORT = -1
+} core_status;
+
+/** Event delivered to callbacks */
+typedef struct core_event {
+    int type;
+    void *state;
+    uintptr_t data;
+} core_event;
+
+typedef core_status core_callback(core_event *event);
+
+/** User callback and its state */
+typedef struct core_handler {
+    core_callback *callback;
+    void *state;
+} core_handler;
+
+/** Memory-mapped io_uring instance */
+typedef struct io_uring_adapter_ring {
+    int fd;
+    unsigned features;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local_tail;      /** SQEs prepared, not yet published */
+    unsigned sq_submitted_tail;  /** SQEs handed to the kernel */
+    struct io_uring_sqe *sqes;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring_ptr;
+    size_t sq_ring_size;
+    void *cq_ring_ptr;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} io_uring_adapter_ring;
+
+/** Provided buffer ring shared with the kernel */
+typedef struct io_uring_adapter_buffers {
+    struct io_uring_buf_ring *ring;
+    size_t ring_size;
+    char *memory;
+    uint16_t tail;
+    uint16_t group_id;
+} io_uring_adapter_buffers;
+
+struct server_session;
+
+/** How a reactor waits when no completions are ready */
+typedef enum core_idle_mode {
+    CORE_IDLE_BLOCK,             /** Sleep in io_uring_enter() */
+    CORE_IDLE_SPIN,              /** Poll for completions for spin_us, then sleep */
+    CORE_IDLE_BUSY_POLL          /** Kernel busy-polls the sockets' NIC queues, then sleeps */
+} core_idle_mode;
+
+/** Idle policy */
+typedef struct core_idle_policy {
+    bool adaptive;               /** Pick the mode from the completion rate */
+    core_idle_mode mode;         /** Fixed mode, or the highest mode adaptive may use */
+    unsigned spin_us;            /** Spin time before sleeping, 0 disables spinning */
+    unsigned busy_poll_us;       /** Kernel busy-poll time, 0 disables busy polling */
+    unsigned spin_rate;          /** Completions per second from which to spin */
+    unsigned busy_poll_rate;     /** Completions per second from which to busy-poll */
+} core_idle_policy;
+
+/** Descriptor watched with core_add() */
+typedef struct core_watch {
+    core_handler user;
+    int fd;
+    int events;
+    struct core_watch *next;
+} core_watch;
+
+/** Reactor instance (one per worker process) */
+typedef struct core {
+    io_uring_adapter_ring ring;
+    io_uring_adapter_buffers buffers;
+    struct server_session *flush_list; /** Sessions with output queued this batch */
+    core_watch *watches;         /** Descriptors watched with core_add() */
+    int active;                  /** Armed listeners and open sessions */
+    bool aborted;
+    bool ready;
+    int64_t date_second;         /** Second http_date() was last refreshed */
+    core_idle_policy idle;       /** Configured idle policy */
+    core_idle_mode idle_mode;    /** Mode in effect */
+    bool napi_registered;        /** Kernel busy polling is enabled on the ring */
+    uint64_t idle_completions;   /** Completions in the current sample */
+    int64_t idle_sample_ms;      /** Start of the current sample */
+    bool sockopt_sync;           /** Socket options are set with setsockopt(), not the ring */
+    timer_wheel_t timers;        /** Connection and drain timeouts */
+    struct __kernel_timespec tick; /** Wakeup interval while timers are armed */
+    bool tick_armed;             /** A tick timeout is in flight */
+} core;
+
+/**
+ * @brief Construct a reactor
+ * @param c Reactor, NULL for the thread default
+ */
+void core_construct(core *c);
+
+/**
+ * @brief Run the reactor until no work remains or core_abort() is called
+ * @param c Reactor, NULL for the thread default
+ */
+void core_loop(core *c);
+
+/**
+ * @brief Request the running loop to return after the current batch
+ * @param c Reactor, NULL for the thread default
+ */
+void core_abort(core *c);
+
+/**
+ * @brief Release reactor resources
+ * @param c Reactor, NULL for the thread default
+ */
+void core_destruct(core *c);
+
+/**
+ * @brief Set how the reactor waits for completions
+ * @param c Reactor, NULL for the thread default
+ * @param policy Idle policy; modes the kernel does not support fall back to
+ *               the next lower one
+ */
+void core_set_idle_policy(core *c, const core_idle_policy *policy);
+
+/**
+ * @brief Get the idle mode in effect
+ * @param c Reactor, NULL for the thread default
+ * @return Current mode
+ */
+core_idle_mode core_get_idle_mode(core *c);
+
+/**
+ * @brief Watch a descriptor for readiness
+ * @param c Reactor, NULL for the thread default
+ * @param callback Called with event->type set to the ready poll events
+ * @param state User state passed in event->state
+ * @param fd Descriptor to watch until the reactor is destructed
+ * @param events Poll events of interest (POLLIN, ...)
+ * @note Watches do not keep core_loop() running on their own
+ */
+void core_add(core *c, core_callback *callback, void *state, int fd, int events);
+
+/* ------------------------------------------------------------------------ */
+/* HTTP/1.1 server                                                           */
+/* ------------------------------------------------------------------------ */
+
+/** Server event types */
+enum {
+    SERVER_ERROR,
+    SERVER_REQUEST
+};
+
+/** Parsed HTTP request (segments point into connection input) */
+typedef struct http_request {
+    segment method;
+    segment target;
+    segment body;
+    int minor_version;
+    bool close;                  /** Connection should close after response */
+    segment if_none_match;       /** If-None-Match value, empty if absent */
+    segment if_modified_since;   /** If-Modified-Since value, empty if absent */
+} http_request;
+
+/** Called once the kernel no longer needs an extent's data */
+typedef void stream_release(void *arg);
+
+/** Output sent without copying into the stream buffer */
+typedef struct stream_extent {
+    size_t position;             /** Offset in the byte buffer the extent follows */
+    const void *base;            /** Memory to send, NULL for a file range */
+    int fd;                      /** File to splice when base is NULL */
+    off_t offset;                /** File offset of the range */
+    size_t size;                 /** Bytes in the extent */
+    stream_release *release;     /** Optional release hook */
+    void *arg;                   /** Argument passed to release */
+} stream_extent;
+
+/** Connection output state */
+typedef struct stream {
+    buffer input;                /** Unparsed partial request bytes */
+    buffer output;               /** Responses queued since the last send */
+    buffer sending;              /** Bytes owned by the in-flight send */
+    size_t sent;                 /** Bytes of sending already accepted */
+    buffer extents;              /** stream_extent array interleaved with output */
+    buffer sending_extents;      /** stream_extent array of the in-flight send */
+    size_t extent_index;         /** Next extent of sending_extents */
+    size_t extent_sent;          /** Bytes of that extent already accepted */
+    size_t piped;                /** File bytes waiting in the splice pipe */
+    int pipe[2];                 /** Splice pipe, -1 until first needed */
+    int send_op;                 /** Kind of the in-flight output operation */
+    struct msghdr message;       /** sendmsg() header for gathered output */
+    struct iovec iov[IO_URING_ADAPTER_SEND_IOVECS];
+} stream;
+
+struct server;
+struct server_http2;
+
+/** Per-request context passed as SERVER_REQUEST event data */
+typedef struct server_context {
+    http_request request;
+    struct server_session *session;
+    uint32_t stream_id;          /** HTTP/2 stream of the request, 0 for HTTP/1.x */
+} server_context;
+
+/** Accepted connection */
+typedef struct server_session {
+    stream stream;
+    server_context context;
+    struct server *server;
+    struct server_session *prev;
+    struct server_session *next;
+    struct server_session *flush_next; /** Link in core flush_list */
+    struct server_http2 *http2;  /** HTTP/2 state, NULL while the connection speaks HTTP/1.x */
+    timer_wheel_timer_t timer;   /** Header, send or keep-alive timeout */
+    int fd;
+    int refs;                    /** In-flight io_uring operations */
+    unsigned flags;
+    unsigned requests;           /** Requests dispatched */
+    trace_record_t trace;        /** Sampled request awaiting its send */
+} server_session;
+
+/** setsockopt() applied to every accepted connection */
+typedef struct server_socket_option {
+    int level;
+    int name;
+    int value;
+} server_socket_option;
+
+/** Timeouts and caps of a server's connections; 0 disables each */
+typedef struct server_limits {
+    unsigned header_timeout_ms;  /** From accept, or a request's first byte, to its complete head */
+    unsigned idle_timeout_ms;    /** Without progress while a response is being sent */
+    unsigned keepalive_timeout_ms; /** Between a response and the next request */
+    unsigned max_requests;       /** Requests per connection, closed after the last response */
+    unsigned max_connections;    /** Open connections; more are closed on accept */
+} server_limits;
+
+/** Listening server */
+typedef struct server {
+    core_handler user;
+    core *core;
+    int fd;
+    bool accepting;
+    bool draining;               /** server_drain() called; no new requests per connection */
+    timer_wheel_timer_t drain_timer; /** Closes what is left when draining takes too long */
+    server_session *sessions;
+    unsigned connections;        /** Open sessions */
+    server_limits limits;
+    server_socket_option options[IO_URING_ADAPTER_MAX_SOCKET_OPTIONS];
+    size_t option_count;
+    unsigned accepts;            /** Connections accepted, paces the CPU check */
+    bool http2;                  /** Connections may switch to HTTP/2 */
+} server;
+
+/**
+ * @brief Construct a server
+ * @param s Server to construct
+ * @param callback Callback receiving SERVER_REQUEST/SERVER_ERROR events
+ * @param state User state passed in event->state
+ */
+void server_construct(server *s, core_callback *callback, void *state);
+
+/**
+ * @brief Open a SO_REUSEPORT listener and start accepting
+ * @param s Server
+ * @param ip IPv4 address in host byte order (0 for any)
+ * @param port TCP port
+ */
+void server_open(server *s, uint32_t ip, uint16_t port);
+
+/**
+ * @brief Start accepting on a listener opened elsewhere
+ * @param s Server
+ * @param fd Listening socket; the server takes ownership
+ */
+void server_open_socket(server *s, int fd);
+
+/**
+ * @brief Set socket options on every connection accepted from now on
+ * @param s Server
+ * @param options Options, copied
+ * @param count Number of options, at most IO_URING_ADAPTER_MAX_SOCKET_OPTIONS
+ * @note The options are queued on the ring with the connection's first
+ *       receive; if the kernel cannot set socket options that way the server
+ *       falls back to setsockopt()
+ */
+void server_set_socket_options(server *s, const server_socket_option *options, size_t count);
+
+/**
+ * @brief Set timeouts and caps for the server's connections
+ * @param s Server
+ * @param limits Limits, copied; apply to connections accepted from now on
+ *               and to the timeouts of open ones as they are rearmed
+ * @note Timeouts are rounded up to IO_URING_ADAPTER_TIMER_TICK_MS; connections
+ *       hitting max_requests close without a Connection: close header
+ */
+void server_set_limits(server *s, const server_limits *limits);
+
+/**
+ * @brief Let connections switch to HTTP/2
+ * @param s Server
+ * @param enable Accept the HTTP/2 preface on new connections and Upgrade: h2c
+ *               on requests without a body
+ */
+void server_set_http2(server *s, bool enable);
+
+/**
+ * @brief Stop accepting and let the connections finish
+ * @param s Server
+ * @param timeout_ms Close connections still open after this long, 0 for no limit
+ * @note Idle connections close at once, others after the response to the
+ *       requests already received, so core_loop() returns once all are gone
+ */
+void server_drain(server *s, unsigned timeout_ms);
+
+/**
+ * @brief Close the listener and all sessions
+ * @param s Server
+ */
+void server_destruct(server *s);
+
+/**
+ * @brief Queue a 200 OK response
+ * @param context Request context
+ * @param type Content-Type value
+ * @param data Response body
+ */
+void server_ok(server_context *context, segment type, segment data);
+
+/**
+ * @brief Queue a response with an explicit status line
+ * @param context Request context
+ * @param status Status text (e.g. "404 Not Found")
+ * @param type Content-Type value
+ * @param data Response body
+ * @note On an HTTP/2 stream the fields are HPACK-encoded per call; handlers
+ *       answering often should pass a prepared block to server_http2_respond()
+ */
+void server_respond(server_context *context, segment status, segment type, segment data);
+
+/**
+ * @brief Close the connection once queued output has been sent
+ * @param context Request context
+ * @note On HTTP/2 the connection sends GOAWAY and closes once its open
+ *       streams are answered
+ */
+void server_disconnect(server_context *context);
+
+/**
+ * @brief Queue the response of an HTTP/2 stream
+ * @param context Request context with a stream id
+ * @param headers Complete HPACK header block, copied
+ * @param body Response body, copied; may be empty
+ * @note The body is sent as DATA frames as far as flow control allows and
+ *       the rest when the peer opens its windows
+ */
+void server_http2_respond(server_context *context, segment headers, segment body);
+
+/**
+ * @brief Queue the response of an HTTP/2 stream with a body sent without copying
+ * @param context Request context with a stream id
+ * @param headers Complete HPACK header block, copied
+ * @param body Memory or file range as for stream_write_reference() and
+ *             stream_splice_file(); position is ignored. Its release hook
+ *             runs once the last frame has been sent or the stream is dropped
+ */
+void server_http2_respond_extent(server_context *context, segment headers, const stream_extent *body);
+
+/**
+ * @brief Reserve space at the end of the connection output
+ * @param s Connection stream
+ * @param size Bytes to reserve
+ * @return Pointer to the reserved bytes
+ */
+void *stream_allocate(stream *s, size_t size);
+
+/**
+ * @brief Append bytes to the connection output
+ * @param s Connection stream
+ * @param data Bytes to append
+ */
+void stream_write(stream *s, segment data);
+
+/**
+ * @brief Append memory owned by the caller without copying it
+ * @param s Connection stream
+ * @param data Bytes to send; must stay valid until release is called
+ * @param release Called once the data has been sent or dropped (may be NULL)
+ * @param arg Argument passed to release
+ */
+void stream_write_reference(stream *s, segment data, stream_release *release, void *arg);
+
+/**
+ * @brief Append a file range spliced from the page cache to the socket
+ * @param s Connection stream
+ * @param fd Open file; must stay open until release is called
+ * @param offset File offset of the range
+ * @param size Bytes to send
+ * @param release Called once the range has been sent or dropped (may be NULL)
+ * @param arg Argument passed to release
+ */
+void stream_splice_file(stream *s, int fd, off_t offset, size_t size, stream_release *release, void *arg);
+
+/**
+ * @brief Get the current RFC 7231 date
+ * @param update Nonzero to reformat from the current time
+ * @return Segment of HTTP date characters (thread-local storage)
+ */
+segment http_date(int update);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLATFORM_IO_URING_ADAPTER_H */
@@ -10,12 +10,14 @@
 #include <time.h>
 #include <unistd.h>
 #include <pthread.h>
-#include <errno.h>
+#include <signal.h>
 
 #include "../../include/platform/log.h"
 
 bool is_logging_disabled = false; // Global flag for disabling logging
 
+log_level_t log_runtime_level = LOG_LEVEL_INFO;
+
 /** ANSI color codes */
 #define LOG_COLOR_RESET   "\033[0m"
 #define LOG_COLOR_RED     "\033[31m"
@@ -30,16 +32,10 @@ static log_config_t current_config = {
     .timestamps = true,
     .colors = true,
     .pid = true,
-    .tid = false
+    .tid = false,
+    .async = true
 };
 
-/** Thread-local buffer for formatting */
-static __thread char format_buffer[4096];
-static __thread char time_buffer[32];
-
-/** Mutex for thread safety */
-static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
-
 /** Level names with colors */
 static const char *level_names[] = {
     [LOG_LEVEL_ERROR] = LOG_COLOR_RED "ERROR" LOG_COLOR_RESET,
@@ -55,103 +51,333 @@ static const char *level_names_plain[] = {
     [LOG_LEVEL_DEBUG] = "DEBUG"
 };
 
+/** One formatted line */
+typedef struct {
+    uint32_t length;
+    char text[LOG_SLOT_SIZE - sizeof(uint32_t)];
+} log_slot_t;
+
+/** Single-producer/single-consumer ring owned by one thread */
+typedef struct {
+    _Alignas(64) uint64_t tail;         /** Written by the producer thread */
+    _Alignas(64) uint64_t head;         /** Written by the flusher */
+    _Alignas(64) uint64_t dropped;      /** Lines lost to a full ring */
+    log_slot_t slots[LOG_RING_SLOTS];
+} log_ring_t;
+
+/** Maximum number of threads with their own ring */
+#define LOG_MAX_RINGS 64
+
+/** Rings registered by producer threads (lock-free append) */
+static log_ring_t *rings[LOG_MAX_RINGS];
+static unsigned ring_count;
+
+/** Per-thread producer state */
+static __thread log_ring_t *thread_ring;
+static __thread bool thread_ring_failed;
+
+/** Cached wall-clock prefix, refreshed when the second changes */
+static __thread time_t cached_second = -1;
+static __thread char time_buffer[32];
+static __thread size_t time_length;
+
+/** Cached "[pid] " prefix, reset in forked children */
+static char pid_buffer[24];
+static size_t pid_length;
+
+/** Lines dropped by rings of threads that no longer exist */
+static uint64_t dropped_total;
+
+/** Consumer side: serializes drains, never taken by producers */
+static pthread_mutex_t flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char flush_buffer[LOG_RING_SLOTS * 64];
+
+/** Flusher thread state */
+static pthread_t flusher_thread;
+static bool flusher_running;
+static bool flusher_stop;
+static bool atfork_registered;
+static pthread_mutex_t flusher_start_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void *log_flusher_main(void *arg);
+
 /**
- * @brief Format timestamp
- * @return Formatted timestamp string
+ * @brief Reset per-process state in a freshly forked child
+ * @note The child inherits copies of the parent's queued lines; the parent
+ *       flushes those, so the child discards them.
  */
-static const char *format_timestamp(void)
+static void log_atfork_child(void)
 {
-    time_t now = time(NULL);
-    struct tm *tm_info = localtime(&now);
-
-    if (!tm_info) {
-        return "00:00:00";
+    pthread_mutex_init(&flush_mutex, NULL);
+    pthread_mutex_init(&flusher_start_mutex, NULL);
+    flusher_running = false;
+    flusher_stop = false;
+    pid_length = 0;
+
+    for (unsigned i = 0; i < ring_count; i++) {
+        if (rings[i] != thread_ring) {
+            rings[i] = NULL;
+        }
+    }
+    if (thread_ring) {
+        thread_ring->head = thread_ring->tail;
+        thread_ring->dropped = 0;
     }
-
-    strftime(time_buffer, sizeof(time_buffer), "%H:%M:%S", tm_info);
-    return time_buffer;
 }
 
 /**
- * @brief Internal logging function
+ * @brief Start the flusher thread for this process if needed
  */
-static void log_internal(log_level_t level, const char *format, va_list args)
+static void log_start_flusher(void)
 {
-    /* Skip logging if disabled globally */
-    if (is_logging_disabled) {
-        return;
+    pthread_mutex_lock(&flusher_start_mutex);
+    if (!flusher_running) {
+        if (!atfork_registered) {
+            pthread_atfork(NULL, NULL, log_atfork_child);
+            atexit(log_flush);
+            atfork_registered = true;
+        }
+        flusher_stop = false;
+
+        /* Signals go to the threads that wait for them, never to the flusher */
+        sigset_t all, previous;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &previous);
+        if (pthread_create(&flusher_thread, NULL, log_flusher_main, NULL) == 0) {
+            flusher_running = true;
+        }
+        pthread_sigmask(SIG_SETMASK, &previous, NULL);
     }
+    pthread_mutex_unlock(&flusher_start_mutex);
+}
 
-    if (level > current_config.level) {
-        return;
+/**
+ * @brief Get (registering on first use) this thread's ring
+ */
+static log_ring_t *log_thread_ring(void)
+{
+    if (thread_ring || thread_ring_failed) {
+        return thread_ring;
     }
 
-    /* Thread-safe output */
-    pthread_mutex_lock(&log_mutex);
+    unsigned index = __atomic_fetch_add(&ring_count, 1, __ATOMIC_ACQ_REL);
+    log_ring_t *ring = index < LOG_MAX_RINGS ? calloc(1, sizeof(*ring)) : NULL;
+    if (!ring) {
+        thread_ring_failed = true;
+        return NULL;
+    }
 
-    FILE *out = current_config.output ? current_config.output : stderr;
+    __atomic_store_n(&rings[index], ring, __ATOMIC_RELEASE);
+    thread_ring = ring;
+    return ring;
+}
 
-    /* Format the message */
-    int len = vsnprintf(format_buffer, sizeof(format_buffer), format, args);
-    if (len < 0 || (size_t)len >= sizeof(format_buffer)) {
-        /* Message too long or error */
-        fprintf(out, "[LOG ERROR: message too long]\n");
-        pthread_mutex_unlock(&log_mutex);
-        return;
+/**
+ * @brief Format timestamp from the per-thread cached clock
+ * @return Length of the "[HH:MM:SS] " prefix in time_buffer
+ */
+static size_t format_timestamp(void)
+{
+    time_t now = time(NULL);
+    if (now != cached_second) {
+        struct tm tm_info;
+        cached_second = now;
+        if (localtime_r(&now, &tm_info)) {
+            time_length = strftime(time_buffer, sizeof(time_buffer), "[%H:%M:%S] ", &tm_info);
+        } else {
+            memcpy(time_buffer, "[00:00:00] ", 12);
+            time_length = 11;
+        }
     }
+    return time_length;
+}
 
-    /* Build the log line */
-    char log_line[8192];
-    char *ptr = log_line;
-    size_t remaining = sizeof(log_line);
+/**
+ * @brief Format one full line (prefix and message) into out
+ * @return Line length including the trailing newline
+ */
+static size_t log_format_line(char *out, size_t size, log_level_t level,
+                              const char *format, va_list args)
+{
+    size_t used = 0;
+
+#define LOG_APPEND(base, len) do { \
+        size_t n_ = (len) < size - 1 - used ? (len) : size - 1 - used; \
+        memcpy(out + used, (base), n_); \
+        used += n_; \
+    } while (0)
 
-    /* Timestamp */
     if (current_config.timestamps) {
-        int written = snprintf(ptr, remaining, "[%s] ", format_timestamp());
-        if (written < 0 || (size_t)written >= remaining) goto overflow;
-        ptr += written;
-        remaining -= written;
+        size_t len = format_timestamp();
+        LOG_APPEND(time_buffer, len);
     }
 
-    /* Level */
-    const char *level_str = current_config.colors ?
-        level_names[level] : level_names_plain[level];
-    int written = snprintf(ptr, remaining, "[%s] ", level_str);
-    if (written < 0 || (size_t)written >= remaining) goto overflow;
-    ptr += written;
-    remaining -= written;
+    const char *level_str = current_config.colors ? level_names[level] : level_names_plain[level];
+    LOG_APPEND("[", 1);
+    LOG_APPEND(level_str, strlen(level_str));
+    LOG_APPEND("] ", 2);
 
-    /* PID */
     if (current_config.pid) {
-        written = snprintf(ptr, remaining, "[%d] ", getpid());
-        if (written < 0 || (size_t)written >= remaining) goto overflow;
-        ptr += written;
-        remaining -= written;
+        if (pid_length == 0) {
+            int n = snprintf(pid_buffer, sizeof(pid_buffer), "[%d] ", getpid());
+            pid_length = n > 0 ? (size_t)n : 0;
+        }
+        LOG_APPEND(pid_buffer, pid_length);
     }
 
-    /* TID */
     if (current_config.tid) {
-        written = snprintf(ptr, remaining, "[%lu] ", (unsigned long)pthread_self());
-        if (written < 0 || (size_t)written >= remaining) goto overflow;
-        ptr += written;
-        remaining -= written;
+        char tid_buffer[32];
+        int n = snprintf(tid_buffer, sizeof(tid_buffer), "[%lu] ", (unsigned long)pthread_self());
+        LOG_APPEND(tid_buffer, n > 0 ? (size_t)n : 0);
+    }
+#undef LOG_APPEND
+
+    /* Message straight into the slot; truncated lines are marked */
+    int len = vsnprintf(out + used, size - 1 - used, format, args);
+    if (len < 0) {
+        len = 0;
+    }
+    if ((size_t)len >= size - 1 - used) {
+        used = size - 1;
+        memcpy(out + used - 3, "...", 3);
+    } else {
+        used += (size_t)len;
+    }
+    out[used++] = '\n';
+    return used;
+}
+
+/**
+ * @brief Drain one ring into the flush buffer, writing out as it fills
+ */
+static size_t log_drain_ring(log_ring_t *ring, FILE *out, size_t used)
+{
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        const log_slot_t *slot = &ring->slots[head & (LOG_RING_SLOTS - 1)];
+        if (used + slot->length > sizeof(flush_buffer)) {
+            fwrite(flush_buffer, 1, used, out);
+            used = 0;
+        }
+        memcpy(flush_buffer + used, slot->text, slot->length);
+        used += slot->length;
+        head++;
+    }
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+    uint64_t dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_ACQ_REL);
+    if (dropped) {
+        __atomic_fetch_add(&dropped_total, dropped, __ATOMIC_RELAXED);
+        int n = snprintf(flush_buffer + used, sizeof(flush_buffer) - used,
+                         "[LOG WARNING: %llu lines dropped, ring full]\n", (unsigned long long)dropped);
+        if (n > 0 && (size_t)n < sizeof(flush_buffer) - used) {
+            used += (size_t)n;
+        }
+    }
+
+    return used;
+}
+
+void log_flush(void)
+{
+    pthread_mutex_lock(&flush_mutex);
+
+    FILE *out = current_config.output ? current_config.output : stderr;
+    size_t used = 0;
+    unsigned count = __atomic_load_n(&ring_count, __ATOMIC_ACQUIRE);
+    if (count > LOG_MAX_RINGS) {
+        count = LOG_MAX_RINGS;
     }
 
-    /* Message */
-    written = snprintf(ptr, remaining, "%s\n", format_buffer);
-    if (written < 0 || (size_t)written >= remaining) goto overflow;
+    for (unsigned i = 0; i < count; i++) {
+        log_ring_t *ring = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+        if (ring) {
+            used = log_drain_ring(ring, out, used);
+        }
+    }
+
+    /* One write for the whole batch */
+    if (used > 0) {
+        fwrite(flush_buffer, 1, used, out);
+        fflush(out);
+    }
+
+    pthread_mutex_unlock(&flush_mutex);
+}
+
+static void *log_flusher_main(void *arg)
+{
+    (void)arg;
+    struct timespec interval = { .tv_sec = 0, .tv_nsec = LOG_FLUSH_INTERVAL_MS * 1000000L };
+
+    while (!__atomic_load_n(&flusher_stop, __ATOMIC_ACQUIRE)) {
+        nanosleep(&interval, NULL);
+        log_flush();
+    }
+
+    return NULL;
+}
+
+uint64_t log_dropped_count(void)
+{
+    uint64_t total = __atomic_load_n(&dropped_total, __ATOMIC_RELAXED);
+    unsigned count = __atomic_load_n(&ring_count, __ATOMIC_ACQUIRE);
+    for (unsigned i = 0; i < count && i < LOG_MAX_RINGS; i++) {
+        log_ring_t *ring = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+        if (ring) {
+            total += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief Internal logging function
+ */
+static void log_internal(log_level_t level, const char *format, va_list args)
+{
+    /* Skip logging if disabled globally */
+    if (is_logging_disabled) {
+        return;
+    }
+
+    if (level > current_config.level) {
+        return;
+    }
 
-    /* Output */
-    fputs(log_line, out);
-    fflush(out);
+    log_ring_t *ring = log_thread_ring();
+    if (!ring) {
+        /* No ring for this thread: format on the stack and write through */
+        char line[LOG_SLOT_SIZE];
+        size_t len = log_format_line(line, sizeof(line), level, format, args);
+        pthread_mutex_lock(&flush_mutex);
+        FILE *out = current_config.output ? current_config.output : stderr;
+        fwrite(line, 1, len, out);
+        fflush(out);
+        pthread_mutex_unlock(&flush_mutex);
+        return;
+    }
 
-    pthread_mutex_unlock(&log_mutex);
-    return;
+    /* Producer side: no locks, no syscalls */
+    uint64_t tail = ring->tail;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail - head >= LOG_RING_SLOTS) {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    log_slot_t *slot = &ring->slots[tail & (LOG_RING_SLOTS - 1)];
+    slot->length = (uint32_t)log_format_line(slot->text, sizeof(slot->text), level, format, args);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
 
-overflow:
-    fprintf(out, "[LOG ERROR: line too long]\n");
-    fflush(out);
-    pthread_mutex_unlock(&log_mutex);
+    if (!current_config.async || level == LOG_LEVEL_ERROR) {
+        /* Synchronous mode, and errors that may precede an abort */
+        log_flush();
+    } else if (!flusher_running) {
+        log_start_flusher();
+    }
 }
 
 log_error_t log_init(const log_config_t *config)
@@ -163,6 +389,7 @@ log_error_t log_init(const log_config_t *config)
 
     if (config) {
         current_config = *config;
+        log_runtime_level = current_config.level;
     }
 
     /* Ensure we have a valid output stream */
@@ -175,8 +402,17 @@ log_error_t log_init(const log_config_t *config)
 
 void log_cleanup(void)
 {
-    /* Close file if we opened it (not implemented yet) */
-    /* For now, just flush */
+    /* Stop the flusher, then drain whatever it left behind */
+    pthread_mutex_lock(&flusher_start_mutex);
+    if (flusher_running) {
+        __atomic_store_n(&flusher_stop, true, __ATOMIC_RELEASE);
+        pthread_join(flusher_thread, NULL);
+        flusher_running = false;
+    }
+    pthread_mutex_unlock(&flusher_start_mutex);
+
+    log_flush();
+
     if (current_config.output && current_config.output != stdout && current_config.output != stderr) {
         fflush(current_config.output);
     }
@@ -186,6 +422,7 @@ void log_set_level(log_level_t level)
 {
     if (level <= LOG_LEVEL_DEBUG) {
         current_config.level = level;
+        log_runtime_level = level;
     }
 }
 
@@ -221,35 +458,11 @@ void log_set_tid(bool enable)
     current_config.tid = enable;
 }
 
-void log_error(const char *format, ...)
-{
-    va_list args;
-    va_start(args, format);
-    log_internal(LOG_LEVEL_ERROR, format, args);
-    va_end(args);
-}
-
-void log_warn(const char *format, ...)
-{
-    va_list args;
-    va_start(args, format);
-    log_internal(LOG_LEVEL_WARN, format, args);
-    va_end(args);
-}
-
-void log_info(const char *format, ...)
-{
-    va_list args;
-    va_start(args, format);
-    log_internal(LOG_LEVEL_INFO, format, args);
-    va_end(args);
-}
-
-void log_debug(const char *format, ...)
+void log_write(log_level_t level, const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    log_internal(LOG_LEVEL_DEBUG, format, args);
+    log_internal(level, format, args);
     va_end(args);
 }
 
@@ -261,6 +474,7 @@ log_config_t log_default_config(void)
         .timestamps = true,
         .colors = isatty(fileno(stderr)),  /* Colors only for terminals */
         .pid = true,
-        .tid = false
+        .tid = false,
+        .async = true
     };
 }
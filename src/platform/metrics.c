@@ -0,0 +1,537 @@
+/**
+ * @file metrics.c
+ * @brief Implementation of per-worker shared-memory metrics
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../include/platform/metrics.h"
+#include "../../include/platform/system.h"
+#include "../../include/platform/log.h"
+
+metrics_worker_t *metrics_local = NULL;
+
+/** Names of the scalar counters as exported */
+static const char *counter_names[] = {
+    [METRICS_ACCEPTS]      = "libreactor_accepts_total",
+    [METRICS_CLOSES]       = "libreactor_closes_total",
+    [METRICS_BYTES_IN]     = "libreactor_bytes_received_total",
+    [METRICS_BYTES_OUT]    = "libreactor_bytes_sent_total",
+    [METRICS_PARSE_ERRORS] = "libreactor_parse_errors_total",
+    [METRICS_CPU_CHECKS]     = "libreactor_accept_cpu_checks_total",
+    [METRICS_CPU_MISMATCHES] = "libreactor_accept_cpu_mismatches_total",
+    [METRICS_TIMEOUTS]       = "libreactor_connection_timeouts_total",
+    [METRICS_REJECTS]        = "libreactor_connections_rejected_total",
+    [METRICS_SQ_FULL]        = "libreactor_sq_full_retries_total"
+};
+
+/** epoll data of the listener; clients use their slot index */
+#define METRICS_LISTENER_EVENT METRICS_MAX_CLIENTS
+
+static int64_t metrics_monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Zero the state and mark every descriptor closed
+ */
+static void metrics_clear(metrics_t *metrics)
+{
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->listen_fd = -1;
+    metrics->poll_fd = -1;
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        metrics->clients[i].fd = -1;
+    }
+}
+
+metrics_error_t metrics_init(metrics_t *metrics, int worker_count)
+{
+    if (!metrics || worker_count <= 0) {
+        return METRICS_ERROR_INVALID_PARAM;
+    }
+
+    metrics_clear(metrics);
+
+    size_t size = (size_t)worker_count * sizeof(metrics_worker_t);
+    void *region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return METRICS_ERROR_MEMORY;
+    }
+
+    metrics->workers = region;
+    metrics->mapping_size = size;
+    metrics->worker_count = worker_count;
+    for (int i = 0; i < worker_count; i++) {
+        metrics->workers[i].cpu_id = -1;
+    }
+
+    return METRICS_OK;
+}
+
+void metrics_cleanup(metrics_t *metrics)
+{
+    if (!metrics) {
+        return;
+    }
+
+    metrics_server_close(metrics);
+
+    if (metrics->workers) {
+        if (metrics_local >= metrics->workers &&
+            metrics_local < metrics->workers + metrics->worker_count) {
+            metrics_local = NULL;
+        }
+        munmap(metrics->workers, metrics->mapping_size);
+    }
+
+    metrics_clear(metrics);
+}
+
+void metrics_set_route_names(metrics_t *metrics, const char *const *names, int count)
+{
+    if (!metrics) {
+        return;
+    }
+
+    metrics->route_names = names;
+    metrics->route_count = count < METRICS_MAX_ROUTES ? count : METRICS_MAX_ROUTES;
+}
+
+void metrics_set_trace(metrics_t *metrics, const trace_t *trace)
+{
+    if (metrics) {
+        metrics->trace = trace;
+    }
+}
+
+void metrics_attach_worker(metrics_t *metrics, int worker_id, int cpu_id)
+{
+    if (!metrics || !metrics->workers || worker_id < 0 || worker_id >= metrics->worker_count) {
+        return;
+    }
+
+    metrics_worker_t *w = &metrics->workers[worker_id];
+    memset(w, 0, sizeof(*w));
+    w->cpu_id = cpu_id;
+    w->pid = (int32_t)getpid();
+    metrics_local = w;
+}
+
+metrics_error_t metrics_server_open(metrics_t *metrics, uint32_t address, uint16_t port)
+{
+    if (!metrics) {
+        return METRICS_ERROR_INVALID_PARAM;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return METRICS_ERROR_SOCKET;
+    }
+
+    int on = 1;
+    (void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = address
+    };
+
+    char name[INET_ADDRSTRLEN];
+    if (!inet_ntop(AF_INET, &addr.sin_addr, name, sizeof(name))) {
+        strcpy(name, "?");
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, 16) == -1) {
+        log_error("Failed to open metrics port %s:%u: %s", name, port, strerror(errno));
+        close(fd);
+        return METRICS_ERROR_SOCKET;
+    }
+
+    int poll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = METRICS_LISTENER_EVENT };
+    if (poll_fd == -1 || epoll_ctl(poll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        log_error("Failed to watch metrics port: %s", strerror(errno));
+        if (poll_fd >= 0) {
+            close(poll_fd);
+        }
+        close(fd);
+        return METRICS_ERROR_SOCKET;
+    }
+
+    metrics->listen_fd = fd;
+    metrics->poll_fd = poll_fd;
+    log_info("Metrics available on %s:%u at /metrics", name, port);
+    return METRICS_OK;
+}
+
+/**
+ * @brief Close an admin connection and free its slot
+ */
+static void metrics_client_close(metrics_client_t *client)
+{
+    /* Closing the last reference also drops it from the epoll set */
+    close(client->fd);
+    system_free(client->response);
+    client->fd = -1;
+    client->response = NULL;
+}
+
+void metrics_server_close(metrics_t *metrics)
+{
+    if (!metrics) {
+        return;
+    }
+
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (metrics->clients[i].fd >= 0) {
+            metrics_client_close(&metrics->clients[i]);
+        }
+    }
+    if (metrics->poll_fd >= 0) {
+        close(metrics->poll_fd);
+        metrics->poll_fd = -1;
+    }
+    if (metrics->listen_fd >= 0) {
+        close(metrics->listen_fd);
+        metrics->listen_fd = -1;
+    }
+}
+
+int metrics_server_fd(const metrics_t *metrics)
+{
+    return metrics ? metrics->poll_fd : -1;
+}
+
+/**
+ * @brief Append formatted text, tracking truncation
+ */
+static void render_append(char *buffer, size_t size, size_t *used, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void render_append(char *buffer, size_t size, size_t *used, const char *format, ...)
+{
+    if (*used >= size) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + *used, size - *used, format, args);
+    va_end(args);
+
+    if (written < 0) {
+        return;
+    }
+    *used += (size_t)written < size - *used ? (size_t)written : size - *used;
+}
+
+size_t metrics_render(const metrics_t *metrics, char *buffer, size_t size)
+{
+    if (!metrics || !metrics->workers || !buffer || size == 0) {
+        return 0;
+    }
+
+    size_t used = 0;
+
+    for (int c = 0; c < METRICS_COUNTER_COUNT; c++) {
+        render_append(buffer, size, &used, "# TYPE %s counter\n", counter_names[c]);
+        for (int i = 0; i < metrics->worker_count; i++) {
+            const metrics_worker_t *w = &metrics->workers[i];
+            render_append(buffer, size, &used, "%s{worker=\"%d\",cpu=\"%d\"} %llu\n",
+                          counter_names[c], i, w->cpu_id,
+                          (unsigned long long)__atomic_load_n(&w->counters[c], __ATOMIC_RELAXED));
+        }
+    }
+
+    render_append(buffer, size, &used, "# TYPE libreactor_active_connections gauge\n");
+    for (int i = 0; i < metrics->worker_count; i++) {
+        const metrics_worker_t *w = &metrics->workers[i];
+        uint64_t accepts = __atomic_load_n(&w->counters[METRICS_ACCEPTS], __ATOMIC_RELAXED);
+        uint64_t closes = __atomic_load_n(&w->counters[METRICS_CLOSES], __ATOMIC_RELAXED);
+        render_append(buffer, size, &used, "libreactor_active_connections{worker=\"%d\",cpu=\"%d\"} %llu\n",
+                      i, w->cpu_id, (unsigned long long)(accepts > closes ? accepts - closes : 0));
+    }
+
+    render_append(buffer, size, &used, "# TYPE libreactor_requests_total counter\n");
+    for (int i = 0; i < metrics->worker_count; i++) {
+        const metrics_worker_t *w = &metrics->workers[i];
+        for (int r = 0; r < metrics->route_count; r++) {
+            render_append(buffer, size, &used,
+                          "libreactor_requests_total{worker=\"%d\",cpu=\"%d\",route=\"%s\"} %llu\n",
+                          i, w->cpu_id, metrics->route_names[r],
+                          (unsigned long long)__atomic_load_n(&w->route_requests[r], __ATOMIC_RELAXED));
+        }
+    }
+
+    render_append(buffer, size, &used, "# TYPE libreactor_request_duration_seconds histogram\n");
+    for (int i = 0; i < metrics->worker_count; i++) {
+        const metrics_worker_t *w = &metrics->workers[i];
+        uint64_t cumulative = 0;
+        for (int b = 0; b < METRICS_LATENCY_BUCKETS; b++) {
+            cumulative += __atomic_load_n(&w->latency_buckets[b], __ATOMIC_RELAXED);
+            if (b == METRICS_LATENCY_BUCKETS - 1) {
+                render_append(buffer, size, &used,
+                              "libreactor_request_duration_seconds_bucket{worker=\"%d\",le=\"+Inf\"} %llu\n",
+                              i, (unsigned long long)cumulative);
+            } else {
+                render_append(buffer, size, &used,
+                              "libreactor_request_duration_seconds_bucket{worker=\"%d\",le=\"%.9g\"} %llu\n",
+                              i, (double)(1ull << b) / 1e9, (unsigned long long)cumulative);
+            }
+        }
+        render_append(buffer, size, &used, "libreactor_request_duration_seconds_sum{worker=\"%d\"} %.9f\n",
+                      i, (double)__atomic_load_n(&w->latency_sum_ns, __ATOMIC_RELAXED) / 1e9);
+        render_append(buffer, size, &used, "libreactor_request_duration_seconds_count{worker=\"%d\"} %llu\n",
+                      i, (unsigned long long)cumulative);
+    }
+
+    return used;
+}
+
+/** Room left ahead of a rendered body for the response headers */
+#define METRICS_HEADER_ROOM 256
+
+/**
+ * @brief Write the headers into the room ahead of a rendered body and close the gap
+ * @return Response size
+ */
+static size_t metrics_frame_response(char *response, const char *content_type, size_t body_size)
+{
+    int header_size = snprintf(response, METRICS_HEADER_ROOM,
+                               "HTTP/1.1 200 OK\r\n"
+                               "Content-Type: %s\r\n"
+                               "Content-Length: %zu\r\n"
+                               "Connection: close\r\n\r\n", content_type, body_size);
+    memmove(response + header_size, response + METRICS_HEADER_ROOM, body_size);
+    return (size_t)header_size + body_size;
+}
+
+/**
+ * @brief Render the Prometheus response
+ * @return Headers and body, NULL without memory
+ */
+static char *metrics_render_response(const metrics_t *metrics, size_t *size)
+{
+    size_t capacity = 4096 + (size_t)metrics->worker_count *
+                      ((size_t)metrics->route_count + METRICS_LATENCY_BUCKETS + METRICS_COUNTER_COUNT + 4) * 128;
+    char *response = system_malloc(METRICS_HEADER_ROOM + capacity);
+    if (!response) {
+        return NULL;
+    }
+
+    size_t body_size = metrics_render(metrics, response + METRICS_HEADER_ROOM, capacity);
+    *size = metrics_frame_response(response, "text/plain; version=0.0.4", body_size);
+    return response;
+}
+
+/**
+ * @brief Render the trace rings as a response
+ * @return Headers and body, NULL without memory
+ * @note Rendered whole up front, so it goes out like a scrape as the socket drains
+ */
+static char *metrics_render_trace(const trace_t *trace, size_t *size)
+{
+    char *response;
+    size_t used;
+    if (trace_render(trace, METRICS_HEADER_ROOM, &response, &used) != TRACE_OK) {
+        log_warn("Trace export failed: out of memory");
+        return NULL;
+    }
+
+    *size = metrics_frame_response(response, "application/json", used - METRICS_HEADER_ROOM);
+    return response;
+}
+
+/**
+ * @brief Prepare the answer to a complete request
+ * @return false if the connection is done with
+ */
+static bool metrics_client_respond(metrics_t *metrics, metrics_client_t *client)
+{
+    const char *request = client->request;
+
+    if (metrics->trace && strncmp(request, "GET /trace", 10) == 0 &&
+        (request[10] == ' ' || request[10] == '?')) {
+        client->response = metrics_render_trace(metrics->trace, &client->response_size);
+        return client->response != NULL;
+    }
+
+    if (strncmp(request, "GET /metrics", 12) == 0 && (request[12] == ' ' || request[12] == '?')) {
+        client->response = metrics_render_response(metrics, &client->response_size);
+        return client->response != NULL;
+    }
+
+    static const char not_found[] =
+        "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    client->response = system_malloc(sizeof(not_found) - 1);
+    if (!client->response) {
+        return false;
+    }
+    memcpy(client->response, not_found, sizeof(not_found) - 1);
+    client->response_size = sizeof(not_found) - 1;
+    return true;
+}
+
+/**
+ * @brief Read what has arrived of the request
+ * @return 1 once the head is complete, 0 if more is needed, -1 if the connection failed
+ */
+static int metrics_client_read(metrics_client_t *client)
+{
+    for (;;) {
+        if (client->request_used == sizeof(client->request) - 1) {
+            /* Only the request line matters; answer what fits */
+            return 1;
+        }
+
+        ssize_t n = recv(client->fd, client->request + client->request_used,
+                         sizeof(client->request) - 1 - client->request_used, 0);
+        if (n == 0) {
+            return client->request_used > 0 ? 1 : -1;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+
+        client->request_used += (size_t)n;
+        client->request[client->request_used] = '\0';
+        if (strstr(client->request, "\r\n\r\n")) {
+            return 1;
+        }
+    }
+}
+
+/**
+ * @brief Send as much of the response as the socket takes
+ * @return true while bytes remain, false once all are sent or the connection failed
+ */
+static bool metrics_client_send(metrics_client_t *client)
+{
+    while (client->response_sent < client->response_size) {
+        ssize_t n = send(client->fd, client->response + client->response_sent,
+                         client->response_size - client->response_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        client->response_sent += (size_t)n;
+    }
+    return false;
+}
+
+/**
+ * @brief Make progress on a readable or writable admin connection
+ */
+static void metrics_client_event(metrics_t *metrics, metrics_client_t *client)
+{
+    if (client->fd < 0) {
+        return;
+    }
+
+    if (!client->response) {
+        int state = metrics_client_read(client);
+        if (state == 0) {
+            return;
+        }
+        if (state < 0 || !metrics_client_respond(metrics, client)) {
+            metrics_client_close(client);
+            return;
+        }
+
+        /* Whatever the socket did not take goes out as it drains */
+        struct epoll_event ev = { .events = EPOLLOUT, .data.u32 = (uint32_t)(client - metrics->clients) };
+        if (!metrics_client_send(client) ||
+            epoll_ctl(metrics->poll_fd, EPOLL_CTL_MOD, client->fd, &ev) == -1) {
+            metrics_client_close(client);
+        }
+        return;
+    }
+
+    if (!metrics_client_send(client)) {
+        metrics_client_close(client);
+    }
+}
+
+/**
+ * @brief Take pending connections into free slots
+ */
+static void metrics_server_accept(metrics_t *metrics)
+{
+    int64_t deadline = metrics_monotonic_ms() + METRICS_CLIENT_TIMEOUT_MS;
+
+    for (;;) {
+        int fd = accept4(metrics->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            return;
+        }
+
+        int slot = 0;
+        while (slot < METRICS_MAX_CLIENTS && metrics->clients[slot].fd >= 0) {
+            slot++;
+        }
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)slot };
+        if (slot == METRICS_MAX_CLIENTS || epoll_ctl(metrics->poll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            log_debug("Metrics connection refused, %d in progress", METRICS_MAX_CLIENTS);
+            close(fd);
+            continue;
+        }
+
+        metrics_client_t *client = &metrics->clients[slot];
+        client->fd = fd;
+        client->request_used = 0;
+        client->request[0] = '\0';
+        client->response = NULL;
+        client->response_size = 0;
+        client->response_sent = 0;
+        client->deadline_ms = deadline;
+    }
+}
+
+void metrics_server_poll(metrics_t *metrics, int timeout_ms)
+{
+    if (!metrics || metrics->poll_fd < 0) {
+        return;
+    }
+
+    struct epoll_event events[METRICS_MAX_CLIENTS + 1];
+    int n = epoll_wait(metrics->poll_fd, events, METRICS_MAX_CLIENTS + 1, timeout_ms);
+
+    /* Stalled connections give up their slot at the next wakeup, which a new connection is */
+    int64_t now = metrics_monotonic_ms();
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (metrics->clients[i].fd >= 0 && metrics->clients[i].deadline_ms <= now) {
+            metrics_client_close(&metrics->clients[i]);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (events[i].data.u32 == METRICS_LISTENER_EVENT) {
+            metrics_server_accept(metrics);
+        } else if (events[i].data.u32 < METRICS_MAX_CLIENTS) {
+            metrics_client_event(metrics, &metrics->clients[events[i].data.u32]);
+        }
+    }
+}
@@ -0,0 +1,390 @@
+/**
+ * @file pool.c
+ * @brief Implementation of the size-classed memory pools
+ */
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../../include/platform/pool.h"
+
+struct pool_cache;
+
+/** Slab: a run of equally sized blocks owned by one thread's cache */
+typedef struct pool_slab {
+    _Alignas(16) struct pool_slab *next; /** Neighbours among slabs with free blocks */
+    struct pool_slab *prev;
+    struct pool_cache *owner;
+    void *free;                         /** Free blocks, linked through their first word */
+    size_t bytes;                       /** Mapping size */
+    uint32_t class_index;
+    uint32_t blocks;
+    uint32_t used;
+} pool_slab_t;
+
+/** Precedes every block; slab is NULL for large allocations */
+typedef struct {
+    _Alignas(16) pool_slab_t *slab;
+    size_t size;                        /** Requested size of a large allocation */
+} pool_header_t;
+
+/** Slabs of one class that still have free blocks; empty ones at the tail */
+typedef struct {
+    pool_slab_t *head;
+    pool_slab_t *tail;
+} pool_class_t;
+
+/** Per-thread cache */
+typedef struct pool_cache {
+    pool_class_t classes[POOL_CLASS_COUNT];
+    void *remote;                       /** Blocks freed by other threads (atomic) */
+    pool_stats_t stats;
+} pool_cache_t;
+
+static size_t pool_high_water = POOL_DEFAULT_HIGH_WATER;
+
+/** Caches are never freed, so blocks can still be queued to exited threads */
+static __thread pool_cache_t *thread_cache;
+
+static inline pool_header_t *pool_header(const void *ptr)
+{
+    return (pool_header_t *)ptr - 1;
+}
+
+/**
+ * @brief Map a size to its class: 64, then 1.5x and 2x of every power of two
+ */
+static inline unsigned pool_class_index(size_t size)
+{
+    if (size <= POOL_MIN_SIZE) {
+        return 0;
+    }
+    unsigned exponent = 63u - (unsigned)__builtin_clzll((unsigned long long)(size - 1));
+    size_t low = (size_t)1 << exponent;
+    return (exponent - 6) * 2 + (size <= low + (low >> 1) ? 1 : 2);
+}
+
+static inline size_t pool_class_size(unsigned index)
+{
+    if (index == 0) {
+        return POOL_MIN_SIZE;
+    }
+    unsigned exponent = (index - 1) / 2 + 6;
+    return index & 1 ? (size_t)3 << (exponent - 1) : (size_t)2 << exponent;
+}
+
+static pool_cache_t *pool_cache_get(void)
+{
+    if (__builtin_expect(thread_cache == NULL, 0)) {
+        thread_cache = calloc(1, sizeof(*thread_cache));
+    }
+    return thread_cache;
+}
+
+static inline void pool_list_remove(pool_class_t *list, pool_slab_t *slab)
+{
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        list->head = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    } else {
+        list->tail = slab->prev;
+    }
+    slab->next = slab->prev = NULL;
+}
+
+static inline void pool_list_push_front(pool_class_t *list, pool_slab_t *slab)
+{
+    slab->prev = NULL;
+    slab->next = list->head;
+    if (list->head) {
+        list->head->prev = slab;
+    } else {
+        list->tail = slab;
+    }
+    list->head = slab;
+}
+
+static inline void pool_list_push_back(pool_class_t *list, pool_slab_t *slab)
+{
+    slab->next = NULL;
+    slab->prev = list->tail;
+    if (list->tail) {
+        list->tail->next = slab;
+    } else {
+        list->head = slab;
+    }
+    list->tail = slab;
+}
+
+static pool_slab_t *pool_slab_create(pool_cache_t *cache, unsigned index)
+{
+    size_t stride = sizeof(pool_header_t) + pool_class_size(index);
+    size_t blocks = (POOL_SLAB_SIZE - sizeof(pool_slab_t)) / stride;
+    if (blocks < POOL_SLAB_MIN_BLOCKS) {
+        blocks = POOL_SLAB_MIN_BLOCKS;
+    }
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t bytes = (sizeof(pool_slab_t) + blocks * stride + page - 1) & ~(page - 1);
+    void *region = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+
+    pool_slab_t *slab = region;
+    slab->owner = cache;
+    slab->bytes = bytes;
+    slab->class_index = index;
+    slab->blocks = (uint32_t)blocks;
+    slab->used = 0;
+
+    /* Thread the free list so blocks are handed out in address order */
+    char *first = (char *)(slab + 1);
+    void *free_list = NULL;
+    for (size_t i = blocks; i-- > 0; ) {
+        pool_header_t *header = (pool_header_t *)(first + i * stride);
+        header->slab = slab;
+        header->size = 0;
+        void *block = header + 1;
+        *(void **)block = free_list;
+        free_list = block;
+    }
+    slab->free = free_list;
+
+    pool_list_push_front(&cache->classes[index], slab);
+    cache->stats.slab_allocations++;
+    cache->stats.slab_bytes += bytes;
+    cache->stats.free_slab_bytes += bytes;
+    return slab;
+}
+
+static void pool_slab_destroy(pool_cache_t *cache, pool_slab_t *slab)
+{
+    pool_list_remove(&cache->classes[slab->class_index], slab);
+    cache->stats.slab_frees++;
+    cache->stats.slab_bytes -= slab->bytes;
+    cache->stats.free_slab_bytes -= slab->bytes;
+    munmap(slab, slab->bytes);
+}
+
+/**
+ * @brief Return a block to a slab of the calling thread
+ */
+static void pool_free_local(pool_cache_t *cache, pool_slab_t *slab, void *block)
+{
+    pool_class_t *list = &cache->classes[slab->class_index];
+    bool was_full = slab->free == NULL;
+
+    *(void **)block = slab->free;
+    slab->free = block;
+    cache->stats.frees++;
+
+    if (was_full) {
+        pool_list_push_front(list, slab);
+    }
+
+    if (--slab->used == 0) {
+        cache->stats.free_slab_bytes += slab->bytes;
+        if (cache->stats.free_slab_bytes > pool_high_water) {
+            pool_slab_destroy(cache, slab);
+        } else if (list->tail != slab) {
+            /* Fill partially used slabs first so empty ones can be released */
+            pool_list_remove(list, slab);
+            pool_list_push_back(list, slab);
+        }
+    }
+}
+
+static void pool_drain_remote(pool_cache_t *cache)
+{
+    void *block = __atomic_exchange_n(&cache->remote, NULL, __ATOMIC_ACQUIRE);
+    while (block) {
+        void *next = *(void **)block;
+        pool_free_local(cache, pool_header(block)->slab, block);
+        block = next;
+    }
+}
+
+static void *pool_alloc_large(size_t size)
+{
+    if (size > SIZE_MAX - sizeof(pool_header_t)) {
+        return NULL;
+    }
+
+    pool_header_t *header = malloc(sizeof(*header) + size);
+    if (!header) {
+        return NULL;
+    }
+    header->slab = NULL;
+    header->size = size;
+    return header + 1;
+}
+
+pool_error_t pool_set_high_water(size_t bytes)
+{
+    pool_high_water = bytes;
+    return POOL_OK;
+}
+
+size_t pool_get_high_water(void)
+{
+    return pool_high_water;
+}
+
+void *pool_alloc(size_t size)
+{
+    if (size == 0) {
+        return NULL;
+    }
+
+    pool_cache_t *cache = pool_cache_get();
+    if (size > POOL_MAX_SIZE || !cache) {
+        if (cache) {
+            cache->stats.large_allocations++;
+        }
+        return pool_alloc_large(size);
+    }
+
+    if (__atomic_load_n(&cache->remote, __ATOMIC_RELAXED)) {
+        pool_drain_remote(cache);
+    }
+
+    unsigned index = pool_class_index(size);
+    pool_class_t *list = &cache->classes[index];
+    pool_slab_t *slab = list->head;
+    if (!slab) {
+        slab = pool_slab_create(cache, index);
+        if (!slab) {
+            return NULL;
+        }
+    }
+
+    void *block = slab->free;
+    slab->free = *(void **)block;
+    if (slab->used++ == 0) {
+        cache->stats.free_slab_bytes -= slab->bytes;
+    }
+    if (!slab->free) {
+        pool_list_remove(list, slab);
+    }
+
+    cache->stats.allocations++;
+    return block;
+}
+
+void pool_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+
+    pool_header_t *header = pool_header(ptr);
+    pool_slab_t *slab = header->slab;
+    if (!slab) {
+        free(header);
+        return;
+    }
+
+    pool_cache_t *cache = thread_cache;
+    if (__builtin_expect(slab->owner == cache, 1)) {
+        pool_free_local(cache, slab, ptr);
+        return;
+    }
+
+    /* Another thread's block: queue it for the owner */
+    pool_cache_t *owner = slab->owner;
+    void *head = __atomic_load_n(&owner->remote, __ATOMIC_RELAXED);
+    do {
+        *(void **)ptr = head;
+    } while (!__atomic_compare_exchange_n(&owner->remote, &head, ptr, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+size_t pool_usable_size(const void *ptr)
+{
+    if (!ptr) {
+        return 0;
+    }
+
+    const pool_header_t *header = pool_header(ptr);
+    return header->slab ? pool_class_size(header->slab->class_index) : header->size;
+}
+
+void *pool_realloc(void *ptr, size_t size)
+{
+    if (!ptr) {
+        return pool_alloc(size);
+    }
+    if (size == 0) {
+        pool_free(ptr);
+        return NULL;
+    }
+
+    pool_header_t *header = pool_header(ptr);
+    size_t usable = pool_usable_size(ptr);
+
+    if (header->slab) {
+        /* Stay in place unless the block would be more than half empty */
+        if (size <= usable && size > usable / 2) {
+            return ptr;
+        }
+    } else if (size > POOL_MAX_SIZE) {
+        pool_header_t *grown = realloc(header, sizeof(*header) + size);
+        if (!grown) {
+            return NULL;
+        }
+        grown->size = size;
+        return grown + 1;
+    }
+
+    void *moved = pool_alloc(size);
+    if (!moved) {
+        return NULL;
+    }
+    memcpy(moved, ptr, usable < size ? usable : size);
+    pool_free(ptr);
+    return moved;
+}
+
+void pool_trim(void)
+{
+    pool_cache_t *cache = thread_cache;
+    if (!cache) {
+        return;
+    }
+
+    pool_drain_remote(cache);
+    for (unsigned i = 0; i < POOL_CLASS_COUNT; i++) {
+        pool_slab_t *slab = cache->classes[i].head;
+        while (slab) {
+            pool_slab_t *next = slab->next;
+            if (slab->used == 0) {
+                pool_slab_destroy(cache, slab);
+            }
+            slab = next;
+        }
+    }
+}
+
+void pool_get_stats(pool_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+
+    pool_cache_t *cache = thread_cache;
+    if (cache) {
+        *stats = cache->stats;
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
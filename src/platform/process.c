@@ -3,9 +3,17 @@
  * @brief Implementation of process management abstraction
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <sys/eventfd.h>
 #include <errno.h>
@@ -13,6 +21,7 @@
 
 #include "../../include/platform/process.h"
 #include "../../include/platform/system.h"
+#include "../../include/platform/topology.h"
 #include "../../include/platform/log.h"
 
 process_error_t worker_manager_init(worker_manager_t *manager, const worker_config_t *config)
@@ -36,6 +45,7 @@ process_error_t worker_manager_init(worker_manager_t *manager, const worker_conf
     /* Copy configuration */
     manager->config.worker_count = config->worker_count;
     manager->config.enable_affinity = config->enable_affinity;
+    manager->config.bind_memory = config->bind_memory;
 
     /* Allocate and copy CPU IDs */
     manager->config.cpu_ids = system_malloc(config->worker_count * sizeof(int));
@@ -52,6 +62,12 @@ process_error_t worker_manager_init(worker_manager_t *manager, const worker_conf
     }
     memset(manager->workers, 0, sizeof(worker_context_t) * config->worker_count);
 
+    /* Worker pidfds are registered here as they are forked */
+    manager->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (manager->epoll_fd == -1) {
+        log_warn("epoll_create1 failed, worker exits are polled: %s", strerror(errno));
+    }
+
     /* Initialize as parent process initially */
     manager->type = PROCESS_TYPE_PARENT;
     manager->current_worker_id = -1;
@@ -75,84 +91,236 @@ void worker_manager_cleanup(worker_manager_t *manager)
             if (manager->workers[i].eventfd > 0) {
                 close(manager->workers[i].eventfd);
             }
+            control_channel_destroy(&manager->workers[i].control);
+            if (manager->workers[i].pidfd > 0) {
+                close(manager->workers[i].pidfd);
+            }
         }
         system_free(manager->workers);
     }
 
+    if (manager->epoll_fd > 0) {
+        close(manager->epoll_fd);
+    }
+
     memset(manager, 0, sizeof(*manager));
 }
 
-process_error_t worker_manager_fork_workers(worker_manager_t *manager)
+static int64_t monotonic_ms(void)
 {
-    if (!manager) {
-        return PROCESS_ERROR_INVALID_PARAM;
-    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-    /* Fork worker processes */
-    for (int i = 0; i < manager->config.worker_count; i++) {
-        /* Create eventfd for synchronization */
-        int efd = eventfd(0, EFD_SEMAPHORE);
+/**
+ * @brief Fork the worker at index; returns in both processes
+ * @param track_ready Give the worker an eventfd to report that it is listening
+ */
+static process_error_t worker_manager_spawn(worker_manager_t *manager, int index, bool track_ready)
+{
+    worker_context_t *worker = &manager->workers[index];
+    pid_t parent = getpid();
+
+    /* Create eventfd for synchronization */
+    int efd = -1;
+    if (track_ready) {
+        efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
         if (efd == -1) {
             return PROCESS_ERROR_EVENTFD;
         }
+    }
+
+    /* Shared with the worker; a replacement starts without its predecessor's backlog */
+    if (worker->control.ring) {
+        control_channel_reset(&worker->control);
+    } else if (control_channel_create(&worker->control) != CONTROL_CHANNEL_OK) {
+        if (efd >= 0) {
+            close(efd);
+        }
+        return PROCESS_ERROR_CHANNEL;
+    }
 
-        pid_t pid = fork();
-        if (pid == -1) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        if (efd >= 0) {
             close(efd);
-            return PROCESS_ERROR_FORK;
         }
+        return PROCESS_ERROR_FORK;
+    }
 
-        /* Parent process */
-        if (pid > 0) {
-            manager->workers[i].worker_id = i;
-            manager->workers[i].cpu_id = manager->config.cpu_ids[i];
-            manager->workers[i].eventfd = efd;
-            manager->workers[i].pid = pid;
+    /* Parent process */
+    if (pid > 0) {
+        worker->worker_id = index;
+        worker->cpu_id = manager->config.cpu_ids[index];
+        worker->pid = pid;
+        worker->started_ms = monotonic_ms();
+
+        /* Exits wake the supervisor through the pidfd; without one it polls */
+        worker->pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+        if (worker->pidfd > 0 && manager->epoll_fd > 0) {
+            struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)index };
+            (void)epoll_ctl(manager->epoll_fd, EPOLL_CTL_ADD, worker->pidfd, &ev);
+        }
 
-            /* Wait for worker to signal ready */
-            eventfd_t value;
-            if (eventfd_read(efd, &value) == -1) {
+        /* Readiness is collected for all workers at once */
+        worker->eventfd = efd;
+        if (!track_ready) {
+            log_info("Worker %d running on CPU %d (PID: %d)", index, worker->cpu_id, pid);
+        }
+        return PROCESS_OK;
+    }
+
+    /* Child/Worker process */
+    manager->type = PROCESS_TYPE_WORKER;
+    manager->current_worker_id = index;
+
+    /* Never outlive the parent: orphans would keep accepting on shared listeners */
+    if (prctl(PR_SET_PDEATHSIG, SIGKILL) == -1 || getppid() != parent) {
+        _exit(EXIT_FAILURE);
+    }
+
+    /* Set CPU affinity if enabled */
+    if (manager->config.enable_affinity) {
+        system_error_t err = system_set_cpu_affinity(manager->config.cpu_ids[index]);
+        if (err != SYSTEM_OK) {
+            if (efd >= 0) {
                 close(efd);
-                return PROCESS_ERROR_EVENTFD;
             }
-            close(efd);
-            manager->workers[i].eventfd = -1; /* Mark as closed */
+            return PROCESS_ERROR_INVALID_PARAM;
+        }
+    }
 
-            log_info("Worker %d running on CPU %d (PID: %d)",
-                     i, manager->config.cpu_ids[i], pid);
-            continue;
+    /* Keep rings, buffers and pools on the node that serves this CPU */
+    if (manager->config.bind_memory) {
+        int node = topology_get_cpu_node(manager->config.cpu_ids[index]);
+        if (topology_bind_memory(node) != TOPOLOGY_OK) {
+            log_warn("Worker %d could not bind memory to node %d: %s", index, node, strerror(errno));
         }
+    }
 
-        /* Child/Worker process */
-        else {
-            manager->type = PROCESS_TYPE_WORKER;
-            manager->current_worker_id = i;
+    /* Free parent-only resources */
+    for (int j = 0; j < manager->config.worker_count; j++) {
+        worker_context_t *other = &manager->workers[j];
+        if (other->eventfd > 0) {
+            close(other->eventfd);
+            other->eventfd = -1;
+        }
+        if (j != index) {
+            control_channel_destroy(&other->control);
+        }
+        if (other->pidfd > 0) {
+            close(other->pidfd);
+            other->pidfd = -1;
+        }
+    }
+    if (manager->epoll_fd > 0) {
+        close(manager->epoll_fd);
+        manager->epoll_fd = -1;
+    }
 
-            /* Set CPU affinity if enabled */
-            if (manager->config.enable_affinity) {
-                system_error_t err = system_set_cpu_affinity(manager->config.cpu_ids[i]);
-                if (err != SYSTEM_OK) {
-                    close(efd);
-                    return PROCESS_ERROR_INVALID_PARAM;
-                }
-            }
+    /* Store eventfd for later signaling */
+    worker->eventfd = efd;
+    worker->cpu_id = manager->config.cpu_ids[index];
+
+    return PROCESS_OK;
+}
+
+/** Tags readiness and exit events of one worker in the startup epoll */
+#define READY_EVENT_EXIT (1ull << 32)
+
+/**
+ * @brief Wait until every worker has signalled readiness on its eventfd
+ * @return PROCESS_OK, PROCESS_ERROR_TIMEOUT if one exits or is not ready in time
+ */
+static process_error_t worker_manager_wait_ready(worker_manager_t *manager)
+{
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        return PROCESS_ERROR_EVENTFD;
+    }
+
+    int pending = 0;
+    for (int i = 0; i < manager->config.worker_count; i++) {
+        worker_context_t *worker = &manager->workers[i];
+        struct epoll_event ev = { .events = EPOLLIN, .data.u64 = (uint64_t)i };
+        if (worker->eventfd <= 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, worker->eventfd, &ev) == -1) {
+            close(epoll_fd);
+            return PROCESS_ERROR_EVENTFD;
+        }
+        pending++;
 
-            /* Store eventfd for later signaling */
-            manager->workers[i].eventfd = efd;
-            manager->workers[i].cpu_id = manager->config.cpu_ids[i];
+        /* A worker dying during startup fails it at once instead of at the timeout */
+        if (worker->pidfd > 0) {
+            ev.data.u64 = (uint64_t)i | READY_EVENT_EXIT;
+            (void)epoll_ctl(epoll_fd, EPOLL_CTL_ADD, worker->pidfd, &ev);
+        }
+    }
+
+    process_error_t result = PROCESS_OK;
+    int64_t deadline = monotonic_ms() + PROCESS_READY_TIMEOUT_MS;
+    while (pending > 0 && result == PROCESS_OK) {
+        int64_t timeout = deadline - monotonic_ms();
+        if (timeout <= 0) {
+            log_error("%d workers not ready after %d ms", pending, PROCESS_READY_TIMEOUT_MS);
+            result = PROCESS_ERROR_TIMEOUT;
+            break;
+        }
+
+        struct epoll_event events[64];
+        int n = epoll_wait(epoll_fd, events, 64, (int)timeout);
+        if (n == -1 && errno != EINTR) {
+            result = PROCESS_ERROR_EVENTFD;
+        }
 
-            /* Free parent-only resources */
-            for (int j = 0; j < i; j++) {
-                if (manager->workers[j].eventfd > 0) {
-                    close(manager->workers[j].eventfd);
-                    manager->workers[j].eventfd = -1;
+        for (int e = 0; e < n; e++) {
+            int i = (int)(uint32_t)events[e].data.u64;
+            worker_context_t *worker = &manager->workers[i];
+
+            if (events[e].data.u64 & READY_EVENT_EXIT) {
+                if (worker->eventfd > 0) {
+                    log_error("Worker %d (PID: %d) exited during startup", i, worker->pid);
+                    result = PROCESS_ERROR_FORK;
+                    break;
                 }
+                /* Ready, then died: the supervisor restarts it */
+                (void)epoll_ctl(epoll_fd, EPOLL_CTL_DEL, worker->pidfd, NULL);
+                continue;
+            }
+
+            eventfd_t value;
+            if (worker->eventfd > 0 && eventfd_read(worker->eventfd, &value) == 0) {
+                close(worker->eventfd);
+                worker->eventfd = -1;
+                pending--;
+                log_info("Worker %d running on CPU %d (PID: %d)", i, worker->cpu_id, worker->pid);
             }
+        }
+    }
+
+    close(epoll_fd);
+    return result;
+}
+
+process_error_t worker_manager_fork_workers(worker_manager_t *manager)
+{
+    if (!manager) {
+        return PROCESS_ERROR_INVALID_PARAM;
+    }
 
-            return PROCESS_OK;
+    /* Fork every worker first; they set up their reactors concurrently */
+    for (int i = 0; i < manager->config.worker_count; i++) {
+        process_error_t err = worker_manager_spawn(manager, i, true);
+        if (err != PROCESS_OK || manager->type == PROCESS_TYPE_WORKER) {
+            return err;
         }
     }
 
+    process_error_t err = worker_manager_wait_ready(manager);
+    if (err != PROCESS_OK) {
+        return err;
+    }
+
     log_info("libreactor running with %d worker processes",
              manager->config.worker_count);
 
@@ -187,20 +355,279 @@ process_error_t worker_manager_signal_ready(worker_manager_t *manager)
     return PROCESS_OK;
 }
 
-process_error_t worker_manager_wait_workers(worker_manager_t *manager)
+/**
+ * @brief Record a worker exit and schedule its replacement
+ */
+static void worker_manager_handle_exit(worker_manager_t *manager, int index, int status, int64_t now)
+{
+    worker_context_t *worker = &manager->workers[index];
+    pid_t pid = worker->pid;
+
+    worker->pid = 0;
+    if (worker->pidfd > 0) {
+        close(worker->pidfd);
+        worker->pidfd = -1;
+    }
+
+    /* A worker that ran for a while crashed once; one that did not is crash-looping */
+    if (now - worker->started_ms >= PROCESS_RESPAWN_STABLE_MS) {
+        worker->failures = 0;
+    }
+    int64_t delay = 0;
+    if (worker->failures > 0) {
+        int shift = worker->failures - 1 < 16 ? worker->failures - 1 : 16;
+        delay = (int64_t)PROCESS_RESPAWN_BACKOFF_MS << shift;
+        if (delay > PROCESS_RESPAWN_BACKOFF_MAX_MS) {
+            delay = PROCESS_RESPAWN_BACKOFF_MAX_MS;
+        }
+    }
+    worker->failures++;
+    worker->respawn_at_ms = now + delay;
+
+    if (WIFSIGNALED(status)) {
+        log_error("Worker %d (PID: %d) killed by signal %d, restarting on CPU %d in %lld ms",
+                  index, pid, WTERMSIG(status), worker->cpu_id, (long long)delay);
+    } else {
+        log_error("Worker %d (PID: %d) exited with status %d, restarting on CPU %d in %lld ms",
+                  index, pid, WEXITSTATUS(status), worker->cpu_id, (long long)delay);
+    }
+}
+
+process_error_t worker_manager_supervise(worker_manager_t *manager)
 {
     if (!manager || manager->type != PROCESS_TYPE_PARENT) {
         return PROCESS_ERROR_INVALID_PARAM;
     }
 
-    /* Wait for any child to exit */
-    int status;
-    pid_t pid = wait(&status);
-    if (pid == -1) {
-        return PROCESS_ERROR_WAIT;
+    /* Reap exited workers; other children (such as a binary started for an
+     * upgrade) are left to their owner */
+    int64_t now = monotonic_ms();
+    for (int i = 0; i < manager->config.worker_count; i++) {
+        pid_t pid = manager->workers[i].pid;
+        int status;
+        if (pid > 0 && waitpid(pid, &status, WNOHANG) == pid) {
+            worker_manager_handle_exit(manager, i, status, now);
+        }
+    }
+
+    /* Replace the ones whose backoff has elapsed, on the same CPU */
+    for (int i = 0; i < manager->config.worker_count; i++) {
+        worker_context_t *worker = &manager->workers[i];
+        if (worker->pid != 0 || worker->respawn_at_ms > now) {
+            continue;
+        }
+
+        process_error_t err = worker_manager_spawn(manager, i, false);
+        if (manager->type == PROCESS_TYPE_WORKER) {
+            return err;
+        }
+        if (err != PROCESS_OK) {
+            log_error("Failed to restart worker %d: %d", i, err);
+            worker->respawn_at_ms = now + PROCESS_RESPAWN_BACKOFF_MAX_MS;
+        }
+    }
+
+    return PROCESS_OK;
+}
+
+int worker_manager_supervise_timeout(const worker_manager_t *manager)
+{
+    if (!manager || manager->type != PROCESS_TYPE_PARENT) {
+        return -1;
+    }
+
+    int64_t now = monotonic_ms();
+    int64_t timeout = -1;
+    for (int i = 0; i < manager->config.worker_count; i++) {
+        const worker_context_t *worker = &manager->workers[i];
+        int64_t wait;
+        if (worker->pid == 0) {
+            wait = worker->respawn_at_ms > now ? worker->respawn_at_ms - now : 0;
+        } else if (worker->pidfd <= 0) {
+            wait = PROCESS_POLL_INTERVAL_MS;  /* No pidfd: poll for exits */
+        } else {
+            continue;
+        }
+        if (timeout < 0 || wait < timeout) {
+            timeout = wait;
+        }
+    }
+
+    return (int)timeout;
+}
+
+int worker_manager_get_event_fd(const worker_manager_t *manager)
+{
+    return manager && manager->type == PROCESS_TYPE_PARENT ? manager->epoll_fd : -1;
+}
+
+int worker_manager_get_control_fd(const worker_manager_t *manager)
+{
+    if (!manager || manager->type != PROCESS_TYPE_WORKER) {
+        return -1;
+    }
+    return manager->workers[manager->current_worker_id].control.doorbell;
+}
+
+control_channel_t *worker_manager_get_control_channel(worker_manager_t *manager)
+{
+    if (!manager || manager->type != PROCESS_TYPE_WORKER) {
+        return NULL;
+    }
+    return &manager->workers[manager->current_worker_id].control;
+}
+
+process_error_t worker_manager_broadcast(worker_manager_t *manager, const control_message_t *message)
+{
+    if (!manager || manager->type != PROCESS_TYPE_PARENT || !message) {
+        return PROCESS_ERROR_INVALID_PARAM;
+    }
+
+    process_error_t result = PROCESS_OK;
+    for (int i = 0; i < manager->config.worker_count; i++) {
+        worker_context_t *worker = &manager->workers[i];
+        if (worker->pid <= 0) {
+            continue;
+        }
+
+        control_channel_error_t err = control_channel_send(&worker->control, message);
+        if (err != CONTROL_CHANNEL_OK) {
+            log_warn("Worker %d did not get control message %u: %s", i, message->type,
+                     err == CONTROL_CHANNEL_ERROR_FULL ? "channel full" : strerror(errno));
+            result = PROCESS_ERROR_CHANNEL;
+        }
+    }
+
+    return result;
+}
+
+process_error_t worker_manager_stop_workers(worker_manager_t *manager)
+{
+    control_message_t message = { .type = CONTROL_MESSAGE_DRAIN };
+    return worker_manager_broadcast(manager, &message);
+}
+
+int worker_manager_running_workers(worker_manager_t *manager)
+{
+    if (!manager || manager->type != PROCESS_TYPE_PARENT) {
+        return 0;
+    }
+
+    int running = 0;
+    for (int i = 0; i < manager->config.worker_count; i++) {
+        pid_t pid = manager->workers[i].pid;
+        int status;
+        if (pid <= 0) {
+            continue;
+        }
+        if (waitpid(pid, &status, WNOHANG) == pid) {
+            /* A reaped worker's pidfd stays readable; closing it leaves the epoll set */
+            manager->workers[i].pid = 0;
+            if (manager->workers[i].pidfd > 0) {
+                close(manager->workers[i].pidfd);
+                manager->workers[i].pidfd = -1;
+            }
+        } else {
+            running++;
+        }
+    }
+
+    return running;
+}
+
+int worker_manager_wait_exit(worker_manager_t *manager, int timeout_ms)
+{
+    int running = worker_manager_running_workers(manager);
+    if (running == 0 || timeout_ms == 0) {
+        return running;
+    }
+
+    for (int i = 0; i < manager->config.worker_count; i++) {
+        const worker_context_t *worker = &manager->workers[i];
+        if (worker->pid > 0 && worker->pidfd <= 0 &&
+            (timeout_ms < 0 || timeout_ms > PROCESS_POLL_INTERVAL_MS)) {
+            timeout_ms = PROCESS_POLL_INTERVAL_MS;
+        }
+    }
+
+    if (manager->epoll_fd > 0) {
+        struct epoll_event events[16];
+        (void)epoll_wait(manager->epoll_fd, events, 16, timeout_ms);
+    } else {
+        usleep((useconds_t)timeout_ms * 1000);
+    }
+
+    return worker_manager_running_workers(manager);
+}
+
+void worker_manager_kill_workers(worker_manager_t *manager)
+{
+    if (!manager || manager->type != PROCESS_TYPE_PARENT) {
+        return;
+    }
+
+    for (int i = 0; i < manager->config.worker_count; i++) {
+        if (manager->workers[i].pid > 0) {
+            kill(manager->workers[i].pid, SIGKILL);
+        }
+    }
+}
+
+process_error_t process_spawn_with_fd(char *const argv[], int fd, const char *env_name, pid_t *pid)
+{
+    if (!argv || !argv[0] || fd < 0 || !env_name || !pid) {
+        return PROCESS_ERROR_INVALID_PARAM;
+    }
+
+    /* Build the environment before forking: the child may only exec */
+    extern char **environ;
+    size_t count = 0;
+    while (environ[count]) {
+        count++;
+    }
+
+    char **envp = system_malloc((count + 2) * sizeof(char *));
+    char *variable = system_malloc(strlen(env_name) + 16);
+    if (!envp || !variable) {
+        system_free(envp);
+        system_free(variable);
+        return PROCESS_ERROR_INVALID_PARAM;
+    }
+
+    size_t name_length = strlen(env_name);
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (strncmp(environ[i], env_name, name_length) != 0 || environ[i][name_length] != '=') {
+            envp[used++] = environ[i];
+        }
+    }
+    sprintf(variable, "%s=%d", env_name, fd);
+    envp[used++] = variable;
+    envp[used] = NULL;
+
+    pid_t child = fork();
+    if (child == 0) {
+        /* The mask survives exec; the new binary opens its own signalfd */
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+
+        int flags = fcntl(fd, F_GETFD);
+        if (flags == -1 || fcntl(fd, F_SETFD, flags & ~FD_CLOEXEC) == -1) {
+            _exit(127);
+        }
+        execvpe(argv[0], argv, envp);
+        _exit(127);
+    }
+
+    system_free(envp);
+    system_free(variable);
+
+    if (child == -1) {
+        return PROCESS_ERROR_FORK;
     }
 
-    log_error("A worker process (PID: %d) has exited unexpectedly. Shutting down", pid);
+    *pid = child;
     return PROCESS_OK;
 }
 
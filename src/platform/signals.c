@@ -9,6 +9,8 @@
 #include <signal.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sys/signalfd.h>
 
 #include "../../include/platform/signals.h"
 #include "../../include/platform/log.h"
@@ -17,64 +19,63 @@
 static signal_manager_t *global_signal_manager = NULL;
 
 /**
- * @brief Generic signal handler
+ * @brief Note a signal and run its callback
+ * @note Runs in signal context when called from signal_handler(): no logging
  */
-static void signal_handler(int signum)
+static void signal_record(signal_manager_t *manager, int signum)
 {
-    if (!global_signal_manager) {
-        return;
-    }
-
     switch (signum) {
         case SIGTERM:
-            global_signal_manager->shutdown_requested = 1;
-            if (global_signal_manager->sigterm_handler) {
-                global_signal_manager->sigterm_handler(signum);
-            } else {
-                log_info("SIGTERM received, initiating graceful shutdown");
+            manager->shutdown_requested = 1;
+            if (manager->sigterm_handler) {
+                manager->sigterm_handler(signum);
             }
             break;
 
         case SIGINT:
-            global_signal_manager->shutdown_requested = 1;
-            if (global_signal_manager->sigint_handler) {
-                global_signal_manager->sigint_handler(signum);
-            } else {
-                log_info("SIGINT received, initiating graceful shutdown");
+            manager->shutdown_requested = 1;
+            if (manager->sigint_handler) {
+                manager->sigint_handler(signum);
             }
             break;
 
         case SIGHUP:
-            global_signal_manager->reload_requested = 1;
-            if (global_signal_manager->sighup_handler) {
-                global_signal_manager->sighup_handler(signum);
-            } else {
-                log_info("SIGHUP received, configuration reload requested");
+            manager->reload_requested = 1;
+            if (manager->sighup_handler) {
+                manager->sighup_handler(signum);
             }
             break;
 
         case SIGUSR1:
-            if (global_signal_manager->sigusr1_handler) {
-                global_signal_manager->sigusr1_handler(signum);
+            manager->usr1_requested = 1;
+            if (manager->sigusr1_handler) {
+                manager->sigusr1_handler(signum);
             }
             break;
 
         case SIGUSR2:
-            if (global_signal_manager->sigusr2_handler) {
-                global_signal_manager->sigusr2_handler(signum);
+            manager->usr2_requested = 1;
+            if (manager->sigusr2_handler) {
+                manager->sigusr2_handler(signum);
             }
             break;
 
-        case SIGPIPE:
-            /* Ignore SIGPIPE by default */
-            break;
-
         default:
-            log_warn("Unhandled signal: %d", signum);
+            /* SIGPIPE is ignored */
             break;
     }
 }
 
+/**
+ * @brief Generic signal handler
+ */
+static void signal_handler(int signum)
+{
+    if (global_signal_manager) {
+        signal_record(global_signal_manager, signum);
+    }
+}
+
 /**
  * @brief Setup signal handler
  */
@@ -115,6 +116,29 @@ static signal_error_t setup_signal_handler(int signum, bool enable)
     return SIGNAL_OK;
 }
 
+/**
+ * @brief Collect the signals the manager handles, except the ignored SIGPIPE
+ */
+static void signal_fill_set(const signal_manager_t *manager, sigset_t *set)
+{
+    sigemptyset(set);
+    if (manager->config.handle_sigterm) {
+        sigaddset(set, SIGTERM);
+    }
+    if (manager->config.handle_sigint) {
+        sigaddset(set, SIGINT);
+    }
+    if (manager->config.handle_sighup) {
+        sigaddset(set, SIGHUP);
+    }
+    if (manager->config.handle_sigusr1) {
+        sigaddset(set, SIGUSR1);
+    }
+    if (manager->config.handle_sigusr2) {
+        sigaddset(set, SIGUSR2);
+    }
+}
+
 signal_error_t signal_manager_init(signal_manager_t *manager, const signal_config_t *config)
 {
     if (!manager) {
@@ -122,6 +146,7 @@ signal_error_t signal_manager_init(signal_manager_t *manager, const signal_confi
     }
 
     memset(manager, 0, sizeof(*manager));
+    manager->fd = -1;
 
     if (config) {
         manager->config = *config;
@@ -175,6 +200,14 @@ void signal_manager_cleanup(signal_manager_t *manager)
         return;
     }
 
+    /* Pending signals reach signal_handler() before the defaults return */
+    if (manager->fd >= 0) {
+        sigset_t set;
+        signal_fill_set(manager, &set);
+        close(manager->fd);
+        pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+    }
+
     /* Remove global reference */
     if (global_signal_manager == manager) {
         global_signal_manager = NULL;
@@ -204,6 +237,64 @@ void signal_manager_cleanup(signal_manager_t *manager)
     log_debug("Signal manager cleaned up");
 }
 
+signal_error_t signal_manager_open_fd(signal_manager_t *manager)
+{
+    if (!manager) {
+        return SIGNAL_ERROR_INVALID_PARAM;
+    }
+
+    sigset_t set;
+    signal_fill_set(manager, &set);
+
+    /* An inherited descriptor stays registered with the parent's epoll set */
+    if (manager->fd >= 0) {
+        close(manager->fd);
+        manager->fd = -1;
+    }
+
+    /* Signals that arrived before this still set their flags through the handler */
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) {
+        return SIGNAL_ERROR_SETUP;
+    }
+
+    int fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd == -1) {
+        log_error("Failed to create signalfd: %s", strerror(errno));
+        pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+        return SIGNAL_ERROR_FD;
+    }
+
+    manager->fd = fd;
+    return SIGNAL_OK;
+}
+
+int signal_manager_get_fd(const signal_manager_t *manager)
+{
+    return manager ? manager->fd : -1;
+}
+
+int signal_manager_dispatch(signal_manager_t *manager)
+{
+    if (!manager || manager->fd < 0) {
+        return 0;
+    }
+
+    struct signalfd_siginfo info[8];
+    int count = 0;
+    for (;;) {
+        ssize_t n = read(manager->fd, info, sizeof(info));
+        if (n <= 0) {
+            break;
+        }
+        for (size_t i = 0; i < (size_t)n / sizeof(info[0]); i++) {
+            log_debug("Signal %u received from PID %u", info[i].ssi_signo, info[i].ssi_pid);
+            signal_record(manager, (int)info[i].ssi_signo);
+            count++;
+        }
+    }
+    return count;
+}
+
 signal_error_t signal_manager_set_handler(signal_manager_t *manager, int signum, signal_callback_t callback)
 {
     if (!manager) {
@@ -243,6 +334,21 @@ bool signal_manager_reload_requested(const signal_manager_t *manager)
     return manager ? manager->reload_requested : false;
 }
 
+bool signal_manager_take_user(signal_manager_t *manager, int signum)
+{
+    if (!manager) {
+        return false;
+    }
+
+    volatile sig_atomic_t *flag = signum == SIGUSR1 ? &manager->usr1_requested :
+                                  signum == SIGUSR2 ? &manager->usr2_requested : NULL;
+    if (!flag || !*flag) {
+        return false;
+    }
+    *flag = 0;
+    return true;
+}
+
 void signal_manager_reset_shutdown(signal_manager_t *manager)
 {
     if (manager) {
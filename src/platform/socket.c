@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -54,7 +55,7 @@ socket_error_t socket_apply_optimizations(int socket_fd, const socket_config_t *
 
     /* Apply CPU-aware load balancing if requested */
     if (config->options & SOCKET_OPT_REUSEPORT_CBPF) {
-        socket_error_t err = socket_enable_reuseport_cbpf(socket_fd);
+        socket_error_t err = socket_enable_reuseport_cbpf(socket_fd, config->cpu_ids, config->cpu_count);
         if (err != SOCKET_OK) {
             result = err;
         }
@@ -63,20 +64,35 @@ socket_error_t socket_apply_optimizations(int socket_fd, const socket_config_t *
     return result;
 }
 
-socket_error_t socket_enable_reuseport_cbpf(int socket_fd)
+socket_error_t socket_enable_reuseport_cbpf(int socket_fd, const int *cpu_ids, int cpu_count)
 {
-    if (socket_fd < 0) {
+    if (socket_fd < 0 || (cpu_ids && (cpu_count <= 0 || cpu_count > SOCKET_CBPF_MAX_CPUS))) {
         return SOCKET_ERROR_INVALID_PARAM;
     }
 
-    /* BPF program that returns the CPU number for load balancing */
-    struct sock_filter code[] = {
-        {BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU},
-        {BPF_RET | BPF_A, 0, 0, 0}
-    };
+    /* Listener i on CPU i: the CPU number is the group index */
+    bool identity = true;
+    for (int i = 0; cpu_ids && i < cpu_count && identity; i++) {
+        identity = cpu_ids[i] == i;
+    }
+
+    struct sock_filter code[2 * SOCKET_CBPF_MAX_CPUS + 2];
+    unsigned short length = 0;
+    code[length++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+
+    if (identity) {
+        code[length++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_A, 0);
+    } else {
+        /* Otherwise map each CPU to its listener; out-of-range indexes select by hash */
+        for (int i = 0; i < cpu_count; i++) {
+            code[length++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)cpu_ids[i], 0, 1);
+            code[length++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, (uint32_t)i);
+        }
+        code[length++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, UINT32_MAX);
+    }
 
     struct sock_fprog prog = {
-        .len = sizeof(code) / sizeof(code[0]),
+        .len = length,
         .filter = code
     };
 
@@ -131,3 +147,216 @@ socket_error_t socket_set_keepalive(int socket_fd, bool enabled)
 
     return SOCKET_OK;
 }
+
+/**
+ * @brief Apply the listener-only options (accept behaviour)
+ */
+static socket_error_t socket_apply_listener_options(int socket_fd, const socket_config_t *config)
+{
+    socket_error_t result = SOCKET_OK;
+
+    if (config->options & SOCKET_OPT_DEFER_ACCEPT) {
+        if (setsockopt(socket_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+                       &config->defer_accept_s, sizeof(config->defer_accept_s)) == -1) {
+            result = SOCKET_ERROR_SETSOCKOPT;
+        }
+    }
+
+    if (config->options & SOCKET_OPT_FASTOPEN) {
+        if (setsockopt(socket_fd, IPPROTO_TCP, TCP_FASTOPEN,
+                       &config->fastopen_queue, sizeof(config->fastopen_queue)) == -1) {
+            result = SOCKET_ERROR_SETSOCKOPT;
+        }
+    }
+
+    return result;
+}
+
+socket_error_t socket_open_listener(uint32_t ip, uint16_t port, int backlog, int incoming_cpu,
+                                    const socket_config_t *config, int *socket_fd)
+{
+    if (!socket_fd || backlog <= 0) {
+        return SOCKET_ERROR_INVALID_PARAM;
+    }
+    *socket_fd = -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return SOCKET_ERROR_SYSTEM;
+    }
+
+    int on = 1;
+    (void)setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    (void)setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+    /* Everything but the BPF program; accepted sockets inherit most of it */
+    socket_error_t result = SOCKET_OK;
+    if (config) {
+        socket_config_t listener = *config;
+        listener.options &= ~(uint32_t)SOCKET_OPT_REUSEPORT_CBPF;
+        result = socket_apply_optimizations(fd, &listener);
+        socket_error_t err = socket_apply_listener_options(fd, config);
+        if (result == SOCKET_OK) {
+            result = err;
+        }
+    }
+
+    if (incoming_cpu >= 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &incoming_cpu, sizeof(incoming_cpu)) == -1 &&
+        result == SOCKET_OK) {
+        result = SOCKET_ERROR_SETSOCKOPT;
+    }
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(ip)
+    };
+
+    bool bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    if (bound && config && (config->options & SOCKET_OPT_REUSEPORT_CBPF)) {
+        socket_error_t err = socket_enable_reuseport_cbpf(fd, config->cpu_ids, config->cpu_count);
+        if (result == SOCKET_OK) {
+            result = err;
+        }
+    }
+
+    if (!bound || listen(fd, backlog) == -1) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return SOCKET_ERROR_SYSTEM;
+    }
+
+    *socket_fd = fd;
+    return result;
+}
+
+int socket_accepted_options(const socket_config_t *config, socket_option_value_t *options)
+{
+    if (!config || !options) {
+        return 0;
+    }
+
+    int count = 0;
+    if (config->options & SOCKET_OPT_NODELAY) {
+        options[count++] = (socket_option_value_t){ IPPROTO_TCP, TCP_NODELAY, 1 };
+    }
+    if (config->options & SOCKET_OPT_KEEPALIVE) {
+        options[count++] = (socket_option_value_t){ SOL_SOCKET, SO_KEEPALIVE, config->keepalive_enabled };
+    }
+    if (config->options & SOCKET_OPT_BUSY_POLL) {
+        options[count++] = (socket_option_value_t){ SOL_SOCKET, SO_BUSY_POLL, config->busy_poll_value };
+    }
+    return count;
+}
+
+int socket_get_incoming_cpu(int socket_fd)
+{
+    int cpu = -1;
+    socklen_t length = sizeof(cpu);
+    if (getsockopt(socket_fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &length) == -1) {
+        return -1;
+    }
+    return cpu;
+}
+
+socket_error_t socket_send_fds(int channel, const int *fds, int count)
+{
+    if (channel < 0 || count < 0 || (count > 0 && !fds)) {
+        return SOCKET_ERROR_INVALID_PARAM;
+    }
+
+    /* Every chunk carries the total so the receiver knows when to stop */
+    uint32_t total = (uint32_t)count;
+    int sent = 0;
+    do {
+        int chunk = count - sent;
+        if (chunk > SOCKET_MAX_PASSED_FDS) {
+            chunk = SOCKET_MAX_PASSED_FDS;
+        }
+
+        union {
+            char data[CMSG_SPACE(sizeof(int) * SOCKET_MAX_PASSED_FDS)];
+            struct cmsghdr align;
+        } control;
+        struct iovec iov = { .iov_base = &total, .iov_len = sizeof(total) };
+        struct msghdr message = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+        if (chunk > 0) {
+            message.msg_control = control.data;
+            message.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)chunk);
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int) * (size_t)chunk);
+            memcpy(CMSG_DATA(cmsg), fds + sent, sizeof(int) * (size_t)chunk);
+        }
+
+        ssize_t n;
+        do {
+            n = sendmsg(channel, &message, MSG_NOSIGNAL);
+        } while (n == -1 && errno == EINTR);
+        if (n != (ssize_t)sizeof(total)) {
+            return SOCKET_ERROR_SYSTEM;
+        }
+        sent += chunk;
+    } while (sent < count);
+
+    return SOCKET_OK;
+}
+
+socket_error_t socket_recv_fds(int channel, int *fds, int capacity, int *count)
+{
+    if (channel < 0 || capacity < 0 || (capacity > 0 && !fds) || !count) {
+        return SOCKET_ERROR_INVALID_PARAM;
+    }
+
+    *count = 0;
+    uint32_t received = 0;
+    uint32_t total = 0;
+    do {
+        union {
+            char data[CMSG_SPACE(sizeof(int) * SOCKET_MAX_PASSED_FDS)];
+            struct cmsghdr align;
+        } control;
+        struct iovec iov = { .iov_base = &total, .iov_len = sizeof(total) };
+        struct msghdr message = {
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = control.data,
+            .msg_controllen = sizeof(control.data)
+        };
+
+        ssize_t n;
+        do {
+            n = recvmsg(channel, &message, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+        } while (n == -1 && errno == EINTR);
+        if (n != (ssize_t)sizeof(total)) {
+            return SOCKET_ERROR_SYSTEM;
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+            size_t passed = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < passed; i++) {
+                int fd;
+                memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+                if (*count < capacity) {
+                    fds[(*count)++] = fd;
+                } else {
+                    close(fd);
+                }
+            }
+            received += (uint32_t)passed;
+        }
+
+        if (message.msg_flags & MSG_CTRUNC) {
+            return SOCKET_ERROR_SYSTEM;
+        }
+    } while (received < total);
+
+    return SOCKET_OK;
+}
@@ -14,6 +14,7 @@
 #include <signal.h>
 
 #include "../../include/platform/system.h"
+#include "../../include/platform/pool.h"
 
 /** Internal state */
 static bool system_initialized = false;
@@ -133,33 +134,17 @@ system_error_t system_get_cpu_affinity_string(char *buffer, size_t size)
 
 void *system_malloc(size_t size)
 {
-    if (size == 0) {
-        return NULL;
-    }
-
-    void *ptr = malloc(size);
-    if (!ptr) {
-        /* In a real implementation, you might want to log this error */
-        return NULL;
-    }
-
-    return ptr;
+    return pool_alloc(size);
 }
 
 void system_free(void *ptr)
 {
-    free(ptr);
+    pool_free(ptr);
 }
 
 void *system_realloc(void *ptr, size_t size)
 {
-    void *new_ptr = realloc(ptr, size);
-    if (size > 0 && !new_ptr) {
-        /* In a real implementation, you might want to log this error */
-        return NULL;
-    }
-
-    return new_ptr;
+    return pool_realloc(ptr, size);
 }
 
 char *system_strdup(const char *str)
@@ -168,11 +153,13 @@ char *system_strdup(const char *str)
         return NULL;
     }
 
-    char *dup = strdup(str);
+    /* Must come from the pool so system_free() can release it */
+    size_t length = strlen(str) + 1;
+    char *dup = system_malloc(length);
     if (!dup) {
-        /* In a real implementation, you might want to log this error */
         return NULL;
     }
 
+    memcpy(dup, str, length);
     return dup;
 }
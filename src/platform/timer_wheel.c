@@ -0,0 +1,152 @@
+/**
+ * @file timer_wheel.c
+ * @brief Implementation of the hierarchical timing wheel
+ */
+
+#include <string.h>
+
+#include "../../include/platform/timer_wheel.h"
+
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+timer_wheel_error_t timer_wheel_init(timer_wheel_t *wheel, unsigned tick_ms, int64_t now_ms)
+{
+    if (!wheel || tick_ms == 0) {
+        return TIMER_WHEEL_ERROR_INVALID_PARAM;
+    }
+
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->tick_ms = tick_ms;
+    wheel->origin_ms = now_ms;
+    wheel->tick = 1;
+    return TIMER_WHEEL_OK;
+}
+
+void timer_wheel_timer_init(timer_wheel_timer_t *timer, timer_wheel_callback_t *callback)
+{
+    timer->next = NULL;
+    timer->link = NULL;
+    timer->expires = 0;
+    timer->callback = callback;
+}
+
+/**
+ * @brief Link a timer into the slot its distance from the current tick selects
+ */
+static void timer_wheel_place(timer_wheel_t *wheel, timer_wheel_timer_t *timer)
+{
+    uint64_t delta = timer->expires - wheel->tick;
+    unsigned level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >> ((level + 1) * TIMER_WHEEL_SLOT_BITS) != 0) {
+        level++;
+    }
+
+    timer_wheel_timer_t **slot =
+        &wheel->slots[level][(timer->expires >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK];
+    timer->next = *slot;
+    if (timer->next) {
+        timer->next->link = &timer->next;
+    }
+    timer->link = slot;
+    *slot = timer;
+}
+
+static void timer_wheel_unlink(timer_wheel_timer_t *timer)
+{
+    *timer->link = timer->next;
+    if (timer->next) {
+        timer->next->link = timer->link;
+    }
+    timer->next = NULL;
+    timer->link = NULL;
+}
+
+void timer_wheel_arm(timer_wheel_t *wheel, timer_wheel_timer_t *timer, uint64_t timeout_ms)
+{
+    uint64_t ticks = timeout_ms / wheel->tick_ms + (timeout_ms % wheel->tick_ms != 0);
+    if (ticks > TIMER_WHEEL_MAX_TICKS) {
+        ticks = TIMER_WHEEL_MAX_TICKS;
+    }
+
+    uint64_t expires = wheel->tick + ticks;
+    if (timer->link) {
+        if (timer->expires == expires) {
+            return;
+        }
+        timer_wheel_unlink(timer);
+    } else {
+        wheel->count++;
+    }
+
+    timer->expires = expires;
+    timer_wheel_place(wheel, timer);
+}
+
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_wheel_timer_t *timer)
+{
+    if (!timer->link) {
+        return;
+    }
+
+    timer_wheel_unlink(timer);
+    wheel->count--;
+}
+
+/**
+ * @brief Process the current tick
+ */
+static size_t timer_wheel_step(timer_wheel_t *wheel)
+{
+    uint64_t tick = wheel->tick;
+
+    /* A new round of a level brings the next slot of the level above down */
+    size_t index = tick & TIMER_WHEEL_SLOT_MASK;
+    for (unsigned level = 1; index == 0 && level < TIMER_WHEEL_LEVELS; level++) {
+        index = (tick >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK;
+        timer_wheel_timer_t *timer = wheel->slots[level][index];
+        wheel->slots[level][index] = NULL;
+        while (timer) {
+            timer_wheel_timer_t *next = timer->next;
+            timer_wheel_place(wheel, timer);
+            timer = next;
+        }
+    }
+
+    /* Detach the slot so callbacks arming timers cannot extend it */
+    timer_wheel_timer_t **slot = &wheel->slots[0][tick & TIMER_WHEEL_SLOT_MASK];
+    timer_wheel_timer_t *expired = *slot;
+    *slot = NULL;
+    if (expired) {
+        expired->link = &expired;
+    }
+    wheel->tick = tick + 1;
+
+    size_t fired = 0;
+    while (expired) {
+        timer_wheel_timer_t *timer = expired;
+        timer_wheel_unlink(timer);
+        wheel->count--;
+        timer->callback(timer);
+        fired++;
+    }
+    return fired;
+}
+
+size_t timer_wheel_advance(timer_wheel_t *wheel, int64_t now_ms)
+{
+    if (now_ms < wheel->origin_ms) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)(now_ms - wheel->origin_ms) / wheel->tick_ms;
+    size_t fired = 0;
+    while (wheel->tick <= target) {
+        if (wheel->count == 0) {
+            /* Nothing to cascade or fire: skip the idle ticks at once */
+            wheel->tick = target + 1;
+            break;
+        }
+        fired += timer_wheel_step(wheel);
+    }
+    return fired;
+}
@@ -0,0 +1,409 @@
+/**
+ * @file topology.c
+ * @brief Implementation of CPU topology discovery and memory placement
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "../../include/platform/topology.h"
+#include "../../include/platform/system.h"
+
+/** Highest node number topology_bind_memory() accepts */
+#define TOPOLOGY_MAX_NODES 1024
+
+#define TOPOLOGY_LONG_BITS (8 * (int)sizeof(unsigned long))
+
+/**
+ * @brief Read a small sysfs or procfs file into a NUL-terminated buffer
+ */
+static bool topology_read_file(const char *path, char *buffer, size_t size)
+{
+    FILE *file = fopen(path, "re");
+    if (!file) {
+        return false;
+    }
+
+    size_t length = fread(buffer, 1, size - 1, file);
+    fclose(file);
+    buffer[length] = '\0';
+    return length > 0;
+}
+
+/**
+ * @brief Parse a kernel CPU list such as "0-3,8,10-11" into a set
+ */
+static bool topology_parse_cpulist(const char *list, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+
+    const char *p = list;
+    while (*p && *p != '\n') {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            return false;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first) {
+                return false;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET((int)cpu, set);
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p && *p != '\n') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+topology_error_t topology_parse_cpu_list(const char *list, int **cpu_ids, int *count)
+{
+    if (!list || !cpu_ids || !count) {
+        return TOPOLOGY_ERROR_INVALID_PARAM;
+    }
+
+    cpu_set_t set;
+    if (!topology_parse_cpulist(list, &set) || CPU_COUNT(&set) == 0) {
+        return TOPOLOGY_ERROR_INVALID_PARAM;
+    }
+
+    int total = CPU_COUNT(&set);
+    int *ids = system_malloc((size_t)total * sizeof(int));
+    if (!ids) {
+        return TOPOLOGY_ERROR_MEMORY;
+    }
+
+    int n = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && n < total; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            ids[n++] = cpu;
+        }
+    }
+
+    *cpu_ids = ids;
+    *count = n;
+    return TOPOLOGY_OK;
+}
+
+int topology_get_cpu_node(int cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return 0;
+    }
+
+    /* The CPU directory links to its node as "node<N>" */
+    int node = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && isdigit((unsigned char)entry->d_name[4])) {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+
+    closedir(dir);
+    return node;
+}
+
+/**
+ * @brief Find the lowest allowed hyperthread sibling of a CPU
+ */
+static int topology_get_cpu_core(int cpu, const cpu_set_t *allowed)
+{
+    char path[96];
+    char list[256];
+    cpu_set_t siblings;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    if (!topology_read_file(path, list, sizeof(list)) || !topology_parse_cpulist(list, &siblings)) {
+        return cpu;
+    }
+
+    for (int i = 0; i < cpu; i++) {
+        if (CPU_ISSET(i, &siblings) && CPU_ISSET(i, allowed)) {
+            return i;
+        }
+    }
+    return cpu;
+}
+
+topology_error_t topology_discover(topology_t *topology)
+{
+    if (!topology) {
+        return TOPOLOGY_ERROR_INVALID_PARAM;
+    }
+
+    memset(topology, 0, sizeof(*topology));
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        return TOPOLOGY_ERROR_AFFINITY;
+    }
+
+    int count = CPU_COUNT(&allowed);
+    if (count <= 0) {
+        return TOPOLOGY_ERROR_AFFINITY;
+    }
+
+    topology->cpus = system_malloc((size_t)count * sizeof(topology_cpu_t));
+    if (!topology->cpus) {
+        return TOPOLOGY_ERROR_MEMORY;
+    }
+
+    cpu_set_t nodes;
+    CPU_ZERO(&nodes);
+
+    for (int cpu = 0; cpu < CPU_SETSIZE && topology->count < count; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+
+        topology_cpu_t *entry = &topology->cpus[topology->count++];
+        entry->cpu = cpu;
+        entry->node = topology_get_cpu_node(cpu);
+        entry->core = topology_get_cpu_core(cpu, &allowed);
+        entry->primary = entry->core == cpu;
+        entry->irq = false;
+
+        if (entry->primary) {
+            topology->core_count++;
+        }
+        if (entry->node < CPU_SETSIZE && !CPU_ISSET(entry->node, &nodes)) {
+            CPU_SET(entry->node, &nodes);
+            topology->node_count++;
+        }
+    }
+
+    return TOPOLOGY_OK;
+}
+
+void topology_destroy(topology_t *topology)
+{
+    if (!topology) {
+        return;
+    }
+
+    system_free(topology->cpus);
+    memset(topology, 0, sizeof(*topology));
+}
+
+/**
+ * @brief Add the CPUs an interrupt is routed to
+ */
+static void topology_add_irq(const char *irq, cpu_set_t *set)
+{
+    char path[96];
+    char list[256];
+    cpu_set_t cpus;
+
+    snprintf(path, sizeof(path), "/proc/irq/%s/smp_affinity_list", irq);
+    if (!topology_read_file(path, list, sizeof(list)) || !topology_parse_cpulist(list, &cpus)) {
+        return;
+    }
+    CPU_OR(set, set, &cpus);
+}
+
+/**
+ * @brief Collect interrupts from /proc/interrupts named after the interface
+ */
+static void topology_scan_interrupts(const char *interface, cpu_set_t *set)
+{
+    FILE *file = fopen("/proc/interrupts", "re");
+    if (!file) {
+        return;
+    }
+
+    size_t name_length = strlen(interface);
+    char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        char *colon = strchr(line, ':');
+        if (!colon) {
+            continue;
+        }
+
+        /* The last field names the handler, e.g. "eth0-TxRx-3" */
+        char *end = line + strlen(line);
+        while (end > colon && isspace((unsigned char)end[-1])) {
+            end--;
+        }
+        *end = '\0';
+        char *name = end;
+        while (name > colon && !isspace((unsigned char)name[-1])) {
+            name--;
+        }
+        if (strncmp(name, interface, name_length) != 0 ||
+            (name[name_length] != '\0' && name[name_length] != '-')) {
+            continue;
+        }
+
+        *colon = '\0';
+        char *irq = line;
+        while (isspace((unsigned char)*irq)) {
+            irq++;
+        }
+        if (isdigit((unsigned char)*irq)) {
+            topology_add_irq(irq, set);
+        }
+    }
+
+    fclose(file);
+}
+
+topology_error_t topology_mark_irq_cpus(topology_t *topology, const char *interface)
+{
+    if (!topology || !interface || !*interface || strchr(interface, '/')) {
+        return TOPOLOGY_ERROR_INVALID_PARAM;
+    }
+
+    cpu_set_t irq_cpus;
+    CPU_ZERO(&irq_cpus);
+
+    /* One MSI vector per queue on multiqueue NICs */
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/class/net/%s/device/msi_irqs", interface);
+    DIR *dir = opendir(path);
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (isdigit((unsigned char)entry->d_name[0])) {
+                topology_add_irq(entry->d_name, &irq_cpus);
+            }
+        }
+        closedir(dir);
+    }
+
+    if (CPU_COUNT(&irq_cpus) == 0) {
+        topology_scan_interrupts(interface, &irq_cpus);
+    }
+
+    topology->irq_count = 0;
+    for (int i = 0; i < topology->count; i++) {
+        topology_cpu_t *entry = &topology->cpus[i];
+        entry->irq = CPU_ISSET(entry->cpu, &irq_cpus);
+        if (entry->irq) {
+            topology->irq_count++;
+        }
+    }
+
+    return topology->irq_count > 0 ? TOPOLOGY_OK : TOPOLOGY_ERROR_NOT_FOUND;
+}
+
+static const topology_cpu_t *topology_find(const topology_t *topology, int cpu)
+{
+    for (int i = 0; i < topology->count; i++) {
+        if (topology->cpus[i].cpu == cpu) {
+            return &topology->cpus[i];
+        }
+    }
+    return NULL;
+}
+
+static int topology_compare(const void *a, const void *b)
+{
+    const topology_cpu_t *x = *(const topology_cpu_t *const *)a;
+    const topology_cpu_t *y = *(const topology_cpu_t *const *)b;
+
+    if (x->node != y->node) {
+        return x->node < y->node ? -1 : 1;
+    }
+    return (x->cpu > y->cpu) - (x->cpu < y->cpu);
+}
+
+topology_error_t topology_select_cpus(const topology_t *topology, const topology_options_t *options,
+                                      int *cpu_ids, int *count)
+{
+    if (!topology || !options || !cpu_ids || !count || *count <= 0) {
+        return TOPOLOGY_ERROR_INVALID_PARAM;
+    }
+
+    const topology_cpu_t **selected = system_malloc((size_t)*count * sizeof(*selected));
+    if (!selected) {
+        return TOPOLOGY_ERROR_MEMORY;
+    }
+
+    int kept = 0;
+    int irq_kept = 0;
+    for (int i = 0; i < *count; i++) {
+        const topology_cpu_t *entry = topology_find(topology, cpu_ids[i]);
+        if (!entry || (options->skip_smt_siblings && !entry->primary)) {
+            continue;
+        }
+
+        /* Candidates listed twice would pin two workers to one CPU */
+        bool duplicate = false;
+        for (int j = 0; j < kept && !duplicate; j++) {
+            duplicate = selected[j] == entry;
+        }
+        if (!duplicate) {
+            selected[kept++] = entry;
+            irq_kept += entry->irq;
+        }
+    }
+
+    /* Run the workers where the NIC delivers their packets */
+    if (options->prefer_irq_cpus && irq_kept > 0) {
+        int irq_only = 0;
+        for (int i = 0; i < kept; i++) {
+            if (selected[i]->irq) {
+                selected[irq_only++] = selected[i];
+            }
+        }
+        kept = irq_only;
+    }
+
+    if (kept == 0) {
+        system_free(selected);
+        return TOPOLOGY_ERROR_NOT_FOUND;
+    }
+
+    qsort(selected, (size_t)kept, sizeof(*selected), topology_compare);
+    for (int i = 0; i < kept; i++) {
+        cpu_ids[i] = selected[i]->cpu;
+    }
+    *count = kept;
+
+    system_free(selected);
+    return TOPOLOGY_OK;
+}
+
+topology_error_t topology_bind_memory(int node)
+{
+    if (node < 0 || node >= TOPOLOGY_MAX_NODES) {
+        return TOPOLOGY_ERROR_INVALID_PARAM;
+    }
+
+    unsigned long mask[TOPOLOGY_MAX_NODES / TOPOLOGY_LONG_BITS] = {0};
+    mask[node / TOPOLOGY_LONG_BITS] = 1ul << (node % TOPOLOGY_LONG_BITS);
+
+    /* The kernel ignores the last bit of maxnode, as libnuma works around too */
+    if (syscall(SYS_set_mempolicy, MPOL_BIND, mask, (unsigned long)TOPOLOGY_MAX_NODES + 1) == -1) {
+        return TOPOLOGY_ERROR_SYSTEM;
+    }
+
+    return TOPOLOGY_OK;
+}
@@ -0,0 +1,289 @@
+/**
+ * @file trace.c
+ * @brief Implementation of sampled per-request phase tracing
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../../include/platform/trace.h"
+#include "../../include/platform/system.h"
+
+#define TRACE_RING_MASK (TRACE_RING_RECORDS - 1)
+
+/** Room for the events of one record */
+#define TRACE_RECORD_TEXT 1536
+
+trace_worker_t trace_local = { NULL, NULL, 0, 0, 0 };
+
+/** Event names of the phases, indexed by the phase they end */
+static const char *phase_names[TRACE_PHASE_COUNT] = {
+    [TRACE_PHASE_PARSED]  = "parse",
+    [TRACE_PHASE_ROUTED]  = "route",
+    [TRACE_PHASE_BUILT]   = "build",
+    [TRACE_PHASE_WRITTEN] = "write"
+};
+
+static uint64_t trace_monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+trace_error_t trace_init(trace_t *trace, int worker_count)
+{
+    if (!trace || worker_count <= 0) {
+        return TRACE_ERROR_INVALID_PARAM;
+    }
+
+    memset(trace, 0, sizeof(*trace));
+
+    size_t size = (size_t)worker_count * sizeof(trace_ring_t);
+    void *region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return TRACE_ERROR_MEMORY;
+    }
+
+    trace->rings = region;
+    trace->mapping_size = size;
+    trace->worker_count = worker_count;
+    for (int i = 0; i < worker_count; i++) {
+        trace->rings[i].cpu_id = -1;
+    }
+
+    /* The counter rate is measured against this point when the trace is written */
+    trace->base_cycles = trace_cycles();
+    trace->base_ns = trace_monotonic_ns();
+    return TRACE_OK;
+}
+
+void trace_cleanup(trace_t *trace)
+{
+    if (!trace) {
+        return;
+    }
+
+    if (trace->rings) {
+        if (trace_local.ring >= trace->rings && trace_local.ring < trace->rings + trace->worker_count) {
+            memset(&trace_local, 0, sizeof(trace_local));
+        }
+        munmap(trace->rings, trace->mapping_size);
+    }
+    memset(trace, 0, sizeof(*trace));
+}
+
+void trace_set_route_names(trace_t *trace, const char *const *names, int count)
+{
+    if (!trace) {
+        return;
+    }
+
+    trace->route_names = names;
+    trace->route_count = count;
+}
+
+void trace_attach_worker(trace_t *trace, int worker_id, int cpu_id)
+{
+    if (!trace || !trace->rings || worker_id < 0 || worker_id >= trace->worker_count) {
+        return;
+    }
+
+    /* A restarted worker starts with an empty ring */
+    trace_ring_t *ring = &trace->rings[worker_id];
+    __atomic_store_n(&ring->head, 0, __ATOMIC_RELEASE);
+    ring->cpu_id = cpu_id;
+    ring->pid = (int32_t)getpid();
+    trace_local.ring = ring;
+}
+
+void trace_set_interval(unsigned interval)
+{
+    /* Sampling needs a ring to put records in */
+    trace_local.interval = TRACE_ENABLED && trace_local.ring ? interval : 0;
+    trace_local.countdown = trace_local.interval;
+    trace_local.current = NULL;
+}
+
+void trace_commit(const trace_record_t *record)
+{
+    trace_ring_t *ring = trace_local.ring;
+    if (!TRACE_ENABLED || !ring) {
+        return;
+    }
+
+    /* Publish the slot before the head that makes it visible */
+    uint64_t head = ring->head;
+    trace_record_t *slot = &ring->records[head & TRACE_RING_MASK];
+    *slot = *record;
+    slot->cycles[TRACE_PHASE_WRITTEN] = trace_cycles();
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/** Output that grows as the rings are rendered */
+typedef struct {
+    char *data;
+    size_t used;
+    size_t capacity;
+} trace_output_t;
+
+/**
+ * @brief Make room for one more rendered record
+ * @return false without memory
+ */
+static bool trace_output_reserve(trace_output_t *out)
+{
+    if (out->capacity - out->used >= TRACE_RECORD_TEXT) {
+        return true;
+    }
+
+    size_t capacity = out->capacity * 2 > out->used + TRACE_RECORD_TEXT ? out->capacity * 2
+                                                                         : out->used + TRACE_RECORD_TEXT;
+    char *data = system_realloc(out->data, capacity);
+    if (!data) {
+        return false;
+    }
+    out->data = data;
+    out->capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Append formatted text, tracking truncation
+ */
+static void trace_append(char *buffer, size_t size, size_t *used, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void trace_append(char *buffer, size_t size, size_t *used, const char *format, ...)
+{
+    if (*used >= size) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + *used, size - *used, format, args);
+    va_end(args);
+
+    if (written < 0) {
+        return;
+    }
+    *used += (size_t)written < size - *used ? (size_t)written : size - *used;
+}
+
+/**
+ * @brief Render the events of one record
+ * @return Bytes written, 0 if the record is incomplete
+ */
+static size_t trace_render_record(const trace_t *trace, const trace_record_t *record, int worker,
+                                  double cycles_per_us, char *buffer, size_t size)
+{
+    const uint64_t *cycles = record->cycles;
+    if (cycles[TRACE_PHASE_PARSED] == 0 || cycles[TRACE_PHASE_WRITTEN] < cycles[TRACE_PHASE_PARSED]) {
+        return 0;
+    }
+
+    const char *route = (int)record->route < trace->route_count ? trace->route_names[record->route] : "unknown";
+    uint64_t start = cycles[TRACE_PHASE_RECEIVED] ? cycles[TRACE_PHASE_RECEIVED] : cycles[TRACE_PHASE_PARSED];
+    size_t used = 0;
+
+#define TRACE_US(value) ((double)((value) - trace->base_cycles) / cycles_per_us)
+    trace_append(buffer, size, &used,
+                 ",\n{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                 "\"pid\":%d,\"tid\":%u,\"args\":{\"bytes\":%u,\"stream\":%u}}",
+                 route, TRACE_US(start), (double)(cycles[TRACE_PHASE_WRITTEN] - start) / cycles_per_us,
+                 worker, record->connection, record->bytes, record->stream);
+
+    /* Each phase runs from the last phase reached before it */
+    uint64_t from = cycles[TRACE_PHASE_RECEIVED];
+    for (int phase = TRACE_PHASE_PARSED; phase < TRACE_PHASE_COUNT; phase++) {
+        uint64_t to = cycles[phase];
+        if (to == 0 || to < from) {
+            continue;
+        }
+        if (from != 0) {
+            trace_append(buffer, size, &used,
+                         ",\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                         "\"pid\":%d,\"tid\":%u}",
+                         phase_names[phase], TRACE_US(from), (double)(to - from) / cycles_per_us,
+                         worker, record->connection);
+        }
+        from = to;
+    }
+#undef TRACE_US
+
+    return used < size ? used : 0;
+}
+
+trace_error_t trace_render(const trace_t *trace, size_t headroom, char **data, size_t *size)
+{
+    if (!trace || !trace->rings || !data || !size) {
+        return TRACE_ERROR_INVALID_PARAM;
+    }
+
+    trace_record_t *records = system_malloc(sizeof(trace_record_t) * TRACE_RING_RECORDS);
+    if (!records) {
+        return TRACE_ERROR_MEMORY;
+    }
+
+    /* Rate since trace_init(); the counters of all CPUs tick together (invariant TSC) */
+    uint64_t elapsed_ns = trace_monotonic_ns() - trace->base_ns;
+    uint64_t elapsed_cycles = trace_cycles() - trace->base_cycles;
+    double cycles_per_us = elapsed_ns > 0 && elapsed_cycles > 0 ? (double)elapsed_cycles * 1000.0 / (double)elapsed_ns : 1.0;
+
+    /* Doubles as records are rendered */
+    trace_output_t out = { NULL, headroom, headroom + 64 * TRACE_RECORD_TEXT };
+    out.data = system_malloc(out.capacity);
+    bool ok = out.data != NULL;
+
+    if (ok) {
+        trace_append(out.data, out.capacity, &out.used, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                     "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":-1,\"args\":{\"name\":\"libreactor-server\"}}");
+    }
+
+    for (int i = 0; i < trace->worker_count && ok; i++) {
+        const trace_ring_t *ring = &trace->rings[i];
+        ok = trace_output_reserve(&out);
+        if (!ok) {
+            break;
+        }
+        trace_append(out.data, out.capacity, &out.used,
+                     ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                     "\"args\":{\"name\":\"worker %d (cpu %d, pid %d)\"}}",
+                     i, i, ring->cpu_id, ring->pid);
+
+        /* Copy, then drop what the worker may have overwritten meanwhile */
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > TRACE_RING_RECORDS ? head - TRACE_RING_RECORDS : 0;
+        for (uint64_t n = first; n < head; n++) {
+            records[n - first] = ring->records[n & TRACE_RING_MASK];
+        }
+        uint64_t now = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t valid = now > TRACE_RING_RECORDS ? now - TRACE_RING_RECORDS : 0;
+
+        for (uint64_t n = first > valid ? first : valid; n < head && ok; n++) {
+            ok = trace_output_reserve(&out);
+            if (ok) {
+                out.used += trace_render_record(trace, &records[n - first], i, cycles_per_us,
+                                                out.data + out.used, TRACE_RECORD_TEXT);
+            }
+        }
+    }
+
+    ok = ok && trace_output_reserve(&out);
+    system_free(records);
+    if (!ok) {
+        system_free(out.data);
+        return TRACE_ERROR_MEMORY;
+    }
+
+    memcpy(out.data + out.used, "\n]}\n", 4);
+    *data = out.data;
+    *size = out.used + 4;
+    return TRACE_OK;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file test.h
+ * @brief Minimal assertion harness for the unit tests
+ *
+ * Each test program defines its cases as functions, runs them with
+ * TEST_RUN() from main() and returns TEST_RESULT(). A failed TEST_CHECK()
+ * reports the expression and location and lets the case continue, so one
+ * run lists every failure.
+ */
+
+#ifndef TESTS_TEST_H
+#define TESTS_TEST_H
+
+#include <stdio.h>
+#include <string.h>
+
+static int test_failures;
+static int test_checks;
+
+/** Check a condition, reporting it when false */
+#define TEST_CHECK(condition) \
+    do { \
+        test_checks++; \
+        if (!(condition)) { \
+            test_failures++; \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        } \
+    } while (0)
+
+/** Check that a buffer holds exactly the given string */
+#define TEST_CHECK_BYTES(data, length, expected) \
+    TEST_CHECK((length) == sizeof(expected) - 1 && memcmp((data), (expected), (length)) == 0)
+
+/** Run one case */
+#define TEST_RUN(name) \
+    do { \
+        int before = test_failures; \
+        name(); \
+        fprintf(stderr, "%-48s %s\n", #name, test_failures == before ? "ok" : "FAILED"); \
+    } while (0)
+
+/** Exit status of the program */
+#define TEST_RESULT() \
+    (fprintf(stderr, "%d checks, %d failed\n", test_checks, test_failures), test_failures ? 1 : 0)
+
+#endif /* TESTS_TEST_H */
@@ -0,0 +1,64 @@
+/**
+ * @file test_date_clock.c
+ * @brief HTTP date formatting and parsing tests
+ */
+
+#include "test.h"
+#include "../src/include/platform/date_clock.h"
+
+static void test_format(void)
+{
+    char date[DATE_CLOCK_LENGTH];
+
+    date_clock_format(0, date);
+    TEST_CHECK_BYTES(date, sizeof(date), "Thu, 01 Jan 1970 00:00:00 GMT");
+    date_clock_format(784111777, date);
+    TEST_CHECK_BYTES(date, sizeof(date), "Sun, 06 Nov 1994 08:49:37 GMT");
+    date_clock_format(951782400, date);
+    TEST_CHECK_BYTES(date, sizeof(date), "Tue, 29 Feb 2000 00:00:00 GMT");
+}
+
+static void test_parse(void)
+{
+    int64_t second = -1;
+
+    TEST_CHECK(date_clock_parse("Sun, 06 Nov 1994 08:49:37 GMT", DATE_CLOCK_LENGTH, &second));
+    TEST_CHECK(second == 784111777);
+    TEST_CHECK(date_clock_parse("Thu, 01 Jan 1970 00:00:00 GMT", DATE_CLOCK_LENGTH, &second));
+    TEST_CHECK(second == 0);
+
+    /* Round trip across leap years and month ends */
+    for (int64_t t = 0; t < 4102444800; t += 86400 * 37 + 3601) {
+        char date[DATE_CLOCK_LENGTH];
+        date_clock_format(t, date);
+        TEST_CHECK(date_clock_parse(date, sizeof(date), &second) && second == t);
+    }
+}
+
+static void test_parse_invalid(void)
+{
+    static const char *const cases[] = {
+        "Sunday, 06-Nov-94 08:49:37 GMT",   /* RFC 850 */
+        "Sun Nov  6 08:49:37 1994",         /* asctime */
+        "Sun, 06 Nov 1994 08:49:37 UTC",
+        "Sun, 06 Foo 1994 08:49:37 GMT",
+        "Sun, 32 Nov 1994 08:49:37 GMT",
+        "Sun, 06 Nov 1994 24:49:37 GMT",
+        "Sun, 06 Nov 19x4 08:49:37 GMT",
+        "Sun, 06 Nov 1994 08:49:37 GMT ",
+        ""
+    };
+    int64_t second;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        TEST_CHECK(!date_clock_parse(cases[i], strlen(cases[i]), &second));
+    }
+}
+
+int main(void)
+{
+    TEST_RUN(test_format);
+    TEST_RUN(test_parse);
+    TEST_RUN(test_parse_invalid);
+    return TEST_RESULT();
+}
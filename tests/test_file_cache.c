@@ -0,0 +1,169 @@
+/**
+ * @file test_file_cache.c
+ * @brief Static file cache tests: path normalization, file types, truncation
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "test.h"
+#include "../src/include/platform/file_cache.h"
+
+static char root[] = "/tmp/file_cache_test.XXXXXX";
+
+/** Create a file below the test root */
+static void test_create(const char *name, const char *content)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", root, name);
+    FILE *file = fopen(path, "w");
+    TEST_CHECK(file != NULL);
+    if (file) {
+        fputs(content, file);
+        fclose(file);
+    }
+}
+
+static void test_setup(void)
+{
+    char path[256];
+
+    TEST_CHECK(mkdtemp(root) != NULL);
+    test_create("plain.txt", "plain");
+    test_create("a b.txt", "space");
+    test_create("100%.txt", "percent");
+    snprintf(path, sizeof(path), "%s/dir", root);
+    mkdir(path, 0755);
+    test_create("dir/index.html", "index");
+    snprintf(path, sizeof(path), "%s/empty", root);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/fifo", root);
+    TEST_CHECK(mkfifo(path, 0644) == 0);
+    snprintf(path, sizeof(path), "%s/escape", root);
+    TEST_CHECK(symlink("/etc/hostname", path) == 0);
+}
+
+static void test_teardown(void)
+{
+    static const char *const names[] = {
+        "plain.txt", "a b.txt", "100%.txt", "dir/index.html", "fifo", "escape", "truncated.txt"
+    };
+    char path[256];
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        snprintf(path, sizeof(path), "%s/%s", root, names[i]);
+        unlink(path);
+    }
+    snprintf(path, sizeof(path), "%s/dir", root);
+    rmdir(path);
+    snprintf(path, sizeof(path), "%s/empty", root);
+    rmdir(path);
+    rmdir(root);
+}
+
+/** Acquire a path and compare the body, NULL expecting FILE_CACHE_ERROR_NOT_FOUND */
+static void test_expect(file_cache_t *cache, const char *path, const char *body)
+{
+    file_cache_entry_t *entry = NULL;
+    file_cache_error_t err = file_cache_acquire(cache, path, strlen(path), &entry);
+
+    if (!body) {
+        TEST_CHECK(err == FILE_CACHE_ERROR_NOT_FOUND);
+        if (err != FILE_CACHE_ERROR_NOT_FOUND) {
+            fprintf(stderr, "  %s: %d\n", path, err);
+        }
+        if (err == FILE_CACHE_OK) {
+            file_cache_release(entry);
+        }
+        return;
+    }
+
+    TEST_CHECK(err == FILE_CACHE_OK);
+    if (err != FILE_CACHE_OK) {
+        fprintf(stderr, "  %s: %d\n", path, err);
+        return;
+    }
+    TEST_CHECK(entry->size == strlen(body) && entry->data && memcmp(entry->data, body, entry->size) == 0);
+    file_cache_release(entry);
+}
+
+static void test_paths(void)
+{
+    file_cache_t cache;
+    TEST_CHECK(file_cache_init(&cache, root, FILE_CACHE_DEFAULT_MEMORY_LIMIT, 16) == FILE_CACHE_OK);
+
+    test_expect(&cache, "/plain.txt", "plain");
+    test_expect(&cache, "/%70lain.txt", "plain");
+    test_expect(&cache, "/a%20b.txt", "space");
+    test_expect(&cache, "/100%25.txt", "percent");
+    test_expect(&cache, "/dir/", "index");
+    test_expect(&cache, "/dir/index.html", "index");
+    test_expect(&cache, "/d%69r/", "index");
+
+    /* Escapes that would change the path structure, broken escapes */
+    test_expect(&cache, "/dir%2Findex.html", NULL);
+    test_expect(&cache, "/dir%2findex.html", NULL);
+    test_expect(&cache, "/plain.txt%00", NULL);
+    test_expect(&cache, "/plain%2", NULL);
+    test_expect(&cache, "/plain%zz.txt", NULL);
+    test_expect(&cache, "/100%.txt", NULL);
+
+    /* Dot segments, plain or escaped, and absolute or escaping targets */
+    test_expect(&cache, "/../etc/hostname", NULL);
+    test_expect(&cache, "/dir/../plain.txt", NULL);
+    test_expect(&cache, "/%2e%2e/etc/hostname", NULL);
+    test_expect(&cache, "/dir/%2E/index.html", NULL);
+    test_expect(&cache, "//etc/hostname", NULL);
+    test_expect(&cache, "/escape", NULL);
+    test_expect(&cache, "plain.txt", NULL);
+    test_expect(&cache, "", NULL);
+
+    /* Only regular files; a FIFO must not block the open */
+    test_expect(&cache, "/fifo", NULL);
+    test_expect(&cache, "/empty", NULL);
+    test_expect(&cache, "/empty/", NULL);
+    test_expect(&cache, "/missing", NULL);
+
+    file_cache_cleanup(&cache);
+}
+
+static void test_truncated_while_cached(void)
+{
+    char path[256];
+    file_cache_t cache;
+    file_cache_entry_t *entry = NULL;
+
+    snprintf(path, sizeof(path), "%s/truncated.txt", root);
+    test_create("truncated.txt", "0123456789abcdef");
+    TEST_CHECK(file_cache_init(&cache, root, FILE_CACHE_DEFAULT_MEMORY_LIMIT, 16) == FILE_CACHE_OK);
+    TEST_CHECK(file_cache_acquire(&cache, "/truncated.txt", 14, &entry) == FILE_CACHE_OK);
+
+    /* The body is a copy: reading it after truncation neither faults nor changes */
+    TEST_CHECK(truncate(path, 0) == 0);
+    TEST_CHECK(entry && entry->size == 16 && memcmp(entry->data, "0123456789abcdef", 16) == 0);
+    file_cache_release(entry);
+
+    /* Larger than the memory limit: sent from the descriptor */
+    file_cache_t small;
+    test_create("truncated.txt", "0123456789abcdef");
+    TEST_CHECK(file_cache_init(&small, root, 8, 16) == FILE_CACHE_OK);
+    TEST_CHECK(file_cache_acquire(&small, "/truncated.txt", 14, &entry) == FILE_CACHE_OK);
+    TEST_CHECK(entry && entry->data == NULL && entry->fd >= 0 && entry->size == 16);
+    file_cache_release(entry);
+
+    file_cache_cleanup(&small);
+    file_cache_cleanup(&cache);
+}
+
+int main(void)
+{
+    test_setup();
+    TEST_RUN(test_paths);
+    TEST_RUN(test_truncated_while_cached);
+    test_teardown();
+    return TEST_RESULT();
+}
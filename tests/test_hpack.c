@@ -0,0 +1,220 @@
+/**
+ * @file test_hpack.c
+ * @brief HPACK decoder and encoder tests (RFC 7541 Appendix C vectors)
+ */
+
+#include <stdint.h>
+
+#include "test.h"
+#include "../src/include/platform/hpack.h"
+
+#define TEST_MAX_FIELDS 16
+
+typedef struct {
+    const char *name;
+    const char *value;
+} test_header_t;
+
+/**
+ * @brief Decode one block and compare the fields and the resulting table size
+ */
+static void test_decode_block(hpack_decoder_t *decoder, const uint8_t *block, size_t length,
+                              const test_header_t *expected, size_t expected_count, size_t table_size)
+{
+    hpack_field_t fields[TEST_MAX_FIELDS];
+    char scratch[1024];
+    size_t count = 0;
+
+    TEST_CHECK(hpack_decode(decoder, block, length, fields, TEST_MAX_FIELDS, &count,
+                            scratch, sizeof(scratch)) == HPACK_OK);
+    TEST_CHECK(count == expected_count);
+    for (size_t i = 0; i < count && i < expected_count; i++) {
+        TEST_CHECK(fields[i].name_length == strlen(expected[i].name) &&
+                   memcmp(fields[i].name, expected[i].name, fields[i].name_length) == 0);
+        TEST_CHECK(fields[i].value_length == strlen(expected[i].value) &&
+                   memcmp(fields[i].value, expected[i].value, fields[i].value_length) == 0);
+    }
+    TEST_CHECK(decoder->size == table_size);
+}
+
+static const test_header_t request1[] = {
+    { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" }
+};
+static const test_header_t request2[] = {
+    { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" },
+    { "cache-control", "no-cache" }
+};
+static const test_header_t request3[] = {
+    { ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" },
+    { ":authority", "www.example.com" }, { "custom-key", "custom-value" }
+};
+
+/** C.3: requests without Huffman coding, sharing one dynamic table */
+static void test_requests_plain(void)
+{
+    static const uint8_t block1[] = {
+        0x82, 0x86, 0x84, 0x41, 0x0f, 0x77, 0x77, 0x77, 0x2e, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65,
+        0x2e, 0x63, 0x6f, 0x6d
+    };
+    static const uint8_t block2[] = {
+        0x82, 0x86, 0x84, 0xbe, 0x58, 0x08, 0x6e, 0x6f, 0x2d, 0x63, 0x61, 0x63, 0x68, 0x65
+    };
+    static const uint8_t block3[] = {
+        0x82, 0x87, 0x85, 0xbf, 0x40, 0x0a, 0x63, 0x75, 0x73, 0x74, 0x6f, 0x6d, 0x2d, 0x6b, 0x65, 0x79,
+        0x0c, 0x63, 0x75, 0x73, 0x74, 0x6f, 0x6d, 0x2d, 0x76, 0x61, 0x6c, 0x75, 0x65
+    };
+
+    hpack_decoder_t decoder;
+    TEST_CHECK(hpack_decoder_init(&decoder, HPACK_DEFAULT_TABLE_SIZE) == HPACK_OK);
+    test_decode_block(&decoder, block1, sizeof(block1), request1, 4, 57);
+    test_decode_block(&decoder, block2, sizeof(block2), request2, 5, 110);
+    test_decode_block(&decoder, block3, sizeof(block3), request3, 5, 164);
+    hpack_decoder_cleanup(&decoder);
+}
+
+/** C.4: the same requests with Huffman-coded strings */
+static void test_requests_huffman(void)
+{
+    static const uint8_t block1[] = {
+        0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab, 0x90, 0xf4,
+        0xff
+    };
+    static const uint8_t block2[] = {
+        0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf
+    };
+    static const uint8_t block3[] = {
+        0x82, 0x87, 0x85, 0xbf, 0x40, 0x88, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xa9, 0x7d, 0x7f, 0x89, 0x25,
+        0xa8, 0x49, 0xe9, 0x5b, 0xb8, 0xe8, 0xb4, 0xbf
+    };
+
+    hpack_decoder_t decoder;
+    TEST_CHECK(hpack_decoder_init(&decoder, HPACK_DEFAULT_TABLE_SIZE) == HPACK_OK);
+    test_decode_block(&decoder, block1, sizeof(block1), request1, 4, 57);
+    test_decode_block(&decoder, block2, sizeof(block2), request2, 5, 110);
+    test_decode_block(&decoder, block3, sizeof(block3), request3, 5, 164);
+    hpack_decoder_cleanup(&decoder);
+}
+
+/** C.5: responses in a 256-byte table, evicting the oldest entries */
+static void test_responses_eviction(void)
+{
+    static const uint8_t block1[] = {
+        0x48, 0x03, 0x33, 0x30, 0x32, 0x58, 0x07, 0x70, 0x72, 0x69, 0x76, 0x61, 0x74, 0x65, 0x61, 0x1d,
+        0x4d, 0x6f, 0x6e, 0x2c, 0x20, 0x32, 0x31, 0x20, 0x4f, 0x63, 0x74, 0x20, 0x32, 0x30, 0x31, 0x33,
+        0x20, 0x32, 0x30, 0x3a, 0x31, 0x33, 0x3a, 0x32, 0x31, 0x20, 0x47, 0x4d, 0x54, 0x6e, 0x17, 0x68,
+        0x74, 0x74, 0x70, 0x73, 0x3a, 0x2f, 0x2f, 0x77, 0x77, 0x77, 0x2e, 0x65, 0x78, 0x61, 0x6d, 0x70,
+        0x6c, 0x65, 0x2e, 0x63, 0x6f, 0x6d
+    };
+    static const uint8_t block2[] = { 0x48, 0x03, 0x33, 0x30, 0x37, 0xc1, 0xc0, 0xbf };
+    static const uint8_t block3[] = {
+        0x88, 0xc1, 0x61, 0x1d, 0x4d, 0x6f, 0x6e, 0x2c, 0x20, 0x32, 0x31, 0x20, 0x4f, 0x63, 0x74, 0x20,
+        0x32, 0x30, 0x31, 0x33, 0x20, 0x32, 0x30, 0x3a, 0x31, 0x33, 0x3a, 0x32, 0x32, 0x20, 0x47, 0x4d,
+        0x54, 0xc0, 0x5a, 0x04, 0x67, 0x7a, 0x69, 0x70, 0x77, 0x38, 0x66, 0x6f, 0x6f, 0x3d, 0x41, 0x53,
+        0x44, 0x4a, 0x4b, 0x48, 0x51, 0x4b, 0x42, 0x5a, 0x58, 0x4f, 0x51, 0x57, 0x45, 0x4f, 0x50, 0x49,
+        0x55, 0x41, 0x58, 0x51, 0x57, 0x45, 0x4f, 0x49, 0x55, 0x3b, 0x20, 0x6d, 0x61, 0x78, 0x2d, 0x61,
+        0x67, 0x65, 0x3d, 0x33, 0x36, 0x30, 0x30, 0x3b, 0x20, 0x76, 0x65, 0x72, 0x73, 0x69, 0x6f, 0x6e,
+        0x3d, 0x31
+    };
+    static const test_header_t response1[] = {
+        { ":status", "302" }, { "cache-control", "private" },
+        { "date", "Mon, 21 Oct 2013 20:13:21 GMT" }, { "location", "https://www.example.com" }
+    };
+    static const test_header_t response2[] = {
+        { ":status", "307" }, { "cache-control", "private" },
+        { "date", "Mon, 21 Oct 2013 20:13:21 GMT" }, { "location", "https://www.example.com" }
+    };
+    static const test_header_t response3[] = {
+        { ":status", "200" }, { "cache-control", "private" },
+        { "date", "Mon, 21 Oct 2013 20:13:22 GMT" }, { "location", "https://www.example.com" },
+        { "content-encoding", "gzip" },
+        { "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" }
+    };
+
+    hpack_decoder_t decoder;
+    TEST_CHECK(hpack_decoder_init(&decoder, 256) == HPACK_OK);
+    test_decode_block(&decoder, block1, sizeof(block1), response1, 4, 222);
+    test_decode_block(&decoder, block2, sizeof(block2), response2, 4, 222);
+    test_decode_block(&decoder, block3, sizeof(block3), response3, 6, 215);
+    hpack_decoder_cleanup(&decoder);
+}
+
+/** Invalid blocks are compression errors */
+static void test_decode_malformed(void)
+{
+    static const uint8_t index_zero[] = { 0x80 };
+    static const uint8_t index_past_table[] = { 0xbe };
+    static const uint8_t truncated_literal[] = { 0x40, 0x0a, 0x63 };
+    static const uint8_t size_above_settings[] = { 0x3f, 0xe2, 0x1f };
+    static const uint8_t huffman_eos[] = { 0x41, 0x84, 0xff, 0xff, 0xff, 0xff };
+
+    const struct {
+        const uint8_t *block;
+        size_t length;
+    } cases[] = {
+        { index_zero, sizeof(index_zero) },
+        { index_past_table, sizeof(index_past_table) },
+        { truncated_literal, sizeof(truncated_literal) },
+        { size_above_settings, sizeof(size_above_settings) },
+        { huffman_eos, sizeof(huffman_eos) }
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        hpack_decoder_t decoder;
+        hpack_field_t fields[TEST_MAX_FIELDS];
+        char scratch[256];
+        size_t count;
+
+        TEST_CHECK(hpack_decoder_init(&decoder, HPACK_DEFAULT_TABLE_SIZE) == HPACK_OK);
+        TEST_CHECK(hpack_decode(&decoder, cases[i].block, cases[i].length, fields, TEST_MAX_FIELDS,
+                                &count, scratch, sizeof(scratch)) == HPACK_ERROR_MALFORMED);
+        hpack_decoder_cleanup(&decoder);
+    }
+}
+
+/** C.1: integer representation */
+static void test_encode_integer(void)
+{
+    uint8_t out[HPACK_INTEGER_MAX_SIZE];
+
+    TEST_CHECK(hpack_encode_integer(out, 10, 5, 0) == 1 && out[0] == 0x0a);
+    TEST_CHECK(hpack_integer_size(10, 5) == 1);
+
+    TEST_CHECK(hpack_encode_integer(out, 1337, 5, 0) == 3);
+    TEST_CHECK(out[0] == 0x1f && out[1] == 0x9a && out[2] == 0x0a);
+    TEST_CHECK(hpack_integer_size(1337, 5) == 3);
+
+    TEST_CHECK(hpack_encode_integer(out, 42, 8, 0) == 1 && out[0] == 0x2a);
+    TEST_CHECK(hpack_encode_integer(out, 31, 5, 0xe0) == 2 && out[0] == 0xff && out[1] == 0x00);
+}
+
+/** Encoded fields decode back to the same headers */
+static void test_encode_round_trip(void)
+{
+    uint8_t block[128];
+    size_t length = 0;
+
+    length += hpack_encode_indexed(block + length, HPACK_INDEX_STATUS_200);
+    length += hpack_encode_literal(block + length, HPACK_INDEX_CONTENT_TYPE, "text/plain", 10);
+    length += hpack_encode_literal(block + length, HPACK_INDEX_CONTENT_LENGTH, "13", 2);
+    TEST_CHECK(length == 1 + hpack_literal_size(HPACK_INDEX_CONTENT_TYPE, 10) +
+                         hpack_literal_size(HPACK_INDEX_CONTENT_LENGTH, 2));
+
+    static const test_header_t expected[] = {
+        { ":status", "200" }, { "content-type", "text/plain" }, { "content-length", "13" }
+    };
+    hpack_decoder_t decoder;
+    TEST_CHECK(hpack_decoder_init(&decoder, HPACK_DEFAULT_TABLE_SIZE) == HPACK_OK);
+    test_decode_block(&decoder, block, length, expected, 3, 0);
+    hpack_decoder_cleanup(&decoder);
+}
+
+int main(void)
+{
+    TEST_RUN(test_requests_plain);
+    TEST_RUN(test_requests_huffman);
+    TEST_RUN(test_responses_eviction);
+    TEST_RUN(test_decode_malformed);
+    TEST_RUN(test_encode_integer);
+    TEST_RUN(test_encode_round_trip);
+    return TEST_RESULT();
+}
@@ -0,0 +1,188 @@
+/**
+ * @file test_http_parser.c
+ * @brief HTTP/1.x request parser tests, run against every available kernel
+ */
+
+#include "test.h"
+#include "../src/include/platform/http_parser.h"
+
+/** Parse a string literal */
+#define TEST_PARSE(text, request) http_parser_parse((text), sizeof(text) - 1, (request))
+
+static void test_simple_get(void)
+{
+    static const char text[] = "GET /plaintext HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n";
+    http_parser_request_t request;
+
+    TEST_CHECK(TEST_PARSE(text, &request) == HTTP_PARSER_OK);
+    TEST_CHECK_BYTES(request.method, request.method_length, "GET");
+    TEST_CHECK_BYTES(request.target, request.target_length, "/plaintext");
+    TEST_CHECK(request.minor_version == 1);
+    TEST_CHECK(!request.close);
+    TEST_CHECK(request.content_length == 0);
+    TEST_CHECK(request.header_length == sizeof(text) - 1);
+    TEST_CHECK(request.length == sizeof(text) - 1);
+}
+
+static void test_connection(void)
+{
+    http_parser_request_t request;
+
+    TEST_CHECK(TEST_PARSE("GET / HTTP/1.0\r\n\r\n", &request) == HTTP_PARSER_OK);
+    TEST_CHECK(request.minor_version == 0 && request.close);
+    TEST_CHECK(TEST_PARSE("GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n", &request) == HTTP_PARSER_OK);
+    TEST_CHECK(!request.close);
+    TEST_CHECK(TEST_PARSE("GET / HTTP/1.1\r\nconnection:close  \r\n\r\n", &request) == HTTP_PARSER_OK);
+    TEST_CHECK(request.close);
+}
+
+static void test_body(void)
+{
+    static const char text[] = "POST /echo HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello";
+    http_parser_request_t request;
+
+    TEST_CHECK(TEST_PARSE(text, &request) == HTTP_PARSER_OK);
+    TEST_CHECK(request.content_length == 5);
+    TEST_CHECK(request.length == sizeof(text) - 1);
+    TEST_CHECK_BYTES(text + request.header_length, request.content_length, "hello");
+
+    /* Head complete, body not: the full length is known */
+    TEST_CHECK(http_parser_parse(text, sizeof(text) - 3, &request) == HTTP_PARSER_ERROR_INCOMPLETE);
+    TEST_CHECK(request.length == sizeof(text) - 1);
+}
+
+static void test_incomplete(void)
+{
+    static const char text[] = "GET /json HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    http_parser_request_t request;
+
+    /* Every prefix of the head is incomplete, never malformed */
+    for (size_t size = 0; size < sizeof(text) - 1; size++) {
+        TEST_CHECK(http_parser_parse(text, size, &request) == HTTP_PARSER_ERROR_INCOMPLETE);
+        TEST_CHECK(request.length == 0);
+    }
+}
+
+static void test_pipelined(void)
+{
+    static const char text[] = "GET /a HTTP/1.1\r\n\r\nGET /b HTTP/1.1\r\n\r\n";
+    http_parser_request_t request;
+
+    TEST_CHECK(TEST_PARSE(text, &request) == HTTP_PARSER_OK);
+    TEST_CHECK_BYTES(request.target, request.target_length, "/a");
+    TEST_CHECK(http_parser_parse(text + request.length, sizeof(text) - 1 - request.length, &request) ==
+               HTTP_PARSER_OK);
+    TEST_CHECK_BYTES(request.target, request.target_length, "/b");
+}
+
+static void test_upgrade(void)
+{
+    static const char text[] = "GET / HTTP/1.1\r\nConnection: Upgrade, HTTP2-Settings\r\nUpgrade: h2c\r\n"
+                               "HTTP2-Settings: AAMAAABkAAQAAP__\r\n\r\n";
+    http_parser_request_t request;
+
+    TEST_CHECK(TEST_PARSE(text, &request) == HTTP_PARSER_OK);
+    TEST_CHECK(request.upgrade_h2c);
+    TEST_CHECK_BYTES(request.http2_settings, request.http2_settings_length, "AAMAAABkAAQAAP__");
+}
+
+static void test_malformed(void)
+{
+    static const char *const cases[] = {
+        "GET\r\n\r\n",
+        " / HTTP/1.1\r\n\r\n",
+        "GET  / HTTP/1.1\r\n\r\n",
+        "G(T / HTTP/1.1\r\n\r\n",
+        "GET / HTTP/2.0\r\n\r\n",
+        "GET / HTTP/1.1 \r\n\r\n",
+        "GET /\x01 HTTP/1.1\r\n\r\n",
+        "GET / HTTP/1.1\r\nNo-Colon\r\n\r\n",
+        "GET / HTTP/1.1\r\nBad Name: x\r\n\r\n",
+        "GET / HTTP/1.1\r\nName: a\x7f" "b\r\n\r\n",
+        "GET / HTTP/1.1\r\nName: a\nb\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length:\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: 1234567890123456789\r\n\r\n"
+    };
+    http_parser_request_t request;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        http_parser_error_t err = http_parser_parse(cases[i], strlen(cases[i]), &request);
+        TEST_CHECK(err == HTTP_PARSER_ERROR_MALFORMED);
+        if (err != HTTP_PARSER_ERROR_MALFORMED) {
+            fprintf(stderr, "  case %zu: %d\n", i, err);
+        }
+    }
+}
+
+static void test_framing(void)
+{
+    http_parser_request_t request;
+
+    /* Repeated Content-Length, equal or not */
+    TEST_CHECK(TEST_PARSE("POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 1\r\n\r\nx", &request) ==
+               HTTP_PARSER_ERROR_MALFORMED);
+    TEST_CHECK(TEST_PARSE("POST / HTTP/1.1\r\nContent-Length: 0\r\ncontent-length: 4\r\n\r\nabcd", &request) ==
+               HTTP_PARSER_ERROR_MALFORMED);
+    TEST_CHECK(TEST_PARSE("POST / HTTP/1.1\r\nContent-Length: 1, 1\r\n\r\nx", &request) ==
+               HTTP_PARSER_ERROR_MALFORMED);
+
+    /* Transfer-Encoding alone is not implemented; with Content-Length, in either order, it is invalid */
+    TEST_CHECK(TEST_PARSE("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n", &request) ==
+               HTTP_PARSER_ERROR_NOT_IMPLEMENTED);
+    TEST_CHECK(TEST_PARSE("POST / HTTP/1.0\r\ntransfer-encoding: gzip, chunked\r\n\r\n", &request) ==
+               HTTP_PARSER_ERROR_NOT_IMPLEMENTED);
+    TEST_CHECK(TEST_PARSE("POST / HTTP/1.1\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n",
+                          &request) == HTTP_PARSER_ERROR_MALFORMED);
+    TEST_CHECK(TEST_PARSE("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 5\r\n\r\n0\r\n\r\n",
+                          &request) == HTTP_PARSER_ERROR_MALFORMED);
+}
+
+static void test_long_lines(void)
+{
+    /* Long enough that every kernel runs its vector loop and its tail */
+    char text[600];
+    size_t length = 0;
+
+    length += (size_t)snprintf(text, sizeof(text), "GET /");
+    for (int i = 0; i < 200; i++) {
+        text[length++] = (char)('a' + i % 26);
+    }
+    length += (size_t)snprintf(text + length, sizeof(text) - length, " HTTP/1.1\r\nX-Long: ");
+    for (int i = 0; i < 300; i++) {
+        text[length++] = (char)(i % 3 ? 'v' : '\t');
+    }
+    length += (size_t)snprintf(text + length, sizeof(text) - length, "\r\n\r\n");
+
+    http_parser_request_t request;
+    TEST_CHECK(http_parser_parse(text, length, &request) == HTTP_PARSER_OK);
+    TEST_CHECK(request.target_length == 201);
+    TEST_CHECK(http_parser_find_header_end(text, length) == length - 4);
+
+    /* A control byte deep in the value */
+    text[length - 50] = '\x02';
+    TEST_CHECK(http_parser_parse(text, length, &request) == HTTP_PARSER_ERROR_MALFORMED);
+}
+
+int main(void)
+{
+    static const char *const implementations[] = { "scalar", "sse4.2", "avx2", "neon" };
+
+    for (size_t i = 0; i < sizeof(implementations) / sizeof(implementations[0]); i++) {
+        if (http_parser_select(implementations[i]) != HTTP_PARSER_OK) {
+            continue;
+        }
+        fprintf(stderr, "-- %s\n", http_parser_implementation());
+        TEST_RUN(test_simple_get);
+        TEST_RUN(test_connection);
+        TEST_RUN(test_body);
+        TEST_RUN(test_incomplete);
+        TEST_RUN(test_pipelined);
+        TEST_RUN(test_upgrade);
+        TEST_RUN(test_malformed);
+        TEST_RUN(test_framing);
+        TEST_RUN(test_long_lines);
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,189 @@
+/**
+ * @file test_http_response.c
+ * @brief HTTP/1.1 and HPACK response building tests
+ */
+
+#include "test.h"
+#include "../src/include/domain/http_response.h"
+#include "../src/include/platform/hpack.h"
+
+/** Build an HTTP/1.1 response into out, returning its length */
+static size_t test_build(const http_response_config_t *config, char *out, size_t size)
+{
+    http_response_buffer_t buffer;
+    TEST_CHECK(http_response_buffer_init(&buffer, out, size) == HTTP_RESPONSE_OK);
+    TEST_CHECK(http_response_calculate_size(config) <= size);
+    TEST_CHECK(http_response_build(&buffer, config) == HTTP_RESPONSE_OK);
+    TEST_CHECK(buffer.used == http_response_calculate_size(config));
+    return buffer.used;
+}
+
+static void test_plaintext(void)
+{
+    http_response_config_t config = {
+        .status_code = HTTP_STATUS_OK,
+        .content_type = CONTENT_TYPE_TEXT_PLAIN,
+        .body = "Hello, World!",
+        .body_length = 13
+    };
+    char out[256];
+    size_t length = test_build(&config, out, sizeof(out));
+
+    TEST_CHECK_BYTES(out, length, "HTTP/1.1 200 OK\r\nServer: L\r\nContent-Type: text/plain\r\n"
+                                  "Content-Length: 13\r\n\r\nHello, World!");
+}
+
+static void test_date(void)
+{
+    http_response_config_t config = {
+        .status_code = HTTP_STATUS_NOT_FOUND,
+        .content_type = CONTENT_TYPE_TEXT_PLAIN,
+        .include_date_header = true
+    };
+    char out[256];
+    size_t length = test_build(&config, out, sizeof(out));
+    size_t offset = http_response_date_offset(&config);
+
+    TEST_CHECK(offset == sizeof("HTTP/1.1 404 Not Found\r\nServer: L\r\nDate: ") - 1);
+    TEST_CHECK(offset + HTTP_RESPONSE_DATE_LENGTH < length);
+    TEST_CHECK(memcmp(out + offset + HTTP_RESPONSE_DATE_LENGTH - 4, " GMT\r\n", 6) == 0);
+    TEST_CHECK(memcmp(out + length - 21, "Content-Length: 0\r\n\r\n", 21) == 0);
+}
+
+static void test_allow(void)
+{
+    http_response_config_t config = {
+        .status_code = HTTP_STATUS_METHOD_NOT_ALLOWED,
+        .content_type = CONTENT_TYPE_TEXT_PLAIN,
+        .allow = "GET, HEAD",
+        .allow_length = 9
+    };
+    char out[256];
+    size_t length = test_build(&config, out, sizeof(out));
+
+    TEST_CHECK_BYTES(out, length, "HTTP/1.1 405 Method Not Allowed\r\nServer: L\r\nContent-Type: text/plain\r\n"
+                                  "Content-Length: 0\r\nAllow: GET, HEAD\r\n\r\n");
+}
+
+static void test_deferred_length(void)
+{
+    static const size_t lengths[] = { 0, 7, 27, 1000, 4294967295u };
+    http_response_config_t config = {
+        .status_code = HTTP_STATUS_OK,
+        .content_type = CONTENT_TYPE_APPLICATION_JSON,
+        .deferred_length = true
+    };
+
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        char out[256];
+        size_t length = test_build(&config, out, sizeof(out));
+        size_t field = http_response_length_offset(&config);
+        TEST_CHECK(field != (size_t)-1);
+
+        /* A short body after the headers, as the JSON handler writes it */
+        memcpy(out + length, "{\"x\":1}", 7);
+        length += 7;
+
+        size_t removed;
+        TEST_CHECK(http_response_set_length(out + field, length - field - HTTP_RESPONSE_LENGTH_FIELD_WIDTH,
+                                            lengths[i], &removed) == HTTP_RESPONSE_OK);
+        length -= removed;
+
+        char expected[256];
+        int n = snprintf(expected, sizeof(expected),
+                         "HTTP/1.1 200 OK\r\nServer: L\r\nContent-Type: application/json\r\n"
+                         "Content-Length: %zu\r\n\r\n{\"x\":1}", lengths[i]);
+        TEST_CHECK(n > 0 && (size_t)n == length && memcmp(out, expected, length) == 0);
+    }
+
+    char field[HTTP_RESPONSE_LENGTH_FIELD_WIDTH];
+    size_t removed;
+    TEST_CHECK(http_response_set_length(field, 0, 10000000000ull, &removed) ==
+               HTTP_RESPONSE_ERROR_BUFFER_OVERFLOW);
+    config.deferred_length = false;
+    TEST_CHECK(http_response_length_offset(&config) == (size_t)-1);
+}
+
+/** Build a header block and decode it back into fields */
+static size_t test_hpack(const http_response_config_t *config, hpack_field_t *fields, size_t max_fields,
+                         uint8_t *block, size_t size)
+{
+    http_response_buffer_t buffer;
+    hpack_decoder_t decoder;
+    char scratch[256];
+    size_t count = 0;
+
+    TEST_CHECK(http_response_hpack_size(config) <= size);
+    TEST_CHECK(http_response_buffer_init(&buffer, (char *)block, size) == HTTP_RESPONSE_OK);
+    TEST_CHECK(http_response_build_hpack(&buffer, config) == HTTP_RESPONSE_OK);
+    TEST_CHECK(buffer.used == http_response_hpack_size(config));
+
+    TEST_CHECK(hpack_decoder_init(&decoder, 4096) == HPACK_OK);
+    TEST_CHECK(hpack_decode(&decoder, block, buffer.used, fields, max_fields, &count,
+                            scratch, sizeof(scratch)) == HPACK_OK);
+    TEST_CHECK(decoder.size == 0);
+    hpack_decoder_cleanup(&decoder);
+    return count;
+}
+
+static void test_hpack_statuses(void)
+{
+    static const struct {
+        http_status_t status;
+        const char *code;
+    } cases[] = {
+        { HTTP_STATUS_OK, "200" },
+        { HTTP_STATUS_NOT_MODIFIED, "304" },
+        { HTTP_STATUS_NOT_FOUND, "404" },
+        { HTTP_STATUS_METHOD_NOT_ALLOWED, "405" },
+        { HTTP_STATUS_INTERNAL_ERROR, "500" }
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        http_response_config_t config = {
+            .status_code = cases[i].status,
+            .content_type = CONTENT_TYPE_TEXT_PLAIN,
+            .body_length = 13
+        };
+        hpack_field_t fields[8];
+        uint8_t block[256];
+        size_t count = test_hpack(&config, fields, 8, block, sizeof(block));
+
+        TEST_CHECK(count == 4);
+        TEST_CHECK_BYTES(fields[0].name, fields[0].name_length, ":status");
+        TEST_CHECK(fields[0].value_length == 3 && memcmp(fields[0].value, cases[i].code, 3) == 0);
+        TEST_CHECK_BYTES(fields[1].name, fields[1].name_length, "server");
+        TEST_CHECK_BYTES(fields[3].name, fields[3].name_length, "content-length");
+        TEST_CHECK_BYTES(fields[3].value, fields[3].value_length, "13");
+    }
+}
+
+static void test_hpack_allow(void)
+{
+    http_response_config_t config = {
+        .status_code = HTTP_STATUS_METHOD_NOT_ALLOWED,
+        .content_type = CONTENT_TYPE_TEXT_PLAIN,
+        .allow = "GET, HEAD",
+        .allow_length = 9
+    };
+    hpack_field_t fields[8];
+    uint8_t block[256];
+    size_t count = test_hpack(&config, fields, 8, block, sizeof(block));
+
+    TEST_CHECK(count == 5);
+    TEST_CHECK_BYTES(fields[4].name, fields[4].name_length, "allow");
+    TEST_CHECK_BYTES(fields[4].value, fields[4].value_length, "GET, HEAD");
+}
+
+int main(void)
+{
+    TEST_CHECK(http_response_init() == HTTP_RESPONSE_OK);
+    TEST_RUN(test_plaintext);
+    TEST_RUN(test_date);
+    TEST_RUN(test_allow);
+    TEST_RUN(test_deferred_length);
+    TEST_RUN(test_hpack_statuses);
+    TEST_RUN(test_hpack_allow);
+    http_response_cleanup();
+    return TEST_RESULT();
+}
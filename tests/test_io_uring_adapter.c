@@ -0,0 +1,226 @@
+/**
+ * @file test_io_uring_adapter.c
+ * @brief io_uring backend tests: buffers, and requests served over loopback
+ *
+ * The server runs in a forked child; the parent is the client and does the
+ * checking, so a hung reactor shows up as a receive timeout, not a hang.
+ */
+
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+
+#include "test.h"
+#include "../src/platform/io_uring_adapter/io_uring_adapter.h"
+
+static void test_buffer(void)
+{
+    buffer b;
+    buffer_construct(&b);
+    TEST_CHECK(buffer_size(&b) == 0);
+
+    buffer_insert(&b, 0, "world", 5);
+    buffer_insert(&b, 0, "hello ", 6);
+    buffer_insert(&b, buffer_size(&b), "!", 1);
+    TEST_CHECK_BYTES(buffer_data(&b), buffer_size(&b), "hello world!");
+
+    buffer_erase(&b, 0, 6);
+    TEST_CHECK_BYTES(buffer_data(&b), buffer_size(&b), "world!");
+    buffer_erase(&b, 5, 1);
+    TEST_CHECK_BYTES(buffer_data(&b), buffer_size(&b), "world");
+
+    /* Growth keeps the contents */
+    char block[1000];
+    memset(block, 'x', sizeof(block));
+    for (int i = 0; i < 100; i++) {
+        buffer_insert(&b, buffer_size(&b), block, sizeof(block));
+    }
+    TEST_CHECK(buffer_size(&b) == 5 + 100 * sizeof(block));
+    TEST_CHECK(memcmp(buffer_data(&b), "worldxxx", 8) == 0);
+
+    buffer_clear(&b);
+    TEST_CHECK(buffer_size(&b) == 0);
+    buffer_destruct(&b);
+    TEST_CHECK(buffer_data(&b) == NULL);
+
+    TEST_CHECK(segment_equal(segment_string("abc"), segment_make("abc", 3)));
+    TEST_CHECK(!segment_equal(segment_string("abc"), segment_string("abd")));
+}
+
+/** Answer every request with its target as the body */
+static core_status test_serve(core_event *event)
+{
+    if (event->type == SERVER_REQUEST) {
+        server_context *context = (server_context *)event->data;
+        server_ok(context, segment_string("text/plain"), context->request.target);
+    }
+    return CORE_OK;
+}
+
+/** Run a loopback server in a child, returning its pid and port */
+static pid_t test_server_start(uint16_t *port)
+{
+    int ready[2];
+    if (pipe(ready) == -1) {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(ready[0]);
+        server s;
+        core_construct(NULL);
+        server_construct(&s, test_serve, NULL);
+        server_open(&s, INADDR_LOOPBACK, 0);
+
+        struct sockaddr_in addr;
+        socklen_t length = sizeof(addr);
+        uint16_t bound = 0;
+        if (s.fd >= 0 && getsockname(s.fd, (struct sockaddr *)&addr, &length) == 0) {
+            bound = ntohs(addr.sin_port);
+        }
+        if (write(ready[1], &bound, sizeof(bound)) != sizeof(bound) || bound == 0) {
+            _exit(1);
+        }
+        close(ready[1]);
+        core_loop(NULL);
+        _exit(0);
+    }
+
+    close(ready[1]);
+    if (pid > 0 && read(ready[0], port, sizeof(*port)) != sizeof(*port)) {
+        *port = 0;
+    }
+    close(ready[0]);
+    return pid;
+}
+
+static int test_connect(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+    };
+    struct timeval timeout = { .tv_sec = 2 };
+
+    if (fd == -1 || setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1 ||
+        connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static bool test_send(int fd, const char *data)
+{
+    size_t length = strlen(data);
+    return send(fd, data, length, MSG_NOSIGNAL) == (ssize_t)length;
+}
+
+/** Read until count responses have arrived, returning the bytes read */
+static size_t test_receive(int fd, int count, char *out, size_t size)
+{
+    size_t used = 0;
+    int seen = 0;
+
+    while (seen < count && used + 1 < size) {
+        ssize_t n = recv(fd, out + used, size - used - 1, 0);
+        if (n <= 0) {
+            break;
+        }
+        used += (size_t)n;
+        out[used] = '\0';
+
+        /* A response is complete once its body, the target, follows the headers */
+        seen = 0;
+        for (const char *p = out; (p = strstr(p, "\r\n\r\n/")) != NULL; p += 4) {
+            seen++;
+        }
+    }
+    out[used] = '\0';
+    return used;
+}
+
+/** Position of needle in haystack, -1 if absent */
+static long test_find(const char *haystack, const char *needle)
+{
+    const char *p = strstr(haystack, needle);
+    return p ? p - haystack : -1;
+}
+
+static void test_requests(void)
+{
+    uint16_t port = 0;
+    pid_t pid = test_server_start(&port);
+    TEST_CHECK(pid > 0 && port != 0);
+    if (pid <= 0 || port == 0) {
+        return;
+    }
+
+    char response[8192];
+    int fd = test_connect(port);
+    TEST_CHECK(fd >= 0);
+
+    if (fd >= 0) {
+        TEST_CHECK(test_send(fd, "GET /one HTTP/1.1\r\nHost: t\r\n\r\n"));
+        test_receive(fd, 1, response, sizeof(response));
+        TEST_CHECK(strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0);
+        TEST_CHECK(strstr(response, "Content-Length: 4\r\n") != NULL);
+        TEST_CHECK(strstr(response, "\r\n\r\n/one") != NULL);
+
+        /* Pipelined requests are answered in order */
+        TEST_CHECK(test_send(fd, "GET /a HTTP/1.1\r\n\r\nGET /bb HTTP/1.1\r\n\r\nGET /ccc HTTP/1.1\r\n\r\n"));
+        test_receive(fd, 3, response, sizeof(response));
+        long a = test_find(response, "\r\n\r\n/a");
+        long bb = test_find(response, "\r\n\r\n/bb");
+        long ccc = test_find(response, "\r\n\r\n/ccc");
+        TEST_CHECK(a >= 0 && bb > a && ccc > bb);
+
+        /* A request split across reads is kept until it is complete */
+        TEST_CHECK(test_send(fd, "GET /split HT"));
+        usleep(20000);
+        TEST_CHECK(test_send(fd, "TP/1.1\r\nHost: t\r\n\r\n"));
+        test_receive(fd, 1, response, sizeof(response));
+        TEST_CHECK(strstr(response, "\r\n\r\n/split") != NULL);
+        close(fd);
+    }
+
+    /* Connections are independent */
+    int first = test_connect(port);
+    int second = test_connect(port);
+    TEST_CHECK(first >= 0 && second >= 0);
+    if (first >= 0 && second >= 0) {
+        TEST_CHECK(test_send(second, "GET /second HTTP/1.1\r\n\r\n"));
+        test_receive(second, 1, response, sizeof(response));
+        TEST_CHECK(strstr(response, "\r\n\r\n/second") != NULL);
+        TEST_CHECK(test_send(first, "GET /first HTTP/1.1\r\n\r\n"));
+        test_receive(first, 1, response, sizeof(response));
+        TEST_CHECK(strstr(response, "\r\n\r\n/first") != NULL);
+    }
+    if (first >= 0) {
+        close(first);
+    }
+    if (second >= 0) {
+        close(second);
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+}
+
+int main(void)
+{
+    TEST_RUN(test_buffer);
+    TEST_RUN(test_requests);
+    return TEST_RESULT();
+}
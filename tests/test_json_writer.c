@@ -0,0 +1,193 @@
+/**
+ * @file test_json_writer.c
+ * @brief Streaming JSON writer tests
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <dynamic.h>
+
+#include "test.h"
+#include "../src/include/domain/json_writer.h"
+
+/** Buffer and writer of one document */
+typedef struct {
+    buffer output;
+    json_writer_t writer;
+} test_document_t;
+
+static void test_document_begin(test_document_t *doc)
+{
+    buffer_construct(&doc->output);
+    TEST_CHECK(json_writer_init(&doc->writer, &doc->output) == JSON_WRITER_OK);
+}
+
+/** Finish the document and compare it with the expected text */
+#define TEST_DOCUMENT_END(doc, expected) \
+    do { \
+        size_t length = 0; \
+        TEST_CHECK(json_writer_finish(&(doc)->writer, &length) == JSON_WRITER_OK); \
+        TEST_CHECK_BYTES((doc)->output.data, length, expected); \
+        buffer_destruct(&(doc)->output); \
+    } while (0)
+
+static void test_object_members(void)
+{
+    test_document_t doc;
+    test_document_begin(&doc);
+    json_writer_begin_object(&doc.writer);
+    json_writer_key(&doc.writer, "message", 7);
+    json_writer_string(&doc.writer, "Hello, World!", 13);
+    json_writer_key(&doc.writer, "id", 2);
+    json_writer_int(&doc.writer, -42);
+    json_writer_key(&doc.writer, "ok", 2);
+    json_writer_bool(&doc.writer, true);
+    json_writer_key(&doc.writer, "none", 4);
+    json_writer_null(&doc.writer);
+    json_writer_end_object(&doc.writer);
+    TEST_DOCUMENT_END(&doc, "{\"message\":\"Hello, World!\",\"id\":-42,\"ok\":true,\"none\":null}");
+}
+
+static void test_nested_arrays(void)
+{
+    test_document_t doc;
+    test_document_begin(&doc);
+    json_writer_begin_array(&doc.writer);
+    json_writer_uint(&doc.writer, 0);
+    json_writer_uint(&doc.writer, UINT64_MAX);
+    json_writer_begin_array(&doc.writer);
+    json_writer_end_array(&doc.writer);
+    json_writer_begin_object(&doc.writer);
+    json_writer_end_object(&doc.writer);
+    json_writer_int(&doc.writer, INT64_MIN);
+    json_writer_end_array(&doc.writer);
+    TEST_DOCUMENT_END(&doc, "[0,18446744073709551615,[],{},-9223372036854775808]");
+}
+
+static void test_string_escapes(void)
+{
+    /* Long enough to cross the 16-byte vector scan with escapes on both sides of a block */
+    static const char input[] = "quote\" back\\slash\ttab\nnew\rret\x01\x1f ctl \x7f del \xc3\xa9 utf8 /";
+
+    test_document_t doc;
+    test_document_begin(&doc);
+    json_writer_string(&doc.writer, input, sizeof(input) - 1);
+    TEST_DOCUMENT_END(&doc, "\"quote\\\" back\\\\slash\\ttab\\nnew\\rret\\u0001\\u001f ctl \x7f del \xc3\xa9 utf8 /\"");
+}
+
+static void test_string_embedded_nul(void)
+{
+    test_document_t doc;
+    test_document_begin(&doc);
+    json_writer_string(&doc.writer, "a\0b", 3);
+    TEST_DOCUMENT_END(&doc, "\"a\\u0000b\"");
+}
+
+static void test_doubles(void)
+{
+    static const struct {
+        double value;
+        const char *text;
+    } cases[] = {
+        { 0.0, "0" }, { 1.5, "1.5" }, { -2.25, "-2.25" }, { 0.001, "0.001" }, { 0.1, "0.1" },
+        { 123456.789, "123456.789" }, { 1e300, "1e+300" }, { NAN, "null" }, { INFINITY, "null" }
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        buffer output;
+        json_writer_t writer;
+        size_t length = 0;
+
+        buffer_construct(&output);
+        json_writer_init(&writer, &output);
+        json_writer_double(&writer, cases[i].value);
+        TEST_CHECK(json_writer_finish(&writer, &length) == JSON_WRITER_OK);
+        TEST_CHECK(length == strlen(cases[i].text) && memcmp(output.data, cases[i].text, length) == 0);
+
+        /* Finite values read back as the same double */
+        if (isfinite(cases[i].value)) {
+            char text[64];
+            memcpy(text, output.data, length);
+            text[length] = '\0';
+            TEST_CHECK(strtod(text, NULL) == cases[i].value);
+        }
+        buffer_destruct(&output);
+    }
+}
+
+static void test_appends_after_existing_output(void)
+{
+    buffer output;
+    json_writer_t writer;
+    size_t length = 0;
+
+    buffer_construct(&output);
+    buffer_insert(&output, 0, "HEADERS", 7);
+    json_writer_init(&writer, &output);
+    json_writer_begin_array(&writer);
+    json_writer_end_array(&writer);
+    TEST_CHECK(json_writer_finish(&writer, &length) == JSON_WRITER_OK);
+    TEST_CHECK(length == 2);
+    TEST_CHECK_BYTES(output.data, output.size, "HEADERS[]");
+    buffer_destruct(&output);
+}
+
+static void test_state_errors(void)
+{
+    buffer output;
+    json_writer_t writer;
+
+    /* Key outside an object */
+    buffer_construct(&output);
+    json_writer_init(&writer, &output);
+    json_writer_begin_array(&writer);
+    TEST_CHECK(json_writer_key(&writer, "k", 1) == JSON_WRITER_ERROR_STATE);
+    /* Sticky: later calls keep failing and write nothing */
+    size_t size = output.size;
+    TEST_CHECK(json_writer_end_array(&writer) == JSON_WRITER_ERROR_STATE);
+    TEST_CHECK(output.size == size);
+    TEST_CHECK(json_writer_finish(&writer, NULL) == JSON_WRITER_ERROR_STATE);
+    buffer_destruct(&output);
+
+    /* Member value without a key */
+    buffer_construct(&output);
+    json_writer_init(&writer, &output);
+    json_writer_begin_object(&writer);
+    TEST_CHECK(json_writer_int(&writer, 1) == JSON_WRITER_ERROR_STATE);
+    buffer_destruct(&output);
+
+    /* Unbalanced close and unfinished document */
+    buffer_construct(&output);
+    json_writer_init(&writer, &output);
+    TEST_CHECK(json_writer_end_object(&writer) == JSON_WRITER_ERROR_DEPTH);
+    buffer_destruct(&output);
+
+    buffer_construct(&output);
+    json_writer_init(&writer, &output);
+    json_writer_begin_object(&writer);
+    TEST_CHECK(json_writer_finish(&writer, NULL) == JSON_WRITER_ERROR_STATE);
+    buffer_destruct(&output);
+
+    /* Nesting limit */
+    buffer_construct(&output);
+    json_writer_init(&writer, &output);
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH; i++) {
+        TEST_CHECK(json_writer_begin_array(&writer) == JSON_WRITER_OK);
+    }
+    TEST_CHECK(json_writer_begin_array(&writer) == JSON_WRITER_ERROR_DEPTH);
+    buffer_destruct(&output);
+}
+
+int main(void)
+{
+    TEST_RUN(test_object_members);
+    TEST_RUN(test_nested_arrays);
+    TEST_RUN(test_string_escapes);
+    TEST_RUN(test_string_embedded_nul);
+    TEST_RUN(test_doubles);
+    TEST_RUN(test_appends_after_existing_output);
+    TEST_RUN(test_state_errors);
+    return TEST_RESULT();
+}
@@ -0,0 +1,106 @@
+/**
+ * @file test_response_cache.c
+ * @brief Response cache key and eviction tests
+ */
+
+#include "test.h"
+#include "../src/include/domain/response_cache.h"
+
+static void test_key_normalization(void)
+{
+    response_cache_key_t a, b;
+
+    TEST_CHECK(response_cache_key(&a, 1, "b=2&a=1", 7) == RESPONSE_CACHE_OK);
+    TEST_CHECK(response_cache_key(&b, 1, "&a=1&&b=2&", 10) == RESPONSE_CACHE_OK);
+    TEST_CHECK_BYTES(a.data, a.length, "a=1&b=2");
+    TEST_CHECK_BYTES(b.data, b.length, "a=1&b=2");
+    TEST_CHECK(a.hash == b.hash);
+
+    /* The route is part of the key */
+    TEST_CHECK(response_cache_key(&b, 2, "a=1&b=2", 7) == RESPONSE_CACHE_OK);
+    TEST_CHECK(a.hash != b.hash);
+
+    TEST_CHECK(response_cache_key(&a, 1, NULL, 0) == RESPONSE_CACHE_OK);
+    TEST_CHECK(a.length == 0);
+    TEST_CHECK(response_cache_key(&a, 1, NULL, 1) == RESPONSE_CACHE_ERROR_INVALID_PARAM);
+}
+
+static void test_key_uncacheable(void)
+{
+    char query[RESPONSE_CACHE_MAX_KEY + 1];
+    response_cache_key_t key;
+
+    memset(query, 'q', sizeof(query));
+    TEST_CHECK(response_cache_key(&key, 1, query, sizeof(query)) == RESPONSE_CACHE_ERROR_UNCACHEABLE);
+
+    /* One parameter over the limit, compacted from empty ones */
+    size_t length = 0;
+    for (int i = 0; i <= RESPONSE_CACHE_MAX_PARAMS; i++) {
+        query[length++] = '&';
+        query[length++] = (char)('a' + i);
+    }
+    TEST_CHECK(response_cache_key(&key, 1, query, length) == RESPONSE_CACHE_ERROR_UNCACHEABLE);
+}
+
+static void test_store_lookup_expiry(void)
+{
+    response_cache_t cache;
+    response_cache_key_t key;
+
+    TEST_CHECK(response_cache_init(&cache, 4, 1024, 100) == RESPONSE_CACHE_OK);
+    response_cache_key(&key, 1, "n=5", 3);
+    TEST_CHECK(response_cache_lookup(&cache, &key, 0) == NULL);
+
+    TEST_CHECK(response_cache_store(&cache, &key, "first", 5, (size_t)-1, 0) == RESPONSE_CACHE_OK);
+    const response_cache_entry_t *entry = response_cache_lookup(&cache, &key, 99);
+    TEST_CHECK(entry && entry->length == 5 && memcmp(entry->data, "first", 5) == 0);
+    TEST_CHECK(response_cache_lookup(&cache, &key, 100) == NULL);
+
+    /* Storing again replaces the entry */
+    TEST_CHECK(response_cache_store(&cache, &key, "second", 6, (size_t)-1, 100) == RESPONSE_CACHE_OK);
+    entry = response_cache_lookup(&cache, &key, 150);
+    TEST_CHECK(entry && entry->length == 6 && memcmp(entry->data, "second", 6) == 0);
+    TEST_CHECK(cache.count == 1);
+
+    TEST_CHECK(response_cache_purge(&cache) == 1);
+    TEST_CHECK(response_cache_lookup(&cache, &key, 150) == NULL);
+    TEST_CHECK(cache.bytes == 0);
+    response_cache_cleanup(&cache);
+}
+
+static void test_byte_budget(void)
+{
+    response_cache_t cache;
+    response_cache_key_t keys[3];
+    char response[40];
+
+    memset(response, 'r', sizeof(response));
+    TEST_CHECK(response_cache_init(&cache, 8, 100, 1000) == RESPONSE_CACHE_OK);
+    response_cache_key(&keys[0], 1, "k=0", 3);
+    response_cache_key(&keys[1], 1, "k=1", 3);
+    response_cache_key(&keys[2], 1, "k=2", 3);
+
+    TEST_CHECK(response_cache_store(&cache, &keys[0], response, sizeof(response), (size_t)-1, 0) == RESPONSE_CACHE_OK);
+    TEST_CHECK(response_cache_store(&cache, &keys[1], response, sizeof(response), (size_t)-1, 0) == RESPONSE_CACHE_OK);
+
+    /* The third does not fit: the CLOCK hand evicts until it does */
+    TEST_CHECK(response_cache_store(&cache, &keys[2], response, sizeof(response), (size_t)-1, 0) == RESPONSE_CACHE_OK);
+    TEST_CHECK(cache.bytes <= 100);
+    TEST_CHECK(cache.count == 2);
+    TEST_CHECK(response_cache_lookup(&cache, &keys[2], 1) != NULL);
+
+    char large[128];
+    memset(large, 'l', sizeof(large));
+    TEST_CHECK(response_cache_store(&cache, &keys[0], large, sizeof(large), (size_t)-1, 0) ==
+               RESPONSE_CACHE_ERROR_UNCACHEABLE);
+    response_cache_cleanup(&cache);
+}
+
+int main(void)
+{
+    TEST_RUN(test_key_normalization);
+    TEST_RUN(test_key_uncacheable);
+    TEST_RUN(test_store_lookup_expiry);
+    TEST_RUN(test_byte_budget);
+    return TEST_RESULT();
+}
@@ -0,0 +1,177 @@
+/**
+ * @file test_server_config.c
+ * @brief Setting parser tests: values, options, config files, string ownership
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "test.h"
+#include "../src/include/infrastructure/server_config.h"
+
+static void test_numbers(void)
+{
+    server_config_t config = server_infrastructure_default_config();
+
+    TEST_CHECK(server_config_set(&config, "port", "8080") == SERVER_CONFIG_OK && config.port == 8080);
+    TEST_CHECK(server_config_set(&config, "port", "0") == SERVER_CONFIG_ERROR_INVALID_VALUE);
+    TEST_CHECK(server_config_set(&config, "port", "65536") == SERVER_CONFIG_ERROR_INVALID_VALUE);
+    TEST_CHECK(server_config_set(&config, "port", "80x") == SERVER_CONFIG_ERROR_INVALID_VALUE);
+    TEST_CHECK(server_config_set(&config, "port", NULL) == SERVER_CONFIG_ERROR_MISSING_VALUE);
+    TEST_CHECK(config.port == 8080);
+
+    TEST_CHECK(server_config_set(&config, "metrics-port", "9200") == SERVER_CONFIG_OK);
+    TEST_CHECK(config.enable_metrics && config.metrics_port == 9200);
+    TEST_CHECK(server_config_set(&config, "metrics-port", "0") == SERVER_CONFIG_OK);
+    TEST_CHECK(!config.enable_metrics && config.metrics_port == 9200);
+
+    TEST_CHECK(config.metrics_address == htonl(INADDR_LOOPBACK));
+    TEST_CHECK(server_config_set(&config, "metrics-address", "0.0.0.0") == SERVER_CONFIG_OK);
+    TEST_CHECK(config.metrics_address == htonl(INADDR_ANY));
+    TEST_CHECK(server_config_set(&config, "metrics-address", "localhost") == SERVER_CONFIG_ERROR_INVALID_VALUE);
+
+    TEST_CHECK(server_config_set(&config, "no-such-setting", "1") == SERVER_CONFIG_ERROR_UNKNOWN_KEY);
+    server_config_cleanup(&config);
+}
+
+static void test_booleans(void)
+{
+    server_config_t config = server_infrastructure_default_config();
+
+    TEST_CHECK(server_config_set(&config, "skip-smt", NULL) == SERVER_CONFIG_OK && config.skip_smt_siblings);
+    TEST_CHECK(server_config_set(&config, "skip-smt", "off") == SERVER_CONFIG_OK && !config.skip_smt_siblings);
+    TEST_CHECK(server_config_set(&config, "skip-smt", "YES") == SERVER_CONFIG_OK && config.skip_smt_siblings);
+    TEST_CHECK(server_config_set(&config, "skip-smt", "maybe") == SERVER_CONFIG_ERROR_INVALID_VALUE);
+    TEST_CHECK(config.skip_smt_siblings);
+    server_config_cleanup(&config);
+}
+
+static void test_strings(void)
+{
+    server_config_t config = server_infrastructure_default_config();
+
+    TEST_CHECK(config.plaintext_response && strcmp(config.plaintext_response, "Hello, World!") == 0);
+
+    /* Each value frees the one it replaces, the defaults included */
+    for (int i = 0; i < 3; i++) {
+        TEST_CHECK(server_config_set(&config, "plaintext-response", "text") == SERVER_CONFIG_OK);
+        TEST_CHECK(server_config_set(&config, "json-message", "message") == SERVER_CONFIG_OK);
+        TEST_CHECK(server_config_set(&config, "document-root", "/srv/www") == SERVER_CONFIG_OK);
+        TEST_CHECK(server_config_set(&config, "irq-interface", "eth0") == SERVER_CONFIG_OK);
+    }
+    TEST_CHECK(strcmp(config.plaintext_response, "text") == 0);
+    TEST_CHECK(strcmp(config.json_message, "message") == 0);
+    TEST_CHECK(strcmp(config.document_root, "/srv/www") == 0);
+    TEST_CHECK(strcmp(config.irq_interface, "eth0") == 0);
+
+    /* Invalid values keep the old one */
+    TEST_CHECK(server_config_set(&config, "irq-interface", "a/b") == SERVER_CONFIG_ERROR_INVALID_VALUE);
+    TEST_CHECK(strcmp(config.irq_interface, "eth0") == 0);
+
+    TEST_CHECK(server_config_set(&config, "document-root", "") == SERVER_CONFIG_OK && !config.document_root);
+    TEST_CHECK(server_config_set(&config, "irq-interface", "none") == SERVER_CONFIG_OK && !config.irq_interface);
+    TEST_CHECK(server_config_set(&config, "irq-interface", "") == SERVER_CONFIG_OK && !config.irq_interface);
+
+    TEST_CHECK(server_config_set(&config, "cpus", "0-1") == SERVER_CONFIG_OK);
+    TEST_CHECK(config.worker_config.worker_count == 2 && config.worker_config.cpu_ids[1] == 1);
+    TEST_CHECK(server_config_set(&config, "cpus", "x") == SERVER_CONFIG_ERROR_INVALID_VALUE);
+    TEST_CHECK(config.worker_config.worker_count == 2);
+
+    server_config_cleanup(&config);
+    TEST_CHECK(!config.plaintext_response && !config.json_message && !config.worker_config.cpu_ids);
+    server_config_cleanup(&config);
+}
+
+static void test_options(void)
+{
+    char *argv[] = {
+        "server", "--port", "81", "--workers=4", "--no-tcp-nodelay", "--skip-smt",
+        "--json-message", "hi", "--port", NULL
+    };
+    int argc = (int)(sizeof(argv) / sizeof(argv[0])) - 1;
+    server_config_t config = server_infrastructure_default_config();
+    config.socket_config.options |= SOCKET_OPT_NODELAY;
+
+    int i = 1;
+    TEST_CHECK(server_config_parse_option(&config, argc, argv, &i) == SERVER_CONFIG_OK && i == 2);
+    TEST_CHECK(config.port == 81);
+    i++;
+    TEST_CHECK(server_config_parse_option(&config, argc, argv, &i) == SERVER_CONFIG_OK && i == 3);
+    TEST_CHECK(config.workers == 4);
+    i++;
+    TEST_CHECK(server_config_parse_option(&config, argc, argv, &i) == SERVER_CONFIG_OK);
+    TEST_CHECK(!(config.socket_config.options & SOCKET_OPT_NODELAY));
+    i++;
+    TEST_CHECK(server_config_parse_option(&config, argc, argv, &i) == SERVER_CONFIG_OK && config.skip_smt_siblings);
+    i++;
+    TEST_CHECK(server_config_parse_option(&config, argc, argv, &i) == SERVER_CONFIG_OK && i == 7);
+    TEST_CHECK(strcmp(config.json_message, "hi") == 0);
+    i++;
+    TEST_CHECK(server_config_parse_option(&config, argc, argv, &i) == SERVER_CONFIG_ERROR_MISSING_VALUE);
+
+    char *unknown[] = { "server", "--no-port", "--bogus", "port" };
+    i = 1;
+    TEST_CHECK(server_config_parse_option(&config, 4, unknown, &i) == SERVER_CONFIG_ERROR_UNKNOWN_KEY);
+    i = 2;
+    TEST_CHECK(server_config_parse_option(&config, 4, unknown, &i) == SERVER_CONFIG_ERROR_UNKNOWN_KEY);
+    i = 3;
+    TEST_CHECK(server_config_parse_option(&config, 4, unknown, &i) == SERVER_CONFIG_ERROR_UNKNOWN_KEY);
+    server_config_cleanup(&config);
+}
+
+/** Write a config file and load it, returning the result */
+static server_config_error_t test_load(server_config_t *config, const char *text, int *line)
+{
+    char path[] = "/tmp/server_config_test.XXXXXX";
+    int fd = mkstemp(path);
+    TEST_CHECK(fd >= 0);
+    if (fd < 0) {
+        return SERVER_CONFIG_ERROR_IO;
+    }
+    TEST_CHECK(write(fd, text, strlen(text)) == (ssize_t)strlen(text));
+    close(fd);
+
+    server_config_error_t err = server_config_load_file(config, path, line);
+    unlink(path);
+    return err;
+}
+
+static void test_file(void)
+{
+    server_config_t config = server_infrastructure_default_config();
+    int line = -1;
+
+    TEST_CHECK(test_load(&config,
+                         "# comment\n"
+                         "\n"
+                         "port = 9000   # trailing comment\n"
+                         "  skip-smt=yes\n"
+                         "plaintext-response = \"  padded  \"\n"
+                         "document-root = /var/www\n",
+                         &line) == SERVER_CONFIG_OK);
+    TEST_CHECK(line == 0);
+    TEST_CHECK(config.port == 9000 && config.skip_smt_siblings);
+    TEST_CHECK(strcmp(config.plaintext_response, "  padded  ") == 0);
+    TEST_CHECK(strcmp(config.document_root, "/var/www") == 0);
+
+    /* Settings before the failing line stay applied */
+    TEST_CHECK(test_load(&config, "port = 9001\nworkers\nport = 9002\n", &line) == SERVER_CONFIG_ERROR_MISSING_VALUE);
+    TEST_CHECK(line == 2 && config.port == 9001);
+    TEST_CHECK(test_load(&config, "\nbogus = 1\n", &line) == SERVER_CONFIG_ERROR_UNKNOWN_KEY && line == 2);
+    TEST_CHECK(test_load(&config, "backlog = -1\n", &line) == SERVER_CONFIG_ERROR_INVALID_VALUE && line == 1);
+
+    TEST_CHECK(server_config_load_file(&config, "/nonexistent/config", &line) == SERVER_CONFIG_ERROR_IO);
+    TEST_CHECK(line == 0);
+    server_config_cleanup(&config);
+}
+
+int main(void)
+{
+    TEST_RUN(test_numbers);
+    TEST_RUN(test_booleans);
+    TEST_RUN(test_strings);
+    TEST_RUN(test_options);
+    TEST_RUN(test_file);
+    return TEST_RESULT();
+}